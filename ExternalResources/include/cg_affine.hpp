@@ -0,0 +1,119 @@
+#ifndef __CG_AFFINE_HPP__
+#define __CG_AFFINE_HPP__
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <type_traits>
+
+namespace cgicmc {
+
+///
+/// Sine and cosine usable in constant expressions: a Taylor series in
+/// double after reducing the angle to [-pi, pi], within 1e-12 before the
+/// result is rounded to float; at run time they are std::sin and std::cos
+constexpr double constexprSinSeries(double x) {
+  const double TWO_PI = 6.283185307179586;
+  long long turns = (long long)(x / TWO_PI + (x < 0.0 ? -0.5 : 0.5));
+  x -= (double)turns * TWO_PI;
+  double term = x, sum = x;
+  for (int i = 1; i < 14; i++) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr float constexprSin(float angle) {
+  if (!std::is_constant_evaluated())
+    return std::sin(angle);
+  return (float)constexprSinSeries(angle);
+}
+
+constexpr float constexprCos(float angle) {
+  if (!std::is_constant_evaluated())
+    return std::cos(angle);
+  // the quarter turn is added in double, not rounded to float first
+  return (float)constexprSinSeries((double)angle + 1.5707963267948966);
+}
+
+///
+/// 2D affine transform, the first two rows of a 3x3 matrix:
+///   x' = a x + c y + tx
+///   y' = b x + d y + ty
+/// Composing two of them takes 12 multiplications instead of the 64 of a
+/// mat4 product. a * b applies b first, as with matrices.
+struct Affine2D {
+  float a, b, c, d, tx, ty;
+
+  ///
+  /// Identity
+  constexpr Affine2D() : a(1.0f), b(0.0f), c(0.0f), d(1.0f), tx(0.0f), ty(0.0f) {}
+  constexpr Affine2D(float a, float b, float c, float d, float tx, float ty)
+      : a(a), b(b), c(c), d(d), tx(tx), ty(ty) {}
+
+  static constexpr Affine2D translation(float x, float y) { return Affine2D(1.0f, 0.0f, 0.0f, 1.0f, x, y); }
+  static constexpr Affine2D scaling(float x, float y) { return Affine2D(x, 0.0f, 0.0f, y, 0.0f, 0.0f); }
+
+  ///
+  /// Counter-clockwise rotation, from an angle or from its cosine and sine
+  static constexpr Affine2D rotation(float angle) { return rotation(constexprCos(angle), constexprSin(angle)); }
+  static constexpr Affine2D rotation(float cos, float sin) { return Affine2D(cos, sin, -sin, cos, 0.0f, 0.0f); }
+
+  ///
+  /// x' = x + shearX y, y' = y + shearY x
+  static constexpr Affine2D shearing(float shearX, float shearY) { return Affine2D(1.0f, shearY, shearX, 1.0f, 0.0f, 0.0f); }
+
+  ///
+  /// Mirror across the line through the origin along (x, y), which need
+  /// not be unit length
+  static constexpr Affine2D reflection(float x, float y) {
+    float s = 1.0f / (x * x + y * y);
+    return Affine2D((x * x - y * y) * s, 2.0f * x * y * s, 2.0f * x * y * s, (y * y - x * x) * s, 0.0f, 0.0f);
+  }
+
+  ///
+  /// The same transform with (x, y) as its fixed point instead of the
+  /// origin (a rotation or a scale about a pivot)
+  constexpr Affine2D about(float x, float y) const { return translation(x, y) * *this * translation(-x, -y); }
+
+  constexpr Affine2D operator*(const Affine2D &o) const {
+    return Affine2D(a * o.a + c * o.b, b * o.a + d * o.b,
+                    a * o.c + c * o.d, b * o.c + d * o.d,
+                    a * o.tx + c * o.ty + tx, b * o.tx + d * o.ty + ty);
+  }
+
+  constexpr bool operator==(const Affine2D &o) const {
+    return a == o.a && b == o.b && c == o.c && d == o.d && tx == o.tx && ty == o.ty;
+  }
+  constexpr bool operator!=(const Affine2D &o) const { return !(*this == o); }
+
+  glm::vec2 apply(glm::vec2 p) const { return glm::vec2(a * p.x + c * p.y + tx, b * p.x + d * p.y + ty); }
+  glm::vec2 applyVector(glm::vec2 v) const { return glm::vec2(a * v.x + c * v.y, b * v.x + d * v.y); }
+  glm::vec2 origin() const { return glm::vec2(tx, ty); }
+
+  ///
+  /// Angle the x axis is turned by (exact for rotations and uniform scales)
+  float angle() const;
+
+  Affine2D inverse() const;
+
+  constexpr float determinant() const { return a * d - b * c; }
+
+  ///
+  /// The same transform for the GL uniforms (column major, z unchanged)
+  glm::mat4 toMat4() const;
+};
+
+///
+/// Fold transforms applied in order (the first one first) into one:
+///   constexpr Affine2D m = chain(Affine2D::scaling(2, 2), Affine2D::rotation(0.5f).about(1, 0));
+inline constexpr Affine2D chain(const Affine2D &transform) { return transform; }
+
+template <typename... Rest>
+constexpr Affine2D chain(const Affine2D &first, const Rest &...rest) {
+  return chain(rest...) * first;
+}
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef __CG_ANIMATION_HPP__
+#define __CG_ANIMATION_HPP__
+
+#include <cg_affine.hpp>
+#include <glm/glm.hpp>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Scalar values a clip animates
+enum class AnimationChannel {
+  PositionX = 0, PositionY, Rotation, ScaleX, ScaleY, Red, Green, Blue, Alpha
+};
+
+const int ANIMATION_CHANNEL_COUNT = 9;
+
+///
+/// How a track goes from a key to the next one: holding the value,
+/// linearly, or along a Catmull-Rom spline through the neighbouring keys
+enum class Interpolation { Step, Linear, Smooth };
+
+///
+/// Keyframed tracks (one per channel) over a duration in seconds. The
+/// interpolation of a key applies from it to the next key; before the
+/// first key and after the last one a track holds its value, and a track
+/// without keys stays at the rest value (position and rotation 0, scale
+/// and color 1).
+class AnimationClip {
+public:
+  AnimationClip(float duration, bool looping = true);
+
+  void addKey(AnimationChannel channel, float time, float value, Interpolation mode = Interpolation::Linear);
+  void addPositionKey(float time, glm::vec2 position, Interpolation mode = Interpolation::Linear);
+  void addRotationKey(float time, float angle, Interpolation mode = Interpolation::Linear);
+  void addScaleKey(float time, glm::vec2 scale, Interpolation mode = Interpolation::Linear);
+  void addColorKey(float time, glm::vec4 color, Interpolation mode = Interpolation::Linear);
+
+  float duration() const { return _duration; }
+  bool looping() const { return _looping; }
+
+  ///
+  /// Value of a channel at a time of the clip, straight from the keys
+  /// (the reference the Animator is checked against)
+  float evaluate(AnimationChannel channel, float time) const;
+
+  static float restValue(AnimationChannel channel);
+
+private:
+  friend class Animator;
+
+  struct Key {
+    float time, value;
+    Interpolation mode;
+  };
+
+  // cubic a + b s + c s^2 + d s^3 from key i (s = 0) to key i + 1 (s = 1)
+  void keyCubic(int channel, int i, float coefficients[4]) const;
+
+  float _duration;
+  bool _looping;
+  std::vector<Key> _keys[ANIMATION_CHANNEL_COUNT]; // sorted by time
+};
+
+///
+/// Plays clips on many objects at once. Each object has two layers (a
+/// clip with its own time and speed) mixed by a weight, which fades from
+/// one to the other when a new clip is played, or stays put to blend two
+/// clips.
+///
+/// The clips are baked when added: the key times of all their channels
+/// are merged into one timeline and every channel is cut into a cubic
+/// polynomial per interval of it (cutting a cubic gives cubics, so this
+/// is exact). An object keeps the bounds of its current segment, so a
+/// lookup is only needed when its time leaves them, and every channel is
+/// evaluated with a Horner scheme. The object state and the results are
+/// stored structure of arrays, and the time advance, the fades, the
+/// segment bound tests and the channel evaluations run over the objects
+/// in SIMD batches (SSE, 4 objects per instruction, with a scalar path
+/// where it is not available).
+class Animator {
+public:
+  Animator();
+
+  ///
+  /// Bake a clip and return its index
+  int addClip(const AnimationClip &clip);
+
+  ///
+  /// Remove the objects (the clips stay)
+  void clearObjects();
+
+  ///
+  /// Add an object playing a clip from a time at a speed (>= 0) and
+  /// return its index
+  int addObject(int clip, float time = 0.0f, float speed = 1.0f);
+
+  ///
+  /// Fade from what the object plays to a clip, played from its start,
+  /// over fadeSeconds
+  void play(int object, int clip, float fadeSeconds = 0.0f, float speed = 1.0f);
+
+  ///
+  /// Play two clips at once, mixed with a fixed weight (0 is clipA)
+  void blend(int object, int clipA, int clipB, float weight);
+
+  ///
+  /// Advance every object by dt seconds and evaluate its channels
+  void update(float dt);
+
+  int objectCount() const { return _count; }
+
+  ///
+  /// Results of the last update, one array per channel
+  const float *channel(AnimationChannel channel) const { return _values[(int)channel].data(); }
+  float value(int object, AnimationChannel channel) const { return _values[(int)channel][object]; }
+  glm::vec2 position(int object) const;
+  float rotation(int object) const { return value(object, AnimationChannel::Rotation); }
+  glm::vec2 scale(int object) const;
+  glm::vec4 color(int object) const;
+
+  ///
+  /// Transform of every object as of the last update (scale, then
+  /// rotation, then translation), into out[0, objectCount()); the sines
+  /// and cosines of the rotations are computed in SIMD batches
+  void transforms(Affine2D *out) const;
+
+  ///
+  /// Clip and time of the layer an object fades to (or the second clip of
+  /// a blend)
+  int clip(int object) const { return _clip[1][object]; }
+  float time(int object) const { return _time[1][object]; }
+
+  ///
+  /// Evaluate with the scalar code instead of SIMD (for comparison)
+  void setVectorized(bool vectorized) { _vectorized = vectorized; }
+
+  ///
+  /// Time taken by the last update()
+  double updateMilliseconds() const { return _updateMilliseconds; }
+
+private:
+  struct BakedClip {
+    float duration;
+    bool looping;
+    int firstSegment, segmentCount;
+  };
+
+  // set a layer of an object to a clip and a time
+  void setLayer(int layer, int object, int clip, float time, float speed);
+  void advance(float dt);
+  void findSegments();
+  void findSegment(int layer, int object);
+  void evaluate();
+
+  // clips: segment s starts at _segmentStart[s], lasts 1 / _segmentScale[s]
+  // and has the coefficients a, b, c, d of each channel at
+  // _coefficients[(s * ANIMATION_CHANNEL_COUNT + channel) * 4]
+  std::vector<BakedClip> _clips;
+  std::vector<float> _segmentStart, _segmentScale, _coefficients;
+
+  // objects, per layer
+  int _count;
+  std::vector<int> _clip[2], _segment[2];
+  std::vector<float> _time[2], _speed[2], _duration[2], _looping[2];
+  std::vector<float> _weight, _fadeRate;
+
+  // per layer: the bounds of the current segment of each object (the
+  // last segment of a clip never ends) and the parameter in it
+  std::vector<float> _segmentBegin[2], _segmentEnd[2], _segmentObjectScale[2];
+  std::vector<float> _u[2];
+
+  std::vector<float> _values[ANIMATION_CHANNEL_COUNT];
+  bool _vectorized;
+  double _updateMilliseconds;
+};
+
+///
+/// Play clips on objectCount objects (a quarter of them fading between
+/// clips) for a few seconds and print the update time of the SIMD and the
+/// scalar evaluation, and their largest difference with the clips' own
+/// evaluation
+void benchmarkAnimation(std::ostream &out, int objectCount);
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef __CG_ANTIALIASING_HPP__
+#define __CG_ANTIALIASING_HPP__
+
+#include <cg_bounds.hpp>
+#include <cg_framebuffer.hpp>
+#include <cg_gpu_timer.hpp>
+#include <glad/glad.h>
+#include <iostream>
+
+namespace cgicmc {
+
+///
+/// Anti-aliasing strategies, from cheapest to most expensive fill cost
+enum class AAMode {
+  Off,          // render straight to the output, no smoothing
+  AnalyticEdge, // coverage computed by the fragment shader, blended
+  FXAA,         // single sampled offscreen target + FXAA post-pass
+  MSAA2x,       // multisampled offscreen target + resolve blit
+  MSAA4x,
+  MSAA8x,
+  Count
+};
+
+///
+/// Human readable name of a mode
+const char *aaModeName(AAMode mode);
+
+///
+/// Owns the offscreen targets and passes needed by each AAMode and
+/// measures the GPU time of every frame rendered with it.
+///
+/// Usage per frame:
+///   beginFrame(output) -> clear + draw the scene -> endFrame(output, w, h)
+class AntiAliasing {
+public:
+  AntiAliasing();
+
+  ///
+  /// Allocate shaders and queries. Targets are allocated lazily, the first
+  /// time a mode that needs them is used.
+  void create(int width, int height);
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Change the size of the rendered scene. Offscreen targets only grow,
+  /// a smaller scene is rendered into a part of them.
+  void resize(int width, int height);
+
+  void setMode(AAMode mode);
+  AAMode mode() const { return _mode; }
+
+  ///
+  /// Select the next mode (wraps around)
+  void cycleMode();
+
+  ///
+  /// True when fragment shaders should output their own edge coverage
+  bool analyticEdges() const { return _mode == AAMode::AnalyticEdge; }
+
+  ///
+  /// Start timing and bind the target the scene must be drawn into
+  void beginFrame(GLuint outputFramebuffer);
+
+  ///
+  /// Framebuffer bound by the last beginFrame()
+  GLuint sceneFramebuffer() const { return _sceneFramebuffer; }
+
+  ///
+  /// Resolve/filter the scene into the output and stop timing. With
+  /// regions only those parts of the output are updated (partial redraw:
+  /// the rectangles that were drawn, each resolved on its own); the
+  /// offscreen targets then keep their content for the following frames.
+  void endFrame(GLuint outputFramebuffer, int outputWidth, int outputHeight, const PixelRect *regions = NULL,
+    int regionCount = 1);
+
+  ///
+  /// Average GPU milliseconds per frame measured for a mode
+  double frameMilliseconds(AAMode mode) const;
+
+  ///
+  /// Most recent GPU milliseconds measured for the current mode
+  double lastFrameMilliseconds() const { return _timers[(int)_mode].lastMilliseconds(); }
+
+  ///
+  /// Print the average GPU cost of every mode that was used
+  void report(std::ostream &out) const;
+
+private:
+  int samplesFor(AAMode mode) const;
+  void resolveRegion(GLuint outputFramebuffer, int outputWidth, int outputHeight, const PixelRect *region);
+
+  AAMode _mode;
+  int _width, _height;
+  bool _created;
+  GLuint _sceneFramebuffer;
+
+  Framebuffer _multisampled; // MSAA modes
+  Framebuffer _resolved;     // FXAA input
+  GLuint _fxaaProgram;
+  GLint _fxaaTexelSize, _fxaaUVScale, _fxaaUVLimit;
+  GLuint _emptyVAO;
+
+  GpuTimer _timers[(int)AAMode::Count];
+};
+}
+
+#endif
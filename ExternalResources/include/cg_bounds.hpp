@@ -0,0 +1,103 @@
+#ifndef __CG_BOUNDS_HPP__
+#define __CG_BOUNDS_HPP__
+
+#include <glm/glm.hpp>
+#include <algorithm>
+
+namespace cgicmc {
+
+///
+/// Axis aligned bounding box in world (or clip) space
+struct AABB {
+  glm::vec2 min, max;
+
+  AABB() : min(1e30f, 1e30f), max(-1e30f, -1e30f) {}
+  AABB(glm::vec2 min, glm::vec2 max) : min(min), max(max) {}
+
+  ///
+  /// Box of a circle
+  static AABB around(glm::vec2 center, float radius) {
+    return AABB(glm::vec2(center.x - radius, center.y - radius), glm::vec2(center.x + radius, center.y + radius));
+  }
+
+  bool empty() const { return min.x > max.x || min.y > max.y; }
+  glm::vec2 center() const { return glm::vec2((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f); }
+  glm::vec2 size() const { return glm::vec2(max.x - min.x, max.y - min.y); }
+  float area() const { return empty() ? 0.0f : (max.x - min.x) * (max.y - min.y); }
+
+  void expand(glm::vec2 point) {
+    min.x = std::min(min.x, point.x);
+    min.y = std::min(min.y, point.y);
+    max.x = std::max(max.x, point.x);
+    max.y = std::max(max.y, point.y);
+  }
+
+  void expand(const AABB &other) {
+    min.x = std::min(min.x, other.min.x);
+    min.y = std::min(min.y, other.min.y);
+    max.x = std::max(max.x, other.max.x);
+    max.y = std::max(max.y, other.max.y);
+  }
+
+  bool intersects(const AABB &other) const {
+    return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+  }
+
+  bool contains(glm::vec2 point) const {
+    return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y;
+  }
+
+  bool contains(const AABB &other) const {
+    return other.min.x >= min.x && other.max.x <= max.x && other.min.y >= min.y && other.max.y <= max.y;
+  }
+};
+
+///
+/// True if the point is inside the triangle (either winding)
+inline bool pointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+  float d0 = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+  float d1 = (c.x - b.x) * (p.y - b.y) - (c.y - b.y) * (p.x - b.x);
+  float d2 = (a.x - c.x) * (p.y - c.y) - (a.y - c.y) * (p.x - c.x);
+  bool negative = d0 < 0.0f || d1 < 0.0f || d2 < 0.0f;
+  bool positive = d0 > 0.0f || d1 > 0.0f || d2 > 0.0f;
+  return !(negative && positive);
+}
+
+///
+/// Rectangle in framebuffer pixels (origin at the bottom left, like GL)
+struct PixelRect {
+  int x, y, width, height;
+
+  PixelRect() : x(0), y(0), width(0), height(0) {}
+  PixelRect(int x, int y, int width, int height) : x(x), y(y), width(width), height(height) {}
+
+  bool empty() const { return width <= 0 || height <= 0; }
+  long long area() const { return empty() ? 0 : (long long)width * height; }
+
+  ///
+  /// Smallest rectangle containing both
+  PixelRect merged(const PixelRect &other) const {
+    if (empty())
+      return other;
+    if (other.empty())
+      return *this;
+    int x0 = std::min(x, other.x), y0 = std::min(y, other.y);
+    int x1 = std::max(x + width, other.x + other.width), y1 = std::max(y + height, other.y + other.height);
+    return PixelRect(x0, y0, x1 - x0, y1 - y0);
+  }
+
+  ///
+  /// Part of the rectangle inside the other one
+  PixelRect clipped(const PixelRect &other) const {
+    int x0 = std::max(x, other.x), y0 = std::max(y, other.y);
+    int x1 = std::min(x + width, other.x + other.width), y1 = std::min(y + height, other.y + other.height);
+    return PixelRect(x0, y0, x1 - x0, y1 - y0);
+  }
+
+  bool overlaps(const PixelRect &other) const {
+    return !clipped(other).empty();
+  }
+};
+}
+
+#endif
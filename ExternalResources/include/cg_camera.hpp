@@ -0,0 +1,107 @@
+#ifndef __CG_CAMERA_HPP__
+#define __CG_CAMERA_HPP__
+
+#include <cg_bounds.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp> // glm::mat4
+
+namespace cgicmc {
+
+///
+/// GLSL declaration of the camera uniform block (std140), to be pasted in
+/// the shaders that read it:
+///   camera.view:     world to clip space
+///   camera.visible:  visible world bounds (min.xy, max.xy)
+///   camera.viewport: width, height in pixels, world units per pixel, zoom
+#define CAMERA_BLOCK_GLSL                                                    \
+  "layout (std140) uniform Camera {\n"                                       \
+  "   mat4 view;\n"                                                          \
+  "   vec4 visible;\n"                                                       \
+  "   vec4 viewport;\n"                                                      \
+  "} camera;\n"
+
+///
+/// 2D orthographic camera. At zoom 1 the visible height is 2 world units
+/// (like clip space) and the width follows the viewport aspect, so shapes
+/// are never stretched. The matrices and bounds live in a uniform buffer
+/// that is uploaded at most once per frame and shared by every program.
+class Camera {
+public:
+  ///
+  /// Uniform buffer binding point of the camera block
+  static const GLuint BINDING = 0;
+
+  Camera();
+
+  ///
+  /// Allocate the uniform buffer (requires a current context)
+  void create();
+
+  ///
+  /// Release the uniform buffer
+  void destroy();
+
+  ///
+  /// Connect the Camera block of a program to the camera binding point
+  static void bindBlock(GLuint program);
+
+  ///
+  /// Size in pixels of the viewport the camera renders to
+  void setViewport(int width, int height);
+
+  void setPosition(glm::vec2 position);
+  glm::vec2 position() const { return _position; }
+
+  ///
+  /// Move the camera by a distance in world units
+  void pan(glm::vec2 delta);
+
+  void setZoom(float zoom);
+  float zoom() const { return _zoom; }
+
+  ///
+  /// Zoom by a factor keeping the world point under a clip space position
+  /// (e.g. the mouse cursor) in place
+  void zoomAt(glm::vec2 clipPoint, float factor);
+
+  ///
+  /// World to clip space matrix
+  glm::mat4 view() const;
+
+  ///
+  /// World bounds covered by the viewport
+  AABB visibleBounds() const;
+
+  ///
+  /// World units covered by one pixel
+  float pixelSize() const;
+
+  ///
+  /// Conversions between world and clip space
+  glm::vec2 toWorld(glm::vec2 clipPoint) const;
+  AABB toClip(const AABB &world) const;
+
+  ///
+  /// Increases every time the view changes
+  unsigned version() const { return _version; }
+
+  ///
+  /// Upload the uniform block if the view changed since the last upload
+  void upload();
+
+  ///
+  /// Bind the uniform buffer to the camera binding point
+  void bind() const;
+
+private:
+  glm::vec2 _position;
+  float _zoom;
+  int _viewportWidth, _viewportHeight;
+  unsigned _version, _uploadedVersion;
+
+  GLuint _ubo;
+};
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef __CG_COLLISION_HPP__
+#define __CG_COLLISION_HPP__
+
+#include <cg_bounds.hpp>
+#include <cg_thread_pool.hpp>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Algorithm finding the bodies whose bounds overlap
+enum class BroadphaseType { SweepAndPrune, SpatialHash };
+
+const char *broadphaseName(BroadphaseType type);
+
+///
+/// Two bodies whose bounds overlap (a < b)
+struct BodyPair {
+  int a, b;
+};
+
+///
+/// Point where two bodies touch: the normal points from a to b and depth
+/// is how far they overlap along it. The feature identifies the polygons
+/// and edges that produced the point, so a contact can be matched with
+/// the same one in the next update.
+struct Contact {
+  int a, b;
+  glm::vec2 normal;
+  glm::vec2 point;
+  float depth;
+  unsigned feature;
+};
+
+///
+/// Collision detection between rigid 2D bodies made of convex polygons
+/// (a triangle mesh is one polygon per triangle).
+///
+/// The broadphase is either an incremental sweep and prune (the bodies stay
+/// sorted by the left side of their bounds between updates, so the
+/// insertion sort touches few elements when they move a little; static
+/// bodies only look for the dynamic ones, so a large static scene costs
+/// little) or a
+/// spatial hash (the bodies are binned into cells keyed by their
+/// coordinates and sorted by key; a pair is reported by the cell holding
+/// the corner of the overlap only). The narrowphase uses the separating
+/// axis test between the polygons and clips the incident edge against the
+/// reference edge to get up to two contact points per polygon pair.
+///
+/// Pair generation and contact generation are split among the threads of
+/// a pool in fixed chunks, so the results are identical for a given
+/// thread count.
+class CollisionWorld {
+public:
+  static const int MAX_POLYGON_VERTICES = 8;
+
+  CollisionWorld();
+
+  void setThreadCount(int threadCount);
+  int threadCount() const { return _pool.threadCount(); }
+
+  void setBroadphase(BroadphaseType type) { _broadphase = type; }
+  BroadphaseType broadphase() const { return _broadphase; }
+
+  ///
+  /// Distance under which polygons that do not overlap yet still produce
+  /// contacts (with a negative depth), so resting contacts do not flicker
+  void setMargin(float margin);
+  float margin() const { return _margin; }
+
+  ///
+  /// Remove every body
+  void clear();
+
+  ///
+  /// Add a body made of the triangles of a mesh (3 vertices each, in the
+  /// body frame) and return its index. Static bodies never collide with
+  /// each other.
+  int addMesh(const std::vector<glm::vec2> &triangles, bool dynamic = true);
+
+  ///
+  /// Add a body made of one convex polygon (at most MAX_POLYGON_VERTICES)
+  int addPolygon(const std::vector<glm::vec2> &polygon, bool dynamic = true);
+
+  ///
+  /// Place a body: rotated counter-clockwise by angle, then translated
+  void setTransform(int body, glm::vec2 position, float angle);
+
+  int bodyCount() const { return (int)_bodies.size(); }
+  const AABB &bounds(int body) const { return _bounds[body]; }
+
+  ///
+  /// Broadphase: find the pairs of bodies whose bounds overlap
+  void findPairs();
+
+  ///
+  /// Narrowphase: find the contacts of the pairs
+  void findContacts();
+
+  ///
+  /// Both phases
+  void update();
+
+  const std::vector<BodyPair> &pairs() const { return _pairs; }
+  const std::vector<Contact> &contacts() const { return _contacts; }
+
+  ///
+  /// True if the last findContacts() found a contact involving the body
+  bool touching(int body) const;
+
+  ///
+  /// Time taken by the last findPairs() and findContacts()
+  double pairMilliseconds() const { return _pairMilliseconds; }
+  double contactMilliseconds() const { return _contactMilliseconds; }
+
+private:
+  struct Body {
+    int firstPart, partCount;
+    glm::vec2 position;
+    float angle;
+    bool dynamic;
+  };
+
+  // convex polygon, counter-clockwise, vertices in _localVertices
+  struct Part {
+    int first, count;
+  };
+
+  int addBody(bool dynamic);
+  void addPart(const glm::vec2 *vertices, int count);
+  void updateGeometry();
+  void sweepAndPrune();
+  void spatialHash();
+  void collideBodies(int a, int b, std::vector<Contact> &contacts) const;
+
+  std::vector<Body> _bodies;
+  std::vector<Part> _parts;
+  std::vector<glm::vec2> _localVertices, _worldVertices;
+  std::vector<AABB> _bounds;
+  std::vector<char> _moved;
+  bool _geometryDirty;
+  float _margin;
+
+  BroadphaseType _broadphase;
+  std::vector<int> _sorted; // sweep and prune order
+  std::vector<int> _dynamicPositions; // where the dynamic bodies are in it
+  std::vector<std::pair<uint64_t, int>> _cells; // spatial hash entries
+  float _cellSize;
+
+  std::vector<BodyPair> _pairs;
+  std::vector<Contact> _contacts;
+  std::vector<std::vector<BodyPair>> _chunkPairs;
+  std::vector<std::vector<Contact>> _chunkContacts;
+  std::vector<std::vector<std::pair<uint64_t, int>>> _chunkCells;
+
+  ThreadPool _pool;
+  double _pairMilliseconds, _contactMilliseconds;
+};
+
+///
+/// Move bodyCount random triangles and boxes for a few frames and print
+/// the broadphase and narrowphase throughput of each broadphase, single
+/// threaded and with every hardware thread
+void benchmarkCollision(std::ostream &out, int bodyCount);
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __CG_DAMAGE_HPP__
+#define __CG_DAMAGE_HPP__
+
+#include <cg_bounds.hpp>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Collects the screen regions that changed during a frame (the bounds of
+/// every object before and after it moved), merges them into a few
+/// rectangles to redraw with scissoring and keeps a short history so a
+/// back buffer of known age can be brought up to date.
+class DamageTracker {
+public:
+  static const int MAX_RECTS = 8;
+  static const int HISTORY = 4;
+
+  DamageTracker();
+
+  ///
+  /// Change the surface size (the whole surface becomes damaged)
+  void resize(int width, int height);
+
+  ///
+  /// Damage the whole surface on the next frame
+  void invalidate();
+
+  ///
+  /// Damage a rectangle in pixels
+  void addRect(const PixelRect &rect);
+
+  ///
+  /// Damage the pixels covered by bounds given in clip space ([-1, 1]),
+  /// grown by a margin in pixels for the anti-aliased edges
+  void addClipBounds(const AABB &bounds, int margin = 2);
+
+  ///
+  /// Merge the damage of the current frame, record it in the history and
+  /// return the rectangles that must be redrawn (empty: nothing changed)
+  const std::vector<PixelRect> &resolve();
+
+  ///
+  /// Rectangles returned by the last resolve()
+  const std::vector<PixelRect> &rects() const { return _rects; }
+
+  ///
+  /// Smallest rectangle containing the damage of the last resolve()
+  PixelRect bounds() const;
+
+  ///
+  /// Region to update in a back buffer whose content is bufferAge frames
+  /// old (0: unknown age, the whole surface)
+  PixelRect presentRegion(int bufferAge) const;
+
+  ///
+  /// Fraction of the surface redrawn by the last frame
+  double touchedFraction() const { return _touched; }
+
+  ///
+  /// Moving average of touchedFraction()
+  double averageTouchedFraction() const { return _averageTouched; }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+private:
+  void merge();
+
+  int _width, _height;
+  bool _fullDamage;
+  std::vector<PixelRect> _pending;
+  std::vector<PixelRect> _rects;
+
+  // union of the damage of the last frames, most recent first
+  PixelRect _history[HISTORY];
+  int _historySize;
+
+  double _touched, _averageTouched;
+};
+}
+
+#endif
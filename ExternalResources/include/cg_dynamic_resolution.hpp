@@ -0,0 +1,82 @@
+#ifndef __CG_DYNAMIC_RESOLUTION_HPP__
+#define __CG_DYNAMIC_RESOLUTION_HPP__
+
+#include <cg_framebuffer.hpp>
+#include <glad/glad.h>
+
+namespace cgicmc {
+
+///
+/// Filter used to bring the scene back to the window resolution
+enum class UpscaleFilter { Bilinear, Sharpen };
+
+///
+/// Renders the scene at a fraction of the output resolution and adapts
+/// that fraction to the measured GPU frame time: above the budget (plus
+/// hysteresis) the scale drops in proportion to the excess, below it (minus
+/// hysteresis) it grows back slowly. The scene target is allocated at the
+/// full output size once, so changing the scale never reallocates.
+class DynamicResolution {
+public:
+  DynamicResolution();
+
+  ///
+  /// Allocate the target and upscale shader for the output size
+  void create(int outputWidth, int outputHeight);
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Change the output size (the scale is kept)
+  void resize(int outputWidth, int outputHeight);
+
+  ///
+  /// GPU milliseconds per frame to stay within, and the relative band
+  /// around it where the scale is left alone
+  void setBudget(double targetMilliseconds, double hysteresis = 0.1);
+
+  ///
+  /// Limits of the scale (fraction of the output width and height)
+  void setScaleRange(float minScale, float maxScale);
+
+  ///
+  /// Go back to the largest scale of the range
+  void reset();
+
+  void setFilter(UpscaleFilter filter) { _filter = filter; }
+  UpscaleFilter filter() const { return _filter; }
+
+  ///
+  /// Feed the GPU time of the last measured frame and adapt the scale
+  void update(double gpuMilliseconds);
+
+  float scale() const { return _scale; }
+  int renderWidth() const;
+  int renderHeight() const;
+
+  ///
+  /// Target the scene must be rendered into (at renderWidth x renderHeight)
+  GLuint framebuffer() const { return _target.id(); }
+
+  ///
+  /// Draw the scene, filtered, over the whole output
+  void upscale(GLuint outputFramebuffer);
+
+private:
+  Framebuffer _target;
+  int _outputWidth, _outputHeight;
+
+  float _scale, _minScale, _maxScale;
+  double _targetMilliseconds, _hysteresis;
+  int _cooldown;
+  UpscaleFilter _filter;
+
+  GLuint _program;
+  GLint _uvScaleLocation, _texelSizeLocation, _sharpenLocation;
+  GLuint _emptyVAO;
+};
+}
+
+#endif
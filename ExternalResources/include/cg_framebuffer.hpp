@@ -0,0 +1,65 @@
+#ifndef __CG_FRAMEBUFFER_HPP__
+#define __CG_FRAMEBUFFER_HPP__
+
+#include <glad/glad.h>
+
+namespace cgicmc {
+
+///
+/// Offscreen render target with a single RGBA8 color attachment.
+/// Single sampled targets use a texture (so they can be sampled by a
+/// post-processing pass), multisampled targets use a renderbuffer that
+/// must be resolved with a blit.
+class Framebuffer {
+public:
+  Framebuffer();
+
+  ///
+  /// Allocate the target with the specified size and sample count
+  void create(int width, int height, int samples = 0);
+
+  ///
+  /// Release the GL objects
+  void destroy();
+
+  ///
+  /// Reallocate the attachments if the size or sample count changed
+  void resize(int width, int height, int samples);
+
+  ///
+  /// Make sure the target is at least the given size, so rendering at a
+  /// varying size inside it does not reallocate. The capacity grows
+  /// geometrically (see growCapacity()) and shrinks only when the requested
+  /// area falls below a quarter of it, so a sequence of resize events
+  /// reallocates a few times instead of once per event.
+  void reserve(int width, int height, int samples);
+
+  ///
+  /// Capacity to allocate for a dimension that must hold requested
+  static int growCapacity(int current, int requested);
+
+  ///
+  /// Number of target allocations since the program started
+  static int allocationCount();
+
+  ///
+  /// Bind as GL_FRAMEBUFFER and set the viewport to cover it
+  void bind() const;
+
+  GLuint id() const { return _fbo; }
+  GLuint colorTexture() const { return _colorTexture; }
+  int width() const { return _width; }
+  int height() const { return _height; }
+  int samples() const { return _samples; }
+  bool valid() const { return _fbo != 0; }
+
+private:
+  GLuint _fbo;
+  GLuint _colorTexture;
+  GLuint _colorRenderbuffer;
+  int _width, _height, _samples;
+  int _requestedSamples;
+};
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __CG_GPU_TIMER_HPP__
+#define __CG_GPU_TIMER_HPP__
+
+#include <glad/glad.h>
+
+namespace cgicmc {
+
+///
+/// Measures GPU time with GL_TIME_ELAPSED queries. Queries are kept in a
+/// small ring and read back only once their results are available, so the
+/// measured value lags a few frames behind but never stalls the pipeline.
+class GpuTimer {
+public:
+  GpuTimer();
+
+  ///
+  /// Allocate the query objects (requires a current context)
+  void create();
+
+  ///
+  /// Release the query objects
+  void destroy();
+
+  ///
+  /// Start timing. Frames are skipped if every query is still in flight.
+  void begin();
+
+  ///
+  /// Stop timing the commands issued since begin()
+  void end();
+
+  ///
+  /// Most recent completed measurement, in milliseconds
+  double lastMilliseconds() const { return _last; }
+
+  ///
+  /// Exponential moving average of the measurements, in milliseconds
+  double averageMilliseconds() const { return _average; }
+
+  ///
+  /// Number of completed measurements
+  unsigned samples() const { return _samples; }
+
+private:
+  void collect();
+
+  static const int QUERY_COUNT = 4;
+  GLuint _queries[QUERY_COUNT];
+  bool _pending[QUERY_COUNT];
+  int _next;
+  bool _active;
+  bool _created;
+
+  double _last, _average;
+  unsigned _samples;
+};
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __CG_LAYERS_HPP__
+#define __CG_LAYERS_HPP__
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <functional>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Retained layers: each layer caches its content in one slice of a
+/// texture array and is redrawn only when marked dirty. Every frame the
+/// visible layers are composited, each with its own transform, by a single
+/// instanced draw, so an unchanged layer costs one textured quad.
+class LayerCompositor {
+public:
+  ///
+  /// Draws the content of a layer into the bound framebuffer (viewport
+  /// already set to the layer size, passed as arguments)
+  typedef std::function<void(int width, int height)> DrawFunction;
+
+  static const int MAX_LAYERS = 16;
+
+  LayerCompositor();
+
+  ///
+  /// Allocate the layer storage and compositing shader
+  void create(int width, int height);
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Change the size of the layers (every layer is redrawn). The storage
+  /// grows geometrically like Framebuffer::reserve(), so a sequence of
+  /// resize events reallocates only a few times.
+  void resize(int width, int height);
+
+  ///
+  /// Add a layer drawn by the given function on top of the existing ones.
+  /// Content is drawn over clearColor (premultiplied alpha); draw functions
+  /// that blend must use glBlendFuncSeparate(GL_SRC_ALPHA,
+  /// GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA) so the layer
+  /// stays premultiplied. Returns the layer index or -1 if every slice is
+  /// in use.
+  int addLayer(DrawFunction draw, glm::vec4 clearColor = glm::vec4(0.0f));
+
+  ///
+  /// Request a redraw of the layer content on the next render()
+  void markDirty(int layer);
+
+  ///
+  /// Request a redraw of every layer
+  void markAllDirty();
+
+  ///
+  /// Transform applied to the layer quad (clip space) when compositing
+  void setTransform(int layer, const glm::mat4 &transform);
+
+  void setVisible(int layer, bool visible);
+
+  ///
+  /// Redraw the dirty layers and composite the visible ones into the
+  /// output framebuffer (blended over its current content)
+  void render(GLuint outputFramebuffer, int outputWidth, int outputHeight);
+
+  ///
+  /// Number of layers whose content was redrawn by the last render()
+  int redrawnLastFrame() const { return _redrawn; }
+
+private:
+  void allocate();
+
+  struct Layer {
+    DrawFunction draw;
+    glm::vec4 clearColor;
+    glm::mat4 transform;
+    GLuint fbo;
+    bool dirty, visible;
+  };
+
+  std::vector<Layer> _layers;
+  int _width, _height;
+  int _capacityWidth, _capacityHeight;
+  int _redrawn;
+
+  GLuint _texture;
+  GLuint _program;
+  GLint _transformsLocation, _slicesLocation;
+  GLint _uvScaleLocation, _uvLimitLocation;
+  GLuint _emptyVAO;
+};
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef __CG_MESH_BATCH_HPP__
+#define __CG_MESH_BATCH_HPP__
+
+#include <cg_affine.hpp>
+#include <cg_camera.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// How a MeshBatcher draws the instances of a mesh: Auto decides per mesh
+/// (see MeshBatcher), the others force every mesh to one path
+enum class MeshDrawPath { Auto, PreTransform, Instanced };
+
+const char *meshDrawPathName(MeshDrawPath path);
+
+///
+/// Where the instanced path of a MeshBatcher reads the instances from:
+/// vertex attributes advancing once per instance, or a buffer texture
+/// fetched by instance index (the same buffer either way)
+enum class InstanceStorage { Attributes, TextureBuffer };
+
+const char *instanceStorageName(InstanceStorage storage);
+
+///
+/// Draws many instances of small triangle meshes, each with its own
+/// transform and color, along one of two paths:
+///   - pre-transform: the CPU moves the vertices of every instance to the
+///     world (SIMD, 4 vertices per instruction) into one vertex buffer,
+///     streamed when something changed, and a single draw covers every
+///     instance of every pre-transformed mesh
+///   - instancing: the mesh is stored once and one instanced draw per mesh
+///     reads a transform and a color per instance
+/// For meshes of a few vertices, instancing wastes most of each vertex
+/// shader batch (an instance never shares one with the next) and pays a
+/// draw per mesh, while pre-transforming costs a few nanoseconds and 12
+/// bytes of upload per vertex; for large meshes it is the other way
+/// around. Auto pre-transforms the meshes of at most batchVertexLimit()
+/// vertices, smallest first, as long as the streamed vertices fit in
+/// streamVertexBudget(), and instances the others.
+///
+/// The instanced meshes read their instances either as attributes or with
+/// texelFetch from a buffer texture, indexed by gl_InstanceID plus the
+/// first instance of the mesh (GL 3.3 has no base instance). The texture
+/// needs no attribute state per mesh and holds as many instances as
+/// GL_MAX_TEXTURE_BUFFER_SIZE allows (two texels each); past that, the
+/// attributes are used.
+class MeshBatcher {
+public:
+  MeshBatcher();
+
+  ///
+  /// Compile the shaders and allocate the buffers (requires a current context)
+  void create();
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Add a mesh (a triangle list, in its own frame) and return its index
+  int addMesh(const std::vector<glm::vec2> &triangles);
+
+  ///
+  /// Add an instance of a mesh and return its index
+  int add(int mesh, const Affine2D &transform, glm::vec4 color);
+
+  void setTransform(int instance, const Affine2D &transform);
+
+  ///
+  /// Replace the transforms of count instances, from first, at once
+  void setTransforms(int first, int count, const Affine2D *transforms);
+  void setColor(int instance, glm::vec4 color);
+  const Affine2D &transform(int instance) const { return _transforms[instance]; }
+
+  ///
+  /// Remove every instance (the meshes stay)
+  void clear();
+
+  int count() const { return (int)_transforms.size(); }
+  int meshCount() const { return (int)_meshes.size(); }
+
+  void setPath(MeshDrawPath path);
+  MeshDrawPath path() const { return _path; }
+  void setBatchVertexLimit(int vertices);
+  int batchVertexLimit() const { return _batchVertexLimit; }
+  void setStreamVertexBudget(int vertices);
+  int streamVertexBudget() const { return _streamVertexBudget; }
+  void setInstanceStorage(InstanceStorage storage);
+  InstanceStorage instanceStorage() const { return _instanceStorage; }
+
+  ///
+  /// Whether the instances of a mesh are pre-transformed with the current
+  /// path and instances
+  bool preTransformed(int mesh);
+
+  ///
+  /// Move the pre-transformed vertices with the scalar code instead of
+  /// SIMD (for comparison)
+  void setVectorized(bool vectorized) { _vectorized = vectorized; }
+
+  ///
+  /// Draw every instance
+  void draw(const Camera &camera);
+
+  ///
+  /// Draw calls of the last draw(), and the vertices streamed and the CPU
+  /// time of the last time the buffers were prepared (after a change)
+  int drawCallsLastFrame() const { return _drawCalls; }
+  int streamedVerticesLastFrame() const { return _streamedVertices; }
+  double prepareMilliseconds() const { return _prepareMilliseconds; }
+
+  ///
+  /// Move every pre-transformed vertex into positions (x, y pairs) and
+  /// colors (RGBA8), as draw() does, and return the vertex count (the
+  /// arrays are resized, with room for the SIMD stores)
+  int preTransform(std::vector<float> &positions, std::vector<unsigned int> &colors);
+
+private:
+  struct Mesh {
+    int firstVertex, vertexCount;
+    // local vertices, structure of arrays padded to a multiple of 4
+    std::vector<float> x, y;
+  };
+  // per instance data of the instanced path, as read by the vertex shader
+  // (padded to two RGBA32UI texels for the buffer texture)
+  struct Instance {
+    float linear[4];
+    float offset[2];
+    GLuint color;
+    GLuint unused;
+  };
+
+  void choosePaths();
+  void uploadInstances();
+
+  std::vector<Mesh> _meshes;
+  std::vector<glm::vec2> _meshVertices; // every mesh, for the instanced path
+  std::vector<int> _meshOf;
+  std::vector<Affine2D> _transforms;
+  std::vector<unsigned int> _colors; // RGBA8
+
+  MeshDrawPath _path;
+  InstanceStorage _instanceStorage;
+  int _batchVertexLimit, _streamVertexBudget;
+  std::vector<unsigned char> _preTransformed; // per mesh
+  bool _pathsValid, _meshesDirty, _instancesDirty, _vectorized;
+
+  // pre-transformed vertices, kept between frames when nothing changed
+  std::vector<float> _positions;
+  std::vector<unsigned int> _vertexColors;
+  int _vertexCount;
+  size_t _streamCapacity;
+
+  // instanced path: per mesh, the range of its instances in the buffer,
+  // and the instances as uploaded (kept between frames)
+  std::vector<int> _instanceStart, _instanceCount, _instanceNext;
+  std::vector<Instance> _instanceData;
+
+  GLuint _batchProgram, _instanceProgram, _textureProgram;
+  GLuint _batchVAO, _streamVBO;
+  GLuint _instanceVAO, _meshVBO, _instanceVBO;
+  GLuint _meshVAO, _instanceTexture; // the mesh alone, the instances as a texture
+  GLint _instanceBaseLocation, _maxTexels;
+  size_t _instanceCapacity;
+
+  int _drawCalls, _streamedVertices;
+  double _prepareMilliseconds;
+};
+
+///
+/// Pre-transform count instances of a 12-vertex mesh with SIMD and with
+/// scalar code and print the times, the vertices per second and the
+/// largest difference between the two
+void benchmarkMeshBatch(std::ostream &out, int count);
+
+///
+/// Draw count instances of a 12-vertex mesh reading them as attributes and
+/// from a buffer texture, in a hidden window, and print the GPU times and
+/// whether the two images are the same
+void benchmarkInstanceStorage(std::ostream &out, int count);
+}
+
+#endif
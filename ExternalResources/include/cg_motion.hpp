@@ -0,0 +1,108 @@
+#ifndef __CG_MOTION_HPP__
+#define __CG_MOTION_HPP__
+
+#include <cg_camera.hpp>
+#include <cg_sdf_shapes.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Closed-form motion of a shape, as a function of the time t in seconds:
+///   center(t)   = center + drift * t
+///               + orbitRadius * (cos, sin)(orbitPhase + orbitSpeed * t)
+///               + oscillation * sin(oscillationPhase + 2 pi oscillationFrequency t)
+///   rotation(t) = rotation + spin * t
+/// The terms add up, so a shape may spin while it orbits. Angles and
+/// speeds are counter-clockwise, in radians and radians per second.
+struct Motion {
+  glm::vec2 drift;
+  float spin;
+  float orbitRadius, orbitSpeed, orbitPhase;
+  glm::vec2 oscillation;
+  float oscillationFrequency, oscillationPhase;
+
+  ///
+  /// No motion
+  Motion();
+
+  static Motion spinning(float speed);
+  static Motion orbiting(float radius, float speed, float phase = 0.0f);
+  static Motion oscillating(glm::vec2 amplitude, float frequency, float phase = 0.0f);
+  static Motion drifting(glm::vec2 velocity);
+
+  ///
+  /// The shape at time t (the same formula as the vertex shader), with the
+  /// phases evaluated in double and wrapped to a turn
+  SdfShape apply(const SdfShape &shape, double t) const;
+
+  ///
+  /// The same motion, started at time t0 from where apply(shape, t0) leaves
+  /// it: the shape moves by the returned motion from the returned pose
+  Motion advanced(SdfShape &shape, double t0) const;
+};
+
+///
+/// Draws SdfShapes whose motion is closed-form. The shapes and their
+/// motions are uploaded once into a static instance buffer and the vertex
+/// shader evaluates each motion from a single time uniform, so animating
+/// them costs the CPU one uniform per frame and no upload, however many
+/// shapes there are. Shapes are not culled on the CPU (their positions are
+/// only known on the GPU): the vertex shader collapses the quads of the
+/// shapes outside the view instead.
+///
+/// The time uniform is a float, so it is kept relative to an epoch: once
+/// it runs past rebaseInterval seconds, the epoch moves to the current
+/// time and the poses and phases at the epoch are uploaded again. A float
+/// of hours since the start would make the spins and orbits jitter.
+class AnimatedShapeRenderer {
+public:
+  AnimatedShapeRenderer();
+
+  ///
+  /// Compile the shader and allocate the buffers (requires a current context)
+  void create();
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Remove every shape
+  void clear();
+
+  ///
+  /// Add a shape with its motion (from the shape's pose at time 0) and
+  /// return its index
+  int add(const SdfShape &shape, const Motion &motion);
+
+  int count() const { return (int)_shapes.size(); }
+
+  ///
+  /// A shape where it is drawn at time t (for picking and collisions)
+  SdfShape shapeAt(int index, double t) const { return _motions[index].apply(_shapes[index], t); }
+
+  ///
+  /// Draw every shape at time t; the instance buffer is uploaded only
+  /// after shapes were added or removed, and when the epoch moves
+  void draw(const Camera &camera, double t);
+
+  static const double rebaseInterval;
+
+private:
+  void upload();
+
+  std::vector<SdfShape> _shapes;
+  std::vector<Motion> _motions;
+  bool _dirty;
+  double _epoch;
+
+  GLuint _program;
+  GLint _timeLocation;
+  GLuint _VAO, _quadVBO, _instanceVBO;
+};
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef __CG_PARTICLES_HPP__
+#define __CG_PARTICLES_HPP__
+
+#include <cg_camera.hpp>
+#include <cg_gpu_timer.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <deque>
+#include <utility>
+
+namespace cgicmc {
+
+///
+/// How the particles are simulated on the GPU
+enum class ParticleBackend { Compute, TransformFeedback };
+
+const char *particleBackendName(ParticleBackend backend);
+
+///
+/// Where and how new particles are born. Each particle gets a random
+/// direction within spread radians of direction, a random speed and a
+/// random lifetime within the ranges; its color goes from startColor to
+/// endColor (fading out) over its life.
+struct ParticleEmitter {
+  glm::vec2 position;
+  float direction, spread; // counter-clockwise, in radians
+  float minSpeed, maxSpeed; // world units per second
+  float minLifetime, maxLifetime; // seconds
+  float rate; // particles per second
+  glm::vec4 startColor, endColor;
+  float pointSize; // pixels
+
+  ParticleEmitter();
+};
+
+///
+/// Particles living entirely in GPU buffers: the CPU only sets the emitter
+/// uniforms and issues a fixed number of commands per frame, whatever the
+/// number of particles. Particles are drawn as additive point sprites.
+///
+/// With GL 4.3 a compute shader integrates the live particles, spawns the
+/// new ones after them and appends the survivors to a second buffer with
+/// an atomic counter, so the live particles stay packed at the front. The
+/// counter is the vertex count of an indirect draw, and a one-thread pass
+/// turns it into the next indirect dispatch, so the count never comes
+/// back to the CPU.
+///
+/// Otherwise (GL 3.3) the buffer is a ring: each frame spawns into the
+/// slots after the newest ones, and a vertex shader captured by transform
+/// feedback integrates only the slots young enough to be alive (known on
+/// the CPU from the emission history). Dead particles in that window are
+/// skipped when drawn, and past the capacity the oldest particles are
+/// overwritten.
+class ParticleSystem {
+public:
+  ParticleSystem();
+
+  ///
+  /// Allocate the buffers for capacity particles and compile the shaders
+  /// (requires a current context); the compute backend is chosen when the
+  /// context supports it
+  void create(int capacity);
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  bool created() const { return _capacity > 0; }
+
+  ///
+  /// Switch backend (the particles are cleared); Compute is ignored on a
+  /// context older than 4.3
+  void setBackend(ParticleBackend backend);
+  ParticleBackend backend() const { return _backend; }
+
+  ///
+  /// Remove every particle
+  void reset();
+
+  ParticleEmitter &emitter() { return _emitter; }
+
+  void setGravity(glm::vec2 gravity) { _gravity = gravity; }
+
+  ///
+  /// Emit and integrate the particles over dt seconds
+  void update(float dt);
+
+  ///
+  /// Draw the live particles through the camera
+  void draw(const Camera &camera);
+
+  int capacity() const { return _capacity; }
+
+  ///
+  /// Particles emitted within the longest lifetime (clamped to the
+  /// capacity): an upper bound of the live particles, kept on the CPU
+  int recentCount() const;
+
+  ///
+  /// GPU time of update()
+  double updateMilliseconds() const { return _timer.averageMilliseconds(); }
+
+private:
+  void createBuffers();
+  void setUpdateUniforms(GLuint program, float dt, int spawnCount);
+  void updateCompute(float dt, int spawnCount);
+  void updateTransformFeedback(float dt, int spawnCount);
+
+  // the slots of the ring that may hold live particles, as up to two
+  // ranges (the window wraps around the end of the buffer)
+  int ringRanges(int firsts[2], int counts[2]) const;
+
+  ParticleBackend _backend;
+  ParticleEmitter _emitter;
+  glm::vec2 _gravity;
+  int _capacity;
+
+  // particle buffers (read one, write the other, then swap), with a
+  // vertex array reading each of them
+  GLuint _buffers[2], _VAOs[2];
+  int _current;
+
+  // compute backend: dispatch and draw commands filled by the GPU
+  GLuint _controlBuffer;
+  GLuint _prepareProgram, _computeProgram;
+
+  // transform feedback backend: next slot to spawn into
+  GLuint _feedbackProgram;
+  int _head;
+
+  GLuint _drawProgram;
+  GLint _startColorLocation, _endColorLocation, _pointSizeLocation;
+
+  // particles spawned per frame, with the time they were spawned, for
+  // the frames still within the longest lifetime
+  std::deque<std::pair<double, int>> _spawned;
+  double _time, _pendingSpawn;
+  unsigned _frame;
+
+  GpuTimer _timer;
+};
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef __CG_PATH_HPP__
+#define __CG_PATH_HPP__
+
+#include <glm/glm.hpp>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// A 2D curve made of cubic segments, with a table giving the curve
+/// parameter at evenly spaced distances along it, so it can be followed at
+/// constant speed. The table is built once per path (the segment lengths
+/// are integrated with Gauss-Legendre quadrature, then inverted) and cuts
+/// every segment into SAMPLES_PER_SEGMENT intervals of the same length,
+/// over each of which the parameter is a cubic of the distance.
+class SplinePath {
+public:
+  static const int SAMPLES_PER_SEGMENT = 32;
+
+  ///
+  /// Centripetal Catmull-Rom spline through the points (no cusps or self
+  /// intersections within a segment); a closed path also joins the last
+  /// point to the first one
+  static SplinePath catmullRom(const std::vector<glm::vec2> &points, bool closed = false);
+
+  ///
+  /// Cubic Bezier segments: an end point, two control points, an end
+  /// point, two control points... (3n + 1 points for n segments)
+  static SplinePath bezier(const std::vector<glm::vec2> &points);
+
+  float length() const { return _length; }
+  int segmentCount() const { return (int)_coefficients.size() / 8; }
+
+  ///
+  /// Point and unit tangent at a distance along the path (clamped to it)
+  glm::vec2 position(float distance) const;
+  glm::vec2 tangent(float distance) const;
+
+private:
+  friend class PathFollowers;
+
+  SplinePath();
+  void addSegment(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d);
+  void addHermite(glm::vec2 p0, glm::vec2 p1, glm::vec2 m0, glm::vec2 m1);
+  void buildTable();
+  // the length of the curve from a parameter to another in a segment
+  float integrateLength(float begin, float end) const;
+
+  // the curve parameter (segment index + parameter in the segment) at a
+  // distance, from the table
+  float parameter(float distance) const;
+  glm::vec2 evaluate(float parameter, glm::vec2 *derivative) const;
+
+  // per segment: a, b, c, d of x then of y (p(u) = a + b u + c u^2 + d u^3)
+  std::vector<float> _coefficients;
+  // per segment: where it starts along the path and its intervals per unit
+  // of length; per interval: the cubic giving the parameter in the segment
+  // from the position in the interval
+  std::vector<float> _segmentStart, _segmentScale, _table;
+  float _length;
+};
+
+///
+/// What a follower does at the end of its path
+enum class PathEnd { Loop, Bounce, Stop };
+
+///
+/// Objects moving along shared paths at constant speed. The paths are
+/// copied into one pool of tables and coefficients, and the followers are
+/// stored structure of arrays; an update advances the distances, looks up
+/// the curve parameters in the tables, then evaluates the positions and
+/// tangents of 4 followers at a time (SSE, with a scalar path where it is
+/// not available).
+class PathFollowers {
+public:
+  PathFollowers();
+
+  ///
+  /// Add a path to the pool and return its index
+  int addPath(const SplinePath &path);
+
+  ///
+  /// Remove the followers (the paths stay)
+  void clearFollowers();
+
+  ///
+  /// Add a follower at a distance along a path, moving at speed units per
+  /// second (a negative speed goes backwards), and return its index
+  int add(int path, float distance, float speed, PathEnd end = PathEnd::Loop);
+
+  ///
+  /// Advance every follower by dt seconds and evaluate where it is
+  void update(float dt);
+
+  int count() const { return (int)_path.size(); }
+  float pathLength(int path) const { return _paths[path].length; }
+
+  glm::vec2 position(int follower) const { return glm::vec2(_x[follower], _y[follower]); }
+  glm::vec2 tangent(int follower) const { return glm::vec2(_tangentX[follower], _tangentY[follower]); }
+  float distance(int follower) const { return _distance[follower]; }
+
+  ///
+  /// Evaluate with the scalar code instead of SIMD (for comparison)
+  void setVectorized(bool vectorized) { _vectorized = vectorized; }
+
+  ///
+  /// Time taken by the last update()
+  double updateMicroseconds() const { return _updateMicroseconds; }
+
+private:
+  struct PooledPath {
+    int firstSegment, segmentCount;
+    float length;
+  };
+
+  void advance(float dt);
+  void locate(int follower);
+  void findParameters();
+  void evaluateFollower(int follower);
+  void evaluate();
+
+  std::vector<PooledPath> _paths;
+  // the segments of every path, as in SplinePath (with their end as well)
+  std::vector<float> _coefficients, _segmentStart, _segmentEnd, _segmentScale, _table;
+
+  // followers
+  std::vector<int> _path, _segment;
+  std::vector<PathEnd> _end;
+  std::vector<float> _distance, _speed, _u;
+  std::vector<float> _x, _y, _tangentX, _tangentY;
+
+  bool _vectorized;
+  double _updateMicroseconds;
+};
+
+///
+/// Move followerCount followers along a few hundred Catmull-Rom and Bezier
+/// paths and print the update time of the SIMD and scalar evaluations and
+/// how far the followers stray from a constant speed
+void benchmarkPaths(std::ostream &out, int followerCount);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef __CG_PHYSICS_HPP__
+#define __CG_PHYSICS_HPP__
+
+#include <cg_collision.hpp>
+#include <cg_thread_pool.hpp>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// State of a rigid body; the position is its center of mass and a zero
+/// inverse mass makes it static
+struct RigidBody {
+  glm::vec2 position;
+  float angle; // counter-clockwise, in radians
+  glm::vec2 velocity;
+  float angularVelocity;
+  float inverseMass, inverseInertia;
+  float friction;
+
+  bool dynamic() const { return inverseMass > 0.0f; }
+};
+
+///
+/// 2D rigid body simulation. Each step finds the contacts through a
+/// CollisionWorld, integrates the velocities, runs a sequential impulse
+/// solver (warm started with the impulses of the matching contacts of the
+/// previous step), integrates the positions and finally pushes the bodies
+/// out of each other directly on the positions, which, unlike a velocity
+/// bias, adds no energy to tall stacks.
+///
+/// The contacts are partitioned into islands: the bodies touching each
+/// other, directly or through other dynamic bodies (static bodies do not
+/// join islands). Islands share no dynamic body, so they are solved in
+/// parallel, each one by a single thread in the order of its contacts.
+/// The result of a step does not depend on the number of threads.
+class PhysicsWorld {
+public:
+  PhysicsWorld();
+
+  void setThreadCount(int threadCount);
+  int threadCount() const { return _pool.threadCount(); }
+
+  void setGravity(glm::vec2 gravity) { _gravity = gravity; }
+  glm::vec2 gravity() const { return _gravity; }
+
+  ///
+  /// Solver passes over the contacts of each step, for the velocities and
+  /// for the positions
+  void setIterations(int velocityIterations, int positionIterations) {
+    _velocityIterations = velocityIterations;
+    _positionIterations = positionIterations;
+  }
+
+  ///
+  /// Remove every body
+  void clear();
+
+  ///
+  /// Add a body made of a convex polygon (in the body frame, moved so
+  /// that its center of mass is the origin) and return its index. A zero
+  /// density makes a static body, which should not be moved afterwards.
+  int addPolygon(const std::vector<glm::vec2> &polygon, float density, glm::vec2 position, float angle);
+
+  ///
+  /// Add a body made of the triangles of a mesh (3 vertices each)
+  int addMesh(const std::vector<glm::vec2> &triangles, float density, glm::vec2 position, float angle);
+
+  RigidBody &body(int index) { return _bodies[index]; }
+  const RigidBody &body(int index) const { return _bodies[index]; }
+  int bodyCount() const { return (int)_bodies.size(); }
+
+  ///
+  /// Advance the simulation by dt seconds
+  void step(float dt);
+
+  const CollisionWorld &collisions() const { return _collisions; }
+
+  ///
+  /// Statistics of the last step
+  int islandCount() const { return (int)_islandOffsets.size() - 1; }
+  int contactCount() const { return (int)_collisions.contacts().size(); }
+  double collideMilliseconds() const { return _collideMilliseconds; }
+  double solveMilliseconds() const { return _solveMilliseconds; }
+
+private:
+  // a contact point prepared for the solver
+  struct ContactPoint {
+    glm::vec2 rA, rB;
+    glm::vec2 localA, localB; // the point in the body frames
+    float depth;
+    float normalMass, tangentMass;
+    float normalImpulse, tangentImpulse;
+    unsigned feature;
+  };
+
+  // the contacts between two polygons; the normal impulses of two points
+  // are solved together (a 2x2 linear complementarity problem), which
+  // keeps resting faces from rocking
+  struct ContactConstraint {
+    int a, b;
+    glm::vec2 normal;
+    float friction;
+    int pointCount;
+    ContactPoint points[2];
+    float k11, k12, k22; // effective mass matrix of the two points
+    float m11, m12, m22; // and its inverse
+  };
+
+  // impulses kept from the previous step, sorted by pair and feature
+  struct CachedImpulse {
+    uint64_t pair;
+    unsigned feature;
+    float normalImpulse, tangentImpulse;
+
+    bool operator<(const CachedImpulse &other) const {
+      return pair < other.pair || (pair == other.pair && feature < other.feature);
+    }
+  };
+
+  int addBody(float area, glm::vec2 center, float inertia, float density, glm::vec2 position, float angle);
+  void buildIslands();
+  void solveVelocities(int island);
+  void solvePositions(int island);
+  void forEachIsland(void (PhysicsWorld::*solve)(int island));
+  int findRoot(int body);
+
+  std::vector<RigidBody> _bodies;
+  CollisionWorld _collisions;
+  glm::vec2 _gravity;
+  int _velocityIterations, _positionIterations;
+
+  std::vector<ContactConstraint> _constraints;
+  std::vector<int> _manifoldStarts; // first contact of each constraint
+  std::vector<CachedImpulse> _cache;
+
+  // islands: union-find over the bodies, then the constraints of island i
+  // are _islandConstraints[_islandOffsets[i] .. _islandOffsets[i + 1])
+  std::vector<int> _parent, _islandOf, _constraintIsland;
+  std::vector<int> _islandConstraints, _islandOffsets;
+
+  ThreadPool _pool;
+  double _collideMilliseconds, _solveMilliseconds;
+};
+
+///
+/// Simulate columns of stacked boxes (bodyCount in total) for a few
+/// seconds, single threaded and with every hardware thread, and print the
+/// step time, the islands, whether the columns still stand and whether
+/// both runs ended in the same state
+void benchmarkPhysics(std::ostream &out, int bodyCount);
+}
+
+#endif
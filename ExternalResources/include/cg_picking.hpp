@@ -0,0 +1,72 @@
+#ifndef __CG_PICKING_HPP__
+#define __CG_PICKING_HPP__
+
+#include <glad/glad.h>
+
+namespace cgicmc {
+
+///
+/// How the object under the cursor is found
+enum class PickMode { Cpu, Gpu };
+
+const char *pickModeName(PickMode mode);
+
+///
+/// Picking through an ID buffer. Each request renders the object ids into
+/// a 1x1 unsigned integer target (the caller uses a camera covering only
+/// the pixel under the cursor, so culling leaves a handful of objects) and
+/// copies the pixel into a pixel pack buffer guarded by a fence. Results
+/// are collected one or two frames later, once the fence has signalled, so
+/// reading them back never waits for the GPU.
+class GpuPicker {
+public:
+  ///
+  /// Value of the pixels not covered by any object
+  static const GLuint NO_ID = 0;
+
+  ///
+  /// Requests in flight (a new request drops the oldest one if the GPU is
+  /// that far behind)
+  static const int RING_SIZE = 3;
+
+  GpuPicker();
+
+  ///
+  /// Allocate the target and the pack buffers
+  void create();
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Bind and clear the id target, the ids must be drawn next (without
+  /// blending, the last object drawn over the pixel wins)
+  void begin();
+
+  ///
+  /// Queue the read back of the drawn id
+  void end();
+
+  ///
+  /// Collect the oldest finished request without waiting. Returns true
+  /// (and the id) when a result arrived since the last call.
+  bool poll(GLuint &id);
+
+  ///
+  /// Frames the last result took to arrive
+  int lastLatency() const { return _lastLatency; }
+
+  bool pending() const { return _count > 0; }
+
+private:
+  GLuint _fbo, _texture;
+  GLuint _buffers[RING_SIZE];
+  GLsync _fences[RING_SIZE];
+  int _frames[RING_SIZE];
+  int _head, _count;
+  int _frame, _lastLatency;
+};
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __CG_PRESENT_HPP__
+#define __CG_PRESENT_HPP__
+
+#include <cg_bounds.hpp>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace cgicmc {
+
+///
+/// Presents the window back buffer, telling the compositor which region
+/// changed when the context is an EGL one with EGL_KHR_swap_buffers_with_damage
+/// (or the EXT variant), EGL_KHR_partial_update and EGL_EXT_buffer_age.
+/// Without them, or when the library was built without EGL (see
+/// CG_PRESENT_EGL in the CMake file), it falls back to a regular
+/// glfwSwapBuffers.
+class Presenter {
+public:
+  Presenter();
+
+  ///
+  /// Look up the EGL extensions of the window context (must be current)
+  void create(GLFWwindow *window);
+
+  ///
+  /// Age of the back buffer in frames (0: unknown, assume undefined content)
+  int bufferAge() const;
+
+  ///
+  /// Declare the region of the back buffer that will be drawn this frame.
+  /// Must be called before the first draw into the back buffer.
+  void setDamageRegion(const PixelRect &region);
+
+  ///
+  /// Swap the buffers, reporting only the region that changed
+  void swap(const PixelRect &region);
+
+  ///
+  /// True when swaps can report damage to the compositor
+  bool partialPresent() const { return _swapWithDamage != 0; }
+
+private:
+  GLFWwindow *_window;
+  void *_display, *_surface;
+
+  // EGL entry points (NULL when the extension is not available)
+  void *_swapWithDamage;
+  void *_setDamageRegion;
+  bool _bufferAge;
+};
+}
+
+#endif
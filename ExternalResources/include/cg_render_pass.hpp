@@ -0,0 +1,85 @@
+#ifndef __CG_RENDER_PASS_HPP__
+#define __CG_RENDER_PASS_HPP__
+
+#include <cg_bounds.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace cgicmc {
+
+///
+/// What happens to an attachment's previous content when a pass begins
+enum class LoadAction {
+  Clear,   // fill with the clear value
+  Load,    // keep the previous content
+  DontCare // previous content is not needed (invalidated)
+};
+
+///
+/// What happens to an attachment's content when a pass ends
+enum class StoreAction {
+  Store,  // keep it for later passes or presentation
+  Discard // not needed anymore (invalidated)
+};
+
+///
+/// Attachment bits for invalidateAttachments()
+enum AttachmentBit { COLOR_ATTACHMENT = 1, DEPTH_ATTACHMENT = 2, STENCIL_ATTACHMENT = 4 };
+
+///
+/// Bind the framebuffer to target and tell the driver the content of the
+/// given attachments (AttachmentBit mask) is not needed, either entirely or
+/// only inside area. Does nothing without GL 4.3/ARB_invalidate_subdata.
+void invalidateAttachments(GLenum target, GLuint framebuffer, int attachments, const PixelRect *area = NULL);
+
+///
+/// A render pass declares up front what it does with each attachment so
+/// the driver never loads or writes back memory nobody needs: load actions
+/// become glClearBuffer* or glInvalidateFramebuffer calls when the pass
+/// begins, store actions become glInvalidateFramebuffer calls when it ends.
+/// Attachments that are not declared are not touched at all (and are
+/// invalidated, since the pass does not use them).
+///
+///   RenderPass pass;
+///   pass.color(LoadAction::Clear, StoreAction::Store, background);
+///   pass.begin(fbo, width, height); ... draw ...; pass.end();
+class RenderPass {
+public:
+  RenderPass();
+
+  RenderPass &color(LoadAction load, StoreAction store, glm::vec4 clearColor = glm::vec4(0.0f));
+  RenderPass &depth(LoadAction load, StoreAction store, float clearDepth = 1.0f);
+  RenderPass &stencil(LoadAction load, StoreAction store, int clearStencil = 0);
+
+  ///
+  /// Limit the pass to a rectangle: clears, invalidation and draws (by the
+  /// scissor test) only affect it. An empty rectangle means the whole target.
+  RenderPass &renderArea(const PixelRect &area);
+
+  ///
+  /// Bind the framebuffer, set the viewport and apply the load actions
+  void begin(GLuint framebuffer, int width, int height) const;
+
+  ///
+  /// Apply the store actions
+  void end() const;
+
+private:
+  struct Attachment {
+    bool used;
+    LoadAction load;
+    StoreAction store;
+  };
+
+  Attachment _color, _depth, _stencil;
+  glm::vec4 _clearColor;
+  float _clearDepth;
+  int _clearStencil;
+  PixelRect _area;
+
+  // framebuffer of the pass in progress
+  mutable GLuint _framebuffer;
+};
+}
+
+#endif
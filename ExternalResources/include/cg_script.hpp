@@ -0,0 +1,225 @@
+#ifndef __CG_SCRIPT_HPP__
+#define __CG_SCRIPT_HPP__
+
+#include <coroutine>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Coroutine frames come from fixed size blocks (size classes of 64 bytes
+/// up to 1 KB) kept on free lists and allocated 64 at a time, so starting
+/// and finishing scripts reuses memory instead of going to the heap.
+/// Larger frames use the heap. Not thread safe: scripts live on the thread
+/// of their scheduler.
+class ScriptFramePool {
+public:
+  static void *allocate(std::size_t size);
+  static void release(void *frame, std::size_t size);
+
+  ///
+  /// Times the pool went to the heap so far (for a block of blocks or a
+  /// frame larger than the largest class)
+  static long long heapAllocations();
+};
+
+class ScriptScheduler;
+
+///
+/// A scripted behavior: a coroutine returning Script, which a
+/// ScriptScheduler runs. A script waits with co_await nextFrame(),
+/// wait(seconds) or tween(value, to, seconds), and may co_await another
+/// Script to run it to its end.
+class Script {
+public:
+  struct promise_type;
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  // resumes the script waiting for this one, if any
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(Handle handle) noexcept;
+    void await_resume() noexcept {}
+  };
+
+  struct promise_type {
+    ScriptScheduler *scheduler;
+    int slot;
+    unsigned generation;
+    std::coroutine_handle<> continuation;
+
+    promise_type();
+    Script get_return_object() { return Script(Handle::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+    FinalAwaiter final_suspend() noexcept { return FinalAwaiter(); }
+    void return_void() {}
+    void unhandled_exception();
+
+    static void *operator new(std::size_t size) { return ScriptFramePool::allocate(size); }
+    static void operator delete(void *frame, std::size_t size) { ScriptFramePool::release(frame, size); }
+  };
+
+  // runs a script inside another one
+  struct Awaiter {
+    Handle handle;
+    bool await_ready() const { return !handle || handle.done(); }
+    Handle await_suspend(Handle parent);
+    void await_resume() {}
+  };
+
+  Script() {}
+  Script(Script &&other);
+  Script &operator=(Script &&other);
+  Script(const Script &) = delete;
+  Script &operator=(const Script &) = delete;
+  ~Script();
+
+  Awaiter operator co_await() && { return Awaiter { _handle }; }
+
+private:
+  friend class ScriptScheduler;
+  explicit Script(Handle handle) : _handle(handle) {}
+  Handle _handle;
+};
+
+///
+/// Shape of a tween over its duration
+enum class Easing { Linear, EaseIn, EaseOut, Smooth };
+
+float ease(Easing easing, float t);
+
+///
+/// What a script can co_await
+struct NextFrameAwaiter {
+  bool await_ready() const { return false; }
+  void await_suspend(Script::Handle handle);
+  void await_resume() {}
+};
+
+struct WaitAwaiter {
+  float seconds;
+  bool await_ready() const { return seconds <= 0.0f; }
+  void await_suspend(Script::Handle handle);
+  void await_resume() {}
+};
+
+struct TweenAwaiter {
+  float *value;
+  float to, seconds;
+  Easing easing;
+  bool await_ready();
+  void await_suspend(Script::Handle handle);
+  void await_resume() {}
+};
+
+///
+/// Resume at the next update
+inline NextFrameAwaiter nextFrame() { return NextFrameAwaiter(); }
+
+///
+/// Resume at the first update seconds from now
+inline WaitAwaiter wait(float seconds) { return WaitAwaiter { seconds }; }
+
+///
+/// Move a value to another one over seconds, then resume. The scheduler
+/// sets the value at every update without resuming the script, so the
+/// value must outlive the tween (or the script be stopped first).
+inline TweenAwaiter tween(float &value, float to, float seconds, Easing easing = Easing::Smooth) {
+  return TweenAwaiter { &value, to, seconds, easing };
+}
+
+///
+/// Runs scripts on the calling thread, one step per update: the scripts
+/// waiting for the next frame are kept in a list, the timers in a heap by
+/// wake time and the tweens in an array updated in one pass, and each
+/// update resumes only the scripts whose wait is over. Nothing is
+/// allocated once the lists have grown to their working size.
+class ScriptScheduler {
+public:
+  ScriptScheduler();
+  ~ScriptScheduler();
+
+  ///
+  /// Run a script until it first waits and return its index (valid until
+  /// it finishes)
+  int start(Script script);
+
+  ///
+  /// Destroy a script where it waits (and any script it runs)
+  void stop(int script);
+  bool running(int script) const;
+
+  ///
+  /// Stop every script
+  void clear();
+
+  ///
+  /// Advance the time by dt seconds and resume the scripts due
+  void update(float dt);
+
+  ///
+  /// Seconds since the scheduler was made (a double, so the wake and
+  /// start times stay exact in long sessions)
+  double time() const { return _time; }
+  int count() const { return _running; }
+
+  ///
+  /// Coroutine resumes since the scheduler was made
+  long long resumeCount() const { return _resumes; }
+
+  ///
+  /// Time taken by the last update()
+  double updateMilliseconds() const { return _updateMilliseconds; }
+
+private:
+  friend struct NextFrameAwaiter;
+  friend struct WaitAwaiter;
+  friend struct TweenAwaiter;
+
+  struct Slot {
+    Script::Handle root;
+    unsigned generation;
+  };
+
+  // a suspended coroutine (the script or one it runs) of a slot
+  struct Waiter {
+    Script::Handle handle;
+    int slot;
+    unsigned generation;
+    double wake;
+  };
+
+  struct Tween {
+    Waiter waiter;
+    float *value;
+    float from, to, duration;
+    double start;
+    Easing easing;
+  };
+
+  Waiter waiter(Script::Handle handle, double wake) const;
+  bool current(const Waiter &waiter) const;
+  void resume(const Waiter &waiter);
+  void finish(int slot);
+
+  std::vector<Slot> _slots;
+  std::vector<int> _freeSlots;
+  std::vector<Waiter> _nextFrame, _timers, _due;
+  std::vector<Tween> _tweens;
+  double _time;
+  int _running;
+  long long _resumes;
+  double _updateMilliseconds;
+};
+
+///
+/// Run scriptCount scripts stepping every frame, then as many scripted
+/// behaviors (spin up, spin for 2 s, stop, reverse...) for a few seconds,
+/// and print the resumes per second and the heap allocations of the
+/// frame pool
+void benchmarkScripts(std::ostream &out, int scriptCount);
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __CG_SDF_SHAPES_HPP__
+#define __CG_SDF_SHAPES_HPP__
+
+#include <cg_bounds.hpp>
+#include <cg_camera.hpp>
+#include <cg_spatial_index.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Shapes the SdfRenderer knows how to evaluate
+enum class ShapeType { Circle = 0, RoundedRect, Polygon, Star, Pinwheel };
+
+///
+/// A shape described by its signed distance field. The meaning of the
+/// size and parameters depends on the type:
+///   Circle:      size.x = radius
+///   RoundedRect: size = half extents, param = corner radius
+///   Polygon:     size.x = circumradius, param = number of sides
+///   Star:        size.x = outer radius, param = number of points,
+///                param2 = sharpness in [2, points]
+///   Pinwheel:    size.x = blade length, param = number of blades,
+///                param2 = blade width relative to its length
+struct SdfShape {
+  ShapeType type;
+  glm::vec2 center;
+  glm::vec2 size;
+  float rotation; // counter-clockwise, in radians
+  float param, param2;
+  glm::vec4 color;
+
+  static SdfShape circle(glm::vec2 center, float radius, glm::vec4 color);
+  static SdfShape roundedRect(glm::vec2 center, glm::vec2 halfSize, float cornerRadius, glm::vec4 color);
+  static SdfShape polygon(glm::vec2 center, float radius, int sides, glm::vec4 color);
+  static SdfShape star(glm::vec2 center, float radius, int points, float sharpness, glm::vec4 color);
+  static SdfShape pinwheel(glm::vec2 center, float length, int blades, float width, glm::vec4 color);
+
+  ///
+  /// Radius of the circle (around center) that contains the whole shape
+  float boundingRadius() const;
+
+  ///
+  /// Signed distance from a world point to the shape (negative inside),
+  /// the same function the fragment shader evaluates
+  float distance(glm::vec2 point) const;
+
+  ///
+  /// Convex polygon (counter-clockwise, in the frame of the shape, at most
+  /// 8 vertices) containing the shape: exact for rectangles and polygons,
+  /// the hull of the points for stars and an enclosing octagon for circles
+  std::vector<glm::vec2> outline() const;
+};
+
+///
+/// Fragment shader code of the shapes, for other renderers of SdfShapes:
+/// the distance functions (shapeDistance(), reading the localPos,
+/// shapeParams, shapeSize, shapeColor and shapeId outputs of the vertex
+/// shader) and the anti-aliased color output. Paste them after a #version.
+extern const char *sdfDistanceShaderSource;
+extern const char *sdfFragmentShaderSource;
+
+///
+/// Draws every shape as one instanced quad; the fragment shader evaluates
+/// the distance field and derives the edge coverage from its screen space
+/// derivative, so edges are smooth without any multisampling.
+class SdfRenderer {
+public:
+  SdfRenderer();
+
+  ///
+  /// Compile the shader and allocate the buffers (requires a current context)
+  void create();
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Remove every shape
+  void clear();
+
+  ///
+  /// Add a shape and return its index
+  int add(const SdfShape &shape);
+
+  ///
+  /// Access a shape to change it (marks the instance buffer for upload)
+  SdfShape &shape(int index);
+  const SdfShape &shape(int index) const { return _shapes[_slotOf[index]]; }
+
+  int count() const { return (int)_shapes.size(); }
+
+  ///
+  /// World bounds of a shape
+  AABB bounds(int index) const;
+
+  ///
+  /// Structure used to find the shapes in a region (the culling and the
+  /// queries). The index is updated incrementally with the shapes changed
+  /// through shape() since the last query.
+  void setSpatialIndex(SpatialIndexType type);
+  SpatialIndexType spatialIndex() const { return _indexType; }
+
+  ///
+  /// Indices of the shapes whose bounds intersect the region, in drawing
+  /// order
+  void query(const AABB &region, std::vector<int> &result);
+
+  ///
+  /// Indices of the shapes whose bounds contain the point, in drawing order
+  void queryPoint(glm::vec2 point, std::vector<int> &result);
+
+  ///
+  /// Store the shapes along a space filling curve, so shapes close in the
+  /// world are close in memory: culling gathers fewer cache lines and
+  /// consecutive instances cover neighbouring pixels. Shape indices are
+  /// kept (they are remapped to the new storage), but overlapping shapes
+  /// are drawn in storage order, so their stacking may change. None
+  /// restores the insertion order.
+  void sortAlongCurve(SpaceFillingCurve curve);
+
+  ///
+  /// Sort automatically: after shapes are added, and every intervalFrames
+  /// draws while shapes keep changing (None disables it)
+  void setSpatialSort(SpaceFillingCurve curve, int intervalFrames = 300);
+  SpaceFillingCurve spatialSort() const { return _sortCurve; }
+
+  ///
+  /// Draw the shapes visible by the camera. Shapes outside its view are
+  /// culled on the CPU before they are packed, so only the visible ones
+  /// are uploaded and drawn; the packing is redone only when a shape or the
+  /// visible bounds changed.
+  void draw(const Camera &camera);
+
+  ///
+  /// Draw the index of the shape covering each pixel, plus idOffset, into
+  /// an unsigned integer target (used for picking)
+  void drawIds(const Camera &camera, GLuint idOffset);
+
+  ///
+  /// Number of shapes drawn by the last draw()
+  int drawnLastFrame() const { return (int)_instanceCount; }
+
+private:
+  bool prepare(const Camera &camera);
+  void upload(const AABB &visible, float margin);
+  void updateIndex();
+  AABB slotBounds(int slot) const;
+  void querySlots(const AABB &region, std::vector<int> &result);
+  void queryPointSlots(glm::vec2 point, std::vector<int> &result);
+
+  // shapes in storage order; shape indices go through _slotOf
+  std::vector<SdfShape> _shapes;
+  std::vector<int> _slotOf, _idOf;
+  bool _dirty;
+  AABB _culledBounds;
+
+  // space filling curve sorting
+  SpaceFillingCurve _sortCurve;
+  int _sortInterval, _framesSinceSort, _changesSinceSort, _sortedCount;
+
+  // spatial index over the storage slots: slots changed or added since
+  // the last update are re-inserted (a full rebuild after clear())
+  SpatialIndexType _indexType;
+  SpatialGrid _grid;
+  Bvh _bvh;
+  bool _indexValid;
+  int _indexedCount;
+  std::vector<int> _changed;
+  std::vector<bool> _changedFlags;
+  std::vector<int> _visible;
+
+  GLuint _program, _idProgram;
+  GLint _idOffsetLocation;
+  GLuint _VAO, _quadVBO, _instanceVBO;
+  size_t _instanceCapacity, _instanceCount;
+};
+}
+
+#endif
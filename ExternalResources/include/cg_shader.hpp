@@ -0,0 +1,30 @@
+#ifndef __CG_SHADER_HPP__
+#define __CG_SHADER_HPP__
+
+#include <glad/glad.h>
+
+namespace cgicmc {
+
+///
+/// Compile a vertex and a fragment shader and link them into a program.
+/// Compilation and link errors are printed to the standard output.
+GLuint createShaderProgram(const char *vertexSource, const char *fragmentSource);
+
+///
+/// Compile a compute shader into a program (requires GL 4.3)
+GLuint createComputeProgram(const char *computeSource);
+
+///
+/// Compile a vertex shader whose outputs named in varyings are captured,
+/// interleaved, by transform feedback (no fragment shader: draw with
+/// GL_RASTERIZER_DISCARD enabled)
+GLuint createTransformFeedbackProgram(const char *vertexSource, const char *const *varyings, int varyingCount);
+
+///
+/// Vertex shader that outputs a triangle covering the whole viewport, with
+/// texture coordinates in "uv". Draw it with glDrawArrays(GL_TRIANGLES, 0, 3)
+/// and any VAO bound (core profile requires one).
+extern const char *fullscreenVertexShaderSource;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef __CG_SPATIAL_INDEX_HPP__
+#define __CG_SPATIAL_INDEX_HPP__
+
+#include <cg_bounds.hpp>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Structure answering the region and point queries over object bounds
+enum class SpatialIndexType { Linear, Grid, Bvh };
+
+const char *spatialIndexName(SpatialIndexType type);
+
+///
+/// Space filling curves used to store spatially close objects next to each
+/// other. Hilbert keeps better locality (consecutive keys are always
+/// neighbour cells), Morton is cheaper to compute.
+enum class SpaceFillingCurve { None, Morton, Hilbert };
+
+const char *spaceFillingCurveName(SpaceFillingCurve curve);
+
+///
+/// Position of a cell of a 65536 x 65536 grid along the curve
+uint32_t mortonKey(uint32_t x, uint32_t y);
+uint32_t hilbertKey(uint32_t x, uint32_t y);
+
+///
+/// Order of the points along the curve: order[k] is the index of the k-th
+/// point (the points are quantized to 16 bits over their bounds)
+void spatialOrder(const std::vector<glm::vec2> &points, SpaceFillingCurve curve, std::vector<int> &order);
+
+///
+/// Loose uniform grid: every object lives in the cell holding the center
+/// of its bounds, and queries are grown by a cell, so objects never span
+/// cells. Objects larger than a cell go to a separate list that every
+/// query checks instead, so one large object (a ground, a wall) does not
+/// make every query scan the whole grid. Each cell keeps the bounds of its
+/// objects, recomputed when one leaves, and queries skip the cells whose
+/// bounds miss the region. Insert, move and remove are O(1) for a bounded
+/// number of objects per cell (the entry is swapped out of its cell),
+/// which suits scenes where many objects move every frame. Objects outside
+/// the world bounds go to the border cells.
+class SpatialGrid {
+public:
+  SpatialGrid();
+
+  ///
+  /// Remove every object and lay out the cells over the world bounds
+  void reset(const AABB &world, float cellSize);
+
+  ///
+  /// Remove every object (the layout is kept)
+  void clear();
+
+  ///
+  /// Add an object (ids are small non-negative integers, like indices)
+  void insert(int id, const AABB &bounds);
+
+  ///
+  /// Change the bounds of an object
+  void move(int id, const AABB &bounds);
+
+  void remove(int id);
+
+  bool contains(int id) const;
+
+  ///
+  /// Append the objects whose bounds intersect the region (unordered)
+  void query(const AABB &region, std::vector<int> &result) const;
+
+  ///
+  /// Append the objects whose bounds contain the point (unordered)
+  void queryPoint(glm::vec2 point, std::vector<int> &result) const;
+
+  int size() const { return _size; }
+
+private:
+  struct Entry {
+    AABB bounds;
+    int id;
+  };
+
+  struct Location {
+    int cell, slot;
+  };
+
+  int cellOf(const AABB &bounds) const;
+  void cellRange(const AABB &region, int &x0, int &y0, int &x1, int &y1) const;
+  void refreshCell(int cell);
+
+  // the objects larger than a cell, after the cells
+  int oversizedCell() const { return _columns * _rows; }
+
+  std::vector<std::vector<Entry>> _cells;
+  std::vector<AABB> _cellBounds; // of the objects in each cell
+  std::vector<Location> _locations; // by id (cell -1: not in the grid)
+  AABB _world;
+  float _cellSize, _inverseCellSize;
+  int _columns, _rows;
+  int _size;
+};
+
+///
+/// Bounding volume hierarchy built by median splits along the longest axis
+/// of the object centers. Nodes are stored in one array with children after
+/// their parent, so moving objects only needs their leaf bounds updated and
+/// a refit (one pass over the nodes in reverse order) instead of a rebuild.
+/// Queries are tighter than the grid's when object sizes vary a lot.
+class Bvh {
+public:
+  Bvh();
+
+  ///
+  /// Build the hierarchy over the bounds (id = index in the vector)
+  void build(const std::vector<AABB> &bounds);
+
+  void clear();
+
+  ///
+  /// Change the bounds of an object; the tree is refitted lazily
+  void update(int id, const AABB &bounds);
+
+  ///
+  /// Recompute the node bounds after updates (done by the queries when
+  /// needed, call it to keep that cost out of them)
+  void refit();
+
+  ///
+  /// Append the objects whose bounds intersect the region (unordered)
+  void query(const AABB &region, std::vector<int> &result);
+
+  ///
+  /// Append the objects whose bounds contain the point (unordered)
+  void queryPoint(glm::vec2 point, std::vector<int> &result);
+
+  int size() const { return (int)_bounds.size(); }
+
+private:
+  // leaves have count > 0 and hold _indices[first, first + count), inner
+  // nodes have count == 0 and their children at first and first + 1
+  struct Node {
+    AABB bounds;
+    int first, count;
+  };
+
+  void split(int node, int begin, int end, std::vector<glm::vec2> &centers);
+
+  std::vector<Node> _nodes;
+  std::vector<int> _indices;
+  std::vector<AABB> _bounds;
+  std::vector<int> _stack;
+  bool _needsRefit;
+};
+
+///
+/// Time build, update and query throughput of every index type over
+/// randomly placed objects and print the results
+void benchmarkSpatialIndex(std::ostream &out, int objectCount);
+
+///
+/// Time view culling plus instance packing with the objects stored in
+/// random, Morton and Hilbert order and print the results
+void benchmarkSpatialOrder(std::ostream &out, int objectCount);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef __CG_STRUCTURED_AFFINE_HPP__
+#define __CG_STRUCTURED_AFFINE_HPP__
+
+#include <cg_affine.hpp>
+#include <glm/glm.hpp>
+#include <ostream>
+
+namespace cgicmc {
+
+///
+/// What is known at compile time about a coefficient of a transform
+enum class TermKind { Zero, One, Any };
+
+///
+/// A coefficient: Zero and One hold nothing and are constants, Any holds
+/// its value. Multiplying or adding terms folds the constants away, so
+/// the result kind (and the work done) is decided at compile time.
+template <TermKind K>
+struct Term {
+  float value;
+  constexpr float get() const { return value; }
+};
+
+template <>
+struct Term<TermKind::Zero> {
+  constexpr float get() const { return 0.0f; }
+};
+
+template <>
+struct Term<TermKind::One> {
+  constexpr float get() const { return 1.0f; }
+};
+
+template <TermKind L, TermKind R>
+constexpr auto operator*(Term<L> l, Term<R> r) {
+  if constexpr (L == TermKind::Zero || R == TermKind::Zero)
+    return Term<TermKind::Zero>{};
+  else if constexpr (L == TermKind::One)
+    return r;
+  else if constexpr (R == TermKind::One)
+    return l;
+  else
+    return Term<TermKind::Any>{l.value * r.value};
+}
+
+template <TermKind L, TermKind R>
+constexpr auto operator+(Term<L> l, Term<R> r) {
+  if constexpr (L == TermKind::Zero)
+    return r;
+  else if constexpr (R == TermKind::Zero)
+    return l;
+  else
+    return Term<TermKind::Any>{l.get() + r.get()};
+}
+
+///
+/// An Affine2D whose structure is part of its type: each coefficient is
+/// known to be 0, known to be 1, or anything. Composing two of them only
+/// computes the terms that are not known to vanish, and the type of the
+/// result records which ones are left, so a chain of translations,
+/// rotations and axis scales compiles down to the few multiply-adds it
+/// really needs (a rotation then a translation is a copy and two
+/// assignments; a mat4 product is 64 multiply-adds).
+///
+/// The coefficients are laid out as in Affine2D:
+///   x' = a x + c y + tx
+///   y' = b x + d y + ty
+/// and l * r applies r first.
+template <TermKind A, TermKind B, TermKind C, TermKind D, TermKind TX, TermKind TY>
+struct StructuredAffine {
+  [[no_unique_address]] Term<A> a;
+  [[no_unique_address]] Term<B> b;
+  [[no_unique_address]] Term<C> c;
+  [[no_unique_address]] Term<D> d;
+  [[no_unique_address]] Term<TX> tx;
+  [[no_unique_address]] Term<TY> ty;
+
+  glm::vec2 apply(glm::vec2 p) const {
+    Term<TermKind::Any> x{p.x}, y{p.y};
+    return glm::vec2((a * x + c * y + tx).get(), (b * x + d * y + ty).get());
+  }
+
+  constexpr Affine2D toAffine() const { return Affine2D(a.get(), b.get(), c.get(), d.get(), tx.get(), ty.get()); }
+  glm::mat4 toMat4() const { return toAffine().toMat4(); }
+};
+
+template <TermKind A, TermKind B, TermKind C, TermKind D, TermKind TX, TermKind TY>
+constexpr StructuredAffine<A, B, C, D, TX, TY> structuredAffine(Term<A> a, Term<B> b, Term<C> c, Term<D> d, Term<TX> tx, Term<TY> ty) {
+  return StructuredAffine<A, B, C, D, TX, TY>{a, b, c, d, tx, ty};
+}
+
+template <TermKind A, TermKind B, TermKind C, TermKind D, TermKind TX, TermKind TY,
+          TermKind OA, TermKind OB, TermKind OC, TermKind OD, TermKind OTX, TermKind OTY>
+constexpr auto operator*(const StructuredAffine<A, B, C, D, TX, TY> &l, const StructuredAffine<OA, OB, OC, OD, OTX, OTY> &r) {
+  return structuredAffine(l.a * r.a + l.c * r.b, l.b * r.a + l.d * r.b,
+                          l.a * r.c + l.c * r.d, l.b * r.c + l.d * r.d,
+                          l.a * r.tx + l.c * r.ty + l.tx, l.b * r.tx + l.d * r.ty + l.ty);
+}
+
+using TranslationAffine = StructuredAffine<TermKind::One, TermKind::Zero, TermKind::Zero, TermKind::One, TermKind::Any, TermKind::Any>;
+using RotationAffine = StructuredAffine<TermKind::Any, TermKind::Any, TermKind::Any, TermKind::Any, TermKind::Zero, TermKind::Zero>;
+using ScalingAffine = StructuredAffine<TermKind::Any, TermKind::Zero, TermKind::Zero, TermKind::Any, TermKind::Zero, TermKind::Zero>;
+using ShearingAffine = StructuredAffine<TermKind::One, TermKind::Any, TermKind::Any, TermKind::One, TermKind::Zero, TermKind::Zero>;
+
+///
+/// The primitives, with the same meaning as the Affine2D builders
+constexpr TranslationAffine structuredTranslation(float x, float y) { return TranslationAffine{{}, {}, {}, {}, {x}, {y}}; }
+constexpr RotationAffine structuredRotation(float cos, float sin) { return RotationAffine{{cos}, {sin}, {-sin}, {cos}, {}, {}}; }
+constexpr RotationAffine structuredRotation(float angle) { return structuredRotation(constexprCos(angle), constexprSin(angle)); }
+constexpr ScalingAffine structuredScaling(float x, float y) { return ScalingAffine{{x}, {}, {}, {y}, {}, {}}; }
+constexpr ShearingAffine structuredShearing(float shearX, float shearY) { return ShearingAffine{{}, {shearY}, {shearX}, {}, {}, {}}; }
+
+///
+/// Fold structured transforms applied in order (the first one first):
+///   auto model = chain(structuredScaling(s, s), structuredRotation(c, s), structuredTranslation(x, y));
+template <TermKind A, TermKind B, TermKind C, TermKind D, TermKind TX, TermKind TY>
+constexpr StructuredAffine<A, B, C, D, TX, TY> chain(const StructuredAffine<A, B, C, D, TX, TY> &transform) {
+  return transform;
+}
+
+template <TermKind A, TermKind B, TermKind C, TermKind D, TermKind TX, TermKind TY, typename... Rest>
+constexpr auto chain(const StructuredAffine<A, B, C, D, TX, TY> &first, const Rest &...rest) {
+  return chain(rest...) * first;
+}
+
+///
+/// Time common chains (rotate then translate; scale, rotate, translate;
+/// rotate about a pivot then translate; a parent times a child) composed
+/// with glm mat4 products, with generic Affine2D products and with
+/// structured affines, over count random transforms
+void benchmarkStructuredAffine(std::ostream &out, int count);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __CG_THREAD_POOL_HPP__
+#define __CG_THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Fixed set of worker threads running data parallel loops. A range is
+/// always split into the same contiguous chunks for a given count and
+/// thread count, so per-chunk results concatenated in chunk order are
+/// deterministic.
+class ThreadPool {
+public:
+  ///
+  /// Process the items [begin, end) as chunk number chunk
+  typedef std::function<void(int begin, int end, int chunk)> RangeFunction;
+
+  ///
+  /// Start threadCount - 1 workers (the calling thread is the last one);
+  /// 0 uses every hardware thread
+  explicit ThreadPool(int threadCount = 0);
+  ~ThreadPool();
+
+  ///
+  /// Restart the pool with another number of threads
+  void setThreadCount(int threadCount);
+  int threadCount() const { return (int)_workers.size() + 1; }
+
+  ///
+  /// Split [0, count) into threadCount() chunks and run them in parallel,
+  /// returning when every chunk is done
+  void parallelFor(int count, const RangeFunction &function);
+
+  ///
+  /// First item of a chunk when count items are split in chunkCount chunks
+  static int chunkBegin(int count, int chunkCount, int chunk);
+
+private:
+  void start(int threadCount);
+  void stop();
+  void work(int chunk, unsigned generation);
+
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wake, _finished;
+  const RangeFunction *_function;
+  int _count;
+  unsigned _generation;
+  int _running;
+  bool _quit;
+};
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef __CG_TRANSFORM_HPP__
+#define __CG_TRANSFORM_HPP__
+
+#include <cg_affine.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Kinds of steps of a TransformPipeline
+enum class TransformStep { Translate, Rotate, Scale, Shear, Reflect };
+
+///
+/// A chain of 2D transforms applied in the order they were added, each
+/// about its own pivot, folded into a single cached Affine2D.
+///
+/// Every step keeps its matrix and the chain keeps the fold of the steps
+/// up to each one, so changing a parameter only refolds from its step on
+/// (changing the last step costs one product), and reading the affine
+/// when nothing changed costs nothing. Setting a parameter to the value it
+/// already has does not invalidate anything. For chains known at compile
+/// time, fold the Affine2D builders with chain() into a constexpr instead.
+class TransformPipeline {
+public:
+  TransformPipeline();
+
+  ///
+  /// Add a step and return its index:
+  ///   translate: by offset
+  ///   rotate: counter-clockwise by angle radians about pivot
+  ///   scale: by factors about pivot
+  ///   shear: x' = x + factors.x y, y' = y + factors.y x, about pivot
+  ///   reflect: across the line through pivot along direction
+  int translate(glm::vec2 offset);
+  int rotate(float angle, glm::vec2 pivot = glm::vec2(0.0f));
+  int scale(glm::vec2 factors, glm::vec2 pivot = glm::vec2(0.0f));
+  int shear(glm::vec2 factors, glm::vec2 pivot = glm::vec2(0.0f));
+  int reflect(glm::vec2 direction, glm::vec2 pivot = glm::vec2(0.0f));
+
+  ///
+  /// Change a step: its vector (offset, factors or direction), its angle
+  /// (rotations) or its pivot
+  void setVector(int step, glm::vec2 value);
+  void setAngle(int step, float angle);
+  void setPivot(int step, glm::vec2 pivot);
+
+  glm::vec2 vector(int step) const { return _steps[step].value; }
+  float angle(int step) const { return _steps[step].angle; }
+  glm::vec2 pivot(int step) const { return _steps[step].pivot; }
+  TransformStep type(int step) const { return _steps[step].type; }
+  int size() const { return (int)_steps.size(); }
+
+  ///
+  /// Remove every step (the affine becomes the identity)
+  void clear();
+
+  ///
+  /// The whole chain, refolded from the first step changed if needed
+  const Affine2D &affine();
+
+  ///
+  /// Matrix products done by the folds so far
+  long long products() const { return _products; }
+
+private:
+  struct Step {
+    TransformStep type;
+    glm::vec2 value, pivot;
+    float angle;
+    Affine2D matrix;
+  };
+
+  int add(TransformStep type, glm::vec2 value, float angle, glm::vec2 pivot);
+  void changed(int step);
+  static Affine2D stepMatrix(const Step &step);
+
+  std::vector<Step> _steps;
+  // _folded[i]: the steps 0 to i; valid before _firstChanged
+  std::vector<Affine2D> _folded;
+  int _firstChanged;
+  long long _products;
+};
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef __CG_TRIG_HPP__
+#define __CG_TRIG_HPP__
+
+#include <ostream>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Sine and cosine of count angles at once, 8 (AVX2) or 4 (SSE) per
+/// instruction, with a scalar path for the rest and where SIMD is not
+/// available (or not asked for); both paths do the same operations.
+///
+/// The angle is reduced to r in [-pi/4, pi/4] by subtracting q pi/2, q
+/// the nearest integer, with pi/2 split in three parts so that q pi/2 is
+/// exact while |q| < 2^13; minimax polynomials of r then give both values,
+/// swapped and negated by the quadrant q mod 4. The largest absolute
+/// error against double precision is 9.3e-8 for |angle| <= 8192 (libm's
+/// is 3e-8) and 1e-6 up to 1e5; from 1e6 on the results are meaningless.
+void sinCos(const float *angles, float *sines, float *cosines, int count, bool vectorized = true);
+
+///
+/// The same as the batch, for a single angle
+void sinCos(float angle, float &sine, float &cosine);
+
+///
+/// Whether the batch sinCos was built with AVX2 (8 lanes) or SSE (4)
+const char *sinCosInstructionSet();
+
+///
+/// Rotations turning by a constant step each: advancing all of them
+/// rotates every (cos, sin) pair by its step's, a few multiply-adds and
+/// no trigonometry. The pairs are pulled back to unit length at every
+/// step, and recomputed from the exact angles every RESYNC_STEPS steps, so
+/// the rounding cannot pile up: they stay within 2e-6 of the exact sines
+/// and cosines for steps up to 0.1 radians.
+class RotationRecurrence {
+public:
+  static const int RESYNC_STEPS = 64;
+
+  RotationRecurrence();
+
+  ///
+  /// Add a rotation at an angle turning by step radians per advance() and
+  /// return its index
+  int add(float angle, float step);
+
+  ///
+  /// Change the step of a rotation (from its current angle)
+  void setStep(int rotation, float step);
+
+  ///
+  /// Turn every rotation by its step
+  void advance();
+
+  float cosine(int rotation) const { return _cos[rotation]; }
+  float sine(int rotation) const { return _sin[rotation]; }
+  const float *cosines() const { return _cos.data(); }
+  const float *sines() const { return _sin.data(); }
+
+  ///
+  /// The exact angle of a rotation (what the pair is an approximation of),
+  /// in [-pi, pi]
+  float angle(int rotation) const;
+
+  int count() const { return (int)_cos.size(); }
+  void clear();
+
+  ///
+  /// Advance with the scalar code instead of SIMD (for comparison)
+  void setVectorized(bool vectorized) { _vectorized = vectorized; }
+
+  ///
+  /// Time taken by the last advance()
+  double updateMilliseconds() const { return _updateMilliseconds; }
+
+private:
+  void resync();
+
+  // the angle of rotation i is _start[i] + _steps * _step[i], in double
+  // precision so that it does not drift however long this runs
+  std::vector<double> _start;
+  std::vector<float> _step, _stepCos, _stepSin;
+  std::vector<float> _cos, _sin, _angles;
+  long long _steps;
+  bool _vectorized;
+  double _updateMilliseconds;
+};
+
+///
+/// Compute the sines and cosines of count angles with libm, with the
+/// scalar and the SIMD sinCos, and advance count constant-speed rotations
+/// with the recurrence; print the times and the largest errors
+void benchmarkTrig(std::ostream &out, int count);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef __CG_VERTEX_PULLING_HPP__
+#define __CG_VERTEX_PULLING_HPP__
+
+#include <cg_affine.hpp>
+#include <cg_camera.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace cgicmc {
+
+///
+/// Where the vertex shader of a VertexPuller reads its data from: a buffer
+/// texture (GL 3.3) or a shader storage buffer (GL 4.3)
+enum class PullingStorage { TextureBuffer, StorageBuffer };
+
+const char *pullingStorageName(PullingStorage storage);
+
+///
+/// How the vertices of a mesh are stored: a position, or a position and a
+/// color (multiplied by the color of the instance)
+enum class VertexFormat { Position, PositionColor };
+
+///
+/// What an instance holds besides its color: an offset and a uniform
+/// scale, or a whole affine transform
+enum class InstanceLayout { OffsetScale, Affine };
+
+///
+/// Draws indexed meshes of different vertex formats, with instances of
+/// different layouts, in a single draw and without vertex attributes: the
+/// vertex shader pulls everything from one buffer of 32-bit words, given
+/// only gl_VertexID.
+///
+/// The instances are grouped in runs of the same mesh and layout; each
+/// run records the first vertex it covers, its mesh (index and vertex
+/// words, format) and its instances (words, layout). A vertex finds its
+/// run by a binary search on the first vertices, then its instance and
+/// index by dividing by the index count of the mesh. Adding a mesh or an
+/// instance rebuilds the buffer; changing an instance only uploads the
+/// instance words again.
+class VertexPuller {
+public:
+  VertexPuller();
+
+  ///
+  /// Compile the shaders and allocate the buffer (requires a current
+  /// context); the storage buffer is used when the context has it
+  void create();
+
+  ///
+  /// Release every GL object
+  void destroy();
+
+  ///
+  /// Add a mesh (an indexed triangle list, in its own frame) and return
+  /// its index
+  int addMesh(const std::vector<glm::vec2> &positions, const std::vector<GLuint> &indices);
+  int addMesh(const std::vector<glm::vec2> &positions, const std::vector<glm::vec4> &colors,
+    const std::vector<GLuint> &indices);
+
+  ///
+  /// Add an instance of a mesh and return its index
+  int add(int mesh, glm::vec2 offset, float scale, glm::vec4 color);
+  int add(int mesh, const Affine2D &transform, glm::vec4 color);
+
+  ///
+  /// Change an instance, keeping its layout
+  void setOffset(int instance, glm::vec2 offset, float scale);
+  void setTransform(int instance, const Affine2D &transform);
+  void setColor(int instance, glm::vec4 color);
+
+  ///
+  /// Replace the transforms of count instances, from first, at once
+  void setTransforms(int first, int count, const Affine2D *transforms);
+
+  ///
+  /// Remove every instance (the meshes stay)
+  void clear();
+
+  int count() const { return (int)_instances.size(); }
+  int meshCount() const { return (int)_meshes.size(); }
+
+  ///
+  /// Select the storage (the storage buffer only if the context has it)
+  void setStorage(PullingStorage storage);
+  PullingStorage storage() const { return _storage; }
+
+  ///
+  /// Draw every instance of every mesh
+  void draw(const Camera &camera);
+
+  ///
+  /// Vertices and runs of the last draw, and the bytes uploaded the last
+  /// time something changed
+  int verticesLastFrame() const { return _vertexCount; }
+  int runCount() const { return _runCount; }
+  size_t uploadedBytes() const { return _uploadedBytes; }
+
+private:
+  struct Mesh {
+    VertexFormat format;
+    int indexWord, vertexWord, indexCount;
+  };
+  struct Instance {
+    int mesh;
+    InstanceLayout layout;
+    int word; // of its data, once the buffer is built
+  };
+
+  void build();
+  void writeInstance(int instance);
+
+  std::vector<Mesh> _meshes;
+  std::vector<GLuint> _meshWords; // indices and vertices of every mesh
+  std::vector<Instance> _instances;
+  std::vector<Affine2D> _transforms; // the offset and scale as a transform
+  std::vector<GLuint> _colors; // RGBA8
+
+  // runs, then the mesh words, then the instance words
+  std::vector<GLuint> _words;
+  int _runCount, _instanceWord, _vertexCount;
+  bool _layoutDirty, _instancesDirty;
+
+  PullingStorage _storage;
+  GLuint _programs[2];
+  GLuint _VAO, _buffer, _texture;
+  size_t _capacity, _uploadedBytes;
+  GLint _maxTexels;
+  GLint _runCountLocations[2];
+};
+}
+
+#endif
@@ -1,12 +1,35 @@
 #ifndef __CG_WINDOW_HPP__
 #define __CG_WINDOW_HPP__
 
+#include <cg_animation.hpp>
+#include <cg_antialiasing.hpp>
+#include <cg_camera.hpp>
+#include <cg_collision.hpp>
+#include <cg_damage.hpp>
+#include <cg_dynamic_resolution.hpp>
+#include <cg_layers.hpp>
+#include <cg_mesh_batch.hpp>
+#include <cg_motion.hpp>
+#include <cg_particles.hpp>
+#include <cg_path.hpp>
+#include <cg_physics.hpp>
+#include <cg_picking.hpp>
+#include <cg_present.hpp>
+#include <cg_render_pass.hpp>
+#include <cg_scene_graph.hpp>
+#include <cg_script.hpp>
+#include <cg_sdf_shapes.hpp>
+#include <cg_structured_affine.hpp>
+#include <cg_transform.hpp>
+#include <cg_trig.hpp>
+#include <cg_vertex_pulling.hpp>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp> // glm::mat4
 #include <glm/gtc/type_ptr.hpp> // glm::value_ptr
 #include <iostream>
+#include <vector>
 
 namespace cgicmc {
 
@@ -28,11 +51,234 @@ public:
   /// Run the application in a loop.
   void run();
 
+  ///
+  /// Select the anti-aliasing mode (can be changed at any time, the M key
+  /// cycles through the modes while running)
+  void setAntiAliasing(AAMode mode);
+
+  ///
+  /// Render at a resolution that adapts to keep the GPU frame time within
+  /// the budget (the V key toggles it while running)
+  void setDynamicResolution(bool enabled, double targetMilliseconds = 12.0,
+                            UpscaleFilter filter = UpscaleFilter::Sharpen);
+
+  ///
+  /// Render the scene at a fixed fraction of the window resolution (the
+  /// dynamic resolution may still lower it further)
+  void setRenderScale(float scale);
+
+  ///
+  /// Scatter random static shapes over a square world of the given half
+  /// size, to be explored with the camera (arrow keys pan, the mouse wheel
+  /// zooms); only the shapes in view are uploaded and drawn
+  void addRandomShapes(int count, float extent);
+
+  ///
+  /// Scatter shapes that spin, orbit, oscillate or drift over a square
+  /// world of the given half size; their motion is evaluated by the vertex
+  /// shader (the N key shows and hides them)
+  void addAnimatedShapes(int count, float extent);
+
+  ///
+  /// Add count spinning instances of a few tiny meshes (3 to 144 vertices)
+  /// in a world of the given half size, for the batcher and the vertex
+  /// puller (the U key shows them and cycles how they are drawn)
+  void addTinyMeshes(int count, float extent);
+
+  ///
+  /// Stack columns of boxes (count in total) on a ground and simulate them
+  /// as rigid bodies from the first frame; the camera is moved to them
+  void addPhysicsStacks(int count);
+
+  ///
+  /// Select how a click finds the shape under the cursor (the G key
+  /// switches while running)
+  void setPickMode(PickMode mode) { pickMode = mode; }
+
 protected:
   void processInput(GLFWwindow *window);
 
+  ///
+  /// Record the new framebuffer size; the resize itself is applied once
+  /// per frame so a drag producing many events reallocates at most once
+  static void framebufferSizeCallback(GLFWwindow *window, int width, int height);
+
+  ///
+  /// Accumulate the wheel motion, applied as a zoom on the next frame
+  static void scrollCallback(GLFWwindow *window, double xOffset, double yOffset);
+
+  ///
+  /// Bring every size-dependent resource to the framebuffer size
+  void applyResize(int width, int height);
+
+  ///
+  /// Cursor position in clip space
+  glm::vec2 cursorClipPosition();
+
+  ///
+  /// Pick id of the topmost shape at a world point, tested on the CPU
+  /// (spatial query, then the exact distance or triangle tests)
+  GLuint pickCpu(glm::vec2 point);
+
+  ///
+  /// Highlight the shape with the given pick id
+  void select(GLuint id);
+
+  ///
+  /// Create the collision bodies of the pinwheel and of the scene shapes
+  void buildCollisionWorld();
+
+  ///
+  /// Put the pinwheel back where it was if its new pose touches a shape
+  void resolveCollisions();
+
+  ///
+  /// Advance the rigid bodies by the fixed steps that fit in the real time
+  /// since the last frame and move their shapes
+  void stepPhysics();
+
+  ///
+  /// Show the frame statistics in the window title
+  void updateTitle();
+
   // openGL variables
   GLFWwindow *_window;
+  int _width, _height; // framebuffer size in pixels (not screen coordinates)
+
+  // resize events are coalesced until the next frame
+  int pendingWidth, pendingHeight;
+  bool resizePending;
+  int resizeEvents;
+
+  // real time since the previous frame, clamped after a stall
+  double lastFrameTime;
+  float frameDelta;
+  float renderScale;
+
+  // camera variables: the layer camera only corrects the aspect, for the
+  // content of layers that move with their compositing transform
+  Camera camera, layerCamera;
+  double pendingScroll;
+  unsigned lastCameraVersion;
+  const float PAN_VAR = 0.01f; // fraction of the visible height per frame
+
+  // static scene shapes (drawn below the pinwheel), culled through a
+  // spatial index (I key cycles the index type) and optionally stored in
+  // Hilbert order (H key)
+  SdfRenderer sceneShapes;
+  int sceneLayer;
+  bool indexKeyPressed, sortKeyPressed;
+
+  // picking variables (left click selects the shape under the cursor);
+  // pick ids: 0 nothing, 1 the pinwheel, 2 + index the scene shapes
+  static const GLuint PINWHEEL_ID = 1;
+  static const GLuint SCENE_ID_BASE = 2;
+  PickMode pickMode;
+  GpuPicker picker;
+  Camera pickCamera;
+  bool mousePressed, pickKeyPressed, pickRequested;
+  GLuint selected;
+  glm::vec4 selectedColor;
+  glm::mat4 pinwheelModel;
+  std::vector<glm::vec2> pinwheelTriangles;
+
+  // collisions (C key): the pinwheel mesh is body 0 and each scene shape
+  // a static body after it; a move or a rotation into a shape is undone
+  CollisionWorld collisions;
+  bool useCollisions, collisionKeyPressed;
+  float freeX, freeY, freeAngle;
+
+  // keyframed pinwheel (K key cycles its clips, crossfading, then gives
+  // the control back to the keyboard); object 0 of the animator
+  Animator pinwheelAnimator;
+  int pinwheelClip, pinwheelClipCount;
+  bool keyframeKeyPressed;
+
+  // pinwheel moving at constant speed along a closed spline (T key);
+  // follower 0 of the path followers
+  PathFollowers pinwheelPath;
+  bool usePath, pathKeyPressed;
+
+  // scripted behaviors, resumed once per frame; the Y key starts or stops
+  // the pinwheel script (spin up, spin, stop, reverse...)
+  ScriptScheduler scripts;
+  int pinwheelScript;
+  bool scriptKeyPressed;
+
+  // transform hierarchy: the pinwheel node, and (O key) moons orbiting it,
+  // each with a moon of its own; moonShapes[i] draws moonNodes[i], which
+  // turns at the constant speed of moonRotations' rotation i
+  SceneGraph sceneGraph;
+  int pinwheelNode;
+  std::vector<int> moonNodes, moonShapeIds;
+  SdfRenderer moonShapes;
+  RotationRecurrence moonRotations;
+  bool useMoons, moonKeyPressed;
+
+  // the pinwheel model, folded again only when a step changes: scale (Z/X
+  // keys), shear (J cycles it), reflection (B toggles it), then the
+  // rotation and the translation; the SDF pinwheel, the picking by
+  // distance and the collisions only follow the last two
+  TransformPipeline pinwheelTransform;
+  int scaleStep, shearStep, reflectStep, rotateStep, translateStep;
+  float pinwheelScale;
+  int pinwheelShear;
+  bool shearKeyPressed, reflectKeyPressed, pinwheelReflected;
+
+  // shapes with closed-form motion (N key), animated by the GPU from the
+  // time since they were shown
+  AnimatedShapeRenderer animatedShapes;
+  bool useAnimation, animationKeyPressed;
+  double animationStart;
+
+  // tiny meshes (U key cycles hidden, auto, pre-transformed, instanced from
+  // attributes and from a buffer texture, and pulled by the vertex
+  // shader): instance i is placed at tinyMeshPlacements[i] (x, y, size)
+  // and turns with tinyMeshRotations' rotation i; the transforms of a
+  // frame are gathered in tinyMeshTransforms and handed over at once
+  MeshBatcher tinyMeshes;
+  VertexPuller tinyMeshPuller;
+  RotationRecurrence tinyMeshRotations;
+  std::vector<glm::vec3> tinyMeshPlacements;
+  std::vector<Affine2D> tinyMeshTransforms;
+  bool useTinyMeshes, pullTinyMeshes, tinyMeshKeyPressed;
+
+  // rigid bodies: body i is drawn as the scene shape physicsShapes[i]
+  PhysicsWorld physics;
+  std::vector<int> physicsShapes;
+  double physicsAccumulator; // real time not yet stepped
+
+  // particles (F key cycles off, compute shader, transform feedback):
+  // sprayed from the center of the pinwheel along its first blade
+  ParticleSystem particles;
+  bool useParticles, particlesKeyPressed;
+  double lastParticleTime;
+
+  // anti-aliasing variables
+  AntiAliasing antiAliasing;
+  bool aaKeyPressed;
+  double lastTitleUpdate;
+
+  // signed distance field shapes (P key toggles them with the triangles)
+  SdfRenderer sdfShapes;
+  int pinwheelShape;
+  bool useSdfShapes, sdfKeyPressed;
+
+  // retained layers (L key): content is cached and moved by the compositor
+  LayerCompositor layers;
+  bool useLayers, layersKeyPressed;
+
+  // partial redraw (R key): only the damaged regions are redrawn into a
+  // retained target and presented
+  DamageTracker damage;
+  Presenter presenter;
+  Framebuffer retained;
+  bool usePartialRedraw, partialKeyPressed;
+  float lastX, lastY, lastAngle;
+
+  // dynamic resolution (full redraw only)
+  DynamicResolution dynamicResolution;
+  bool useDynamicResolution, dynamicKeyPressed;
 
   // translation variables
   float x, y;
@@ -0,0 +1,29 @@
+#include <cg_affine.hpp>
+#include <cmath>
+
+namespace cgicmc {
+
+	float Affine2D::angle() const {
+		return std::atan2(b, a);
+	}
+
+	// a singular transform has no inverse: the identity is returned
+	Affine2D Affine2D::inverse() const {
+		if (determinant() == 0.0f)
+			return Affine2D();
+		float s = 1.0f / determinant();
+		float ia = d * s, ib = -b * s, ic = -c * s, id = a * s;
+		return Affine2D(ia, ib, ic, id, -(ia * tx + ic * ty), -(ib * tx + id * ty));
+	}
+
+	glm::mat4 Affine2D::toMat4() const {
+		glm::mat4 m(1.0f);
+		m[0][0] = a;
+		m[0][1] = b;
+		m[1][0] = c;
+		m[1][1] = d;
+		m[3][0] = tx;
+		m[3][1] = ty;
+		return m;
+	}
+}
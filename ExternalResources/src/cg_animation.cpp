@@ -0,0 +1,513 @@
+#include <cg_animation.hpp>
+#include <cg_trig.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CG_ANIMATION_SSE 1
+#endif
+
+namespace cgicmc {
+
+	AnimationClip::AnimationClip(float duration, bool looping) {
+		_duration = std::max(duration, 1e-6f);
+		_looping = looping;
+	}
+
+	void AnimationClip::addKey(AnimationChannel channel, float time, float value, Interpolation mode) {
+		std::vector<Key> &keys = _keys[(int)channel];
+		Key key = { time, value, mode };
+		std::vector<Key>::iterator position = keys.begin();
+		while (position != keys.end() && position->time <= time)
+			++position;
+		keys.insert(position, key);
+	}
+
+	void AnimationClip::addPositionKey(float time, glm::vec2 position, Interpolation mode) {
+		addKey(AnimationChannel::PositionX, time, position.x, mode);
+		addKey(AnimationChannel::PositionY, time, position.y, mode);
+	}
+
+	void AnimationClip::addRotationKey(float time, float angle, Interpolation mode) {
+		addKey(AnimationChannel::Rotation, time, angle, mode);
+	}
+
+	void AnimationClip::addScaleKey(float time, glm::vec2 scale, Interpolation mode) {
+		addKey(AnimationChannel::ScaleX, time, scale.x, mode);
+		addKey(AnimationChannel::ScaleY, time, scale.y, mode);
+	}
+
+	void AnimationClip::addColorKey(float time, glm::vec4 color, Interpolation mode) {
+		for (int i = 0; i < 4; i++)
+			addKey((AnimationChannel)((int)AnimationChannel::Red + i), time, color[i], mode);
+	}
+
+	float AnimationClip::restValue(AnimationChannel channel) {
+		switch (channel) {
+		case AnimationChannel::PositionX:
+		case AnimationChannel::PositionY:
+		case AnimationChannel::Rotation: return 0.0f;
+		default: return 1.0f;
+		}
+	}
+
+	void AnimationClip::keyCubic(int channel, int i, float coefficients[4]) const {
+		const std::vector<Key> &keys = _keys[channel];
+		float v0 = keys[i].value, v1 = keys[i + 1].value;
+		coefficients[0] = v0;
+		coefficients[1] = coefficients[2] = coefficients[3] = 0.0f;
+		if (keys[i].mode == Interpolation::Linear) {
+			coefficients[1] = v1 - v0;
+		} else if (keys[i].mode == Interpolation::Smooth) {
+			// Catmull-Rom slopes from the neighbours (one-sided at the ends),
+			// as tangents of the cubic Hermite curve over the interval
+			int n = (int)keys.size();
+			float slopes[2];
+			for (int j = 0; j < 2; j++) {
+				int previous = std::max(i + j - 1, 0), next = std::min(i + j + 1, n - 1);
+				float span = keys[next].time - keys[previous].time;
+				slopes[j] = span > 0.0f ? (keys[next].value - keys[previous].value) / span : 0.0f;
+			}
+			float length = keys[i + 1].time - keys[i].time;
+			float m0 = slopes[0] * length, m1 = slopes[1] * length;
+			coefficients[1] = m0;
+			coefficients[2] = 3.0f * (v1 - v0) - 2.0f * m0 - m1;
+			coefficients[3] = 2.0f * (v0 - v1) + m0 + m1;
+		}
+	}
+
+	// same wrapping as Animator::advance()
+	static float clipTime(float time, float duration, bool looping) {
+		if (looping)
+			return time - std::floor(time / duration) * duration;
+		return std::min(std::max(time, 0.0f), duration);
+	}
+
+	float AnimationClip::evaluate(AnimationChannel channel, float time) const {
+		const std::vector<Key> &keys = _keys[(int)channel];
+		if (keys.empty())
+			return restValue(channel);
+		time = clipTime(time, _duration, _looping);
+		if (time <= keys.front().time)
+			return keys.front().value;
+		if (time >= keys.back().time)
+			return keys.back().value;
+		int i = 0;
+		while (keys[i + 1].time <= time)
+			i++;
+		float coefficients[4];
+		keyCubic((int)channel, i, coefficients);
+		float s = (time - keys[i].time) / (keys[i + 1].time - keys[i].time);
+		return ((coefficients[3] * s + coefficients[2]) * s + coefficients[1]) * s + coefficients[0];
+	}
+
+	Animator::Animator() {
+		_count = 0;
+		_vectorized = true;
+		_updateMilliseconds = 0.0;
+	}
+
+	int Animator::addClip(const AnimationClip &clip) {
+		// the timeline: every key time within the clip, plus its ends
+		std::vector<float> times;
+		times.push_back(0.0f);
+		times.push_back(clip._duration);
+		for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++)
+			for (size_t k = 0; k < clip._keys[c].size(); k++)
+				if (clip._keys[c][k].time > 0.0f && clip._keys[c][k].time < clip._duration)
+					times.push_back(clip._keys[c][k].time);
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+
+		BakedClip baked;
+		baked.duration = clip._duration;
+		baked.looping = clip._looping;
+		baked.firstSegment = (int)_segmentStart.size();
+		baked.segmentCount = (int)times.size() - 1;
+
+		for (int s = 0; s < baked.segmentCount; s++) {
+			float start = times[s], end = times[s + 1];
+			_segmentStart.push_back(start);
+			_segmentScale.push_back(1.0f / (end - start));
+
+			for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++) {
+				const std::vector<AnimationClip::Key> &keys = clip._keys[c];
+				float coefficients[4] = { AnimationClip::restValue((AnimationChannel)c), 0.0f, 0.0f, 0.0f };
+
+				// the key interval holding the segment (no key time is inside it)
+				float middle = 0.5f * (start + end);
+				if (!keys.empty() && middle <= keys.front().time) {
+					coefficients[0] = keys.front().value;
+				} else if (!keys.empty() && middle >= keys.back().time) {
+					coefficients[0] = keys.back().value;
+				} else if (!keys.empty()) {
+					int i = 0;
+					while (keys[i + 1].time <= middle)
+						i++;
+					float key[4];
+					clip.keyCubic(c, i, key);
+
+					// p(s0 + k u) for u in [0, 1], expanded in powers of u
+					float length = keys[i + 1].time - keys[i].time;
+					float s0 = (start - keys[i].time) / length;
+					float k = (end - start) / length;
+					coefficients[0] = ((key[3] * s0 + key[2]) * s0 + key[1]) * s0 + key[0];
+					coefficients[1] = k * (key[1] + 2.0f * key[2] * s0 + 3.0f * key[3] * s0 * s0);
+					coefficients[2] = k * k * (key[2] + 3.0f * key[3] * s0);
+					coefficients[3] = k * k * k * key[3];
+				}
+				for (int j = 0; j < 4; j++)
+					_coefficients.push_back(coefficients[j]);
+			}
+		}
+
+		_clips.push_back(baked);
+		return (int)_clips.size() - 1;
+	}
+
+	void Animator::clearObjects() {
+		_count = 0;
+		for (int layer = 0; layer < 2; layer++) {
+			_clip[layer].clear();
+			_segment[layer].clear();
+			_time[layer].clear();
+			_speed[layer].clear();
+			_duration[layer].clear();
+			_looping[layer].clear();
+			_segmentBegin[layer].clear();
+			_segmentEnd[layer].clear();
+			_segmentObjectScale[layer].clear();
+			_u[layer].clear();
+		}
+		_weight.clear();
+		_fadeRate.clear();
+		for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++)
+			_values[c].clear();
+	}
+
+	int Animator::addObject(int clip, float time, float speed) {
+		int object = _count++;
+		for (int layer = 0; layer < 2; layer++) {
+			_clip[layer].push_back(0);
+			_segment[layer].push_back(0);
+			_time[layer].push_back(0.0f);
+			_speed[layer].push_back(0.0f);
+			_duration[layer].push_back(0.0f);
+			_looping[layer].push_back(0.0f);
+			_segmentBegin[layer].push_back(0.0f);
+			_segmentEnd[layer].push_back(0.0f);
+			_segmentObjectScale[layer].push_back(0.0f);
+			_u[layer].push_back(0.0f);
+			setLayer(layer, object, clip, time, speed);
+		}
+		_weight.push_back(1.0f);
+		_fadeRate.push_back(0.0f);
+		for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++)
+			_values[c].push_back(AnimationClip::restValue((AnimationChannel)c));
+		return object;
+	}
+
+	void Animator::setLayer(int layer, int object, int clip, float time, float speed) {
+		const BakedClip &baked = _clips[clip];
+		_clip[layer][object] = clip;
+		_segment[layer][object] = baked.firstSegment;
+		_time[layer][object] = clipTime(time, baked.duration, baked.looping);
+		_speed[layer][object] = std::max(speed, 0.0f);
+		_duration[layer][object] = baked.duration;
+		_looping[layer][object] = baked.looping ? 1.0f : 0.0f;
+		findSegment(layer, object);
+	}
+
+	// the clip being faded to becomes the one faded from (a fade cut short
+	// jumps to its target)
+	void Animator::play(int object, int clip, float fadeSeconds, float speed) {
+		_clip[0][object] = _clip[1][object];
+		_segment[0][object] = _segment[1][object];
+		_time[0][object] = _time[1][object];
+		_speed[0][object] = _speed[1][object];
+		_duration[0][object] = _duration[1][object];
+		_looping[0][object] = _looping[1][object];
+		_segmentBegin[0][object] = _segmentBegin[1][object];
+		_segmentEnd[0][object] = _segmentEnd[1][object];
+		_segmentObjectScale[0][object] = _segmentObjectScale[1][object];
+		setLayer(1, object, clip, 0.0f, speed);
+		_weight[object] = fadeSeconds > 0.0f ? 0.0f : 1.0f;
+		_fadeRate[object] = fadeSeconds > 0.0f ? 1.0f / fadeSeconds : 0.0f;
+	}
+
+	void Animator::blend(int object, int clipA, int clipB, float weight) {
+		setLayer(0, object, clipA, 0.0f, 1.0f);
+		setLayer(1, object, clipB, 0.0f, 1.0f);
+		_weight[object] = glm::clamp(weight, 0.0f, 1.0f);
+		_fadeRate[object] = 0.0f;
+	}
+
+	glm::vec2 Animator::position(int object) const {
+		return glm::vec2(value(object, AnimationChannel::PositionX), value(object, AnimationChannel::PositionY));
+	}
+
+	glm::vec2 Animator::scale(int object) const {
+		return glm::vec2(value(object, AnimationChannel::ScaleX), value(object, AnimationChannel::ScaleY));
+	}
+
+	glm::vec4 Animator::color(int object) const {
+		return glm::vec4(value(object, AnimationChannel::Red), value(object, AnimationChannel::Green),
+			value(object, AnimationChannel::Blue), value(object, AnimationChannel::Alpha));
+	}
+
+	void Animator::transforms(Affine2D *out) const {
+		const int BATCH = 256;
+		float sines[BATCH], cosines[BATCH];
+		const float *x = channel(AnimationChannel::PositionX), *y = channel(AnimationChannel::PositionY);
+		const float *scaleX = channel(AnimationChannel::ScaleX), *scaleY = channel(AnimationChannel::ScaleY);
+		const float *rotation = channel(AnimationChannel::Rotation);
+		for (int begin = 0; begin < _count; begin += BATCH) {
+			int n = std::min(BATCH, _count - begin);
+			sinCos(rotation + begin, sines, cosines, n, _vectorized);
+			for (int k = 0; k < n; k++) {
+				int i = begin + k;
+				out[i] = Affine2D(cosines[k] * scaleX[i], sines[k] * scaleX[i], -sines[k] * scaleY[i], cosines[k] * scaleY[i], x[i], y[i]);
+			}
+		}
+	}
+
+	void Animator::update(float dt) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		advance(dt);
+		findSegments();
+		evaluate();
+		_updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// times move by dt * speed, wrapped by looping clips and clamped by the
+	// others; weights move towards 1 at their fade rate
+	void Animator::advance(float dt) {
+		int i = 0;
+#ifdef CG_ANIMATION_SSE
+		if (_vectorized) {
+			__m128 step = _mm_set1_ps(dt), one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+			for (; i + 4 <= _count; i += 4) {
+				for (int layer = 0; layer < 2; layer++) {
+					__m128 time = _mm_add_ps(_mm_loadu_ps(&_time[layer][i]), _mm_mul_ps(step, _mm_loadu_ps(&_speed[layer][i])));
+					__m128 duration = _mm_loadu_ps(&_duration[layer][i]);
+					// the times are positive, so truncating is flooring
+					__m128 turns = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(time, duration)));
+					__m128 wrapped = _mm_sub_ps(time, _mm_mul_ps(turns, duration));
+					__m128 clamped = _mm_min_ps(time, duration);
+					__m128 looping = _mm_cmpgt_ps(_mm_loadu_ps(&_looping[layer][i]), zero);
+					_mm_storeu_ps(&_time[layer][i], _mm_or_ps(_mm_and_ps(looping, wrapped), _mm_andnot_ps(looping, clamped)));
+				}
+				__m128 weight = _mm_add_ps(_mm_loadu_ps(&_weight[i]), _mm_mul_ps(step, _mm_loadu_ps(&_fadeRate[i])));
+				_mm_storeu_ps(&_weight[i], _mm_min_ps(weight, one));
+			}
+		}
+#endif
+		for (; i < _count; i++) {
+			for (int layer = 0; layer < 2; layer++) {
+				float time = _time[layer][i] + dt * _speed[layer][i];
+				float duration = _duration[layer][i];
+				float wrapped = time - (float)(int)(time / duration) * duration;
+				_time[layer][i] = _looping[layer][i] > 0.0f ? wrapped : std::min(time, duration);
+			}
+			_weight[i] = std::min(_weight[i] + dt * _fadeRate[i], 1.0f);
+		}
+	}
+
+	// the segments only move forward, unless the clip wrapped around
+	void Animator::findSegment(int layer, int object) {
+		const BakedClip &clip = _clips[_clip[layer][object]];
+		int segment = _segment[layer][object];
+		int last = clip.firstSegment + clip.segmentCount - 1;
+		float time = _time[layer][object];
+		if (time < _segmentStart[segment])
+			segment = clip.firstSegment;
+		while (segment < last && time >= _segmentStart[segment + 1])
+			segment++;
+		_segment[layer][object] = segment;
+		_segmentBegin[layer][object] = _segmentStart[segment];
+		_segmentEnd[layer][object] = segment < last ? _segmentStart[segment + 1] : FLT_MAX;
+		_segmentObjectScale[layer][object] = _segmentScale[segment];
+	}
+
+	// most objects stay within their segment from a frame to the next: the
+	// others are found by testing the bounds of 4 objects at a time
+	void Animator::findSegments() {
+		for (int layer = 0; layer < 2; layer++) {
+			const float *times = _time[layer].data();
+			const float *begins = _segmentBegin[layer].data();
+			const float *ends = _segmentEnd[layer].data();
+			const float *scales = _segmentObjectScale[layer].data();
+			float *u = _u[layer].data();
+			int i = 0;
+#ifdef CG_ANIMATION_SSE
+			if (_vectorized) {
+				for (; i + 4 <= _count; i += 4) {
+					__m128 time = _mm_loadu_ps(times + i);
+					__m128 outside = _mm_or_ps(_mm_cmplt_ps(time, _mm_loadu_ps(begins + i)),
+						_mm_cmpge_ps(time, _mm_loadu_ps(ends + i)));
+					int moved = _mm_movemask_ps(outside);
+					for (int j = 0; moved; j++, moved >>= 1)
+						if (moved & 1)
+							findSegment(layer, i + j);
+					_mm_storeu_ps(u + i, _mm_mul_ps(_mm_sub_ps(time, _mm_loadu_ps(begins + i)), _mm_loadu_ps(scales + i)));
+				}
+			}
+#endif
+			for (; i < _count; i++) {
+				if (times[i] < begins[i] || times[i] >= ends[i])
+					findSegment(layer, i);
+				u[i] = (times[i] - begins[i]) * scales[i];
+			}
+		}
+	}
+
+	void Animator::evaluate() {
+		const int STRIDE = ANIMATION_CHANNEL_COUNT * 4;
+		const float *coefficients = _coefficients.data();
+		float *values[ANIMATION_CHANNEL_COUNT];
+		for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++)
+			values[c] = _values[c].data();
+
+		int i = 0;
+#ifdef CG_ANIMATION_SSE
+		if (_vectorized) {
+			for (; i + 4 <= _count; i += 4) {
+				// the channels of a segment are contiguous: 4 objects read 4
+				// short runs of memory, whatever the number of channels
+				const float *segments[2][4];
+				__m128 u[2];
+				for (int layer = 0; layer < 2; layer++) {
+					for (int j = 0; j < 4; j++)
+						segments[layer][j] = coefficients + _segment[layer][i + j] * STRIDE;
+					u[layer] = _mm_loadu_ps(&_u[layer][i]);
+				}
+				__m128 weight = _mm_loadu_ps(&_weight[i]);
+
+				for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++) {
+					__m128 layerValues[2];
+					for (int layer = 0; layer < 2; layer++) {
+						// the a, b, c, d of 4 objects, transposed into 4 registers
+						__m128 a = _mm_loadu_ps(segments[layer][0] + c * 4);
+						__m128 b = _mm_loadu_ps(segments[layer][1] + c * 4);
+						__m128 cc = _mm_loadu_ps(segments[layer][2] + c * 4);
+						__m128 d = _mm_loadu_ps(segments[layer][3] + c * 4);
+						_MM_TRANSPOSE4_PS(a, b, cc, d);
+						__m128 value = _mm_add_ps(_mm_mul_ps(d, u[layer]), cc);
+						value = _mm_add_ps(_mm_mul_ps(value, u[layer]), b);
+						layerValues[layer] = _mm_add_ps(_mm_mul_ps(value, u[layer]), a);
+					}
+					__m128 mixed = _mm_add_ps(layerValues[0], _mm_mul_ps(_mm_sub_ps(layerValues[1], layerValues[0]), weight));
+					_mm_storeu_ps(values[c] + i, mixed);
+				}
+			}
+		}
+#endif
+		for (; i < _count; i++) {
+			for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++) {
+				float layerValues[2];
+				for (int layer = 0; layer < 2; layer++) {
+					const float *p = coefficients + _segment[layer][i] * STRIDE + c * 4;
+					float u = _u[layer][i];
+					layerValues[layer] = ((p[3] * u + p[2]) * u + p[1]) * u + p[0];
+				}
+				values[c][i] = layerValues[0] + (layerValues[1] - layerValues[0]) * _weight[i];
+			}
+		}
+	}
+
+	// a clip with random keys on every channel, in every interpolation mode
+	static AnimationClip randomClip(std::mt19937 &random, bool looping) {
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		float duration = 1.0f + 3.0f * unit(random);
+		AnimationClip clip(duration, looping);
+		for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++) {
+			int keys = 2 + (int)(unit(random) * 6.0f);
+			for (int k = 0; k < keys; k++)
+				clip.addKey((AnimationChannel)c, unit(random) * duration, unit(random) * 2.0f - 1.0f,
+					(Interpolation)((c + k) % 3));
+		}
+		return clip;
+	}
+
+	void benchmarkAnimation(std::ostream &out, int objectCount) {
+		const int CLIPS = 16, FRAMES = 240;
+		std::vector<AnimationClip> clips;
+		std::mt19937 random(2019);
+		for (int i = 0; i < CLIPS; i++)
+			clips.push_back(randomClip(random, i % 4 != 0));
+
+		out << "Animation benchmark: " << objectCount << " objects playing " << CLIPS << " clips of "
+			<< ANIMATION_CHANNEL_COUNT << " channels, " << FRAMES << " frames\n";
+		out << std::fixed << std::setprecision(3);
+
+		std::vector<float> results[2];
+		for (int pass = 0; pass < 2; pass++) {
+			Animator animator;
+			animator.setVectorized(pass == 0);
+			for (int i = 0; i < CLIPS; i++)
+				animator.addClip(clips[i]);
+
+			// the same objects in both passes; a quarter of them fade to
+			// another clip during the first second
+			std::mt19937 objectRandom(2020);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			for (int i = 0; i < objectCount; i++) {
+				int object = animator.addObject(i % CLIPS, unit(objectRandom) * 4.0f, 0.5f + unit(objectRandom));
+				if (i % 4 == 0)
+					animator.play(object, (i / 4) % CLIPS, 1.0f);
+			}
+
+			double total = 0.0;
+			for (int frame = 0; frame < FRAMES; frame++) {
+				animator.update(1.0f / 60.0f);
+				total += animator.updateMilliseconds();
+			}
+			double milliseconds = total / FRAMES;
+
+			// every fade is over: each object plays a single clip, which must
+			// agree with the keys themselves
+			float error = 0.0f;
+			for (int i = 0; i < objectCount; i++)
+				for (int c = 0; c < ANIMATION_CHANNEL_COUNT; c++) {
+					float expected = clips[animator.clip(i)].evaluate((AnimationChannel)c, animator.time(i));
+					error = std::max(error, std::fabs(animator.value(i, (AnimationChannel)c) - expected));
+					results[pass].push_back(animator.value(i, (AnimationChannel)c));
+				}
+
+			out << "  " << (pass == 0 ? "SIMD  " : "scalar") << ": " << std::setw(8) << milliseconds << " ms per update, "
+				<< std::setw(7) << std::setprecision(1) << objectCount / milliseconds / 1000.0 << "M objects/s, "
+				<< std::setw(7) << objectCount * ANIMATION_CHANNEL_COUNT / milliseconds / 1000.0 << "M channels/s"
+				<< std::scientific << std::setprecision(1) << " | largest error against the keys: " << error
+				<< std::fixed << std::setprecision(3) << "\n";
+
+			// the objects' transforms, with batched sines and cosines and, in
+			// the scalar pass, with libm
+			std::vector<Affine2D> transforms(objectCount);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			animator.transforms(transforms.data());
+			double transformMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			out << "          transforms: " << std::setw(8) << transformMilliseconds << " ms";
+			if (pass == 1) {
+				start = std::chrono::steady_clock::now();
+				for (int i = 0; i < objectCount; i++) {
+					float angle = animator.rotation(i), c = std::cos(angle), s = std::sin(angle);
+					glm::vec2 position = animator.position(i), scale = animator.scale(i);
+					transforms[i] = Affine2D(c * scale.x, s * scale.x, -s * scale.y, c * scale.y, position.x, position.y);
+				}
+				out << ", with libm sin and cos: " << std::setw(8)
+					<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms";
+			}
+			out << "\n";
+		}
+
+		float difference = 0.0f;
+		for (size_t i = 0; i < results[0].size(); i++)
+			difference = std::max(difference, std::fabs(results[0][i] - results[1][i]));
+		out << "  largest difference between SIMD and scalar: " << std::scientific << difference << std::fixed << "\n";
+	}
+}
@@ -0,0 +1,245 @@
+#include <cg_antialiasing.hpp>
+#include <cg_render_pass.hpp>
+#include <cg_shader.hpp>
+#include <iomanip>
+
+namespace cgicmc {
+
+	// FXAA post-pass (luma based, single pass, after Timothy Lottes' FXAA)
+	static const char *fxaaFragmentShaderSource =
+		"#version 330 core\n"
+		"in vec2 uv;\n"
+		"out vec4 FragColor;\n"
+
+		"uniform sampler2D image;\n"
+		"uniform vec2 texelSize;\n"
+		"uniform vec2 uvScale;\n" // part of the texture holding the scene
+		"uniform vec2 uvLimit;\n" // last texel center holding the scene
+
+		"const float REDUCE_MIN = 1.0 / 128.0;\n"
+		"const float REDUCE_MUL = 1.0 / 8.0;\n"
+		"const float SPAN_MAX = 8.0;\n"
+
+		"float luma(vec3 c) { return dot(c, vec3(0.299, 0.587, 0.114)); }\n"
+		// past the scene the texture holds stale texels (it keeps its
+		// capacity after a resize), so the taps stop at its edges
+		"vec3 tap(vec2 p) { return texture(image, clamp(p, 0.5 * texelSize, uvLimit)).rgb; }\n"
+
+		"void main() {\n"
+		"   vec2 texCoord = uv * uvScale;\n"
+		"   vec3 rgbM = tap(texCoord);\n"
+		"   float lumaNW = luma(tap(texCoord + vec2(-1.0, -1.0) * texelSize));\n"
+		"   float lumaNE = luma(tap(texCoord + vec2( 1.0, -1.0) * texelSize));\n"
+		"   float lumaSW = luma(tap(texCoord + vec2(-1.0,  1.0) * texelSize));\n"
+		"   float lumaSE = luma(tap(texCoord + vec2( 1.0,  1.0) * texelSize));\n"
+		"   float lumaM = luma(rgbM);\n"
+		"   float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));\n"
+		"   float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));\n"
+
+		// flat areas: nothing to filter
+		"   if (lumaMax - lumaMin < max(0.0312, lumaMax * 0.125)) {\n"
+		"       FragColor = vec4(rgbM, 1.0);\n"
+		"       return;\n"
+		"   }\n"
+
+		// blur along the edge direction
+		"   vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));\n"
+		"   float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);\n"
+		"   float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);\n"
+		"   dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texelSize;\n"
+
+		"   vec3 rgbA = 0.5 * (tap(texCoord + dir * (1.0 / 3.0 - 0.5)) +\n"
+		"                      tap(texCoord + dir * (2.0 / 3.0 - 0.5)));\n"
+		"   vec3 rgbB = rgbA * 0.5 + 0.25 * (tap(texCoord - dir * 0.5) +\n"
+		"                                    tap(texCoord + dir * 0.5));\n"
+		"   float lumaB = luma(rgbB);\n"
+		"   FragColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0);\n"
+		"}\n\0";
+
+	const char *aaModeName(AAMode mode) {
+		switch (mode) {
+		case AAMode::Off: return "off";
+		case AAMode::AnalyticEdge: return "analytic edges";
+		case AAMode::FXAA: return "FXAA";
+		case AAMode::MSAA2x: return "MSAA 2x";
+		case AAMode::MSAA4x: return "MSAA 4x";
+		case AAMode::MSAA8x: return "MSAA 8x";
+		default: return "?";
+		}
+	}
+
+	AntiAliasing::AntiAliasing() {
+		_mode = AAMode::MSAA4x;
+		_width = 0;
+		_height = 0;
+		_created = false;
+		_sceneFramebuffer = 0;
+		_fxaaProgram = 0;
+		_fxaaTexelSize = -1;
+		_fxaaUVScale = -1;
+		_fxaaUVLimit = -1;
+		_emptyVAO = 0;
+	}
+
+	void AntiAliasing::create(int width, int height) {
+		_width = width;
+		_height = height;
+
+		_fxaaProgram = createShaderProgram(fullscreenVertexShaderSource, fxaaFragmentShaderSource);
+		_fxaaTexelSize = glGetUniformLocation(_fxaaProgram, "texelSize");
+		_fxaaUVScale = glGetUniformLocation(_fxaaProgram, "uvScale");
+		_fxaaUVLimit = glGetUniformLocation(_fxaaProgram, "uvLimit");
+		glUseProgram(_fxaaProgram);
+		glUniform1i(glGetUniformLocation(_fxaaProgram, "image"), 0);
+		glUseProgram(0);
+
+		// the full screen triangle has no attributes, but core profile needs a VAO
+		glGenVertexArrays(1, &_emptyVAO);
+
+		for (int i = 0; i < (int)AAMode::Count; i++)
+			_timers[i].create();
+		_created = true;
+	}
+
+	void AntiAliasing::destroy() {
+		if (!_created)
+			return;
+		_multisampled.destroy();
+		_resolved.destroy();
+		glDeleteProgram(_fxaaProgram);
+		glDeleteVertexArrays(1, &_emptyVAO);
+		for (int i = 0; i < (int)AAMode::Count; i++)
+			_timers[i].destroy();
+		_created = false;
+	}
+
+	void AntiAliasing::resize(int width, int height) {
+		_width = width;
+		_height = height;
+	}
+
+	void AntiAliasing::setMode(AAMode mode) {
+		_mode = mode;
+
+		// targets of the previous mode are no longer needed
+		if (_created) {
+			if (samplesFor(_mode) == 0)
+				_multisampled.destroy();
+			if (_mode != AAMode::FXAA)
+				_resolved.destroy();
+		}
+	}
+
+	void AntiAliasing::cycleMode() {
+		setMode((AAMode)(((int)_mode + 1) % (int)AAMode::Count));
+	}
+
+	int AntiAliasing::samplesFor(AAMode mode) const {
+		switch (mode) {
+		case AAMode::MSAA2x: return 2;
+		case AAMode::MSAA4x: return 4;
+		case AAMode::MSAA8x: return 8;
+		default: return 0;
+		}
+	}
+
+	void AntiAliasing::beginFrame(GLuint outputFramebuffer) {
+		_timers[(int)_mode].begin();
+
+		int samples = samplesFor(_mode);
+		if (samples > 0) {
+			_multisampled.reserve(_width, _height, samples);
+			_sceneFramebuffer = _multisampled.id();
+		} else if (_mode == AAMode::FXAA) {
+			_resolved.reserve(_width, _height, 0);
+			_sceneFramebuffer = _resolved.id();
+		} else {
+			_sceneFramebuffer = outputFramebuffer;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+		glViewport(0, 0, _width, _height);
+
+		// analytic edges output coverage in alpha
+		if (_mode == AAMode::AnalyticEdge) {
+			glEnable(GL_BLEND);
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		}
+	}
+
+	void AntiAliasing::endFrame(GLuint outputFramebuffer, int outputWidth, int outputHeight, const PixelRect *regions,
+		int regionCount) {
+		if (_mode == AAMode::AnalyticEdge)
+			glDisable(GL_BLEND);
+
+		// only the drawn regions hold samples of this frame: between them
+		// the targets are stale, so each region is resolved on its own
+		int count = regions ? regionCount : 1;
+		for (int i = 0; i < count; i++)
+			resolveRegion(outputFramebuffer, outputWidth, outputHeight, regions ? &regions[i] : NULL);
+
+		// a partial redraw filters pixels next to the regions, keep them
+		if (_mode == AAMode::FXAA && !regions)
+			invalidateAttachments(GL_FRAMEBUFFER, _resolved.id(), COLOR_ATTACHMENT);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+		glViewport(0, 0, outputWidth, outputHeight);
+
+		_timers[(int)_mode].end();
+	}
+
+	void AntiAliasing::resolveRegion(GLuint outputFramebuffer, int outputWidth, int outputHeight, const PixelRect *region) {
+		// blits and draws below are limited to the region by the scissor test
+		if (region) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(region->x, region->y, region->width, region->height);
+		}
+
+		if (samplesFor(_mode) > 0) {
+			// resolve the samples into the output
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, _multisampled.id());
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+			glBlitFramebuffer(0, 0, _width, _height,
+				0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+			// the samples are never read again (a partial redraw clears the
+			// region it draws): let the driver drop them instead of writing
+			// them back to memory
+			invalidateAttachments(GL_READ_FRAMEBUFFER, _multisampled.id(), COLOR_ATTACHMENT, region);
+		} else if (_mode == AAMode::FXAA) {
+			// every output pixel (of the region) is written by the pass
+			RenderPass pass;
+			pass.color(LoadAction::DontCare, StoreAction::Store);
+			if (region)
+				pass.renderArea(*region);
+			pass.begin(outputFramebuffer, outputWidth, outputHeight);
+
+			glUseProgram(_fxaaProgram);
+			glUniform2f(_fxaaTexelSize, 1.0f / _resolved.width(), 1.0f / _resolved.height());
+			glUniform2f(_fxaaUVScale, (float)_width / _resolved.width(), (float)_height / _resolved.height());
+			glUniform2f(_fxaaUVLimit, (_width - 0.5f) / _resolved.width(), (_height - 0.5f) / _resolved.height());
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, _resolved.colorTexture());
+			glBindVertexArray(_emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			pass.end();
+		}
+
+		if (region)
+			glDisable(GL_SCISSOR_TEST);
+	}
+
+	double AntiAliasing::frameMilliseconds(AAMode mode) const {
+		return _timers[(int)mode].averageMilliseconds();
+	}
+
+	void AntiAliasing::report(std::ostream &out) const {
+		out << "Anti-aliasing GPU cost per frame:\n";
+		for (int i = 0; i < (int)AAMode::Count; i++) {
+			if (_timers[i].samples() == 0)
+				continue;
+			out << "  " << std::setw(16) << std::left << aaModeName((AAMode)i)
+				<< std::fixed << std::setprecision(3) << _timers[i].averageMilliseconds()
+				<< " ms (" << _timers[i].samples() << " frames)\n";
+		}
+	}
+}
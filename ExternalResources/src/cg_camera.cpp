@@ -0,0 +1,143 @@
+#include <cg_camera.hpp>
+#include <glm/gtc/type_ptr.hpp> // glm::value_ptr
+#include <cstring>
+
+namespace cgicmc {
+
+	// zoom limits, far enough to see a huge scene or a single pixel
+	static const float MIN_ZOOM = 1e-4f;
+	static const float MAX_ZOOM = 1e4f;
+
+	// memory layout of the Camera block (std140)
+	struct CameraBlock {
+		float view[16];
+		float visible[4];
+		float viewport[4];
+	};
+
+	Camera::Camera() {
+		_position = glm::vec2(0.0f);
+		_zoom = 1.0f;
+		_viewportWidth = 1;
+		_viewportHeight = 1;
+		_version = 1;
+		_uploadedVersion = 0;
+		_ubo = 0;
+	}
+
+	void Camera::create() {
+		glGenBuffers(1, &_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		_uploadedVersion = 0;
+	}
+
+	void Camera::destroy() {
+		if (!_ubo)
+			return;
+		glDeleteBuffers(1, &_ubo);
+		_ubo = 0;
+	}
+
+	// GL 3.3 has no layout(binding = N) for uniform blocks
+	void Camera::bindBlock(GLuint program) {
+		GLuint index = glGetUniformBlockIndex(program, "Camera");
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, BINDING);
+	}
+
+	void Camera::setViewport(int width, int height) {
+		width = width > 1 ? width : 1;
+		height = height > 1 ? height : 1;
+		if (width == _viewportWidth && height == _viewportHeight)
+			return;
+		_viewportWidth = width;
+		_viewportHeight = height;
+		_version++;
+	}
+
+	void Camera::setPosition(glm::vec2 position) {
+		if (position == _position)
+			return;
+		_position = position;
+		_version++;
+	}
+
+	void Camera::pan(glm::vec2 delta) {
+		setPosition(_position + delta);
+	}
+
+	void Camera::setZoom(float zoom) {
+		zoom = glm::clamp(zoom, MIN_ZOOM, MAX_ZOOM);
+		if (zoom == _zoom)
+			return;
+		_zoom = zoom;
+		_version++;
+	}
+
+	void Camera::zoomAt(glm::vec2 clipPoint, float factor) {
+		glm::vec2 anchor = toWorld(clipPoint);
+		setZoom(_zoom * factor);
+		// move the anchor back under the clip point
+		setPosition(_position + anchor - toWorld(clipPoint));
+	}
+
+	glm::mat4 Camera::view() const {
+		float aspect = (float)_viewportWidth / (float)_viewportHeight;
+		glm::mat4 view(1.0f);
+		view[0][0] = _zoom / aspect;
+		view[1][1] = _zoom;
+		view[3][0] = -_position.x * view[0][0];
+		view[3][1] = -_position.y * view[1][1];
+		return view;
+	}
+
+	AABB Camera::visibleBounds() const {
+		float aspect = (float)_viewportWidth / (float)_viewportHeight;
+		glm::vec2 halfSize(aspect / _zoom, 1.0f / _zoom);
+		return AABB(_position - halfSize, _position + halfSize);
+	}
+
+	float Camera::pixelSize() const {
+		return 2.0f / (_zoom * (float)_viewportHeight);
+	}
+
+	glm::vec2 Camera::toWorld(glm::vec2 clipPoint) const {
+		float aspect = (float)_viewportWidth / (float)_viewportHeight;
+		return _position + glm::vec2(clipPoint.x * aspect, clipPoint.y) / _zoom;
+	}
+
+	AABB Camera::toClip(const AABB &world) const {
+		glm::mat4 m = view();
+		glm::vec2 scale(m[0][0], m[1][1]), offset(m[3][0], m[3][1]);
+		return AABB(world.min * scale + offset, world.max * scale + offset);
+	}
+
+	void Camera::upload() {
+		if (_uploadedVersion == _version || !_ubo)
+			return;
+
+		CameraBlock block;
+		glm::mat4 m = view();
+		AABB visible = visibleBounds();
+		std::memcpy(block.view, glm::value_ptr(m), sizeof(block.view));
+		block.visible[0] = visible.min.x;
+		block.visible[1] = visible.min.y;
+		block.visible[2] = visible.max.x;
+		block.visible[3] = visible.max.y;
+		block.viewport[0] = (float)_viewportWidth;
+		block.viewport[1] = (float)_viewportHeight;
+		block.viewport[2] = pixelSize();
+		block.viewport[3] = _zoom;
+
+		glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		_uploadedVersion = _version;
+	}
+
+	void Camera::bind() const {
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, _ubo);
+	}
+}
@@ -0,0 +1,527 @@
+#include <cg_collision.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace cgicmc {
+
+	// spatial hash cells per average body size
+	static const float CELL_SCALE = 2.0f;
+
+	// the reference polygon changes only if the other one separates clearly
+	// more, which keeps the contacts of resting bodies from flickering
+	static const float REFERENCE_TOLERANCE = 0.005f;
+
+	const char *broadphaseName(BroadphaseType type) {
+		switch (type) {
+		case BroadphaseType::SweepAndPrune: return "sweep and prune";
+		case BroadphaseType::SpatialHash: return "spatial hash";
+		}
+		return "?";
+	}
+
+	CollisionWorld::CollisionWorld() {
+		_geometryDirty = false;
+		_margin = 0.0f;
+		_broadphase = BroadphaseType::SweepAndPrune;
+		_cellSize = 0.0f;
+		_pairMilliseconds = 0.0;
+		_contactMilliseconds = 0.0;
+	}
+
+	void CollisionWorld::setThreadCount(int threadCount) {
+		_pool.setThreadCount(threadCount);
+	}
+
+	void CollisionWorld::setMargin(float margin) {
+		_margin = margin;
+		std::fill(_moved.begin(), _moved.end(), 1);
+		_geometryDirty = true;
+	}
+
+	void CollisionWorld::clear() {
+		_bodies.clear();
+		_parts.clear();
+		_localVertices.clear();
+		_worldVertices.clear();
+		_bounds.clear();
+		_moved.clear();
+		_sorted.clear();
+		_dynamicPositions.clear();
+		_cells.clear();
+		_pairs.clear();
+		_contacts.clear();
+		_geometryDirty = false;
+	}
+
+	int CollisionWorld::addBody(bool dynamic) {
+		Body body;
+		body.firstPart = (int)_parts.size();
+		body.partCount = 0;
+		body.position = glm::vec2(0.0f, 0.0f);
+		body.angle = 0.0f;
+		body.dynamic = dynamic;
+		_bodies.push_back(body);
+		_bounds.push_back(AABB());
+		_moved.push_back(1);
+		_geometryDirty = true;
+		return (int)_bodies.size() - 1;
+	}
+
+	void CollisionWorld::addPart(const glm::vec2 *vertices, int count) {
+		float area = 0.0f;
+		for (int i = 0; i < count; i++) {
+			glm::vec2 a = vertices[i], b = vertices[(i + 1) % count];
+			area += a.x * b.y - b.x * a.y;
+		}
+		if (area == 0.0f)
+			return;
+
+		// stored counter-clockwise, whatever the winding of the input
+		Part part;
+		part.first = (int)_localVertices.size();
+		part.count = count;
+		for (int i = 0; i < count; i++)
+			_localVertices.push_back(vertices[area > 0.0f ? i : count - 1 - i]);
+		_worldVertices.resize(_localVertices.size());
+		_parts.push_back(part);
+		_bodies.back().partCount++;
+	}
+
+	int CollisionWorld::addMesh(const std::vector<glm::vec2> &triangles, bool dynamic) {
+		int body = addBody(dynamic);
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+			addPart(&triangles[i], 3);
+		return body;
+	}
+
+	int CollisionWorld::addPolygon(const std::vector<glm::vec2> &polygon, bool dynamic) {
+		int body = addBody(dynamic);
+		if (polygon.size() >= 3 && polygon.size() <= (size_t)MAX_POLYGON_VERTICES)
+			addPart(polygon.data(), (int)polygon.size());
+		else
+			std::cout << "Collision polygons need 3 to " << MAX_POLYGON_VERTICES << " vertices\n";
+		return body;
+	}
+
+	void CollisionWorld::setTransform(int body, glm::vec2 position, float angle) {
+		_bodies[body].position = position;
+		_bodies[body].angle = angle;
+		_moved[body] = 1;
+		_geometryDirty = true;
+	}
+
+	// move the vertices of the bodies placed since the last update to the
+	// world and recompute their bounds (grown by the margin)
+	void CollisionWorld::updateGeometry() {
+		if (!_geometryDirty)
+			return;
+		_geometryDirty = false;
+
+		_pool.parallelFor((int)_bodies.size(), [&](int begin, int end, int) {
+			for (int i = begin; i < end; i++) {
+				if (!_moved[i])
+					continue;
+				_moved[i] = 0;
+				const Body &body = _bodies[i];
+				float c = std::cos(body.angle), s = std::sin(body.angle);
+				AABB bounds;
+				for (int p = body.firstPart; p < body.firstPart + body.partCount; p++) {
+					const Part &part = _parts[p];
+					for (int v = part.first; v < part.first + part.count; v++) {
+						glm::vec2 local = _localVertices[v];
+						glm::vec2 world(body.position.x + c * local.x - s * local.y,
+							body.position.y + s * local.x + c * local.y);
+						_worldVertices[v] = world;
+						bounds.expand(world);
+					}
+				}
+				_bounds[i] = AABB(bounds.min - glm::vec2(_margin, _margin), bounds.max + glm::vec2(_margin, _margin));
+			}
+		});
+	}
+
+	void CollisionWorld::findPairs() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		updateGeometry();
+		_chunkPairs.resize(_pool.threadCount());
+		for (size_t i = 0; i < _chunkPairs.size(); i++)
+			_chunkPairs[i].clear();
+
+		if (_broadphase == BroadphaseType::SweepAndPrune)
+			sweepAndPrune();
+		else
+			spatialHash();
+
+		// chunk order keeps the result independent of the thread timing
+		_pairs.clear();
+		for (size_t i = 0; i < _chunkPairs.size(); i++)
+			_pairs.insert(_pairs.end(), _chunkPairs[i].begin(), _chunkPairs[i].end());
+
+		_pairMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void CollisionWorld::sweepAndPrune() {
+		// new bodies join the order at the end, the insertion sort places them
+		int count = (int)_bodies.size();
+		if ((int)_sorted.size() > count)
+			_sorted.clear();
+		for (int i = (int)_sorted.size(); i < count; i++)
+			_sorted.push_back(i);
+
+		// bodies move little between updates: the order is almost sorted
+		for (int i = 1; i < count; i++) {
+			int body = _sorted[i];
+			float key = _bounds[body].min.x;
+			int j = i - 1;
+			while (j >= 0 && _bounds[_sorted[j]].min.x > key) {
+				_sorted[j + 1] = _sorted[j];
+				j--;
+			}
+			_sorted[j + 1] = body;
+		}
+
+		_dynamicPositions.clear();
+		for (int i = 0; i < count; i++)
+			if (_bodies[_sorted[i]].dynamic)
+				_dynamicPositions.push_back(i);
+
+		// each body is tested against the following ones starting before its
+		// right side (only the dynamic ones for a static body)
+		_pool.parallelFor(count, [&](int begin, int end, int chunk) {
+			std::vector<BodyPair> &pairs = _chunkPairs[chunk];
+			for (int i = begin; i < end; i++) {
+				int a = _sorted[i];
+				const AABB &boundsA = _bounds[a];
+				if (boundsA.empty())
+					continue;
+				bool dynamic = _bodies[a].dynamic;
+				std::vector<int>::const_iterator next = _dynamicPositions.end();
+				if (!dynamic)
+					next = std::upper_bound(_dynamicPositions.begin(), _dynamicPositions.end(), i);
+				for (int j = i + 1; j < count; j++) {
+					if (!dynamic) {
+						if (next == _dynamicPositions.end())
+							break;
+						j = *next++;
+					}
+					int b = _sorted[j];
+					const AABB &boundsB = _bounds[b];
+					if (boundsB.min.x > boundsA.max.x)
+						break;
+					if (boundsB.min.y > boundsA.max.y || boundsA.min.y > boundsB.max.y)
+						continue;
+					BodyPair pair = { std::min(a, b), std::max(a, b) };
+					pairs.push_back(pair);
+				}
+			}
+		});
+	}
+
+	// 64 bit key of a cell, the coordinates are biased to stay unsigned
+	static uint64_t cellKey(int x, int y) {
+		return ((uint64_t)(uint32_t)(x + 0x40000000) << 32) | (uint32_t)(y + 0x40000000);
+	}
+
+	void CollisionWorld::spatialHash() {
+		int count = (int)_bodies.size();
+
+		// cells twice as large as the average body
+		float extent = 0.0f;
+		int sized = 0;
+		for (int i = 0; i < count; i++)
+			if (!_bounds[i].empty()) {
+				glm::vec2 size = _bounds[i].size();
+				extent += std::max(size.x, size.y);
+				sized++;
+			}
+		if (sized == 0)
+			return;
+		_cellSize = std::max(CELL_SCALE * extent / sized, 1e-6f);
+		float inverse = 1.0f / _cellSize;
+
+		// entries of each cell overlapped by each body
+		_chunkCells.resize(_pool.threadCount());
+		_pool.parallelFor(count, [&](int begin, int end, int chunk) {
+			std::vector<std::pair<uint64_t, int>> &cells = _chunkCells[chunk];
+			cells.clear();
+			for (int i = begin; i < end; i++) {
+				const AABB &bounds = _bounds[i];
+				if (bounds.empty())
+					continue;
+				int x0 = (int)std::floor(bounds.min.x * inverse), x1 = (int)std::floor(bounds.max.x * inverse);
+				int y0 = (int)std::floor(bounds.min.y * inverse), y1 = (int)std::floor(bounds.max.y * inverse);
+				for (int y = y0; y <= y1; y++)
+					for (int x = x0; x <= x1; x++)
+						cells.push_back(std::make_pair(cellKey(x, y), i));
+			}
+		});
+		_cells.clear();
+		for (size_t i = 0; i < _chunkCells.size(); i++)
+			_cells.insert(_cells.end(), _chunkCells[i].begin(), _chunkCells[i].end());
+		std::sort(_cells.begin(), _cells.end());
+
+		// the bodies sharing a cell are tested against each other; chunks
+		// start and end on cell boundaries
+		int entries = (int)_cells.size();
+		_pool.parallelFor(entries, [&](int begin, int end, int chunk) {
+			while (begin > 0 && begin < entries && _cells[begin].first == _cells[begin - 1].first)
+				begin++;
+			while (end < entries && end > 0 && _cells[end].first == _cells[end - 1].first)
+				end++;
+
+			std::vector<BodyPair> &pairs = _chunkPairs[chunk];
+			for (int first = begin; first < end;) {
+				uint64_t key = _cells[first].first;
+				int last = first + 1;
+				while (last < entries && _cells[last].first == key)
+					last++;
+
+				for (int i = first; i < last; i++) {
+					int a = _cells[i].second;
+					const AABB &boundsA = _bounds[a];
+					for (int j = i + 1; j < last; j++) {
+						int b = _cells[j].second;
+						if (!_bodies[a].dynamic && !_bodies[b].dynamic)
+							continue;
+						const AABB &boundsB = _bounds[b];
+						if (!boundsA.intersects(boundsB))
+							continue;
+
+						// a pair sharing several cells is reported by the one
+						// holding the corner of the overlap
+						int x = (int)std::floor(std::max(boundsA.min.x, boundsB.min.x) * inverse);
+						int y = (int)std::floor(std::max(boundsA.min.y, boundsB.min.y) * inverse);
+						if (cellKey(x, y) != key)
+							continue;
+						BodyPair pair = { std::min(a, b), std::max(a, b) };
+						pairs.push_back(pair);
+					}
+				}
+				first = last;
+			}
+		});
+	}
+
+	// outward normal of the edge i of a counter-clockwise polygon
+	static glm::vec2 edgeNormal(const glm::vec2 *vertices, int count, int i) {
+		glm::vec2 edge = vertices[(i + 1) % count] - vertices[i];
+		float length = std::sqrt(edge.x * edge.x + edge.y * edge.y);
+		return length > 0.0f ? glm::vec2(edge.y / length, -edge.x / length) : glm::vec2(0.0f, 0.0f);
+	}
+
+	// largest distance from an edge of polygon 1 to polygon 2 (positive when
+	// that edge separates them)
+	static float maxSeparation(const glm::vec2 *v1, int n1, const glm::vec2 *v2, int n2, int &edge) {
+		float best = -1e30f;
+		edge = 0;
+		for (int i = 0; i < n1; i++) {
+			glm::vec2 normal = edgeNormal(v1, n1, i);
+			float separation = 1e30f;
+			for (int j = 0; j < n2; j++)
+				separation = std::min(separation, glm::dot(normal, v2[j] - v1[i]));
+			if (separation > best) {
+				best = separation;
+				edge = i;
+			}
+		}
+		return best;
+	}
+
+	// end of a clipped segment: id is the incident vertex it is, or 8 plus
+	// the reference vertex whose side plane cut it, so the same point keeps
+	// the same id from one update to the next
+	struct ClipVertex {
+		glm::vec2 point;
+		unsigned id;
+	};
+
+	// keep the part of the segment where dot(normal, p) <= offset
+	static int clipSegment(const ClipVertex in[2], glm::vec2 normal, float offset, unsigned plane, ClipVertex out[2]) {
+		int count = 0;
+		float d0 = glm::dot(normal, in[0].point) - offset, d1 = glm::dot(normal, in[1].point) - offset;
+		if (d0 <= 0.0f)
+			out[count++] = in[0];
+		if (d1 <= 0.0f)
+			out[count++] = in[1];
+		if (d0 * d1 < 0.0f) {
+			out[count].point = in[0].point + (in[1].point - in[0].point) * (d0 / (d0 - d1));
+			out[count++].id = 8 + plane;
+		}
+		return count;
+	}
+
+	// separating axis test between two convex polygons, adding up to two
+	// contacts of the deepest edge
+	static void collidePolygons(int a, const glm::vec2 *va, int na, int b, const glm::vec2 *vb, int nb,
+		float margin, unsigned feature, std::vector<Contact> &contacts) {
+		int edgeA, edgeB;
+		float separationA = maxSeparation(va, na, vb, nb, edgeA);
+		if (separationA > margin)
+			return;
+		float separationB = maxSeparation(vb, nb, va, na, edgeB);
+		if (separationB > margin)
+			return;
+
+		// the reference edge is the one separating the most
+		bool flip = separationB > separationA + REFERENCE_TOLERANCE;
+		const glm::vec2 *reference = flip ? vb : va, *incident = flip ? va : vb;
+		int referenceCount = flip ? nb : na, incidentCount = flip ? na : nb;
+		int edge = flip ? edgeB : edgeA;
+		glm::vec2 normal = edgeNormal(reference, referenceCount, edge);
+
+		// the incident edge faces the reference normal the most
+		int incidentEdge = 0;
+		float facing = 1e30f;
+		for (int i = 0; i < incidentCount; i++) {
+			float d = glm::dot(normal, edgeNormal(incident, incidentCount, i));
+			if (d < facing) {
+				facing = d;
+				incidentEdge = i;
+			}
+		}
+		int nextEdge = (incidentEdge + 1) % incidentCount;
+		ClipVertex segment[2] = { { incident[incidentEdge], (unsigned)incidentEdge }, { incident[nextEdge], (unsigned)nextEdge } };
+
+		// clip it to the sides of the reference edge
+		int edgeEnd = (edge + 1) % referenceCount;
+		glm::vec2 v1 = reference[edge], v2 = reference[edgeEnd];
+		glm::vec2 tangent = v2 - v1;
+		float length = std::sqrt(tangent.x * tangent.x + tangent.y * tangent.y);
+		if (length == 0.0f)
+			return;
+		tangent = tangent / length;
+
+		ClipVertex clipped[2], clipped2[2];
+		if (clipSegment(segment, -tangent, -glm::dot(tangent, v1), (unsigned)edge, clipped) < 2)
+			return;
+		if (clipSegment(clipped, tangent, glm::dot(tangent, v2), (unsigned)edgeEnd, clipped2) < 2)
+			return;
+
+		// the points below the reference edge (or within the margin) touch
+		for (int i = 0; i < 2; i++) {
+			float separation = glm::dot(normal, clipped2[i].point - v1);
+			if (separation > margin)
+				continue;
+			Contact contact;
+			contact.a = a;
+			contact.b = b;
+			contact.normal = flip ? -normal : normal;
+			contact.point = clipped2[i].point - normal * (separation * 0.5f);
+			contact.depth = -separation;
+			contact.feature = feature << 8 | (flip ? 1u << 7 : 0u) | (unsigned)edge << 4 | clipped2[i].id;
+			contacts.push_back(contact);
+		}
+	}
+
+	void CollisionWorld::collideBodies(int a, int b, std::vector<Contact> &contacts) const {
+		const Body &bodyA = _bodies[a], &bodyB = _bodies[b];
+		// the feature of a contact starts with the index of its polygon pair
+		unsigned feature = 0;
+		for (int pa = bodyA.firstPart; pa < bodyA.firstPart + bodyA.partCount; pa++) {
+			const Part &partA = _parts[pa];
+			for (int pb = bodyB.firstPart; pb < bodyB.firstPart + bodyB.partCount; pb++) {
+				const Part &partB = _parts[pb];
+				collidePolygons(a, &_worldVertices[partA.first], partA.count,
+					b, &_worldVertices[partB.first], partB.count, _margin, feature++, contacts);
+			}
+		}
+	}
+
+	void CollisionWorld::findContacts() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		_chunkContacts.resize(_pool.threadCount());
+		_pool.parallelFor((int)_pairs.size(), [&](int begin, int end, int chunk) {
+			std::vector<Contact> &contacts = _chunkContacts[chunk];
+			contacts.clear();
+			for (int i = begin; i < end; i++)
+				collideBodies(_pairs[i].a, _pairs[i].b, contacts);
+		});
+
+		_contacts.clear();
+		for (size_t i = 0; i < _chunkContacts.size(); i++)
+			_contacts.insert(_contacts.end(), _chunkContacts[i].begin(), _chunkContacts[i].end());
+
+		_contactMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void CollisionWorld::update() {
+		findPairs();
+		findContacts();
+	}
+
+	bool CollisionWorld::touching(int body) const {
+		for (size_t i = 0; i < _contacts.size(); i++)
+			if (_contacts[i].a == body || _contacts[i].b == body)
+				return true;
+		return false;
+	}
+
+	void benchmarkCollision(std::ostream &out, int bodyCount) {
+		// about one body per square unit, so neighbours touch now and then
+		float extent = 0.5f * std::sqrt((float)bodyCount);
+		std::mt19937 random(2019);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.2f, 0.6f);
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+		std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+
+		std::vector<glm::vec2> positions(bodyCount), velocities(bodyCount);
+		std::vector<float> angles(bodyCount);
+		std::vector<std::vector<glm::vec2>> shapes(bodyCount);
+		for (int i = 0; i < bodyCount; i++) {
+			positions[i] = glm::vec2(position(random), position(random));
+			velocities[i] = glm::vec2(step(random), step(random));
+			angles[i] = angle(random);
+			float s = size(random);
+			if (i % 2)
+				shapes[i] = { glm::vec2(-s, -s), glm::vec2(s, -s), glm::vec2(s, s), glm::vec2(-s, s) };
+			else
+				shapes[i] = { glm::vec2(-s, -s), glm::vec2(s, -s), glm::vec2(0.0f, s) };
+		}
+
+		const int FRAMES = 10;
+		int threads = (int)std::thread::hardware_concurrency();
+		out << "Collision benchmark: " << bodyCount << " moving bodies, " << FRAMES << " frames\n";
+		out << std::fixed << std::setprecision(2);
+
+		for (int type = 0; type < 2; type++) {
+			for (int pass = 0; pass < 2; pass++) {
+				int threadCount = pass == 0 ? 1 : std::max(threads, 1);
+				CollisionWorld world;
+				world.setThreadCount(threadCount);
+				world.setBroadphase((BroadphaseType)type);
+				for (int i = 0; i < bodyCount; i++) {
+					int body = i % 2 ? world.addPolygon(shapes[i]) : world.addMesh(shapes[i]);
+					world.setTransform(body, positions[i], angles[i]);
+				}
+				// the first update sorts from scratch
+				world.update();
+
+				double pairMs = 0.0, contactMs = 0.0;
+				size_t pairs = 0, contacts = 0;
+				for (int frame = 1; frame <= FRAMES; frame++) {
+					for (int i = 0; i < bodyCount; i++)
+						world.setTransform(i, positions[i] + velocities[i] * (float)frame, angles[i] + 0.01f * frame);
+					world.update();
+					pairMs += world.pairMilliseconds();
+					contactMs += world.contactMilliseconds();
+					pairs += world.pairs().size();
+					contacts += world.contacts().size();
+				}
+
+				out << "  " << std::setw(15) << broadphaseName((BroadphaseType)type)
+					<< ", " << std::setw(2) << threadCount << " threads"
+					<< ": broadphase " << std::setw(7) << pairMs / FRAMES << " ms"
+					<< " (" << std::setw(11) << pairs / (pairMs * 0.001) << " pairs/s)"
+					<< " | narrowphase " << std::setw(7) << contactMs / FRAMES << " ms"
+					<< " | " << pairs / FRAMES << " pairs, " << contacts / FRAMES << " contacts\n";
+			}
+		}
+	}
+}
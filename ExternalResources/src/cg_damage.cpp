@@ -0,0 +1,122 @@
+#include <cg_damage.hpp>
+#include <cmath>
+
+namespace cgicmc {
+
+	// weight of a new frame in the moving average
+	static const double AVERAGE_WEIGHT = 0.05;
+
+	DamageTracker::DamageTracker() {
+		_width = 0;
+		_height = 0;
+		_fullDamage = true;
+		_historySize = 0;
+		_touched = 1;
+		_averageTouched = 1;
+	}
+
+	void DamageTracker::resize(int width, int height) {
+		_width = width;
+		_height = height;
+		invalidate();
+	}
+
+	void DamageTracker::invalidate() {
+		_fullDamage = true;
+		// older back buffers no longer match anything
+		_historySize = 0;
+	}
+
+	void DamageTracker::addRect(const PixelRect &rect) {
+		PixelRect visible = rect.clipped(PixelRect(0, 0, _width, _height));
+		if (!visible.empty())
+			_pending.push_back(visible);
+	}
+
+	void DamageTracker::addClipBounds(const AABB &bounds, int margin) {
+		if (bounds.empty())
+			return;
+		int x0 = (int)std::floor((bounds.min.x + 1.0f) * 0.5f * _width) - margin;
+		int y0 = (int)std::floor((bounds.min.y + 1.0f) * 0.5f * _height) - margin;
+		int x1 = (int)std::ceil((bounds.max.x + 1.0f) * 0.5f * _width) + margin;
+		int y1 = (int)std::ceil((bounds.max.y + 1.0f) * 0.5f * _height) + margin;
+		addRect(PixelRect(x0, y0, x1 - x0, y1 - y0));
+	}
+
+	// join rectangles while it does not increase the redrawn area much,
+	// then until no more than MAX_RECTS are left
+	void DamageTracker::merge() {
+		bool merged = true;
+		while (merged) {
+			merged = false;
+
+			int bestI = -1, bestJ = -1;
+			long long bestGrowth = 0;
+			for (size_t i = 0; i < _rects.size(); i++) {
+				for (size_t j = i + 1; j < _rects.size(); j++) {
+					PixelRect joined = _rects[i].merged(_rects[j]);
+					long long growth = joined.area() - _rects[i].area() - _rects[j].area();
+					if (bestI < 0 || growth < bestGrowth) {
+						bestI = (int)i;
+						bestJ = (int)j;
+						bestGrowth = growth;
+					}
+				}
+			}
+
+			// overlapping or touching rectangles are always joined
+			if (bestI >= 0 && (bestGrowth <= 0 || (int)_rects.size() > MAX_RECTS)) {
+				_rects[bestI] = _rects[bestI].merged(_rects[bestJ]);
+				_rects.erase(_rects.begin() + bestJ);
+				merged = true;
+			}
+		}
+	}
+
+	const std::vector<PixelRect> &DamageTracker::resolve() {
+		_rects.clear();
+		if (_fullDamage) {
+			_rects.push_back(PixelRect(0, 0, _width, _height));
+		} else {
+			_rects = _pending;
+			merge();
+		}
+		_pending.clear();
+		_fullDamage = false;
+
+		// statistics
+		long long touched = 0;
+		for (size_t i = 0; i < _rects.size(); i++)
+			touched += _rects[i].area();
+		long long total = (long long)_width * _height;
+		_touched = total > 0 ? (double)touched / total : 0.0;
+		_averageTouched += (_touched - _averageTouched) * AVERAGE_WEIGHT;
+
+		// remember this frame for back buffers presented before it
+		for (int i = HISTORY - 1; i > 0; i--)
+			_history[i] = _history[i - 1];
+		_history[0] = bounds();
+		if (_historySize < HISTORY)
+			_historySize++;
+
+		return _rects;
+	}
+
+	PixelRect DamageTracker::bounds() const {
+		PixelRect result;
+		for (size_t i = 0; i < _rects.size(); i++)
+			result = result.merged(_rects[i]);
+		return result;
+	}
+
+	PixelRect DamageTracker::presentRegion(int bufferAge) const {
+		// a buffer presented N frames ago misses the damage of those N frames
+		if (bufferAge <= 0 || bufferAge > _historySize)
+			return PixelRect(0, 0, _width, _height);
+
+		PixelRect result;
+		for (int i = 0; i < bufferAge; i++)
+			result = result.merged(_history[i]);
+		return result;
+	}
+}
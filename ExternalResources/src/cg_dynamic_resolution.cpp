@@ -0,0 +1,161 @@
+#include <cg_dynamic_resolution.hpp>
+#include <cg_render_pass.hpp>
+#include <cg_shader.hpp>
+#include <cmath>
+
+namespace cgicmc {
+
+	// frames to wait after a change, so timer queries in flight (rendered
+	// at the previous scale) do not trigger another change
+	static const int COOLDOWN_FRAMES = 8;
+
+	// the scale is snapped to multiples of this step
+	static const float SCALE_STEP = 1.0f / 32.0f;
+
+	// bilinear upscale with optional contrast adaptive sharpening (the
+	// sharpened value is limited to the range of its neighbours)
+	static const char *upscaleFragmentShaderSource =
+		"#version 330 core\n"
+		"in vec2 uv;\n"
+		"out vec4 FragColor;\n"
+
+		"uniform sampler2D image;\n"
+		"uniform vec2 uvScale;\n"   // part of the texture holding the scene
+		"uniform vec2 texelSize;\n"
+		"uniform float sharpen;\n"
+
+		"void main() {\n"
+		"   vec2 halfTexel = 0.5 * texelSize;\n"
+		"   vec2 texCoord = clamp(uv * uvScale, halfTexel, uvScale - halfTexel);\n"
+		"   vec3 color = texture(image, texCoord).rgb;\n"
+		"   if (sharpen > 0.0) {\n"
+		"       vec3 n = texture(image, texCoord + vec2(0.0, texelSize.y)).rgb;\n"
+		"       vec3 s = texture(image, texCoord - vec2(0.0, texelSize.y)).rgb;\n"
+		"       vec3 e = texture(image, texCoord + vec2(texelSize.x, 0.0)).rgb;\n"
+		"       vec3 w = texture(image, texCoord - vec2(texelSize.x, 0.0)).rgb;\n"
+		"       vec3 lo = min(color, min(min(n, s), min(e, w)));\n"
+		"       vec3 hi = max(color, max(max(n, s), max(e, w)));\n"
+		"       vec3 sharpened = color + sharpen * (4.0 * color - n - s - e - w) * 0.25;\n"
+		"       color = clamp(sharpened, lo, hi);\n"
+		"   }\n"
+		"   FragColor = vec4(color, 1.0);\n"
+		"}\n\0";
+
+	DynamicResolution::DynamicResolution() {
+		_outputWidth = 0;
+		_outputHeight = 0;
+		_scale = 1.0f;
+		_minScale = 0.25f;
+		_maxScale = 1.0f;
+		_targetMilliseconds = 12.0;
+		_hysteresis = 0.1;
+		_cooldown = 0;
+		_filter = UpscaleFilter::Sharpen;
+		_program = 0;
+		_uvScaleLocation = -1;
+		_texelSizeLocation = -1;
+		_sharpenLocation = -1;
+		_emptyVAO = 0;
+	}
+
+	void DynamicResolution::create(int outputWidth, int outputHeight) {
+		_program = createShaderProgram(fullscreenVertexShaderSource, upscaleFragmentShaderSource);
+		_uvScaleLocation = glGetUniformLocation(_program, "uvScale");
+		_texelSizeLocation = glGetUniformLocation(_program, "texelSize");
+		_sharpenLocation = glGetUniformLocation(_program, "sharpen");
+		glUseProgram(_program);
+		glUniform1i(glGetUniformLocation(_program, "image"), 0);
+		glUseProgram(0);
+
+		glGenVertexArrays(1, &_emptyVAO);
+		resize(outputWidth, outputHeight);
+	}
+
+	void DynamicResolution::destroy() {
+		if (!_program)
+			return;
+		_target.destroy();
+		glDeleteProgram(_program);
+		glDeleteVertexArrays(1, &_emptyVAO);
+		_program = 0;
+	}
+
+	void DynamicResolution::resize(int outputWidth, int outputHeight) {
+		_outputWidth = outputWidth;
+		_outputHeight = outputHeight;
+		_target.reserve(outputWidth, outputHeight, 0);
+	}
+
+	void DynamicResolution::setBudget(double targetMilliseconds, double hysteresis) {
+		_targetMilliseconds = targetMilliseconds;
+		_hysteresis = hysteresis;
+	}
+
+	void DynamicResolution::setScaleRange(float minScale, float maxScale) {
+		_minScale = minScale;
+		_maxScale = maxScale;
+		_scale = std::fmin(std::fmax(_scale, _minScale), _maxScale);
+	}
+
+	void DynamicResolution::reset() {
+		_scale = _maxScale;
+		_cooldown = 0;
+	}
+
+	void DynamicResolution::update(double gpuMilliseconds) {
+		if (_cooldown > 0) {
+			_cooldown--;
+			return;
+		}
+		if (gpuMilliseconds <= 0.0)
+			return;
+
+		float scale = _scale;
+		if (gpuMilliseconds > _targetMilliseconds * (1.0 + _hysteresis)) {
+			// fill cost is proportional to the pixel count (scale squared)
+			scale = _scale * (float)std::sqrt(_targetMilliseconds / gpuMilliseconds);
+		} else if (gpuMilliseconds < _targetMilliseconds * (1.0 - _hysteresis)) {
+			// grow back one step at a time to avoid oscillating
+			scale = _scale + SCALE_STEP;
+		}
+
+		scale = std::floor(scale / SCALE_STEP + 0.5f) * SCALE_STEP;
+		scale = std::fmin(std::fmax(scale, _minScale), _maxScale);
+		if (scale != _scale) {
+			_scale = scale;
+			_cooldown = COOLDOWN_FRAMES;
+		}
+	}
+
+	int DynamicResolution::renderWidth() const {
+		int width = (int)(_outputWidth * _scale + 0.5f);
+		return width > 0 ? width : 1;
+	}
+
+	int DynamicResolution::renderHeight() const {
+		int height = (int)(_outputHeight * _scale + 0.5f);
+		return height > 0 ? height : 1;
+	}
+
+	void DynamicResolution::upscale(GLuint outputFramebuffer) {
+		// every output pixel is written
+		RenderPass pass;
+		pass.color(LoadAction::DontCare, StoreAction::Store);
+		pass.begin(outputFramebuffer, _outputWidth, _outputHeight);
+
+		glUseProgram(_program);
+		glUniform2f(_uvScaleLocation, (float)renderWidth() / _target.width(), (float)renderHeight() / _target.height());
+		glUniform2f(_texelSizeLocation, 1.0f / _target.width(), 1.0f / _target.height());
+		glUniform1f(_sharpenLocation, _filter == UpscaleFilter::Sharpen && _scale < 1.0f ? 1.0f : 0.0f);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, _target.colorTexture());
+		glBindVertexArray(_emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		pass.end();
+
+		// the scene is rendered again from scratch next frame
+		invalidateAttachments(GL_FRAMEBUFFER, _target.id(), COLOR_ATTACHMENT);
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	}
+}
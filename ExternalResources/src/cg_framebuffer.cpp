@@ -0,0 +1,136 @@
+#include <cg_framebuffer.hpp>
+#include <iostream>
+
+namespace cgicmc {
+
+	// capacities are multiples of this many pixels
+	static const int CAPACITY_ALIGNMENT = 64;
+
+	static int allocations = 0;
+
+	int Framebuffer::growCapacity(int current, int requested) {
+		if (requested <= current)
+			return current;
+
+		// at least 50% more than the current capacity, so growing step by
+		// step (interactive resizing) reallocates only a few times
+		int capacity = current + current / 2;
+		if (capacity < requested)
+			capacity = requested;
+		capacity = (capacity + CAPACITY_ALIGNMENT - 1) / CAPACITY_ALIGNMENT * CAPACITY_ALIGNMENT;
+
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+		if (maxSize > 0 && capacity > maxSize)
+			capacity = maxSize > requested ? maxSize : requested;
+		return capacity;
+	}
+
+	int Framebuffer::allocationCount() {
+		return allocations;
+	}
+
+	Framebuffer::Framebuffer() {
+		_fbo = 0;
+		_colorTexture = 0;
+		_colorRenderbuffer = 0;
+		_width = 0;
+		_height = 0;
+		_samples = 0;
+		_requestedSamples = 0;
+	}
+
+	void Framebuffer::create(int width, int height, int samples) {
+		destroy();
+		_requestedSamples = samples;
+
+		// clamp the sample count to what the implementation supports
+		if (samples > 0) {
+			GLint maxSamples = 0;
+			glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+			if (samples > maxSamples)
+				samples = maxSamples;
+		}
+
+		_width = width > 0 ? width : 1;
+		_height = height > 0 ? height : 1;
+		_samples = samples;
+
+		glGenFramebuffers(1, &_fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		allocations++;
+
+		if (_samples > 0) {
+			glGenRenderbuffers(1, &_colorRenderbuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, _colorRenderbuffer);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, _samples, GL_RGBA8, _width, _height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorRenderbuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		} else {
+			glGenTextures(1, &_colorTexture);
+			glBindTexture(GL_TEXTURE_2D, _colorTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _colorTexture, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Framebuffer " << _width << "x" << _height << " (" << _samples << " samples) is incomplete\n";
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void Framebuffer::destroy() {
+		if (_colorTexture)
+			glDeleteTextures(1, &_colorTexture);
+		if (_colorRenderbuffer)
+			glDeleteRenderbuffers(1, &_colorRenderbuffer);
+		if (_fbo)
+			glDeleteFramebuffers(1, &_fbo);
+		_fbo = 0;
+		_colorTexture = 0;
+		_colorRenderbuffer = 0;
+	}
+
+	void Framebuffer::resize(int width, int height, int samples) {
+		if (width < 1)
+			width = 1;
+		if (height < 1)
+			height = 1;
+		if (valid() && width == _width && height == _height && samples == _requestedSamples)
+			return;
+		create(width, height, samples);
+	}
+
+	void Framebuffer::reserve(int width, int height, int samples) {
+		if (width < 1)
+			width = 1;
+		if (height < 1)
+			height = 1;
+
+		if (valid() && samples == _requestedSamples) {
+			bool fits = width <= _width && height <= _height;
+			bool wasteful = (long long)width * height * 4 < (long long)_width * _height;
+			if (fits && !wasteful)
+				return;
+
+			// grow from the current capacity, or start over when shrinking
+			if (fits) {
+				create(growCapacity(0, width), growCapacity(0, height), samples);
+			} else {
+				create(growCapacity(_width, width), growCapacity(_height, height), samples);
+			}
+			return;
+		}
+		create(growCapacity(0, width), growCapacity(0, height), samples);
+	}
+
+	void Framebuffer::bind() const {
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		glViewport(0, 0, _width, _height);
+	}
+}
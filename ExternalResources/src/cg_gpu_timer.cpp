@@ -0,0 +1,79 @@
+#include <cg_gpu_timer.hpp>
+
+namespace cgicmc {
+
+	// weight of a new sample in the moving average
+	static const double AVERAGE_WEIGHT = 0.05;
+
+	GpuTimer::GpuTimer() {
+		for (int i = 0; i < QUERY_COUNT; i++) {
+			_queries[i] = 0;
+			_pending[i] = false;
+		}
+		_next = 0;
+		_active = false;
+		_created = false;
+		_last = 0;
+		_average = 0;
+		_samples = 0;
+	}
+
+	void GpuTimer::create() {
+		if (_created)
+			return;
+		glGenQueries(QUERY_COUNT, _queries);
+		_created = true;
+	}
+
+	void GpuTimer::destroy() {
+		if (!_created)
+			return;
+		glDeleteQueries(QUERY_COUNT, _queries);
+		for (int i = 0; i < QUERY_COUNT; i++)
+			_pending[i] = false;
+		_created = false;
+	}
+
+	// read back every query whose result is already available
+	void GpuTimer::collect() {
+		for (int i = 0; i < QUERY_COUNT; i++) {
+			if (!_pending[i])
+				continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(_queries[i], GL_QUERY_RESULT, &elapsed);
+			_pending[i] = false;
+
+			_last = elapsed / 1.0e6;
+			_average = _samples == 0 ? _last : _average + (_last - _average) * AVERAGE_WEIGHT;
+			_samples++;
+		}
+	}
+
+	void GpuTimer::begin() {
+		if (!_created)
+			return;
+		collect();
+
+		// every query still in flight: skip this frame instead of waiting
+		if (_pending[_next])
+			return;
+
+		glBeginQuery(GL_TIME_ELAPSED, _queries[_next]);
+		_active = true;
+	}
+
+	void GpuTimer::end() {
+		if (!_active)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		_pending[_next] = true;
+		_next = (_next + 1) % QUERY_COUNT;
+		_active = false;
+	}
+}
@@ -0,0 +1,232 @@
+#include <cg_layers.hpp>
+#include <glm/gtc/type_ptr.hpp> // glm::value_ptr
+#include <cg_framebuffer.hpp>
+#include <cg_render_pass.hpp>
+#include <cg_shader.hpp>
+#include <iostream>
+
+namespace cgicmc {
+
+	// one quad per visible layer, the instance selects transform and slice
+	static const char *compositeVertexShaderSource =
+		"#version 330 core\n"
+		"#define MAX_LAYERS 16\n"
+		"uniform mat4 transforms[MAX_LAYERS];\n"
+		"uniform float slices[MAX_LAYERS];\n"
+		"uniform vec2 uvScale;\n" // part of the storage holding the layers
+
+		"out vec3 uvw;\n"
+
+		"void main() {\n"
+		"   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+		"   uvw = vec3(corner * uvScale, slices[gl_InstanceID]);\n"
+		"   gl_Position = transforms[gl_InstanceID] * vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+		"}\0";
+
+	static const char *compositeFragmentShaderSource =
+		"#version 330 core\n"
+		"in vec3 uvw;\n"
+		"out vec4 FragColor;\n"
+
+		"uniform sampler2DArray layers;\n"
+		"uniform vec2 uvLimit;\n" // last texel center holding the layers
+
+		"void main() {\n"
+		"   FragColor = texture(layers, vec3(min(uvw.xy, uvLimit), uvw.z));\n"
+		"}\n\0";
+
+	LayerCompositor::LayerCompositor() {
+		_width = 0;
+		_height = 0;
+		_capacityWidth = 0;
+		_capacityHeight = 0;
+		_redrawn = 0;
+		_texture = 0;
+		_program = 0;
+		_transformsLocation = -1;
+		_slicesLocation = -1;
+		_uvScaleLocation = -1;
+		_uvLimitLocation = -1;
+		_emptyVAO = 0;
+	}
+
+	void LayerCompositor::create(int width, int height) {
+		_width = width > 0 ? width : 1;
+		_height = height > 0 ? height : 1;
+		_capacityWidth = Framebuffer::growCapacity(0, _width);
+		_capacityHeight = Framebuffer::growCapacity(0, _height);
+
+		_program = createShaderProgram(compositeVertexShaderSource, compositeFragmentShaderSource);
+		_transformsLocation = glGetUniformLocation(_program, "transforms");
+		_slicesLocation = glGetUniformLocation(_program, "slices");
+		_uvScaleLocation = glGetUniformLocation(_program, "uvScale");
+		_uvLimitLocation = glGetUniformLocation(_program, "uvLimit");
+		glUseProgram(_program);
+		glUniform1i(glGetUniformLocation(_program, "layers"), 0);
+		glUseProgram(0);
+
+		glGenVertexArrays(1, &_emptyVAO);
+		allocate();
+	}
+
+	// (re)allocate the texture array and attach one slice to each layer
+	void LayerCompositor::allocate() {
+		if (_texture)
+			glDeleteTextures(1, &_texture);
+
+		glGenTextures(1, &_texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, _capacityWidth, _capacityHeight, MAX_LAYERS, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		for (size_t i = 0; i < _layers.size(); i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, _layers[i].fbo);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _texture, 0, (GLint)i);
+			_layers[i].dirty = true;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void LayerCompositor::destroy() {
+		if (!_program)
+			return;
+		for (size_t i = 0; i < _layers.size(); i++)
+			glDeleteFramebuffers(1, &_layers[i].fbo);
+		_layers.clear();
+		glDeleteTextures(1, &_texture);
+		glDeleteProgram(_program);
+		glDeleteVertexArrays(1, &_emptyVAO);
+		_texture = 0;
+		_program = 0;
+	}
+
+	void LayerCompositor::resize(int width, int height) {
+		if (width < 1)
+			width = 1;
+		if (height < 1)
+			height = 1;
+		if (width == _width && height == _height)
+			return;
+		_width = width;
+		_height = height;
+		markAllDirty();
+
+		// reallocate only when the layers do not fit or waste most of it
+		bool fits = width <= _capacityWidth && height <= _capacityHeight;
+		bool wasteful = (long long)width * height * 4 < (long long)_capacityWidth * _capacityHeight;
+		if (fits && !wasteful)
+			return;
+		_capacityWidth = Framebuffer::growCapacity(fits ? 0 : _capacityWidth, width);
+		_capacityHeight = Framebuffer::growCapacity(fits ? 0 : _capacityHeight, height);
+		allocate();
+	}
+
+	int LayerCompositor::addLayer(DrawFunction draw, glm::vec4 clearColor) {
+		if ((int)_layers.size() >= MAX_LAYERS) {
+			std::cout << "LayerCompositor: no more than " << MAX_LAYERS << " layers are supported\n";
+			return -1;
+		}
+
+		Layer layer;
+		layer.draw = draw;
+		layer.clearColor = clearColor;
+		layer.transform = glm::mat4(1.0f);
+		layer.dirty = true;
+		layer.visible = true;
+
+		glGenFramebuffers(1, &layer.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _texture, 0, (GLint)_layers.size());
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		_layers.push_back(layer);
+		return (int)_layers.size() - 1;
+	}
+
+	void LayerCompositor::markDirty(int layer) {
+		_layers[layer].dirty = true;
+	}
+
+	void LayerCompositor::markAllDirty() {
+		for (size_t i = 0; i < _layers.size(); i++)
+			_layers[i].dirty = true;
+	}
+
+	void LayerCompositor::setTransform(int layer, const glm::mat4 &transform) {
+		_layers[layer].transform = transform;
+	}
+
+	void LayerCompositor::setVisible(int layer, bool visible) {
+		_layers[layer].visible = visible;
+	}
+
+	void LayerCompositor::render(GLuint outputFramebuffer, int outputWidth, int outputHeight) {
+		// redraw only the layers whose content changed (a scissor set for
+		// the output must not clip the layer content)
+		_redrawn = 0;
+		GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+		glDisable(GL_SCISSOR_TEST);
+		for (size_t i = 0; i < _layers.size(); i++) {
+			Layer &layer = _layers[i];
+			if (!layer.dirty)
+				continue;
+
+			// the content is rebuilt from scratch and kept for compositing
+			glm::vec4 clear = layer.clearColor;
+			RenderPass pass;
+			pass.color(LoadAction::Clear, StoreAction::Store, glm::vec4(clear.x * clear.w, clear.y * clear.w, clear.z * clear.w, clear.w));
+			pass.begin(layer.fbo, _width, _height);
+			if (layer.draw)
+				layer.draw(_width, _height);
+			pass.end();
+
+			layer.dirty = false;
+			_redrawn++;
+		}
+		if (scissor)
+			glEnable(GL_SCISSOR_TEST);
+
+		// gather the visible layers, bottom to top
+		glm::mat4 transforms[MAX_LAYERS];
+		float slices[MAX_LAYERS];
+		int visible = 0;
+		for (size_t i = 0; i < _layers.size(); i++) {
+			if (!_layers[i].visible)
+				continue;
+			transforms[visible] = _layers[i].transform;
+			slices[visible] = (float)i;
+			visible++;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+		glViewport(0, 0, outputWidth, outputHeight);
+		if (visible == 0)
+			return;
+
+		// composite everything with a single draw call
+		glUseProgram(_program);
+		glUniformMatrix4fv(_transformsLocation, visible, GL_FALSE, glm::value_ptr(transforms[0]));
+		glUniform1fv(_slicesLocation, visible, slices);
+		glUniform2f(_uvScaleLocation, (float)_width / _capacityWidth, (float)_height / _capacityHeight);
+		glUniform2f(_uvLimitLocation, (_width - 0.5f) / _capacityWidth, (_height - 0.5f) / _capacityHeight);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _texture);
+
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		glBindVertexArray(_emptyVAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, visible);
+
+		// restore the straight alpha blending used by the other passes
+		if (blend)
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		else
+			glDisable(GL_BLEND);
+	}
+}
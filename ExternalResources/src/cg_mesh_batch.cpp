@@ -0,0 +1,613 @@
+#include <cg_mesh_batch.hpp>
+#include <cg_framebuffer.hpp>
+#include <cg_shader.hpp>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CG_MESH_BATCH_SSE 1
+#endif
+
+namespace cgicmc {
+
+	// vertices already in the world
+	static const char *batchVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 aPos;\n"
+		"layout (location = 1) in vec4 aColor;\n"
+
+		CAMERA_BLOCK_GLSL
+
+		"out vec4 color;\n"
+
+		"void main() {\n"
+		"   gl_Position = camera.view * vec4(aPos, 0.0, 1.0);\n"
+		"   color = aColor;\n"
+		"}\0";
+
+	// vertices of the mesh, moved by the transform of their instance
+	static const char *instanceVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 aLocal;\n"
+		"layout (location = 1) in vec4 aColor;\n"
+		"layout (location = 2) in vec4 aLinear;\n" // a, b, c, d of the Affine2D
+		"layout (location = 3) in vec2 aOffset;\n" // tx, ty
+
+		CAMERA_BLOCK_GLSL
+
+		"out vec4 color;\n"
+
+		"void main() {\n"
+		"   vec2 world = vec2(aLinear.x * aLocal.x + aLinear.z * aLocal.y, aLinear.y * aLocal.x + aLinear.w * aLocal.y) + aOffset;\n"
+		"   gl_Position = camera.view * vec4(world, 0.0, 1.0);\n"
+		"   color = aColor;\n"
+		"}\0";
+
+	// the same, with the instance fetched from the buffer texture: two
+	// texels, (a, b, c, d) and (tx, ty, color, unused)
+	static const char *textureVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 aLocal;\n"
+
+		CAMERA_BLOCK_GLSL
+
+		"uniform usamplerBuffer instances;\n"
+		"uniform int instanceBase;\n"
+		"out vec4 color;\n"
+
+		"void main() {\n"
+		"   int texel = 2 * (instanceBase + gl_InstanceID);\n"
+		"   vec4 linear = uintBitsToFloat(texelFetch(instances, texel));\n"
+		"   uvec4 rest = texelFetch(instances, texel + 1);\n"
+		"   vec2 world = vec2(linear.x * aLocal.x + linear.z * aLocal.y, linear.y * aLocal.x + linear.w * aLocal.y) + uintBitsToFloat(rest.xy);\n"
+		"   gl_Position = camera.view * vec4(world, 0.0, 1.0);\n"
+		"   color = vec4(uvec4(rest.z, rest.z >> 8u, rest.z >> 16u, rest.z >> 24u) & 0xFFu) / 255.0;\n"
+		"}\0";
+
+	static const char *meshFragmentShaderSource =
+		"#version 330 core\n"
+		"in vec4 color;\n"
+		"out vec4 FragColor;\n"
+		"void main() {\n"
+		"   FragColor = color;\n"
+		"}\0";
+
+	static unsigned int packColor(glm::vec4 color) {
+		unsigned int packed = 0;
+		for (int i = 0; i < 4; i++)
+			packed |= (unsigned int)(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f) << (8 * i);
+		return packed;
+	}
+
+	const char *meshDrawPathName(MeshDrawPath path) {
+		switch (path) {
+		case MeshDrawPath::Auto: return "auto";
+		case MeshDrawPath::PreTransform: return "pre-transform";
+		case MeshDrawPath::Instanced: return "instanced";
+		}
+		return "";
+	}
+
+	const char *instanceStorageName(InstanceStorage storage) {
+		switch (storage) {
+		case InstanceStorage::Attributes: return "attributes";
+		case InstanceStorage::TextureBuffer: return "buffer texture";
+		}
+		return "";
+	}
+
+	MeshBatcher::MeshBatcher() {
+		_path = MeshDrawPath::Auto;
+		_instanceStorage = InstanceStorage::Attributes;
+		_batchVertexLimit = 32;
+		_streamVertexBudget = 1 << 21;
+		_pathsValid = false;
+		_meshesDirty = true;
+		_instancesDirty = true;
+		_vectorized = true;
+		_vertexCount = 0;
+		_streamCapacity = 0;
+		_batchProgram = 0;
+		_instanceProgram = 0;
+		_textureProgram = 0;
+		_batchVAO = 0;
+		_streamVBO = 0;
+		_instanceVAO = 0;
+		_meshVBO = 0;
+		_instanceVBO = 0;
+		_meshVAO = 0;
+		_instanceTexture = 0;
+		_instanceBaseLocation = -1;
+		_maxTexels = 0;
+		_instanceCapacity = 0;
+		_drawCalls = 0;
+		_streamedVertices = 0;
+		_prepareMilliseconds = 0.0;
+	}
+
+	void MeshBatcher::create() {
+		_batchProgram = createShaderProgram(batchVertexShaderSource, meshFragmentShaderSource);
+		_instanceProgram = createShaderProgram(instanceVertexShaderSource, meshFragmentShaderSource);
+		_textureProgram = createShaderProgram(textureVertexShaderSource, meshFragmentShaderSource);
+		Camera::bindBlock(_batchProgram);
+		Camera::bindBlock(_instanceProgram);
+		Camera::bindBlock(_textureProgram);
+		glUseProgram(_textureProgram);
+		glUniform1i(glGetUniformLocation(_textureProgram, "instances"), 0);
+		_instanceBaseLocation = glGetUniformLocation(_textureProgram, "instanceBase");
+
+		// the attribute pointers of the streamed buffer are set when it is
+		// allocated (the colors follow the positions)
+		glGenVertexArrays(1, &_batchVAO);
+		glGenBuffers(1, &_streamVBO);
+
+		glGenVertexArrays(1, &_instanceVAO);
+		glBindVertexArray(_instanceVAO);
+		glGenBuffers(1, &_meshVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _meshVBO);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+		glEnableVertexAttribArray(0);
+		// the instance attributes advance once per instance; their offsets
+		// are set per mesh when drawing
+		glGenBuffers(1, &_instanceVBO);
+		for (int i = 1; i < 4; i++) {
+			glVertexAttribDivisor(i, 1);
+			glEnableVertexAttribArray(i);
+		}
+
+		// the mesh alone, the instances come from the texture over the
+		// instance buffer
+		glGenVertexArrays(1, &_meshVAO);
+		glBindVertexArray(_meshVAO);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_TEXTURE_BUFFER, _instanceVBO);
+		glGenTextures(1, &_instanceTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, _instanceTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, _instanceVBO);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &_maxTexels);
+		_streamCapacity = 0;
+		_instanceCapacity = 0;
+		_meshesDirty = true;
+		_instancesDirty = true;
+	}
+
+	void MeshBatcher::destroy() {
+		if (!_batchProgram)
+			return;
+		glDeleteProgram(_batchProgram);
+		glDeleteProgram(_instanceProgram);
+		glDeleteProgram(_textureProgram);
+		glDeleteVertexArrays(1, &_batchVAO);
+		glDeleteVertexArrays(1, &_instanceVAO);
+		glDeleteVertexArrays(1, &_meshVAO);
+		glDeleteTextures(1, &_instanceTexture);
+		glDeleteBuffers(1, &_streamVBO);
+		glDeleteBuffers(1, &_meshVBO);
+		glDeleteBuffers(1, &_instanceVBO);
+		_batchProgram = 0;
+	}
+
+	int MeshBatcher::addMesh(const std::vector<glm::vec2> &triangles) {
+		Mesh mesh;
+		mesh.firstVertex = (int)_meshVertices.size();
+		mesh.vertexCount = (int)triangles.size();
+		for (const glm::vec2 &vertex : triangles) {
+			mesh.x.push_back(vertex.x);
+			mesh.y.push_back(vertex.y);
+		}
+		mesh.x.resize((mesh.x.size() + 3) / 4 * 4, 0.0f);
+		mesh.y.resize(mesh.x.size(), 0.0f);
+		_meshVertices.insert(_meshVertices.end(), triangles.begin(), triangles.end());
+		_meshes.push_back(mesh);
+		_meshesDirty = true;
+		_pathsValid = false;
+		return (int)_meshes.size() - 1;
+	}
+
+	int MeshBatcher::add(int mesh, const Affine2D &transform, glm::vec4 color) {
+		_meshOf.push_back(mesh);
+		_transforms.push_back(transform);
+		_colors.push_back(packColor(color));
+		_pathsValid = false;
+		_instancesDirty = true;
+		return (int)_transforms.size() - 1;
+	}
+
+	void MeshBatcher::setTransform(int instance, const Affine2D &transform) {
+		_transforms[instance] = transform;
+		_instancesDirty = true;
+	}
+
+	void MeshBatcher::setTransforms(int first, int count, const Affine2D *transforms) {
+		std::copy(transforms, transforms + count, _transforms.begin() + first);
+		_instancesDirty = true;
+	}
+
+	void MeshBatcher::setColor(int instance, glm::vec4 color) {
+		_colors[instance] = packColor(color);
+		_instancesDirty = true;
+	}
+
+	void MeshBatcher::clear() {
+		_meshOf.clear();
+		_transforms.clear();
+		_colors.clear();
+		_pathsValid = false;
+		_instancesDirty = true;
+	}
+
+	void MeshBatcher::setPath(MeshDrawPath path) {
+		_path = path;
+		_pathsValid = false;
+	}
+
+	void MeshBatcher::setBatchVertexLimit(int vertices) {
+		_batchVertexLimit = vertices;
+		_pathsValid = false;
+	}
+
+	void MeshBatcher::setStreamVertexBudget(int vertices) {
+		_streamVertexBudget = vertices;
+		_pathsValid = false;
+	}
+
+	void MeshBatcher::setInstanceStorage(InstanceStorage storage) {
+		if (storage == _instanceStorage)
+			return;
+		_instanceStorage = storage;
+		// the upload checks that the instances fit in the buffer texture
+		_instancesDirty = true;
+	}
+
+	bool MeshBatcher::preTransformed(int mesh) {
+		if (!_pathsValid)
+			choosePaths();
+		return _preTransformed[mesh] != 0;
+	}
+
+	// the small meshes, smallest first, while their vertices fit in the
+	// budget (see the class)
+	void MeshBatcher::choosePaths() {
+		int meshCount = (int)_meshes.size();
+		std::vector<long long> instances(meshCount, 0);
+		for (int mesh : _meshOf)
+			instances[mesh]++;
+
+		_preTransformed.assign(meshCount, _path == MeshDrawPath::PreTransform ? 1 : 0);
+		if (_path == MeshDrawPath::Auto) {
+			std::vector<int> order(meshCount);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return _meshes[a].vertexCount < _meshes[b].vertexCount; });
+			long long streamed = 0;
+			for (int mesh : order) {
+				if (_meshes[mesh].vertexCount > _batchVertexLimit)
+					break;
+				streamed += instances[mesh] * _meshes[mesh].vertexCount;
+				if (streamed > _streamVertexBudget)
+					break;
+				_preTransformed[mesh] = 1;
+			}
+		}
+		_pathsValid = true;
+		_instancesDirty = true;
+	}
+
+	// world = (a x + c y + tx, b x + d y + ty) for every vertex of every
+	// pre-transformed instance, in the order the instances were added
+	int MeshBatcher::preTransform(std::vector<float> &positions, std::vector<unsigned int> &colors) {
+		if (!_pathsValid)
+			choosePaths();
+		int total = 0;
+		for (size_t i = 0; i < _meshOf.size(); i++)
+			if (_preTransformed[_meshOf[i]])
+				total += _meshes[_meshOf[i]].vertexCount;
+		// the SIMD stores of an instance may run 3 vertices past its end
+		positions.resize(2 * (size_t)(total + 4));
+		colors.resize((size_t)total + 4);
+
+		int v = 0;
+		for (size_t i = 0; i < _meshOf.size(); i++) {
+			if (!_preTransformed[_meshOf[i]])
+				continue;
+			const Mesh &mesh = _meshes[_meshOf[i]];
+			const Affine2D &t = _transforms[i];
+			float *position = &positions[2 * (size_t)v];
+			unsigned int *color = &colors[v];
+			int k = 0;
+#ifdef CG_MESH_BATCH_SSE
+			if (_vectorized) {
+				__m128 a = _mm_set1_ps(t.a), b = _mm_set1_ps(t.b), c = _mm_set1_ps(t.c), d = _mm_set1_ps(t.d);
+				__m128 tx = _mm_set1_ps(t.tx), ty = _mm_set1_ps(t.ty);
+				__m128i packed = _mm_set1_epi32((int)_colors[i]);
+				for (; k < mesh.vertexCount; k += 4) {
+					__m128 x = _mm_loadu_ps(&mesh.x[k]), y = _mm_loadu_ps(&mesh.y[k]);
+					__m128 worldX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(c, y)), tx);
+					__m128 worldY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(d, y)), ty);
+					_mm_storeu_ps(position + 2 * k, _mm_unpacklo_ps(worldX, worldY));
+					_mm_storeu_ps(position + 2 * k + 4, _mm_unpackhi_ps(worldX, worldY));
+					_mm_storeu_si128((__m128i *)(color + k), packed);
+				}
+			}
+#endif
+			for (; k < mesh.vertexCount; k++) {
+				position[2 * k] = t.a * mesh.x[k] + t.c * mesh.y[k] + t.tx;
+				position[2 * k + 1] = t.b * mesh.x[k] + t.d * mesh.y[k] + t.ty;
+				color[k] = _colors[i];
+			}
+			v += mesh.vertexCount;
+		}
+		return total;
+	}
+
+	// the instances of the instanced meshes, grouped by mesh
+	void MeshBatcher::uploadInstances() {
+		int meshCount = (int)_meshes.size();
+		_instanceStart.assign(meshCount + 1, 0);
+		_instanceCount.assign(meshCount, 0);
+		for (int mesh : _meshOf)
+			if (!_preTransformed[mesh])
+				_instanceCount[mesh]++;
+		for (int m = 0; m < meshCount; m++)
+			_instanceStart[m + 1] = _instanceStart[m] + _instanceCount[m];
+		if (_instanceStart[meshCount] == 0)
+			return;
+
+		std::vector<Instance> &instances = _instanceData;
+		instances.resize(_instanceStart[meshCount]);
+		_instanceNext.assign(_instanceStart.begin(), _instanceStart.end() - 1);
+		for (size_t i = 0; i < _meshOf.size(); i++) {
+			if (_preTransformed[_meshOf[i]])
+				continue;
+			Instance &instance = instances[_instanceNext[_meshOf[i]]++];
+			const Affine2D &t = _transforms[i];
+			instance.linear[0] = t.a;
+			instance.linear[1] = t.b;
+			instance.linear[2] = t.c;
+			instance.linear[3] = t.d;
+			instance.offset[0] = t.tx;
+			instance.offset[1] = t.ty;
+			instance.color = _colors[i];
+			instance.unused = 0;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+		if (instances.size() > _instanceCapacity) {
+			_instanceCapacity = instances.size() * 2;
+			glBufferData(GL_ARRAY_BUFFER, _instanceCapacity * sizeof(Instance), NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+
+		if (_instanceStorage == InstanceStorage::TextureBuffer && 2 * instances.size() > (size_t)_maxTexels) {
+			std::cout << "Mesh batch: " << instances.size() << " instances do not fit in a buffer texture of "
+				<< _maxTexels << " texels, using attributes\n";
+			_instanceStorage = InstanceStorage::Attributes;
+		}
+	}
+
+	void MeshBatcher::draw(const Camera &camera) {
+		_drawCalls = 0;
+		if (_transforms.empty())
+			return;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!_pathsValid)
+			choosePaths();
+		if (_meshesDirty) {
+			glBindBuffer(GL_ARRAY_BUFFER, _meshVBO);
+			glBufferData(GL_ARRAY_BUFFER, _meshVertices.size() * sizeof(glm::vec2), _meshVertices.data(), GL_STATIC_DRAW);
+			_meshesDirty = false;
+		}
+		if (_instancesDirty) {
+			_vertexCount = preTransform(_positions, _vertexColors);
+			_streamedVertices = _vertexCount;
+			if (_vertexCount > 0) {
+				glBindBuffer(GL_ARRAY_BUFFER, _streamVBO);
+				if ((size_t)_vertexCount > _streamCapacity) {
+					_streamCapacity = (size_t)_vertexCount * 2;
+					glBindVertexArray(_batchVAO);
+					glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+					glEnableVertexAttribArray(0);
+					glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GLuint), (void *)(_streamCapacity * 2 * sizeof(float)));
+					glEnableVertexAttribArray(1);
+				}
+				// orphan the storage the GPU may still read, so the upload
+				// never waits for the previous frame
+				size_t positionBytes = _streamCapacity * 2 * sizeof(float);
+				glBufferData(GL_ARRAY_BUFFER, positionBytes + _streamCapacity * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)_vertexCount * 2 * sizeof(float), _positions.data());
+				glBufferSubData(GL_ARRAY_BUFFER, positionBytes, (size_t)_vertexCount * sizeof(GLuint), _vertexColors.data());
+			}
+			uploadInstances();
+			_instancesDirty = false;
+			_prepareMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// every pre-transformed instance, of every mesh, in one draw
+		if (_vertexCount > 0) {
+			glUseProgram(_batchProgram);
+			camera.bind();
+			glBindVertexArray(_batchVAO);
+			glDrawArrays(GL_TRIANGLES, 0, _vertexCount);
+			_drawCalls++;
+		}
+
+		// one instanced draw per remaining mesh, its instances starting at
+		// the offset its attributes point to, or at the base given to the
+		// texture fetches
+		bool textureStorage = _instanceStorage == InstanceStorage::TextureBuffer;
+		bool programBound = false;
+		for (int m = 0; m < (int)_meshes.size(); m++) {
+			if (_preTransformed[m] || _instanceCount[m] == 0)
+				continue;
+			if (textureStorage) {
+				if (!programBound) {
+					glUseProgram(_textureProgram);
+					camera.bind();
+					glBindVertexArray(_meshVAO);
+					glActiveTexture(GL_TEXTURE0);
+					glBindTexture(GL_TEXTURE_BUFFER, _instanceTexture);
+					programBound = true;
+				}
+				glUniform1i(_instanceBaseLocation, _instanceStart[m]);
+				glDrawArraysInstanced(GL_TRIANGLES, _meshes[m].firstVertex, _meshes[m].vertexCount, _instanceCount[m]);
+				_drawCalls++;
+				continue;
+			}
+			if (!programBound) {
+				glUseProgram(_instanceProgram);
+				camera.bind();
+				glBindVertexArray(_instanceVAO);
+				glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+				programBound = true;
+			}
+			size_t offset = (size_t)_instanceStart[m] * sizeof(Instance);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void *)(offset + 6 * sizeof(float)));
+			glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offset);
+			glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)(offset + 4 * sizeof(float)));
+			glDrawArraysInstanced(GL_TRIANGLES, _meshes[m].firstVertex, _meshes[m].vertexCount, _instanceCount[m]);
+			_drawCalls++;
+		}
+	}
+
+	void benchmarkMeshBatch(std::ostream &out, int count) {
+		const int REPEATS = 20;
+		// the pinwheel: 4 triangles
+		std::vector<glm::vec2> pinwheel = {
+			{ 0.0f, 0.0f }, { 0.0f, 0.5f }, { 0.3f, 0.5f }, { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, -0.3f },
+			{ 0.0f, 0.0f }, { 0.0f, -0.5f }, { -0.3f, -0.5f }, { 0.0f, 0.0f }, { -0.5f, 0.0f }, { -0.5f, 0.3f } };
+		std::mt19937 random(2048);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		MeshBatcher batcher;
+		batcher.setPath(MeshDrawPath::PreTransform);
+		int mesh = batcher.addMesh(pinwheel);
+		for (int i = 0; i < count; i++) {
+			float scale = 0.01f + 0.05f * unit(random);
+			batcher.add(mesh, Affine2D::translation(unit(random) - 0.5f, unit(random) - 0.5f) * Affine2D::rotation(unit(random) * 6.2831853f)
+				* Affine2D::scaling(scale, scale), glm::vec4(unit(random), unit(random), unit(random), 1.0f));
+		}
+
+		out << "Mesh batch benchmark: " << count << " instances of a " << pinwheel.size() << "-vertex mesh, " << REPEATS << " passes\n";
+		out << std::fixed << std::setprecision(3);
+
+		std::vector<float> positions[2];
+		std::vector<unsigned int> colors[2];
+		for (int pass = 0; pass < 2; pass++) {
+			batcher.setVectorized(pass == 0);
+			int vertices = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int repeat = 0; repeat < REPEATS; repeat++)
+				vertices = batcher.preTransform(positions[pass], colors[pass]);
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+			out << "  pre-transform " << (pass == 0 ? "SIMD  " : "scalar") << ": " << std::setw(8) << milliseconds << " ms, "
+				<< std::setprecision(1) << std::setw(7) << vertices / milliseconds / 1000.0 << "M vertices/s, "
+				<< std::setprecision(2) << vertices * 12.0 / 1048576.0 << " MB streamed" << std::setprecision(3) << "\n";
+		}
+
+		float difference = 0.0f;
+		for (size_t i = 0; i < positions[0].size(); i++)
+			difference = std::max(difference, std::fabs(positions[0][i] - positions[1][i]));
+		out << "  largest difference between SIMD and scalar: " << std::scientific << std::setprecision(1) << difference
+			<< std::fixed << "\n";
+		out << "  (the GPU side of pre-transforming and instancing is compared in the window, U key)\n";
+	}
+
+	void benchmarkInstanceStorage(std::ostream &out, int count) {
+		const int SIZE = 512, REPEATS = 10;
+		out << "Instance storage benchmark: " << count << " instances of a 12-vertex mesh, " << REPEATS << " draws\n";
+		// a hidden window, for its context only
+		if (!glfwInit()) {
+			out << "  skipped: GLFW could not be initialized\n";
+			return;
+		}
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow *window = glfwCreateWindow(64, 64, "", NULL, NULL);
+		if (!window) {
+			out << "  skipped: no OpenGL 3.3 context\n";
+			glfwTerminate();
+			return;
+		}
+		glfwMakeContextCurrent(window);
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+			out << "  skipped: the OpenGL functions could not be loaded\n";
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return;
+		}
+
+		std::vector<glm::vec2> pinwheel = {
+			{ 0.0f, 0.0f }, { 0.0f, 0.5f }, { 0.3f, 0.5f }, { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, -0.3f },
+			{ 0.0f, 0.0f }, { 0.0f, -0.5f }, { -0.3f, -0.5f }, { 0.0f, 0.0f }, { -0.5f, 0.0f }, { -0.5f, 0.3f } };
+		std::mt19937 random(2050);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		Framebuffer target;
+		target.create(SIZE, SIZE);
+		Camera camera;
+		camera.create();
+		camera.setViewport(SIZE, SIZE);
+		camera.upload();
+		MeshBatcher batcher;
+		batcher.create();
+		batcher.setPath(MeshDrawPath::Instanced);
+		int mesh = batcher.addMesh(pinwheel);
+		for (int i = 0; i < count; i++) {
+			float scale = 0.002f + 0.01f * unit(random);
+			batcher.add(mesh, Affine2D::translation(2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f)
+				* Affine2D::rotation(unit(random) * 6.2831853f) * Affine2D::scaling(scale, scale),
+				glm::vec4(unit(random), unit(random), unit(random), 1.0f));
+		}
+
+		out << std::fixed << std::setprecision(3);
+		GLuint query;
+		glGenQueries(1, &query);
+		std::vector<unsigned char> pixels[2];
+		for (int pass = 0; pass < 2; pass++) {
+			InstanceStorage storage = pass == 0 ? InstanceStorage::Attributes : InstanceStorage::TextureBuffer;
+			batcher.setInstanceStorage(storage);
+			target.bind();
+			// the first draw uploads the instances, the others only draw
+			glClear(GL_COLOR_BUFFER_BIT);
+			batcher.draw(camera);
+			glFinish();
+			GLuint64 total = 0;
+			for (int repeat = 0; repeat < REPEATS; repeat++) {
+				glClear(GL_COLOR_BUFFER_BIT);
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				batcher.draw(camera);
+				glEndQuery(GL_TIME_ELAPSED);
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+				total += nanoseconds;
+			}
+			double milliseconds = total / 1e6 / REPEATS;
+			pixels[pass].resize((size_t)SIZE * SIZE * 4);
+			glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels[pass].data());
+			out << "  " << std::setw(14) << instanceStorageName(batcher.instanceStorage()) << ": " << std::setw(8) << milliseconds
+				<< " ms GPU, " << std::setprecision(1) << std::setw(7) << count / milliseconds / 1000.0 << "M instances/s"
+				<< std::setprecision(3) << "\n";
+		}
+		out << "  images " << (pixels[0] == pixels[1] ? "identical" : "different") << "\n";
+
+		glDeleteQueries(1, &query);
+		batcher.destroy();
+		camera.destroy();
+		target.destroy();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+}
@@ -0,0 +1,259 @@
+#include <cg_motion.hpp>
+#include <cg_shader.hpp>
+#include <cmath>
+#include <string>
+
+namespace cgicmc {
+
+	// the quad of the SdfRenderer, moved by the motion of its shape
+	static const char *motionVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 aCorner;\n"     // quad corner in [-1, 1]
+		"layout (location = 1) in vec4 aCenterSize;\n" // center.xy, size.xy
+		"layout (location = 2) in vec4 aShape;\n"      // rotation, type, param, param2
+		"layout (location = 3) in vec4 aColor;\n"
+		"layout (location = 4) in vec4 aMotionA;\n"    // drift.xy, spin, orbit radius
+		"layout (location = 5) in vec4 aMotionB;\n"    // orbit speed, orbit phase, oscillation.xy
+		"layout (location = 6) in vec2 aMotionC;\n"    // oscillation frequency, phase
+
+		CAMERA_BLOCK_GLSL
+
+		"uniform float time;\n"
+
+		"out vec2 localPos;\n"
+		"flat out vec3 shapeParams;\n"
+		"flat out vec2 shapeSize;\n"
+		"flat out vec4 shapeColor;\n"
+		"flat out uint shapeId;\n"
+
+		"void main() {\n"
+		"   int type = int(aShape.y + 0.5);\n"
+		"   vec2 size = aCenterSize.zw;\n"
+
+		"   vec2 extent = vec2(size.x);\n"
+		"   if (type == 1) extent = size;\n"
+		"   if (type == 4) extent = vec2(size.x * length(vec2(1.0, aShape.w)));\n"
+
+		// the motion (see Motion)
+		"   float orbit = aMotionB.y + aMotionB.x * time;\n"
+		"   float oscillation = sin(aMotionC.y + 6.2831853 * aMotionC.x * time);\n"
+		"   vec2 center = aCenterSize.xy + aMotionA.xy * time\n"
+		"       + aMotionA.w * vec2(cos(orbit), sin(orbit)) + aMotionB.zw * oscillation;\n"
+		"   float rotation = aShape.x + aMotionA.z * time;\n"
+
+		// shapes out of the view collapse to a point outside the clip volume
+		"   float radius = length(extent) + 2.0 * camera.viewport.z;\n"
+		"   if (any(lessThan(center + radius, camera.visible.xy)) || any(greaterThan(center - radius, camera.visible.zw))) {\n"
+		"       gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+		"       return;\n"
+		"   }\n"
+
+		// grow the quad so the smoothed edge is not clipped
+		"   localPos = aCorner * (extent + vec2(2.0 * camera.viewport.z));\n"
+
+		"   float c = cos(rotation), s = sin(rotation);\n"
+		"   vec2 world = center + vec2(c * localPos.x - s * localPos.y, s * localPos.x + c * localPos.y);\n"
+		"   gl_Position = camera.view * vec4(world, 0.0, 1.0);\n"
+
+		"   shapeParams = vec3(type, aShape.z, aShape.w);\n"
+		"   shapeSize = size;\n"
+		"   shapeColor = aColor;\n"
+		"   shapeId = uint(gl_InstanceID);\n"
+		"}\0";
+
+	// per instance data, as read by the vertex shader
+	struct MotionInstance {
+		float centerSize[4];
+		float shape[4];
+		float color[4];
+		float motionA[4];
+		float motionB[4];
+		float motionC[2];
+	};
+
+	Motion::Motion() {
+		drift = glm::vec2(0.0f);
+		spin = 0.0f;
+		orbitRadius = 0.0f;
+		orbitSpeed = 0.0f;
+		orbitPhase = 0.0f;
+		oscillation = glm::vec2(0.0f);
+		oscillationFrequency = 0.0f;
+		oscillationPhase = 0.0f;
+	}
+
+	Motion Motion::spinning(float speed) {
+		Motion motion;
+		motion.spin = speed;
+		return motion;
+	}
+
+	Motion Motion::orbiting(float radius, float speed, float phase) {
+		Motion motion;
+		motion.orbitRadius = radius;
+		motion.orbitSpeed = speed;
+		motion.orbitPhase = phase;
+		return motion;
+	}
+
+	Motion Motion::oscillating(glm::vec2 amplitude, float frequency, float phase) {
+		Motion motion;
+		motion.oscillation = amplitude;
+		motion.oscillationFrequency = frequency;
+		motion.oscillationPhase = phase;
+		return motion;
+	}
+
+	Motion Motion::drifting(glm::vec2 velocity) {
+		Motion motion;
+		motion.drift = velocity;
+		return motion;
+	}
+
+	static const double twoPi = 6.283185307179586;
+
+	Motion Motion::advanced(SdfShape &shape, double t0) const {
+		Motion motion = *this;
+		shape.center.x = (float)(shape.center.x + drift.x * t0);
+		shape.center.y = (float)(shape.center.y + drift.y * t0);
+		shape.rotation = (float)std::fmod(shape.rotation + spin * t0, twoPi);
+		motion.orbitPhase = (float)std::fmod(orbitPhase + orbitSpeed * t0, twoPi);
+		motion.oscillationPhase = (float)std::fmod(oscillationPhase + twoPi * oscillationFrequency * t0, twoPi);
+		return motion;
+	}
+
+	SdfShape Motion::apply(const SdfShape &shape, double t) const {
+		SdfShape moved = shape;
+		Motion motion = advanced(moved, t);
+		moved.center += orbitRadius * glm::vec2(std::cos(motion.orbitPhase), std::sin(motion.orbitPhase))
+			+ oscillation * std::sin(motion.oscillationPhase);
+		return moved;
+	}
+
+	AnimatedShapeRenderer::AnimatedShapeRenderer() {
+		_dirty = false;
+		_epoch = 0.0;
+		_program = 0;
+		_timeLocation = -1;
+		_VAO = 0;
+		_quadVBO = 0;
+		_instanceVBO = 0;
+	}
+
+	void AnimatedShapeRenderer::create() {
+		std::string fragment = std::string("#version 330 core\n") + sdfDistanceShaderSource + sdfFragmentShaderSource;
+		_program = createShaderProgram(motionVertexShaderSource, fragment.c_str());
+		_timeLocation = glGetUniformLocation(_program, "time");
+		Camera::bindBlock(_program);
+
+		// the quad is shared by every shape, drawn as a triangle strip
+		float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+		glGenVertexArrays(1, &_VAO);
+		glBindVertexArray(_VAO);
+
+		glGenBuffers(1, &_quadVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+		glEnableVertexAttribArray(0);
+
+		// the instance attributes advance once per shape
+		glGenBuffers(1, &_instanceVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+		for (int i = 0; i < 6; i++) {
+			glVertexAttribPointer(1 + i, i < 5 ? 4 : 2, GL_FLOAT, GL_FALSE, sizeof(MotionInstance), (void *)(i * 4 * sizeof(float)));
+			glVertexAttribDivisor(1 + i, 1);
+			glEnableVertexAttribArray(1 + i);
+		}
+
+		glBindVertexArray(0);
+		_dirty = true;
+	}
+
+	void AnimatedShapeRenderer::destroy() {
+		if (!_program)
+			return;
+		glDeleteProgram(_program);
+		glDeleteVertexArrays(1, &_VAO);
+		glDeleteBuffers(1, &_quadVBO);
+		glDeleteBuffers(1, &_instanceVBO);
+		_program = 0;
+	}
+
+	void AnimatedShapeRenderer::clear() {
+		_shapes.clear();
+		_motions.clear();
+		_dirty = true;
+	}
+
+	int AnimatedShapeRenderer::add(const SdfShape &shape, const Motion &motion) {
+		_shapes.push_back(shape);
+		_motions.push_back(motion);
+		_dirty = true;
+		return (int)_shapes.size() - 1;
+	}
+
+	const double AnimatedShapeRenderer::rebaseInterval = 60.0;
+
+	// the whole buffer is rebuilt: it only changes when shapes are added and
+	// when the epoch moves, with the poses and phases at the epoch
+	void AnimatedShapeRenderer::upload() {
+		std::vector<MotionInstance> instances(_shapes.size());
+		for (size_t i = 0; i < _shapes.size(); i++) {
+			SdfShape shape = _shapes[i];
+			Motion motion = _motions[i].advanced(shape, _epoch);
+			MotionInstance &instance = instances[i];
+			instance.centerSize[0] = shape.center.x;
+			instance.centerSize[1] = shape.center.y;
+			instance.centerSize[2] = shape.size.x;
+			instance.centerSize[3] = shape.size.y;
+			instance.shape[0] = shape.rotation;
+			instance.shape[1] = (float)shape.type;
+			instance.shape[2] = shape.param;
+			instance.shape[3] = shape.param2;
+			for (int j = 0; j < 4; j++)
+				instance.color[j] = shape.color[j];
+			instance.motionA[0] = motion.drift.x;
+			instance.motionA[1] = motion.drift.y;
+			instance.motionA[2] = motion.spin;
+			instance.motionA[3] = motion.orbitRadius;
+			instance.motionB[0] = motion.orbitSpeed;
+			instance.motionB[1] = motion.orbitPhase;
+			instance.motionB[2] = motion.oscillation.x;
+			instance.motionB[3] = motion.oscillation.y;
+			instance.motionC[0] = motion.oscillationFrequency;
+			instance.motionC[1] = motion.oscillationPhase;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(MotionInstance), instances.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		_dirty = false;
+	}
+
+	void AnimatedShapeRenderer::draw(const Camera &camera, double t) {
+		if (_shapes.empty())
+			return;
+		if (t < _epoch || t - _epoch > rebaseInterval) {
+			_epoch = t;
+			_dirty = true;
+		}
+		if (_dirty)
+			upload();
+
+		glUseProgram(_program);
+		camera.bind();
+		glUniform1f(_timeLocation, (float)(t - _epoch));
+
+		// coverage is written to alpha
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		glBindVertexArray(_VAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)_shapes.size());
+
+		if (!blend)
+			glDisable(GL_BLEND);
+	}
+}
@@ -0,0 +1,435 @@
+#include <cg_particles.hpp>
+#include <cg_shader.hpp>
+#include <algorithm>
+#include <string>
+
+namespace cgicmc {
+
+	// a particle is two vec4: position.xy and velocity.zw, then age and
+	// lifetime (the same layout in std430 and in the vertex attributes)
+	static const int PARTICLE_SIZE = 8 * sizeof(float);
+
+	// emission and integration, shared by the compute shader and the
+	// transform feedback vertex shader
+	static const char *particleCommonSource =
+		"uniform vec2 emitterPosition;\n"
+		"uniform vec2 emitterDirection;\n" // direction, spread
+		"uniform vec2 speedRange;\n"
+		"uniform vec2 lifetimeRange;\n"
+		"uniform vec2 gravity;\n"
+		"uniform float dt;\n"
+		"uniform uint frameSeed;\n"
+
+		// integer hash (low bias, see Chris Wellons' hash prospector)
+		"uint hash(uint x) {\n"
+		"   x ^= x >> 16; x *= 0x7feb352du;\n"
+		"   x ^= x >> 15; x *= 0x846ca68bu;\n"
+		"   x ^= x >> 16;\n"
+		"   return x;\n"
+		"}\n"
+
+		"float random(inout uint state) {\n"
+		"   state = hash(state);\n"
+		"   return float(state >> 8) / 16777216.0;\n"
+		"}\n"
+
+		// the births are spread over the frame so a frame's particles do
+		// not leave the emitter as a single blob
+		"void spawn(uint index, out vec4 positionVelocity, out vec4 state) {\n"
+		"   uint seed = hash(index ^ hash(frameSeed));\n"
+		"   float angle = emitterDirection.x + (random(seed) - 0.5) * emitterDirection.y;\n"
+		"   vec2 velocity = mix(speedRange.x, speedRange.y, random(seed)) * vec2(cos(angle), sin(angle));\n"
+		"   float age = random(seed) * dt;\n"
+		"   positionVelocity = vec4(emitterPosition + velocity * age, velocity);\n"
+		"   state = vec4(age, mix(lifetimeRange.x, lifetimeRange.y, random(seed)), 0.0, 0.0);\n"
+		"}\n"
+
+		// semi-implicit Euler
+		"void integrate(inout vec4 positionVelocity, inout vec4 state) {\n"
+		"   positionVelocity.zw += gravity * dt;\n"
+		"   positionVelocity.xy += positionVelocity.zw * dt;\n"
+		"   state.x += dt;\n"
+		"}\n";
+
+	static const char *controlBlockSource =
+		"layout (std430, binding = 2) buffer Control {\n"
+		"   uvec4 dispatch;\n" // group counts, live particles of the source
+		"   uvec4 draw;\n"     // vertex count, instances, first, base instance
+		"};\n"
+		"uniform uint spawnCount;\n"
+		"uniform uint capacity;\n";
+
+	// turns the count written by the last update into the next dispatch
+	static const char *prepareShaderSource =
+		"layout (local_size_x = 1) in;\n"
+
+		"void main() {\n"
+		"   uint live = draw.x;\n"
+		"   uint total = min(live + spawnCount, capacity);\n"
+		"   dispatch = uvec4((total + 255u) / 256u, 1u, 1u, live);\n"
+		"   draw = uvec4(0u, 1u, 0u, 0u);\n"
+		"}\n";
+
+	// one thread per live particle, then one per new particle; survivors
+	// are appended to the destination
+	static const char *computeShaderSource =
+		"layout (local_size_x = 256) in;\n"
+		"struct Particle { vec4 positionVelocity; vec4 state; };\n"
+		"layout (std430, binding = 0) readonly buffer Source { Particle source[]; };\n"
+		"layout (std430, binding = 1) writeonly buffer Destination { Particle destination[]; };\n"
+
+		"void main() {\n"
+		"   uint index = gl_GlobalInvocationID.x;\n"
+		"   uint live = dispatch.w;\n"
+		"   vec4 positionVelocity, state;\n"
+		"   if (index < live) {\n"
+		"       positionVelocity = source[index].positionVelocity;\n"
+		"       state = source[index].state;\n"
+		"       integrate(positionVelocity, state);\n"
+		"   } else if (index < min(live + spawnCount, capacity)) {\n"
+		"       spawn(index - live, positionVelocity, state);\n"
+		"   } else {\n"
+		"       return;\n"
+		"   }\n"
+		"   if (state.x >= state.y)\n"
+		"       return;\n"
+		"   uint slot = atomicAdd(draw.x, 1u);\n"
+		"   destination[slot].positionVelocity = positionVelocity;\n"
+		"   destination[slot].state = state;\n"
+		"}\n";
+
+	// one vertex per slot of the ring window, captured by transform feedback
+	static const char *feedbackShaderSource =
+		"layout (location = 0) in vec4 aPositionVelocity;\n"
+		"layout (location = 1) in vec4 aState;\n"
+		"uniform uint spawnFirst;\n"
+		"uniform uint spawnCount;\n"
+		"uniform uint capacity;\n"
+		"out vec4 positionVelocity;\n"
+		"out vec4 state;\n"
+
+		"void main() {\n"
+		"   uint slot = uint(gl_VertexID);\n"
+		"   if ((slot + capacity - spawnFirst) % capacity < spawnCount) {\n"
+		"       spawn(slot, positionVelocity, state);\n"
+		"   } else {\n"
+		"       positionVelocity = aPositionVelocity;\n"
+		"       state = aState;\n"
+		"       if (state.x < state.y)\n"
+		"           integrate(positionVelocity, state);\n"
+		"   }\n"
+		"}\n";
+
+	static const char *particleVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec4 aPositionVelocity;\n"
+		"layout (location = 1) in vec4 aState;\n"
+
+		CAMERA_BLOCK_GLSL
+
+		"uniform vec4 startColor;\n"
+		"uniform vec4 endColor;\n"
+		"uniform float pointSize;\n"
+		"out vec4 color;\n"
+
+		"void main() {\n"
+		"   float t = aState.x / aState.y;\n"
+		// dead particles (ring window) are moved out of the clip volume
+		"   if (!(t < 1.0)) {\n"
+		"       gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+		"       gl_PointSize = 1.0;\n"
+		"       color = vec4(0.0);\n"
+		"       return;\n"
+		"   }\n"
+		"   gl_Position = camera.view * vec4(aPositionVelocity.xy, 0.0, 1.0);\n"
+		"   gl_PointSize = pointSize;\n"
+		"   color = mix(startColor, endColor, t);\n"
+		"   color.a *= 1.0 - t;\n"
+		"}\0";
+
+	// round sprite with a soft edge
+	static const char *particleFragmentShaderSource =
+		"#version 330 core\n"
+		"in vec4 color;\n"
+		"out vec4 FragColor;\n"
+
+		"void main() {\n"
+		"   float d = length(gl_PointCoord * 2.0 - 1.0);\n"
+		"   FragColor = vec4(color.rgb, color.a * (1.0 - smoothstep(0.5, 1.0, d)));\n"
+		"}\0";
+
+	const char *particleBackendName(ParticleBackend backend) {
+		switch (backend) {
+		case ParticleBackend::Compute: return "compute shader";
+		case ParticleBackend::TransformFeedback: return "transform feedback";
+		}
+		return "?";
+	}
+
+	ParticleEmitter::ParticleEmitter() {
+		position = glm::vec2(0.0f);
+		direction = 1.5707963f;
+		spread = 0.5f;
+		minSpeed = 0.5f;
+		maxSpeed = 1.0f;
+		minLifetime = 1.0f;
+		maxLifetime = 3.0f;
+		rate = 100000.0f;
+		startColor = glm::vec4(1.0f, 0.9f, 0.4f, 1.0f);
+		endColor = glm::vec4(1.0f, 0.2f, 0.0f, 1.0f);
+		pointSize = 2.0f;
+	}
+
+	ParticleSystem::ParticleSystem() {
+		_backend = ParticleBackend::TransformFeedback;
+		_gravity = glm::vec2(0.0f, -0.5f);
+		_capacity = 0;
+		for (int i = 0; i < 2; i++) {
+			_buffers[i] = 0;
+			_VAOs[i] = 0;
+		}
+		_current = 0;
+		_controlBuffer = 0;
+		_prepareProgram = 0;
+		_computeProgram = 0;
+		_feedbackProgram = 0;
+		_head = 0;
+		_drawProgram = 0;
+		_startColorLocation = -1;
+		_endColorLocation = -1;
+		_pointSizeLocation = -1;
+		_time = 0.0;
+		_pendingSpawn = 0.0;
+		_frame = 0;
+	}
+
+	void ParticleSystem::create(int capacity) {
+		_capacity = std::max(capacity, 1);
+
+		_drawProgram = createShaderProgram(particleVertexShaderSource, particleFragmentShaderSource);
+		Camera::bindBlock(_drawProgram);
+		_startColorLocation = glGetUniformLocation(_drawProgram, "startColor");
+		_endColorLocation = glGetUniformLocation(_drawProgram, "endColor");
+		_pointSizeLocation = glGetUniformLocation(_drawProgram, "pointSize");
+
+		std::string feedback = std::string("#version 330 core\n") + particleCommonSource + feedbackShaderSource;
+		const char *varyings[] = { "positionVelocity", "state" };
+		_feedbackProgram = createTransformFeedbackProgram(feedback.c_str(), varyings, 2);
+
+		if (GLAD_GL_VERSION_4_3) {
+			std::string header = std::string("#version 430 core\n") + controlBlockSource;
+			_prepareProgram = createComputeProgram((header + prepareShaderSource).c_str());
+			_computeProgram = createComputeProgram((header + particleCommonSource + computeShaderSource).c_str());
+			_backend = ParticleBackend::Compute;
+		} else {
+			_backend = ParticleBackend::TransformFeedback;
+		}
+
+		createBuffers();
+		_timer.create();
+		reset();
+	}
+
+	void ParticleSystem::createBuffers() {
+		glGenBuffers(2, _buffers);
+		glGenVertexArrays(2, _VAOs);
+		for (int i = 0; i < 2; i++) {
+			glBindVertexArray(_VAOs[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, _buffers[i]);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)_capacity * PARTICLE_SIZE, NULL, GL_DYNAMIC_COPY);
+			for (int j = 0; j < 2; j++) {
+				glVertexAttribPointer(j, 4, GL_FLOAT, GL_FALSE, PARTICLE_SIZE, (void *)(j * 4 * sizeof(float)));
+				glEnableVertexAttribArray(j);
+			}
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (GLAD_GL_VERSION_4_3) {
+			glGenBuffers(1, &_controlBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _controlBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, 8 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+	}
+
+	void ParticleSystem::destroy() {
+		if (!_capacity)
+			return;
+		glDeleteBuffers(2, _buffers);
+		glDeleteVertexArrays(2, _VAOs);
+		glDeleteProgram(_feedbackProgram);
+		glDeleteProgram(_drawProgram);
+		if (_controlBuffer) {
+			glDeleteBuffers(1, &_controlBuffer);
+			glDeleteProgram(_prepareProgram);
+			glDeleteProgram(_computeProgram);
+			_controlBuffer = 0;
+		}
+		_timer.destroy();
+		_capacity = 0;
+	}
+
+	void ParticleSystem::setBackend(ParticleBackend backend) {
+		if (backend == ParticleBackend::Compute && !_controlBuffer)
+			return;
+		_backend = backend;
+		reset();
+	}
+
+	void ParticleSystem::reset() {
+		_current = 0;
+		_head = 0;
+		_spawned.clear();
+		_pendingSpawn = 0.0;
+
+		// no live particle, nothing to draw
+		if (_controlBuffer) {
+			GLuint control[8] = { 0, 1, 1, 0, 0, 1, 0, 0 };
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _controlBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(control), control);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+	}
+
+	int ParticleSystem::recentCount() const {
+		int count = 0;
+		for (size_t i = 0; i < _spawned.size(); i++)
+			count += _spawned[i].second;
+		return std::min(count, _capacity);
+	}
+
+	void ParticleSystem::update(float dt) {
+		if (!_capacity)
+			return;
+
+		// whole particles only, the fraction is carried to the next frame
+		_pendingSpawn += (double)_emitter.rate * dt;
+		int spawnCount = (int)std::min(_pendingSpawn, (double)_capacity);
+		_pendingSpawn -= spawnCount;
+
+		// forget the frames whose particles are all dead
+		_time += dt;
+		_frame++;
+		_spawned.push_back(std::make_pair(_time, spawnCount));
+		while (!_spawned.empty() && _spawned.front().first + _emitter.maxLifetime < _time)
+			_spawned.pop_front();
+
+		_timer.begin();
+		if (_backend == ParticleBackend::Compute)
+			updateCompute(dt, spawnCount);
+		else
+			updateTransformFeedback(dt, spawnCount);
+		_timer.end();
+		_current = 1 - _current;
+	}
+
+	void ParticleSystem::setUpdateUniforms(GLuint program, float dt, int spawnCount) {
+		glUniform2f(glGetUniformLocation(program, "emitterPosition"), _emitter.position.x, _emitter.position.y);
+		glUniform2f(glGetUniformLocation(program, "emitterDirection"), _emitter.direction, _emitter.spread);
+		glUniform2f(glGetUniformLocation(program, "speedRange"), _emitter.minSpeed, _emitter.maxSpeed);
+		glUniform2f(glGetUniformLocation(program, "lifetimeRange"), _emitter.minLifetime, _emitter.maxLifetime);
+		glUniform2f(glGetUniformLocation(program, "gravity"), _gravity.x, _gravity.y);
+		glUniform1f(glGetUniformLocation(program, "dt"), dt);
+		glUniform1ui(glGetUniformLocation(program, "frameSeed"), _frame);
+		glUniform1ui(glGetUniformLocation(program, "spawnCount"), (GLuint)spawnCount);
+		glUniform1ui(glGetUniformLocation(program, "capacity"), (GLuint)_capacity);
+	}
+
+	void ParticleSystem::updateCompute(float dt, int spawnCount) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _controlBuffer);
+
+		// the group count follows the live count, without reading it back
+		glUseProgram(_prepareProgram);
+		glUniform1ui(glGetUniformLocation(_prepareProgram, "spawnCount"), (GLuint)spawnCount);
+		glUniform1ui(glGetUniformLocation(_prepareProgram, "capacity"), (GLuint)_capacity);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		glUseProgram(_computeProgram);
+		setUpdateUniforms(_computeProgram, dt, spawnCount);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _buffers[_current]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _buffers[1 - _current]);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, _controlBuffer);
+		glDispatchComputeIndirect(0);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+		// the particles are drawn as vertices, the count as a command
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	int ParticleSystem::ringRanges(int firsts[2], int counts[2]) const {
+		int count = recentCount();
+		int first = ((_head - count) % _capacity + _capacity) % _capacity;
+		if (count == 0)
+			return 0;
+		if (first + count <= _capacity) {
+			firsts[0] = first;
+			counts[0] = count;
+			return 1;
+		}
+		firsts[0] = first;
+		counts[0] = _capacity - first;
+		firsts[1] = 0;
+		counts[1] = count - counts[0];
+		return 2;
+	}
+
+	void ParticleSystem::updateTransformFeedback(float dt, int spawnCount) {
+		int spawnFirst = _head;
+		_head = (_head + spawnCount) % _capacity;
+
+		glUseProgram(_feedbackProgram);
+		setUpdateUniforms(_feedbackProgram, dt, spawnCount);
+		glUniform1ui(glGetUniformLocation(_feedbackProgram, "spawnFirst"), (GLuint)spawnFirst);
+
+		// each slot is written at the same place in the other buffer
+		int firsts[2], counts[2];
+		int ranges = ringRanges(firsts, counts);
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindVertexArray(_VAOs[_current]);
+		for (int i = 0; i < ranges; i++) {
+			glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, _buffers[1 - _current],
+				(GLintptr)firsts[i] * PARTICLE_SIZE, (GLsizeiptr)counts[i] * PARTICLE_SIZE);
+			glBeginTransformFeedback(GL_POINTS);
+			glDrawArrays(GL_POINTS, firsts[i], counts[i]);
+			glEndTransformFeedback();
+		}
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+	}
+
+	void ParticleSystem::draw(const Camera &camera) {
+		if (!_capacity)
+			return;
+
+		glUseProgram(_drawProgram);
+		camera.bind();
+		glUniform4fv(_startColorLocation, 1, &_emitter.startColor.x);
+		glUniform4fv(_endColorLocation, 1, &_emitter.endColor.x);
+		glUniform1f(_pointSizeLocation, _emitter.pointSize);
+
+		// additive, the alpha of the target is kept
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+
+		glBindVertexArray(_VAOs[_current]);
+		if (_backend == ParticleBackend::Compute) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _controlBuffer);
+			glDrawArraysIndirect(GL_POINTS, (void *)(4 * sizeof(GLuint)));
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		} else {
+			int firsts[2], counts[2];
+			int ranges = ringRanges(firsts, counts);
+			for (int i = 0; i < ranges; i++)
+				glDrawArrays(GL_POINTS, firsts[i], counts[i]);
+		}
+
+		glDisable(GL_PROGRAM_POINT_SIZE);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		if (!blend)
+			glDisable(GL_BLEND);
+	}
+}
@@ -0,0 +1,470 @@
+#include <cg_path.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CG_PATH_SSE 1
+#endif
+
+namespace cgicmc {
+
+	// 5 point Gauss-Legendre quadrature on [0, 1]
+	static const float GAUSS_NODES[5] = { 0.0469101f, 0.2307653f, 0.5f, 0.7692347f, 0.9530899f };
+	static const float GAUSS_WEIGHTS[5] = { 0.1184634f, 0.2393143f, 0.2844444f, 0.2393143f, 0.1184634f };
+
+	// subintervals of a segment integrated when building the table
+	static const int LENGTH_STEPS = 16;
+
+	SplinePath::SplinePath() {
+		_length = 0.0f;
+	}
+
+	SplinePath SplinePath::catmullRom(const std::vector<glm::vec2> &points, bool closed) {
+		// repeated points would give segments without length
+		std::vector<glm::vec2> p;
+		for (size_t i = 0; i < points.size(); i++)
+			if (p.empty() || glm::length(points[i] - p.back()) > 1e-6f)
+				p.push_back(points[i]);
+		if (closed && p.size() > 2 && glm::length(p.back() - p.front()) <= 1e-6f)
+			p.pop_back();
+
+		SplinePath path;
+		int n = (int)p.size();
+		if (n < 2) {
+			glm::vec2 point = n ? p[0] : glm::vec2(0.0f);
+			path.addSegment(point, glm::vec2(0.0f), glm::vec2(0.0f), glm::vec2(0.0f));
+			path.buildTable();
+			return path;
+		}
+
+		int segments = closed ? n : n - 1;
+		for (int i = 0; i < segments; i++) {
+			glm::vec2 p1 = p[i], p2 = p[(i + 1) % n];
+			// an open path is extended by mirroring its end points
+			glm::vec2 p0 = closed ? p[(i + n - 1) % n] : (i > 0 ? p[i - 1] : 2.0f * p1 - p2);
+			glm::vec2 p3 = closed ? p[(i + 2) % n] : (i + 2 < n ? p[i + 2] : 2.0f * p2 - p1);
+
+			// centripetal knots (the square root of the distances), turned
+			// into the tangents of a Hermite curve over the segment
+			float t01 = std::max(std::sqrt(glm::length(p1 - p0)), 1e-4f);
+			float t12 = std::max(std::sqrt(glm::length(p2 - p1)), 1e-4f);
+			float t23 = std::max(std::sqrt(glm::length(p3 - p2)), 1e-4f);
+			glm::vec2 m1 = p2 - p1 + t12 * ((p1 - p0) / t01 - (p2 - p0) / (t01 + t12));
+			glm::vec2 m2 = p2 - p1 + t12 * ((p3 - p2) / t23 - (p3 - p1) / (t12 + t23));
+			path.addHermite(p1, p2, m1, m2);
+		}
+		path.buildTable();
+		return path;
+	}
+
+	SplinePath SplinePath::bezier(const std::vector<glm::vec2> &points) {
+		SplinePath path;
+		for (size_t i = 0; i + 3 < points.size(); i += 3) {
+			glm::vec2 p0 = points[i], c0 = points[i + 1], c1 = points[i + 2], p1 = points[i + 3];
+			path.addSegment(p0, 3.0f * (c0 - p0), 3.0f * (p0 - 2.0f * c0 + c1), p1 - p0 + 3.0f * (c0 - c1));
+		}
+		if (path._coefficients.empty()) {
+			glm::vec2 point = points.empty() ? glm::vec2(0.0f) : points[0];
+			path.addSegment(point, glm::vec2(0.0f), glm::vec2(0.0f), glm::vec2(0.0f));
+		}
+		path.buildTable();
+		return path;
+	}
+
+	void SplinePath::addSegment(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d) {
+		float coefficients[8] = { a.x, b.x, c.x, d.x, a.y, b.y, c.y, d.y };
+		_coefficients.insert(_coefficients.end(), coefficients, coefficients + 8);
+	}
+
+	void SplinePath::addHermite(glm::vec2 p0, glm::vec2 p1, glm::vec2 m0, glm::vec2 m1) {
+		addSegment(p0, m0, 3.0f * (p1 - p0) - 2.0f * m0 - m1, 2.0f * (p0 - p1) + m0 + m1);
+	}
+
+	glm::vec2 SplinePath::evaluate(float parameter, glm::vec2 *derivative) const {
+		int segments = segmentCount();
+		int segment = std::min(std::max((int)parameter, 0), segments - 1);
+		float u = parameter - (float)segment;
+		const float *x = &_coefficients[segment * 8], *y = x + 4;
+		if (derivative)
+			*derivative = glm::vec2((3.0f * x[3] * u + 2.0f * x[2]) * u + x[1], (3.0f * y[3] * u + 2.0f * y[2]) * u + y[1]);
+		return glm::vec2(((x[3] * u + x[2]) * u + x[1]) * u + x[0], ((y[3] * u + y[2]) * u + y[1]) * u + y[0]);
+	}
+
+	float SplinePath::integrateLength(float begin, float end) const {
+		float length = 0.0f;
+		for (int k = 0; k < 5; k++) {
+			glm::vec2 derivative;
+			evaluate(begin + (end - begin) * GAUSS_NODES[k], &derivative);
+			length += GAUSS_WEIGHTS[k] * glm::length(derivative);
+		}
+		return length * (end - begin);
+	}
+
+	// per segment: the cumulated length at LENGTH_STEPS parameters, then the
+	// parameter at evenly spaced lengths, interpolated in those steps and
+	// refined with Newton's method (the speed is the derivative of the
+	// length). Between two of them the parameter follows the cubic Hermite
+	// curve with their slopes, the inverse of the speed, limited to 3 times
+	// the secant so it never goes back (the parameter only grows along the
+	// path, even where the speed falls to 0). The speed jumps where segments
+	// meet, so the tables stop there too.
+	void SplinePath::buildTable() {
+		const int S = SAMPLES_PER_SEGMENT;
+		int segments = segmentCount();
+		_segmentStart.assign(segments + 1, 0.0f);
+		_segmentScale.assign(segments, 0.0f);
+		_table.assign(segments * S * 4, 0.0f);
+
+		for (int segment = 0; segment < segments; segment++) {
+			float cumulated[LENGTH_STEPS + 1];
+			cumulated[0] = 0.0f;
+			for (int i = 0; i < LENGTH_STEPS; i++) {
+				float begin = segment + (float)i / LENGTH_STEPS, end = segment + (float)(i + 1) / LENGTH_STEPS;
+				cumulated[i + 1] = cumulated[i] + integrateLength(begin, end);
+			}
+			float length = cumulated[LENGTH_STEPS];
+			_segmentStart[segment + 1] = _segmentStart[segment] + length;
+			_segmentScale[segment] = length > 0.0f ? (float)S / length : 0.0f;
+
+			float parameters[S + 1], slopes[S + 1];
+			parameters[0] = 0.0f;
+			parameters[S] = 1.0f;
+			int step = 0;
+			for (int j = 1; j < S; j++) {
+				float distance = length * j / S;
+				while (step < LENGTH_STEPS - 1 && cumulated[step + 1] < distance)
+					step++;
+				float begin = (float)step / LENGTH_STEPS, end = (float)(step + 1) / LENGTH_STEPS;
+				float span = cumulated[step + 1] - cumulated[step];
+				float parameter = begin + (span > 0.0f ? (distance - cumulated[step]) / span : 0.0f) * (end - begin);
+				for (int iteration = 0; iteration < 2; iteration++) {
+					glm::vec2 derivative;
+					evaluate(segment + parameter, &derivative);
+					float speed = glm::length(derivative);
+					if (speed <= 1e-6f)
+						break;
+					float error = cumulated[step] + integrateLength(segment + begin, segment + parameter) - distance;
+					parameter = std::min(std::max(parameter - error / speed, begin), end);
+				}
+				parameters[j] = parameter;
+			}
+			for (int j = 0; j <= S; j++) {
+				// evaluated inside the segment at its end
+				glm::vec2 derivative;
+				evaluate(segment + std::min(parameters[j], 0.99999f), &derivative);
+				float speed = glm::length(derivative) * _segmentScale[segment];
+				slopes[j] = speed > 0.0f ? 1.0f / speed : FLT_MAX;
+			}
+
+			for (int j = 0; j < S; j++) {
+				float secant = parameters[j + 1] - parameters[j];
+				float m0 = std::min(slopes[j], 3.0f * secant), m1 = std::min(slopes[j + 1], 3.0f * secant);
+				float *cubic = &_table[(segment * S + j) * 4];
+				cubic[0] = parameters[j];
+				cubic[1] = m0;
+				cubic[2] = 3.0f * secant - 2.0f * m0 - m1;
+				cubic[3] = m0 + m1 - 2.0f * secant;
+			}
+		}
+		_length = _segmentStart[segments];
+	}
+
+	float SplinePath::parameter(float distance) const {
+		int segments = segmentCount();
+		distance = std::min(std::max(distance, 0.0f), _length);
+		int segment = (int)(std::upper_bound(_segmentStart.begin() + 1, _segmentStart.end() - 1, distance) - _segmentStart.begin()) - 1;
+		float f = (distance - _segmentStart[segment]) * _segmentScale[segment];
+		int k = std::min((int)f, SAMPLES_PER_SEGMENT - 1);
+		const float *cubic = &_table[(segment * SAMPLES_PER_SEGMENT + k) * 4];
+		f -= (float)k;
+		float u = ((cubic[3] * f + cubic[2]) * f + cubic[1]) * f + cubic[0];
+		return std::min((float)segment + std::min(std::max(u, 0.0f), 1.0f), (float)segments);
+	}
+
+	glm::vec2 SplinePath::position(float distance) const {
+		return evaluate(parameter(distance), NULL);
+	}
+
+	glm::vec2 SplinePath::tangent(float distance) const {
+		glm::vec2 derivative;
+		evaluate(parameter(distance), &derivative);
+		float length = glm::length(derivative);
+		return length > 0.0f ? derivative / length : glm::vec2(1.0f, 0.0f);
+	}
+
+	PathFollowers::PathFollowers() {
+		_vectorized = true;
+		_updateMicroseconds = 0.0;
+	}
+
+	int PathFollowers::addPath(const SplinePath &path) {
+		PooledPath pooled;
+		pooled.firstSegment = (int)_coefficients.size() / 8;
+		pooled.segmentCount = path.segmentCount();
+		pooled.length = path._length;
+		_coefficients.insert(_coefficients.end(), path._coefficients.begin(), path._coefficients.end());
+		_segmentStart.insert(_segmentStart.end(), path._segmentStart.begin(), path._segmentStart.end() - 1);
+		_segmentEnd.insert(_segmentEnd.end(), path._segmentStart.begin() + 1, path._segmentStart.end());
+		_segmentScale.insert(_segmentScale.end(), path._segmentScale.begin(), path._segmentScale.end());
+		_table.insert(_table.end(), path._table.begin(), path._table.end());
+		_paths.push_back(pooled);
+		return (int)_paths.size() - 1;
+	}
+
+	void PathFollowers::clearFollowers() {
+		_path.clear();
+		_segment.clear();
+		_end.clear();
+		_distance.clear();
+		_speed.clear();
+		_u.clear();
+		_x.clear();
+		_y.clear();
+		_tangentX.clear();
+		_tangentY.clear();
+	}
+
+	int PathFollowers::add(int path, float distance, float speed, PathEnd end) {
+		_path.push_back(path);
+		_segment.push_back(_paths[path].firstSegment);
+		_end.push_back(end);
+		_distance.push_back(distance);
+		_speed.push_back(speed);
+		_u.push_back(0.0f);
+		_x.push_back(0.0f);
+		_y.push_back(0.0f);
+		_tangentX.push_back(1.0f);
+		_tangentY.push_back(0.0f);
+
+		// place it without moving it
+		int follower = count() - 1;
+		locate(follower);
+		evaluateFollower(follower);
+		return follower;
+	}
+
+	void PathFollowers::update(float dt) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		advance(dt);
+		findParameters();
+		evaluate();
+		_updateMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// distances move by dt * speed: looping followers wrap around their
+	// path, bouncing ones turn back at its ends and the others stop there
+	void PathFollowers::advance(float dt) {
+		int n = count();
+		for (int i = 0; i < n; i++) {
+			float length = _paths[_path[i]].length;
+			if (length <= 0.0f) {
+				_distance[i] = 0.0f;
+				continue;
+			}
+			float distance = _distance[i] + dt * _speed[i];
+			switch (_end[i]) {
+			case PathEnd::Loop:
+				distance -= std::floor(distance / length) * length;
+				break;
+			case PathEnd::Bounce:
+				if (distance > length) {
+					distance = 2.0f * length - distance;
+					_speed[i] = -_speed[i];
+				} else if (distance < 0.0f) {
+					distance = -distance;
+					_speed[i] = -_speed[i];
+				}
+				break;
+			case PathEnd::Stop:
+				break;
+			}
+			_distance[i] = std::min(std::max(distance, 0.0f), length);
+		}
+	}
+
+	// the segments rarely change from a frame to the next: the one at the
+	// distance is searched from the last one, then the parameter in it is
+	// read from the cubic of its table interval
+	void PathFollowers::locate(int follower) {
+		const PooledPath &path = _paths[_path[follower]];
+		int segment = _segment[follower], last = path.firstSegment + path.segmentCount - 1;
+		float distance = _distance[follower];
+		while (segment > path.firstSegment && distance < _segmentStart[segment])
+			segment--;
+		while (segment < last && distance >= _segmentEnd[segment])
+			segment++;
+		float f = (distance - _segmentStart[segment]) * _segmentScale[segment];
+		int k = std::min(std::max((int)f, 0), SplinePath::SAMPLES_PER_SEGMENT - 1);
+		const float *cubic = &_table[(segment * SplinePath::SAMPLES_PER_SEGMENT + k) * 4];
+		f -= (float)k;
+		_segment[follower] = segment;
+		_u[follower] = std::min(std::max(((cubic[3] * f + cubic[2]) * f + cubic[1]) * f + cubic[0], 0.0f), 1.0f);
+	}
+
+	void PathFollowers::findParameters() {
+		int n = count();
+		for (int i = 0; i < n; i++)
+			locate(i);
+	}
+
+	void PathFollowers::evaluateFollower(int follower) {
+		const float *x = &_coefficients[_segment[follower] * 8], *y = x + 4;
+		float u = _u[follower];
+		_x[follower] = ((x[3] * u + x[2]) * u + x[1]) * u + x[0];
+		_y[follower] = ((y[3] * u + y[2]) * u + y[1]) * u + y[0];
+		float dx = (3.0f * x[3] * u + 2.0f * x[2]) * u + x[1];
+		float dy = (3.0f * y[3] * u + 2.0f * y[2]) * u + y[1];
+		float length = std::sqrt(std::max(dx * dx + dy * dy, 1e-12f));
+		_tangentX[follower] = dx / length;
+		_tangentY[follower] = dy / length;
+	}
+
+	void PathFollowers::evaluate() {
+		int n = count();
+		const float *coefficients = _coefficients.data();
+		int i = 0;
+#ifdef CG_PATH_SSE
+		if (_vectorized) {
+			__m128 two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f), tiny = _mm_set1_ps(1e-12f);
+			for (; i + 4 <= n; i += 4) {
+				const float *segments[4];
+				for (int j = 0; j < 4; j++)
+					segments[j] = coefficients + _segment[i + j] * 8;
+				__m128 u = _mm_loadu_ps(&_u[i]);
+
+				__m128 result[2], derivative[2];
+				for (int axis = 0; axis < 2; axis++) {
+					// the a, b, c, d of 4 followers, transposed into 4 registers
+					__m128 a = _mm_loadu_ps(segments[0] + axis * 4);
+					__m128 b = _mm_loadu_ps(segments[1] + axis * 4);
+					__m128 c = _mm_loadu_ps(segments[2] + axis * 4);
+					__m128 d = _mm_loadu_ps(segments[3] + axis * 4);
+					_MM_TRANSPOSE4_PS(a, b, c, d);
+					__m128 value = _mm_add_ps(_mm_mul_ps(d, u), c);
+					value = _mm_add_ps(_mm_mul_ps(value, u), b);
+					result[axis] = _mm_add_ps(_mm_mul_ps(value, u), a);
+					__m128 slope = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(three, d), u), _mm_mul_ps(two, c));
+					derivative[axis] = _mm_add_ps(_mm_mul_ps(slope, u), b);
+				}
+				__m128 length = _mm_sqrt_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(derivative[0], derivative[0]),
+					_mm_mul_ps(derivative[1], derivative[1])), tiny));
+				_mm_storeu_ps(&_x[i], result[0]);
+				_mm_storeu_ps(&_y[i], result[1]);
+				_mm_storeu_ps(&_tangentX[i], _mm_div_ps(derivative[0], length));
+				_mm_storeu_ps(&_tangentY[i], _mm_div_ps(derivative[1], length));
+			}
+		}
+#endif
+		for (; i < n; i++)
+			evaluateFollower(i);
+	}
+
+	void benchmarkPaths(std::ostream &out, int followerCount) {
+		const int PATHS = 256, FRAMES = 240;
+		const float DT = 1.0f / 60.0f;
+		std::mt19937 random(2042);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		// closed Catmull-Rom loops and open Bezier chains of a few segments
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<SplinePath> paths;
+		int intervals = 0;
+		for (int p = 0; p < PATHS; p++) {
+			std::vector<glm::vec2> points;
+			if (p % 2 == 0) {
+				int count = 5 + (int)(unit(random) * 8.0f);
+				for (int k = 0; k < count; k++) {
+					float angle = 6.2831853f * k / count, radius = 20.0f + 30.0f * unit(random);
+					points.push_back(glm::vec2(std::cos(angle), std::sin(angle)) * radius);
+				}
+				paths.push_back(SplinePath::catmullRom(points, true));
+			} else {
+				// the control points around a joint are aligned, as drawn in an
+				// editor, so the chain turns without corners
+				int segments = 2 + (int)(unit(random) * 6.0f);
+				points.push_back(glm::vec2(unit(random) * 100.0f - 50.0f, unit(random) * 100.0f - 50.0f));
+				glm::vec2 handle = glm::vec2(unit(random) - 0.5f, unit(random) - 0.5f) * 30.0f;
+				for (int k = 0; k < segments; k++) {
+					glm::vec2 end = glm::vec2(unit(random) * 100.0f - 50.0f, unit(random) * 100.0f - 50.0f);
+					glm::vec2 endHandle = glm::vec2(unit(random) - 0.5f, unit(random) - 0.5f) * 30.0f;
+					points.push_back(points.back() + handle);
+					points.push_back(end - endHandle);
+					points.push_back(end);
+					handle = endHandle;
+				}
+				paths.push_back(SplinePath::bezier(points));
+			}
+			intervals += paths.back().segmentCount() * SplinePath::SAMPLES_PER_SEGMENT;
+		}
+		double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		out << "Path benchmark: " << followerCount << " followers on " << PATHS << " paths (" << intervals
+			<< " table intervals, built in " << std::fixed << std::setprecision(2) << buildMilliseconds << " ms), "
+			<< FRAMES << " frames\n";
+
+		std::vector<float> results[2];
+		for (int pass = 0; pass < 2; pass++) {
+			PathFollowers followers;
+			followers.setVectorized(pass == 0);
+			for (int p = 0; p < PATHS; p++)
+				followers.addPath(paths[p]);
+
+			std::mt19937 followerRandom(2043);
+			std::vector<float> speeds(followerCount);
+			for (int i = 0; i < followerCount; i++) {
+				int path = i % PATHS;
+				speeds[i] = 5.0f + 20.0f * unit(followerRandom);
+				followers.add(path, unit(followerRandom) * followers.pathLength(path), speeds[i] * (i % 3 == 0 ? -1.0f : 1.0f),
+					path % 2 == 0 ? PathEnd::Loop : PathEnd::Bounce);
+			}
+
+			// the distance covered in a frame (the chord, a hair shorter than
+			// the arc) against the one asked for, away from the ends of the
+			// open paths where the followers turn back
+			double total = 0.0, errorSum = 0.0;
+			std::vector<float> errors;
+			std::vector<glm::vec2> previous(followerCount);
+			for (int frame = 0; frame < FRAMES; frame++) {
+				for (int i = 0; i < followerCount; i++)
+					previous[i] = followers.position(i);
+				followers.update(DT);
+				total += followers.updateMicroseconds();
+				for (int i = 0; i < followerCount; i++) {
+					float step = speeds[i] * DT, distance = followers.distance(i);
+					if ((i % PATHS) % 2 != 0 && (distance < step || distance > followers.pathLength(i % PATHS) - step))
+						continue;
+					float error = std::fabs(glm::length(followers.position(i) - previous[i]) - step) / step;
+					errors.push_back(error);
+					errorSum += error;
+				}
+			}
+			double microseconds = total / FRAMES;
+			// the worst ones are at the sharpest turns, where the chord is
+			// much shorter than the arc
+			if (errors.empty())
+				errors.push_back(0.0f);
+			size_t percentile = errors.size() * 99 / 100;
+			std::nth_element(errors.begin(), errors.begin() + percentile, errors.end());
+
+			for (int i = 0; i < followerCount; i++) {
+				results[pass].push_back(followers.position(i).x);
+				results[pass].push_back(followers.position(i).y);
+			}
+			out << "  " << (pass == 0 ? "SIMD  " : "scalar") << ": " << std::setw(8) << microseconds << " us per update, "
+				<< std::setw(6) << microseconds * 1000.0 / followerCount << " ns per follower | speed error: "
+				<< std::setprecision(3) << 100.0 * errorSum / std::max(errors.size(), (size_t)1) << "% on average, "
+				<< 100.0f * errors[percentile] << "% for 99% of the steps\n" << std::setprecision(2);
+		}
+
+		float difference = 0.0f;
+		for (size_t i = 0; i < results[0].size(); i++)
+			difference = std::max(difference, std::fabs(results[0][i] - results[1][i]));
+		out << "  largest difference between SIMD and scalar: " << std::scientific << std::setprecision(1) << difference
+			<< std::fixed << "\n";
+	}
+}
@@ -0,0 +1,521 @@
+#include <cg_physics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace cgicmc {
+
+	// penetration allowed without correction, the fraction of the rest
+	// corrected per pass, and the largest correction of a pass
+	static const float LINEAR_SLOP = 0.005f;
+	static const float BAUMGARTE = 0.2f;
+	static const float MAX_CORRECTION = 0.2f;
+
+	static float cross(glm::vec2 a, glm::vec2 b) {
+		return a.x * b.y - a.y * b.x;
+	}
+
+	// velocity of a point at r from the center of a body rotating at w
+	static glm::vec2 cross(float w, glm::vec2 r) {
+		return glm::vec2(-w * r.y, w * r.x);
+	}
+
+	// rotate counter-clockwise by the angle with the given cosine and sine
+	static glm::vec2 rotate(glm::vec2 v, float c, float s) {
+		return glm::vec2(c * v.x - s * v.y, s * v.x + c * v.y);
+	}
+
+	// area, first moment and second moment (about the origin) of a polygon,
+	// as a fan of triangles around the origin
+	static void accumulateMass(const glm::vec2 *vertices, int count, float &area, glm::vec2 &moment, float &inertia) {
+		for (int i = 0; i < count; i++) {
+			glm::vec2 e1 = vertices[i], e2 = vertices[(i + 1) % count];
+			float d = cross(e1, e2);
+			float triangleArea = 0.5f * d;
+			area += triangleArea;
+			moment += (e1 + e2) * (triangleArea / 3.0f);
+			float intx2 = e1.x * e1.x + e2.x * e1.x + e2.x * e2.x;
+			float inty2 = e1.y * e1.y + e2.y * e1.y + e2.y * e2.y;
+			inertia += (0.25f / 3.0f * d) * (intx2 + inty2);
+		}
+	}
+
+	PhysicsWorld::PhysicsWorld() {
+		_gravity = glm::vec2(0.0f, -10.0f);
+		_velocityIterations = 8;
+		_positionIterations = 3;
+		_collisions.setMargin(2.0f * LINEAR_SLOP);
+		_islandOffsets.push_back(0);
+		_collideMilliseconds = 0.0;
+		_solveMilliseconds = 0.0;
+	}
+
+	void PhysicsWorld::setThreadCount(int threadCount) {
+		_pool.setThreadCount(threadCount);
+		_collisions.setThreadCount(threadCount);
+	}
+
+	void PhysicsWorld::clear() {
+		_bodies.clear();
+		_collisions.clear();
+		_constraints.clear();
+		_cache.clear();
+		_islandConstraints.clear();
+		_islandOffsets.assign(1, 0);
+	}
+
+	int PhysicsWorld::addBody(float area, glm::vec2 center, float inertia, float density, glm::vec2 position, float angle) {
+		RigidBody body;
+		body.position = position;
+		body.angle = angle;
+		body.velocity = glm::vec2(0.0f, 0.0f);
+		body.angularVelocity = 0.0f;
+		body.friction = 0.6f;
+		body.inverseMass = 0.0f;
+		body.inverseInertia = 0.0f;
+		if (density > 0.0f && area > 0.0f) {
+			// the inertia about the center of mass (parallel axis theorem)
+			float mass = density * area;
+			float centralInertia = density * inertia - mass * glm::dot(center, center);
+			body.inverseMass = 1.0f / mass;
+			body.inverseInertia = centralInertia > 0.0f ? 1.0f / centralInertia : 0.0f;
+		}
+		_bodies.push_back(body);
+		return (int)_bodies.size() - 1;
+	}
+
+	int PhysicsWorld::addPolygon(const std::vector<glm::vec2> &polygon, float density, glm::vec2 position, float angle) {
+		float area = 0.0f, inertia = 0.0f;
+		glm::vec2 moment(0.0f, 0.0f);
+		accumulateMass(polygon.data(), (int)polygon.size(), area, moment, inertia);
+		if (area < 0.0f) {
+			area = -area;
+			moment = -moment;
+			inertia = -inertia;
+		}
+		glm::vec2 center = area > 0.0f ? moment / area : glm::vec2(0.0f, 0.0f);
+
+		std::vector<glm::vec2> centered(polygon.size());
+		for (size_t i = 0; i < polygon.size(); i++)
+			centered[i] = polygon[i] - center;
+		int body = addBody(area, center, inertia, density, position, angle);
+		_collisions.addPolygon(centered, density > 0.0f);
+		_collisions.setTransform(body, position, angle);
+		return body;
+	}
+
+	int PhysicsWorld::addMesh(const std::vector<glm::vec2> &triangles, float density, glm::vec2 position, float angle) {
+		float area = 0.0f, inertia = 0.0f;
+		glm::vec2 moment(0.0f, 0.0f);
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+			// every triangle counts positively, whatever its winding
+			float triangleArea = 0.0f, triangleInertia = 0.0f;
+			glm::vec2 triangleMoment(0.0f, 0.0f);
+			accumulateMass(&triangles[i], 3, triangleArea, triangleMoment, triangleInertia);
+			float sign = triangleArea < 0.0f ? -1.0f : 1.0f;
+			area += sign * triangleArea;
+			moment += triangleMoment * sign;
+			inertia += sign * triangleInertia;
+		}
+		glm::vec2 center = area > 0.0f ? moment / area : glm::vec2(0.0f, 0.0f);
+
+		std::vector<glm::vec2> centered(triangles.size());
+		for (size_t i = 0; i < triangles.size(); i++)
+			centered[i] = triangles[i] - center;
+		int body = addBody(area, center, inertia, density, position, angle);
+		_collisions.addMesh(centered, density > 0.0f);
+		_collisions.setTransform(body, position, angle);
+		return body;
+	}
+
+	int PhysicsWorld::findRoot(int body) {
+		while (_parent[body] != body) {
+			_parent[body] = _parent[_parent[body]];
+			body = _parent[body];
+		}
+		return body;
+	}
+
+	// group the constraints by island, keeping their order inside each one
+	void PhysicsWorld::buildIslands() {
+		int bodyCount = (int)_bodies.size();
+		int constraintCount = (int)_constraints.size();
+		_parent.resize(bodyCount);
+		for (int i = 0; i < bodyCount; i++)
+			_parent[i] = i;
+
+		// the smaller index becomes the root, so the islands do not depend
+		// on anything but the contact order
+		for (int i = 0; i < constraintCount; i++) {
+			const ContactConstraint &c = _constraints[i];
+			if (!_bodies[c.a].dynamic() || !_bodies[c.b].dynamic())
+				continue;
+			int rootA = findRoot(c.a), rootB = findRoot(c.b);
+			if (rootA < rootB)
+				_parent[rootB] = rootA;
+			else if (rootB < rootA)
+				_parent[rootA] = rootB;
+		}
+
+		// islands numbered in the order of their first contact
+		_islandOf.assign(bodyCount, -1);
+		_constraintIsland.resize(constraintCount);
+		int islandCount = 0;
+		for (int i = 0; i < constraintCount; i++) {
+			const ContactConstraint &c = _constraints[i];
+			int root = findRoot(_bodies[c.a].dynamic() ? c.a : c.b);
+			if (_islandOf[root] < 0)
+				_islandOf[root] = islandCount++;
+			_constraintIsland[i] = _islandOf[root];
+		}
+
+		_islandOffsets.assign(islandCount + 1, 0);
+		for (int i = 0; i < constraintCount; i++)
+			_islandOffsets[_constraintIsland[i] + 1]++;
+		for (int i = 0; i < islandCount; i++)
+			_islandOffsets[i + 1] += _islandOffsets[i];
+
+		_islandConstraints.resize(constraintCount);
+		std::vector<int> &next = _islandOf; // reused as the fill positions
+		next.assign(_islandOffsets.begin(), _islandOffsets.end() - 1);
+		for (int i = 0; i < constraintCount; i++)
+			_islandConstraints[next[_constraintIsland[i]]++] = i;
+	}
+
+	// apply an impulse at a contact point, to b and in the opposite direction to
+	// a (static bodies are shared between islands and never written)
+	static void applyImpulse(RigidBody &a, RigidBody &b, glm::vec2 rA, glm::vec2 rB, glm::vec2 impulse) {
+		if (a.dynamic()) {
+			a.velocity -= impulse * a.inverseMass;
+			a.angularVelocity -= a.inverseInertia * cross(rA, impulse);
+		}
+		if (b.dynamic()) {
+			b.velocity += impulse * b.inverseMass;
+			b.angularVelocity += b.inverseInertia * cross(rB, impulse);
+		}
+	}
+
+	// velocity of b relative to a at a contact point
+	static glm::vec2 relativeVelocity(const RigidBody &a, const RigidBody &b, glm::vec2 rA, glm::vec2 rB) {
+		return b.velocity + cross(b.angularVelocity, rB) - a.velocity - cross(a.angularVelocity, rA);
+	}
+
+	void PhysicsWorld::solveVelocities(int island) {
+		int begin = _islandOffsets[island], end = _islandOffsets[island + 1];
+
+		// warm start with the impulses of the previous step
+		for (int k = begin; k < end; k++) {
+			const ContactConstraint &c = _constraints[_islandConstraints[k]];
+			glm::vec2 tangent(c.normal.y, -c.normal.x);
+			for (int i = 0; i < c.pointCount; i++) {
+				const ContactPoint &p = c.points[i];
+				applyImpulse(_bodies[c.a], _bodies[c.b], p.rA, p.rB, c.normal * p.normalImpulse + tangent * p.tangentImpulse);
+			}
+		}
+
+		for (int iteration = 0; iteration < _velocityIterations; iteration++) {
+			for (int k = begin; k < end; k++) {
+				ContactConstraint &c = _constraints[_islandConstraints[k]];
+				RigidBody &a = _bodies[c.a], &b = _bodies[c.b];
+				glm::vec2 tangent(c.normal.y, -c.normal.x);
+
+				// friction, bounded by the current normal impulses
+				for (int i = 0; i < c.pointCount; i++) {
+					ContactPoint &p = c.points[i];
+					float lambda = -p.tangentMass * glm::dot(relativeVelocity(a, b, p.rA, p.rB), tangent);
+					float maxFriction = c.friction * p.normalImpulse;
+					float tangentImpulse = glm::clamp(p.tangentImpulse + lambda, -maxFriction, maxFriction);
+					lambda = tangentImpulse - p.tangentImpulse;
+					p.tangentImpulse = tangentImpulse;
+					applyImpulse(a, b, p.rA, p.rB, tangent * lambda);
+				}
+
+				// non penetration, the total impulses only push
+				if (c.pointCount == 1) {
+					ContactPoint &p = c.points[0];
+					float lambda = -p.normalMass * glm::dot(relativeVelocity(a, b, p.rA, p.rB), c.normal);
+					float normalImpulse = std::max(p.normalImpulse + lambda, 0.0f);
+					lambda = normalImpulse - p.normalImpulse;
+					p.normalImpulse = normalImpulse;
+					applyImpulse(a, b, p.rA, p.rB, c.normal * lambda);
+					continue;
+				}
+
+				// two points: find the impulses x >= 0 with velocities
+				// vn = K x + d >= 0 and x * vn = 0, trying which points push
+				ContactPoint &p1 = c.points[0], &p2 = c.points[1];
+				float old1 = p1.normalImpulse, old2 = p2.normalImpulse;
+				float d1 = glm::dot(relativeVelocity(a, b, p1.rA, p1.rB), c.normal) - (c.k11 * old1 + c.k12 * old2);
+				float d2 = glm::dot(relativeVelocity(a, b, p2.rA, p2.rB), c.normal) - (c.k12 * old1 + c.k22 * old2);
+
+				float x1 = -(c.m11 * d1 + c.m12 * d2), x2 = -(c.m12 * d1 + c.m22 * d2);
+				if (x1 < 0.0f || x2 < 0.0f) {
+					x1 = -p1.normalMass * d1;
+					x2 = 0.0f;
+					if (x1 < 0.0f || c.k12 * x1 + d2 < 0.0f) {
+						x1 = 0.0f;
+						x2 = -p2.normalMass * d2;
+						if (x2 < 0.0f || c.k12 * x2 + d1 < 0.0f) {
+							x1 = 0.0f;
+							x2 = 0.0f;
+							if (d1 < 0.0f || d2 < 0.0f)
+								continue;
+						}
+					}
+				}
+				applyImpulse(a, b, p1.rA, p1.rB, c.normal * (x1 - old1));
+				applyImpulse(a, b, p2.rA, p2.rB, c.normal * (x2 - old2));
+				p1.normalImpulse = x1;
+				p2.normalImpulse = x2;
+			}
+		}
+	}
+
+	// move the bodies apart along the normals, with the contact points
+	// following the bodies; the corrections of two points are solved
+	// together, like their impulses
+	void PhysicsWorld::solvePositions(int island) {
+		int begin = _islandOffsets[island], end = _islandOffsets[island + 1];
+		for (int iteration = 0; iteration < _positionIterations; iteration++) {
+			for (int k = begin; k < end; k++) {
+				const ContactConstraint &c = _constraints[_islandConstraints[k]];
+				RigidBody &a = _bodies[c.a], &b = _bodies[c.b];
+				float cosA = std::cos(a.angle), sinA = std::sin(a.angle);
+				float cosB = std::cos(b.angle), sinB = std::sin(b.angle);
+
+				glm::vec2 rA[2], rB[2];
+				float correction[2], mass[2];
+				for (int i = 0; i < c.pointCount; i++) {
+					const ContactPoint &p = c.points[i];
+					rA[i] = rotate(p.localA, cosA, sinA);
+					rB[i] = rotate(p.localB, cosB, sinB);
+					float separation = glm::dot(b.position + rB[i] - a.position - rA[i], c.normal) - p.depth;
+					correction[i] = glm::clamp(BAUMGARTE * (separation + LINEAR_SLOP), -MAX_CORRECTION, 0.0f);
+					float rnA = cross(rA[i], c.normal), rnB = cross(rB[i], c.normal);
+					mass[i] = a.inverseMass + b.inverseMass + a.inverseInertia * rnA * rnA + b.inverseInertia * rnB * rnB;
+				}
+
+				float push[2] = { 0.0f, 0.0f };
+				if (c.pointCount == 2) {
+					push[0] = -(c.m11 * correction[0] + c.m12 * correction[1]);
+					push[1] = -(c.m12 * correction[0] + c.m22 * correction[1]);
+				}
+				if (c.pointCount == 1 || push[0] < 0.0f || push[1] < 0.0f) {
+					// one point, or only one of the two should push: the
+					// deepest one alone
+					int i = c.pointCount == 2 && correction[1] < correction[0] ? 1 : 0;
+					push[0] = push[1] = 0.0f;
+					if (mass[i] > 0.0f)
+						push[i] = -correction[i] / mass[i];
+				}
+
+				for (int i = 0; i < c.pointCount; i++) {
+					glm::vec2 impulse = c.normal * push[i];
+					if (a.dynamic()) {
+						a.position -= impulse * a.inverseMass;
+						a.angle -= a.inverseInertia * cross(rA[i], impulse);
+					}
+					if (b.dynamic()) {
+						b.position += impulse * b.inverseMass;
+						b.angle += b.inverseInertia * cross(rB[i], impulse);
+					}
+				}
+			}
+		}
+	}
+
+	// islands share no dynamic body: each chunk solves the islands whose
+	// constraints start in its range
+	void PhysicsWorld::forEachIsland(void (PhysicsWorld::*solve)(int island)) {
+		int islandCount = (int)_islandOffsets.size() - 1;
+		_pool.parallelFor((int)_islandConstraints.size(), [&](int begin, int end, int) {
+			int island = (int)(std::lower_bound(_islandOffsets.begin(), _islandOffsets.end() - 1, begin) - _islandOffsets.begin());
+			for (; island < islandCount && _islandOffsets[island] < end; island++)
+				(this->*solve)(island);
+		});
+	}
+
+	void PhysicsWorld::step(float dt) {
+		if (dt <= 0.0f)
+			return;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// contacts at the current positions
+		int bodyCount = (int)_bodies.size();
+		for (int i = 0; i < bodyCount; i++)
+			if (_bodies[i].dynamic())
+				_collisions.setTransform(i, _bodies[i].position, _bodies[i].angle);
+		_collisions.update();
+
+		std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+		_collideMilliseconds = std::chrono::duration<double, std::milli>(solveStart - start).count();
+
+		_pool.parallelFor(bodyCount, [&](int begin, int end, int) {
+			for (int i = begin; i < end; i++)
+				if (_bodies[i].dynamic())
+					_bodies[i].velocity += _gravity * dt;
+		});
+
+		// one constraint per polygon pair: its points are consecutive and
+		// share everything but the last bits of their feature
+		const std::vector<Contact> &contacts = _collisions.contacts();
+		int contactCount = (int)contacts.size();
+		_manifoldStarts.clear();
+		for (int i = 0; i < contactCount; i++)
+			if (i == 0 || contacts[i].a != contacts[i - 1].a || contacts[i].b != contacts[i - 1].b
+				|| contacts[i].feature >> 4 != contacts[i - 1].feature >> 4 || i - _manifoldStarts.back() == 2)
+				_manifoldStarts.push_back(i);
+		int constraintCount = (int)_manifoldStarts.size();
+		_manifoldStarts.push_back(contactCount);
+
+		// prepare the constraints, starting from the impulses of the same
+		// contacts in the previous step
+		_constraints.resize(constraintCount);
+		_pool.parallelFor(constraintCount, [&](int begin, int end, int) {
+			for (int m = begin; m < end; m++) {
+				const Contact &first = contacts[_manifoldStarts[m]];
+				const RigidBody &a = _bodies[first.a], &b = _bodies[first.b];
+				ContactConstraint &c = _constraints[m];
+				c.a = first.a;
+				c.b = first.b;
+				c.normal = first.normal;
+				c.friction = std::sqrt(a.friction * b.friction);
+				c.pointCount = _manifoldStarts[m + 1] - _manifoldStarts[m];
+
+				glm::vec2 tangent(c.normal.y, -c.normal.x);
+				float mass = a.inverseMass + b.inverseMass;
+				for (int i = 0; i < c.pointCount; i++) {
+					const Contact &contact = contacts[_manifoldStarts[m] + i];
+					ContactPoint &p = c.points[i];
+					p.rA = contact.point - a.position;
+					p.rB = contact.point - b.position;
+					p.localA = rotate(p.rA, std::cos(a.angle), -std::sin(a.angle));
+					p.localB = rotate(p.rB, std::cos(b.angle), -std::sin(b.angle));
+					p.depth = contact.depth;
+					p.feature = contact.feature;
+
+					float rnA = cross(p.rA, c.normal), rnB = cross(p.rB, c.normal);
+					float rtA = cross(p.rA, tangent), rtB = cross(p.rB, tangent);
+					float normalK = mass + a.inverseInertia * rnA * rnA + b.inverseInertia * rnB * rnB;
+					float tangentK = mass + a.inverseInertia * rtA * rtA + b.inverseInertia * rtB * rtB;
+					p.normalMass = normalK > 0.0f ? 1.0f / normalK : 0.0f;
+					p.tangentMass = tangentK > 0.0f ? 1.0f / tangentK : 0.0f;
+
+					p.normalImpulse = 0.0f;
+					p.tangentImpulse = 0.0f;
+					CachedImpulse key;
+					key.pair = (uint64_t)c.a << 32 | (uint32_t)c.b;
+					key.feature = contact.feature;
+					std::vector<CachedImpulse>::const_iterator cached = std::lower_bound(_cache.begin(), _cache.end(), key);
+					if (cached != _cache.end() && cached->pair == key.pair && cached->feature == key.feature) {
+						p.normalImpulse = cached->normalImpulse;
+						p.tangentImpulse = cached->tangentImpulse;
+					}
+				}
+
+				if (c.pointCount == 2) {
+					float rn1A = cross(c.points[0].rA, c.normal), rn1B = cross(c.points[0].rB, c.normal);
+					float rn2A = cross(c.points[1].rA, c.normal), rn2B = cross(c.points[1].rB, c.normal);
+					c.k11 = mass + a.inverseInertia * rn1A * rn1A + b.inverseInertia * rn1B * rn1B;
+					c.k22 = mass + a.inverseInertia * rn2A * rn2A + b.inverseInertia * rn2B * rn2B;
+					c.k12 = mass + a.inverseInertia * rn1A * rn2A + b.inverseInertia * rn1B * rn2B;
+					float determinant = c.k11 * c.k22 - c.k12 * c.k12;
+					if (c.k11 * c.k11 < 1000.0f * determinant) {
+						c.m11 = c.k22 / determinant;
+						c.m12 = -c.k12 / determinant;
+						c.m22 = c.k11 / determinant;
+					} else {
+						// the points are almost the same: keep one
+						c.pointCount = 1;
+					}
+				}
+			}
+		});
+
+		buildIslands();
+		forEachIsland(&PhysicsWorld::solveVelocities);
+
+		// keep the impulses for the next step
+		_cache.clear();
+		for (int m = 0; m < constraintCount; m++) {
+			const ContactConstraint &c = _constraints[m];
+			for (int i = 0; i < c.pointCount; i++) {
+				CachedImpulse entry;
+				entry.pair = (uint64_t)c.a << 32 | (uint32_t)c.b;
+				entry.feature = c.points[i].feature;
+				entry.normalImpulse = c.points[i].normalImpulse;
+				entry.tangentImpulse = c.points[i].tangentImpulse;
+				_cache.push_back(entry);
+			}
+		}
+		std::sort(_cache.begin(), _cache.end());
+
+		_pool.parallelFor(bodyCount, [&](int begin, int end, int) {
+			for (int i = begin; i < end; i++) {
+				RigidBody &body = _bodies[i];
+				if (!body.dynamic())
+					continue;
+				body.position += body.velocity * dt;
+				body.angle += body.angularVelocity * dt;
+			}
+		});
+		forEachIsland(&PhysicsWorld::solvePositions);
+
+		_solveMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+	}
+
+	void benchmarkPhysics(std::ostream &out, int bodyCount) {
+		// columns of boxes on a static ground, a little apart so that each
+		// column is an island
+		const int HEIGHT = 40, STEPS = 300;
+		int columns = std::max(bodyCount / HEIGHT, 1);
+		std::vector<glm::vec2> box = { glm::vec2(-0.5f, -0.5f), glm::vec2(0.5f, -0.5f), glm::vec2(0.5f, 0.5f), glm::vec2(-0.5f, 0.5f) };
+		float width = columns * 1.5f;
+		std::vector<glm::vec2> ground = { glm::vec2(-0.5f * width - 1.0f, -0.5f), glm::vec2(0.5f * width + 1.0f, -0.5f),
+			glm::vec2(0.5f * width + 1.0f, 0.5f), glm::vec2(-0.5f * width - 1.0f, 0.5f) };
+
+		int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+		out << "Physics benchmark: " << columns * HEIGHT << " bodies in columns of " << HEIGHT
+			<< ", " << STEPS << " steps of 1/60 s\n";
+		out << std::fixed << std::setprecision(2);
+
+		std::vector<RigidBody> finalState[2];
+		for (int pass = 0; pass < 2; pass++) {
+			int threadCount = pass == 0 ? 1 : threads;
+			PhysicsWorld world;
+			world.setThreadCount(threadCount);
+			world.addPolygon(ground, 0.0f, glm::vec2(0.0f, -0.5f), 0.0f);
+			for (int column = 0; column < columns; column++) {
+				float x = (column + 0.5f) * 1.5f - 0.5f * width;
+				for (int row = 0; row < HEIGHT; row++)
+					world.addPolygon(box, 1.0f, glm::vec2(x, row * 1.01f + 0.5f), 0.0f);
+			}
+
+			double collideMs = 0.0, solveMs = 0.0;
+			for (int step = 0; step < STEPS; step++) {
+				world.step(1.0f / 60.0f);
+				collideMs += world.collideMilliseconds();
+				solveMs += world.solveMilliseconds();
+			}
+
+			// the columns should stand: their tops stay a box below HEIGHT
+			float lowestTop = 1e30f;
+			for (int column = 0; column < columns; column++)
+				lowestTop = std::min(lowestTop, world.body(1 + column * HEIGHT + HEIGHT - 1).position.y);
+			for (int i = 0; i < world.bodyCount(); i++)
+				finalState[pass].push_back(world.body(i));
+
+			out << "  " << std::setw(2) << threadCount << " threads: collide " << std::setw(7) << collideMs / STEPS
+				<< " ms | solve " << std::setw(7) << solveMs / STEPS << " ms per step | "
+				<< world.islandCount() << " islands, " << world.contactCount() << " contacts"
+				<< " | lowest column top at " << lowestTop << "\n";
+		}
+
+		bool same = true;
+		for (size_t i = 0; i < finalState[0].size() && same; i++)
+			same = finalState[0][i].position == finalState[1][i].position && finalState[0][i].angle == finalState[1][i].angle;
+		out << "  same final state with 1 and " << threads << " threads: " << (same ? "yes" : "no") << "\n";
+	}
+}
@@ -0,0 +1,127 @@
+#include <cg_picking.hpp>
+#include <iostream>
+
+namespace cgicmc {
+
+	const char *pickModeName(PickMode mode) {
+		switch (mode) {
+		case PickMode::Cpu: return "CPU query";
+		case PickMode::Gpu: return "GPU id buffer";
+		}
+		return "?";
+	}
+
+	GpuPicker::GpuPicker() {
+		_fbo = 0;
+		_texture = 0;
+		for (int i = 0; i < RING_SIZE; i++) {
+			_buffers[i] = 0;
+			_fences[i] = 0;
+			_frames[i] = 0;
+		}
+		_head = 0;
+		_count = 0;
+		_frame = 0;
+		_lastLatency = 0;
+	}
+
+	void GpuPicker::create() {
+		glGenTextures(1, &_texture);
+		glBindTexture(GL_TEXTURE_2D, _texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 1, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &_fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Picking framebuffer is incomplete\n";
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// the pack buffers are read by the CPU
+		glGenBuffers(RING_SIZE, _buffers);
+		for (int i = 0; i < RING_SIZE; i++) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, _buffers[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	void GpuPicker::destroy() {
+		if (!_fbo)
+			return;
+		for (int i = 0; i < RING_SIZE; i++)
+			if (_fences[i])
+				glDeleteSync(_fences[i]);
+		glDeleteBuffers(RING_SIZE, _buffers);
+		glDeleteFramebuffers(1, &_fbo);
+		glDeleteTextures(1, &_texture);
+		_fbo = 0;
+		_count = 0;
+	}
+
+	void GpuPicker::begin() {
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		glViewport(0, 0, 1, 1);
+		GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+		glDisable(GL_SCISSOR_TEST);
+		GLuint clear[4] = { NO_ID, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 0, clear);
+		if (scissor)
+			glEnable(GL_SCISSOR_TEST);
+	}
+
+	void GpuPicker::end() {
+		// the ring is full: forget the oldest request
+		if (_count == RING_SIZE) {
+			int oldest = (_head + RING_SIZE - _count) % RING_SIZE;
+			glDeleteSync(_fences[oldest]);
+			_fences[oldest] = 0;
+			_count--;
+		}
+
+		// the copy into the pack buffer is asynchronous
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, _buffers[_head]);
+		glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		_fences[_head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_frames[_head] = _frame;
+		_head = (_head + 1) % RING_SIZE;
+		_count++;
+	}
+
+	bool GpuPicker::poll(GLuint &id) {
+		_frame++;
+		bool found = false;
+
+		// collect every finished request, keeping the most recent result
+		while (_count > 0) {
+			int oldest = (_head + RING_SIZE - _count) % RING_SIZE;
+			GLint status = GL_UNSIGNALED;
+			glGetSynciv(_fences[oldest], GL_SYNC_STATUS, 1, NULL, &status);
+			if (status != GL_SIGNALED)
+				break;
+
+			glDeleteSync(_fences[oldest]);
+			_fences[oldest] = 0;
+			_count--;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, _buffers[oldest]);
+			GLuint *pixel = (GLuint *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+			if (pixel) {
+				id = *pixel;
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				found = true;
+				_lastLatency = _frame - _frames[oldest];
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+		return found;
+	}
+}
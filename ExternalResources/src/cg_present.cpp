@@ -0,0 +1,80 @@
+#include <cg_present.hpp>
+// defined by the CMake file when EGL is found, which also links it
+#ifdef CG_PRESENT_EGL
+#define GLFW_EXPOSE_NATIVE_EGL
+#include <GLFW/glfw3native.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace cgicmc {
+
+#ifdef CG_PRESENT_EGL
+	typedef EGLBoolean (*SwapBuffersWithDamageProc)(EGLDisplay, EGLSurface, EGLint *, EGLint);
+	typedef EGLBoolean (*SetDamageRegionProc)(EGLDisplay, EGLSurface, EGLint *, EGLint);
+#endif
+
+	Presenter::Presenter() {
+		_window = NULL;
+		_display = NULL;
+		_surface = NULL;
+		_swapWithDamage = NULL;
+		_setDamageRegion = NULL;
+		_bufferAge = false;
+	}
+
+	void Presenter::create(GLFWwindow *window) {
+		_window = window;
+
+#ifdef CG_PRESENT_EGL
+		// the extensions below only exist for EGL contexts
+		if (glfwGetEGLContext(window) == EGL_NO_CONTEXT)
+			return;
+		_display = (void *)glfwGetEGLDisplay();
+		_surface = (void *)glfwGetEGLSurface(window);
+
+		// eglGetProcAddress always resolves extension functions; the core
+		// eglQuerySurface is linked
+		if (glfwExtensionSupported("EGL_KHR_swap_buffers_with_damage"))
+			_swapWithDamage = (void *)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+		else if (glfwExtensionSupported("EGL_EXT_swap_buffers_with_damage"))
+			_swapWithDamage = (void *)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+
+		if (glfwExtensionSupported("EGL_KHR_partial_update"))
+			_setDamageRegion = (void *)eglGetProcAddress("eglSetDamageRegionKHR");
+
+		_bufferAge = glfwExtensionSupported("EGL_EXT_buffer_age") || glfwExtensionSupported("EGL_KHR_partial_update");
+#endif
+	}
+
+	int Presenter::bufferAge() const {
+#ifdef CG_PRESENT_EGL
+		EGLint age = 0;
+		if (_bufferAge && eglQuerySurface((EGLDisplay)_display, (EGLSurface)_surface, EGL_BUFFER_AGE_EXT, &age))
+			return age;
+#endif
+		return 0;
+	}
+
+	void Presenter::setDamageRegion([[maybe_unused]] const PixelRect &region) {
+#ifdef CG_PRESENT_EGL
+		if (!_setDamageRegion)
+			return;
+		EGLint rect[4] = { region.x, region.y, region.width, region.height };
+		((SetDamageRegionProc)_setDamageRegion)((EGLDisplay)_display, (EGLSurface)_surface, rect, region.empty() ? 0 : 1);
+#endif
+	}
+
+	void Presenter::swap(const PixelRect &region) {
+		if (!_swapWithDamage || region.empty()) {
+			glfwSwapBuffers(_window);
+			return;
+		}
+
+#ifdef CG_PRESENT_EGL
+		// EGL rectangles have their origin at the bottom left, like GL
+		EGLint rect[4] = { region.x, region.y, region.width, region.height };
+		((SwapBuffersWithDamageProc)_swapWithDamage)((EGLDisplay)_display, (EGLSurface)_surface, rect, 1);
+#endif
+	}
+}
@@ -0,0 +1,113 @@
+#include <cg_render_pass.hpp>
+
+namespace cgicmc {
+
+	void invalidateAttachments(GLenum target, GLuint framebuffer, int attachments, const PixelRect *area) {
+		if (!attachments || !(GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_invalidate_subdata))
+			return;
+
+		// the default framebuffer names its buffers differently
+		GLenum list[3];
+		int count = 0;
+		if (attachments & COLOR_ATTACHMENT)
+			list[count++] = framebuffer ? GL_COLOR_ATTACHMENT0 : GL_COLOR;
+		if (attachments & DEPTH_ATTACHMENT)
+			list[count++] = framebuffer ? GL_DEPTH_ATTACHMENT : GL_DEPTH;
+		if (attachments & STENCIL_ATTACHMENT)
+			list[count++] = framebuffer ? GL_STENCIL_ATTACHMENT : GL_STENCIL;
+
+		glBindFramebuffer(target, framebuffer);
+		if (area && !area->empty())
+			glInvalidateSubFramebuffer(target, count, list, area->x, area->y, area->width, area->height);
+		else
+			glInvalidateFramebuffer(target, count, list);
+	}
+
+	RenderPass::RenderPass() {
+		_color.used = false;
+		_depth.used = false;
+		_stencil.used = false;
+		_clearColor = glm::vec4(0.0f);
+		_clearDepth = 1.0f;
+		_clearStencil = 0;
+		_framebuffer = 0;
+	}
+
+	RenderPass &RenderPass::color(LoadAction load, StoreAction store, glm::vec4 clearColor) {
+		_color.used = true;
+		_color.load = load;
+		_color.store = store;
+		_clearColor = clearColor;
+		return *this;
+	}
+
+	RenderPass &RenderPass::depth(LoadAction load, StoreAction store, float clearDepth) {
+		_depth.used = true;
+		_depth.load = load;
+		_depth.store = store;
+		_clearDepth = clearDepth;
+		return *this;
+	}
+
+	RenderPass &RenderPass::stencil(LoadAction load, StoreAction store, int clearStencil) {
+		_stencil.used = true;
+		_stencil.load = load;
+		_stencil.store = store;
+		_clearStencil = clearStencil;
+		return *this;
+	}
+
+	RenderPass &RenderPass::renderArea(const PixelRect &area) {
+		_area = area;
+		return *this;
+	}
+
+	void RenderPass::begin(GLuint framebuffer, int width, int height) const {
+		_framebuffer = framebuffer;
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+
+		const PixelRect *area = _area.empty() ? NULL : &_area;
+		if (area) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(area->x, area->y, area->width, area->height);
+		}
+
+		// previous content nobody will read (undeclared attachments included)
+		int invalid = 0;
+		if (!_color.used || _color.load == LoadAction::DontCare)
+			invalid |= COLOR_ATTACHMENT;
+		if (!_depth.used || _depth.load == LoadAction::DontCare)
+			invalid |= DEPTH_ATTACHMENT;
+		if (!_stencil.used || _stencil.load == LoadAction::DontCare)
+			invalid |= STENCIL_ATTACHMENT;
+		invalidateAttachments(GL_FRAMEBUFFER, framebuffer, invalid, area);
+
+		// clears only touch the declared attachments
+		if (_color.used && _color.load == LoadAction::Clear)
+			glClearBufferfv(GL_COLOR, 0, &_clearColor.x);
+		if (_depth.used && _depth.load == LoadAction::Clear && _stencil.used && _stencil.load == LoadAction::Clear)
+			glClearBufferfi(GL_DEPTH_STENCIL, 0, _clearDepth, _clearStencil);
+		else if (_depth.used && _depth.load == LoadAction::Clear)
+			glClearBufferfv(GL_DEPTH, 0, &_clearDepth);
+		else if (_stencil.used && _stencil.load == LoadAction::Clear)
+			glClearBufferiv(GL_STENCIL, 0, &_clearStencil);
+	}
+
+	void RenderPass::end() const {
+		const PixelRect *area = _area.empty() ? NULL : &_area;
+
+		// content that is not needed after the pass is never written back
+		int invalid = 0;
+		if (_color.used && _color.store == StoreAction::Discard)
+			invalid |= COLOR_ATTACHMENT;
+		if (_depth.used && _depth.store == StoreAction::Discard)
+			invalid |= DEPTH_ATTACHMENT;
+		if (_stencil.used && _stencil.store == StoreAction::Discard)
+			invalid |= STENCIL_ATTACHMENT;
+		invalidateAttachments(GL_FRAMEBUFFER, _framebuffer, invalid, area);
+
+		if (area)
+			glDisable(GL_SCISSOR_TEST);
+	}
+}
@@ -0,0 +1,271 @@
+#include <cg_scene_graph.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace cgicmc {
+
+	SceneGraph::SceneGraph() {
+		_orderChanged = false;
+		_anyDirty = false;
+		_updated = 0;
+		_updateMilliseconds = 0.0;
+	}
+
+	int SceneGraph::add(int parent, const Affine2D &local) {
+		int node;
+		if (!_freeNodes.empty()) {
+			node = _freeNodes.back();
+			_freeNodes.pop_back();
+		} else {
+			node = (int)_parent.size();
+			_parent.push_back(NO_PARENT);
+			_firstChild.push_back(-1);
+			_nextSibling.push_back(-1);
+			_position.push_back(-1);
+			_alive.push_back(false);
+			_localOf.push_back(Affine2D());
+		}
+		_parent[node] = NO_PARENT;
+		_firstChild[node] = -1;
+		_nextSibling[node] = -1;
+		_position[node] = -1;
+		_alive[node] = true;
+		_localOf[node] = local;
+		if (parent != NO_PARENT) {
+			_parent[node] = parent;
+			_nextSibling[node] = _firstChild[parent];
+			_firstChild[parent] = node;
+		}
+		_orderChanged = true;
+		return node;
+	}
+
+	// unlink a node from its parent's children
+	void SceneGraph::detach(int node) {
+		int parent = _parent[node];
+		if (parent == NO_PARENT)
+			return;
+		if (_firstChild[parent] == node) {
+			_firstChild[parent] = _nextSibling[node];
+		} else {
+			int sibling = _firstChild[parent];
+			while (_nextSibling[sibling] != node)
+				sibling = _nextSibling[sibling];
+			_nextSibling[sibling] = _nextSibling[node];
+		}
+		_parent[node] = NO_PARENT;
+		_nextSibling[node] = -1;
+	}
+
+	void SceneGraph::remove(int node) {
+		if (node < 0 || node >= (int)_alive.size() || !_alive[node])
+			return;
+		detach(node);
+		std::vector<int> stack(1, node);
+		while (!stack.empty()) {
+			int current = stack.back();
+			stack.pop_back();
+			for (int child = _firstChild[current]; child != -1; child = _nextSibling[child])
+				stack.push_back(child);
+			_alive[current] = false;
+			_position[current] = -1;
+			_parent[current] = NO_PARENT;
+			_firstChild[current] = -1;
+			_nextSibling[current] = -1;
+			_freeNodes.push_back(current);
+		}
+		_orderChanged = true;
+	}
+
+	void SceneGraph::setParent(int node, int parent) {
+		if (_parent[node] == parent)
+			return;
+		for (int ancestor = parent; ancestor != NO_PARENT; ancestor = _parent[ancestor])
+			if (ancestor == node) {
+				std::cout << "Scene graph: node " << node << " cannot go under its descendant " << parent << std::endl;
+				return;
+			}
+		detach(node);
+		if (parent != NO_PARENT) {
+			_parent[node] = parent;
+			_nextSibling[node] = _firstChild[parent];
+			_firstChild[parent] = node;
+		}
+		_orderChanged = true;
+	}
+
+	void SceneGraph::setLocal(int node, const Affine2D &local) {
+		_localOf[node] = local;
+		// the whole graph is recomputed after the order changes
+		if (_orderChanged)
+			return;
+		int position = _position[node];
+		_local[position] = local;
+		_dirty[position] = 1;
+		_anyDirty = true;
+		for (int above = _parentPosition[position]; above >= 0 && !_dirtyBelow[above]; above = _parentPosition[above])
+			_dirtyBelow[above] = 1;
+	}
+
+	const Affine2D &SceneGraph::world(int node) const {
+		static const Affine2D identity;
+		int position = _position[node];
+		return position >= 0 ? _world[position] : identity;
+	}
+
+	void SceneGraph::clear() {
+		_parent.clear();
+		_firstChild.clear();
+		_nextSibling.clear();
+		_position.clear();
+		_alive.clear();
+		_localOf.clear();
+		_freeNodes.clear();
+		_orderChanged = true;
+	}
+
+	// depth first from every root; the end of a subtree is the largest end
+	// of its children, found walking the array backwards
+	void SceneGraph::rebuildOrder() {
+		int n = count();
+		_parentPosition.resize(n);
+		_subtreeEnd.resize(n);
+		_local.resize(n);
+		_world.resize(n);
+		_dirty.assign(n, 0);
+		_dirtyBelow.assign(n, 0);
+
+		int position = 0;
+		std::vector<int> stack;
+		for (int root = 0; root < (int)_parent.size(); root++) {
+			if (!_alive[root] || _parent[root] != NO_PARENT)
+				continue;
+			_dirty[position] = 1;
+			stack.push_back(root);
+			while (!stack.empty()) {
+				int node = stack.back();
+				stack.pop_back();
+				_position[node] = position;
+				_parentPosition[position] = _parent[node] == NO_PARENT ? -1 : _position[_parent[node]];
+				_subtreeEnd[position] = position + 1;
+				_local[position] = _localOf[node];
+				position++;
+				for (int child = _firstChild[node]; child != -1; child = _nextSibling[child])
+					stack.push_back(child);
+			}
+		}
+		for (int p = n - 1; p >= 0; p--)
+			if (_parentPosition[p] >= 0)
+				_subtreeEnd[_parentPosition[p]] = std::max(_subtreeEnd[_parentPosition[p]], _subtreeEnd[p]);
+
+		_orderChanged = false;
+		_anyDirty = n > 0;
+	}
+
+	void SceneGraph::update() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		_updated = 0;
+		if (_orderChanged)
+			rebuildOrder();
+
+		if (_anyDirty) {
+			int n = (int)_world.size();
+			const int *parents = _parentPosition.data();
+			const Affine2D *local = _local.data();
+			Affine2D *world = _world.data();
+			int i = 0;
+			while (i < n) {
+				int end = _subtreeEnd[i];
+				if (_dirty[i]) {
+					// the parent of the first node is outside the range and
+					// already up to date; the others follow their parent
+					for (int j = i; j < end; j++) {
+						world[j] = parents[j] < 0 ? local[j] : world[parents[j]] * local[j];
+						_dirty[j] = 0;
+						_dirtyBelow[j] = 0;
+					}
+					_updated += end - i;
+					i = end;
+				} else if (_dirtyBelow[i]) {
+					_dirtyBelow[i] = 0;
+					i++;
+				} else {
+					i = end;
+				}
+			}
+			_anyDirty = false;
+		}
+		_updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	static Affine2D randomLocal(std::mt19937 &random) {
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		float scale = 0.9f + 0.2f * unit(random);
+		return Affine2D::translation(unit(random) - 0.5f, unit(random) - 0.5f) * Affine2D::rotation(unit(random) * 6.2831853f)
+			* Affine2D::scaling(scale, scale);
+	}
+
+	void benchmarkSceneGraph(std::ostream &out, int nodeCount) {
+		const int ROOTS = 64, FRAMES = 60;
+		std::mt19937 random(2044);
+
+		// random trees: every node goes under an earlier one, so a node's
+		// index is larger than its parent's
+		SceneGraph graph;
+		std::vector<int> parents(nodeCount);
+		for (int i = 0; i < nodeCount; i++) {
+			parents[i] = i < ROOTS ? SceneGraph::NO_PARENT : (int)(random() % (unsigned)i);
+			graph.add(parents[i], randomLocal(random));
+		}
+
+		out << "Scene graph benchmark: " << nodeCount << " nodes in " << ROOTS << " trees, " << FRAMES << " frames\n";
+		out << std::fixed << std::setprecision(3);
+
+		graph.update();
+		out << "  first update (order and every world transform): " << std::setw(8) << graph.updateMilliseconds() << " ms\n";
+
+		const char *names[3] = { "every node moved", "1% of the nodes moved", "nothing moved" };
+		for (int scenario = 0; scenario < 3; scenario++) {
+			double total = 0.0;
+			for (int frame = 0; frame < FRAMES; frame++) {
+				if (scenario == 0) {
+					for (int i = 0; i < ROOTS; i++)
+						graph.setLocal(i, randomLocal(random));
+				} else if (scenario == 1) {
+					for (int i = 0; i < nodeCount / 100; i++)
+						graph.setLocal((int)(random() % (unsigned)nodeCount), randomLocal(random));
+				}
+				graph.update();
+				total += graph.updateMilliseconds();
+			}
+			out << "  " << std::setw(22) << std::left << names[scenario] << std::right << ": " << std::setw(8) << total / FRAMES
+				<< " ms per update, " << graph.updatedLastFrame() << " world transforms recomputed\n";
+		}
+
+		// the same worlds recomputed every frame with glm matrices
+		std::vector<glm::mat4> worlds(nodeCount);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+			for (int i = 0; i < nodeCount; i++) {
+				glm::mat4 local = graph.local(i).toMat4();
+				worlds[i] = parents[i] == SceneGraph::NO_PARENT ? local : worlds[parents[i]] * local;
+			}
+		double glmMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+
+		float difference = 0.0f;
+		for (int i = 0; i < nodeCount; i++) {
+			const Affine2D &world = graph.world(i);
+			float values[6] = { world.a, world.b, world.c, world.d, world.tx, world.ty };
+			float expected[6] = { worlds[i][0][0], worlds[i][0][1], worlds[i][1][0], worlds[i][1][1], worlds[i][3][0], worlds[i][3][1] };
+			for (int k = 0; k < 6; k++)
+				difference = std::max(difference, std::fabs(values[k] - expected[k]));
+		}
+		out << "  every world with glm mat4 : " << std::setw(8) << glmMilliseconds << " ms per frame"
+			<< " | largest difference with the graph: " << std::scientific << std::setprecision(1) << difference
+			<< std::fixed << "\n";
+	}
+}
@@ -0,0 +1,338 @@
+#include <cg_script.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+
+namespace cgicmc {
+
+	static const std::size_t FRAME_CLASS_SIZE = 64;
+	static const int FRAME_CLASSES = 16;
+	static const int FRAMES_PER_BLOCK = 64;
+
+	// free blocks of each class, linked through their first bytes; the
+	// blocks of blocks are kept for the life of the program
+	static void *freeFrames[FRAME_CLASSES];
+	static long long frameHeapAllocations = 0;
+
+	void *ScriptFramePool::allocate(std::size_t size) {
+		int frameClass = (int)((size + FRAME_CLASS_SIZE - 1) / FRAME_CLASS_SIZE) - 1;
+		if (frameClass >= FRAME_CLASSES) {
+			frameHeapAllocations++;
+			return ::operator new(size);
+		}
+		if (!freeFrames[frameClass]) {
+			std::size_t blockSize = (frameClass + 1) * FRAME_CLASS_SIZE;
+			char *block = (char *)::operator new(blockSize * FRAMES_PER_BLOCK);
+			frameHeapAllocations++;
+			for (int i = FRAMES_PER_BLOCK - 1; i >= 0; i--) {
+				void *frame = block + i * blockSize;
+				*(void **)frame = freeFrames[frameClass];
+				freeFrames[frameClass] = frame;
+			}
+		}
+		void *frame = freeFrames[frameClass];
+		freeFrames[frameClass] = *(void **)frame;
+		return frame;
+	}
+
+	void ScriptFramePool::release(void *frame, std::size_t size) {
+		int frameClass = (int)((size + FRAME_CLASS_SIZE - 1) / FRAME_CLASS_SIZE) - 1;
+		if (frameClass >= FRAME_CLASSES) {
+			::operator delete(frame);
+			return;
+		}
+		*(void **)frame = freeFrames[frameClass];
+		freeFrames[frameClass] = frame;
+	}
+
+	long long ScriptFramePool::heapAllocations() {
+		return frameHeapAllocations;
+	}
+
+	Script::promise_type::promise_type() {
+		scheduler = NULL;
+		slot = -1;
+		generation = 0;
+	}
+
+	// the script ends there, as if it had returned
+	void Script::promise_type::unhandled_exception() {
+		std::cout << "Script stopped by an exception" << std::endl;
+	}
+
+	std::coroutine_handle<> Script::FinalAwaiter::await_suspend(Handle handle) noexcept {
+		std::coroutine_handle<> continuation = handle.promise().continuation;
+		if (continuation)
+			return continuation;
+		return std::noop_coroutine();
+	}
+
+	// the script runs at once, in the slot of the one awaiting it
+	Script::Handle Script::Awaiter::await_suspend(Handle parent) {
+		promise_type &promise = handle.promise();
+		promise.scheduler = parent.promise().scheduler;
+		promise.slot = parent.promise().slot;
+		promise.generation = parent.promise().generation;
+		promise.continuation = parent;
+		return handle;
+	}
+
+	Script::Script(Script &&other) {
+		_handle = other._handle;
+		other._handle = Handle();
+	}
+
+	Script &Script::operator=(Script &&other) {
+		if (this != &other) {
+			if (_handle)
+				_handle.destroy();
+			_handle = other._handle;
+			other._handle = Handle();
+		}
+		return *this;
+	}
+
+	Script::~Script() {
+		if (_handle)
+			_handle.destroy();
+	}
+
+	float ease(Easing easing, float t) {
+		switch (easing) {
+		case Easing::EaseIn: return t * t;
+		case Easing::EaseOut: return t * (2.0f - t);
+		case Easing::Smooth: return t * t * (3.0f - 2.0f * t);
+		default: return t;
+		}
+	}
+
+	void NextFrameAwaiter::await_suspend(Script::Handle handle) {
+		ScriptScheduler *scheduler = handle.promise().scheduler;
+		scheduler->_nextFrame.push_back(scheduler->waiter(handle, 0.0f));
+	}
+
+	// the timers are a heap with the earliest wake time first
+	static bool wakesLater(double a, double b) {
+		return a > b;
+	}
+
+	void WaitAwaiter::await_suspend(Script::Handle handle) {
+		ScriptScheduler *scheduler = handle.promise().scheduler;
+		scheduler->_timers.push_back(scheduler->waiter(handle, scheduler->_time + seconds));
+		std::push_heap(scheduler->_timers.begin(), scheduler->_timers.end(),
+			[](const ScriptScheduler::Waiter &a, const ScriptScheduler::Waiter &b) { return wakesLater(a.wake, b.wake); });
+	}
+
+	bool TweenAwaiter::await_ready() {
+		if (seconds > 0.0f)
+			return false;
+		*value = to;
+		return true;
+	}
+
+	void TweenAwaiter::await_suspend(Script::Handle handle) {
+		ScriptScheduler *scheduler = handle.promise().scheduler;
+		ScriptScheduler::Tween tween;
+		tween.waiter = scheduler->waiter(handle, 0.0);
+		tween.value = value;
+		tween.from = *value;
+		tween.to = to;
+		tween.start = scheduler->_time;
+		tween.duration = seconds;
+		tween.easing = easing;
+		scheduler->_tweens.push_back(tween);
+	}
+
+	ScriptScheduler::ScriptScheduler() {
+		_time = 0.0;
+		_running = 0;
+		_resumes = 0;
+		_updateMilliseconds = 0.0;
+	}
+
+	ScriptScheduler::~ScriptScheduler() {
+		clear();
+	}
+
+	ScriptScheduler::Waiter ScriptScheduler::waiter(Script::Handle handle, double wake) const {
+		const Script::promise_type &promise = handle.promise();
+		Waiter waiter = { handle, promise.slot, promise.generation, wake };
+		return waiter;
+	}
+
+	// a stopped script leaves its waiters behind: they are dropped when due
+	bool ScriptScheduler::current(const Waiter &waiter) const {
+		return _slots[waiter.slot].generation == waiter.generation && _slots[waiter.slot].root;
+	}
+
+	int ScriptScheduler::start(Script script) {
+		int slot;
+		if (!_freeSlots.empty()) {
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+		} else {
+			slot = (int)_slots.size();
+			Slot empty = { Script::Handle(), 0 };
+			_slots.push_back(empty);
+		}
+		Script::Handle handle = script._handle;
+		script._handle = Script::Handle();
+		_slots[slot].root = handle;
+		_running++;
+
+		Script::promise_type &promise = handle.promise();
+		promise.scheduler = this;
+		promise.slot = slot;
+		promise.generation = _slots[slot].generation;
+		resume(waiter(handle, _time));
+		return slot;
+	}
+
+	void ScriptScheduler::resume(const Waiter &waiter) {
+		if (!current(waiter))
+			return;
+		waiter.handle.resume();
+		_resumes++;
+		if (current(waiter) && _slots[waiter.slot].root.done())
+			finish(waiter.slot);
+	}
+
+	// destroying the root frame destroys the scripts it awaits
+	void ScriptScheduler::finish(int slot) {
+		_slots[slot].root.destroy();
+		_slots[slot].root = Script::Handle();
+		_slots[slot].generation++;
+		_freeSlots.push_back(slot);
+		_running--;
+	}
+
+	void ScriptScheduler::stop(int script) {
+		if (running(script))
+			finish(script);
+	}
+
+	bool ScriptScheduler::running(int script) const {
+		return script >= 0 && script < (int)_slots.size() && _slots[script].root;
+	}
+
+	void ScriptScheduler::clear() {
+		for (int slot = 0; slot < (int)_slots.size(); slot++)
+			stop(slot);
+		_nextFrame.clear();
+		_timers.clear();
+		_tweens.clear();
+	}
+
+	// the scripts due are gathered before any is resumed, so what they wait
+	// for next is for a later update
+	void ScriptScheduler::update(float dt) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		_time += dt;
+		_due.clear();
+
+		while (!_timers.empty() && _timers.front().wake <= _time) {
+			std::pop_heap(_timers.begin(), _timers.end(),
+				[](const Waiter &a, const Waiter &b) { return wakesLater(a.wake, b.wake); });
+			_due.push_back(_timers.back());
+			_timers.pop_back();
+		}
+
+		for (size_t i = 0; i < _tweens.size();) {
+			Tween &tween = _tweens[i];
+			bool over = !current(tween.waiter);
+			if (!over) {
+				float t = (float)((_time - tween.start) / tween.duration);
+				over = t >= 1.0f;
+				*tween.value = over ? tween.to : tween.from + (tween.to - tween.from) * ease(tween.easing, t);
+				if (over)
+					_due.push_back(tween.waiter);
+			}
+			if (over) {
+				tween = _tweens.back();
+				_tweens.pop_back();
+			} else {
+				i++;
+			}
+		}
+
+		_due.insert(_due.end(), _nextFrame.begin(), _nextFrame.end());
+		_nextFrame.clear();
+		for (size_t i = 0; i < _due.size(); i++)
+			resume(_due[i]);
+
+		_updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// turns at a speed, one step per frame
+	static Script stepEveryFrame(float *angle, float speed) {
+		for (;;) {
+			*angle += speed * (1.0f / 60.0f);
+			co_await nextFrame();
+		}
+	}
+
+	// speeds up, holds the speed, then stops
+	static Script spinFor(float *speed, float target, float seconds) {
+		co_await tween(*speed, target, 0.5f);
+		co_await wait(seconds);
+		co_await tween(*speed, 0.0f, 0.25f, Easing::EaseOut);
+	}
+
+	// spin for 2 s, stop, reverse, stop...
+	static Script spinAndReverse(float *speed, float delay) {
+		co_await wait(delay);
+		for (;;) {
+			co_await spinFor(speed, 3.0f, 2.0f);
+			co_await wait(0.5f);
+			co_await spinFor(speed, -3.0f, 2.0f);
+			co_await wait(0.5f);
+		}
+	}
+
+	void benchmarkScripts(std::ostream &out, int scriptCount) {
+		const int FRAMES = 600;
+		const float DT = 1.0f / 60.0f;
+		std::vector<float> angles(scriptCount, 0.0f), speeds(scriptCount, 0.0f);
+		std::mt19937 random(2043);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		out << "Script benchmark: " << scriptCount << " scripts, " << FRAMES << " frames\n";
+		out << std::fixed << std::setprecision(2);
+
+		ScriptScheduler scheduler;
+		const char *names[3] = { "every frame       ", "spin/reverse      ", "spin/reverse again" };
+		for (int pass = 0; pass < 3; pass++) {
+			// the first start of a kind of script takes its frames from the
+			// heap, the next ones reuse them
+			long long heap = ScriptFramePool::heapAllocations();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int i = 0; i < scriptCount; i++) {
+				if (pass == 0)
+					scheduler.start(stepEveryFrame(&angles[i], 1.0f + unit(random)));
+				else
+					scheduler.start(spinAndReverse(&speeds[i], unit(random) * 2.0f));
+			}
+			double startMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			long long startHeap = ScriptFramePool::heapAllocations() - heap;
+
+			heap = ScriptFramePool::heapAllocations();
+			long long resumes = scheduler.resumeCount();
+			double total = 0.0;
+			for (int frame = 0; frame < FRAMES; frame++) {
+				scheduler.update(DT);
+				total += scheduler.updateMilliseconds();
+			}
+			resumes = scheduler.resumeCount() - resumes;
+
+			out << "  " << names[pass] << ": started in " << std::setw(6) << startMilliseconds
+				<< " ms (" << startHeap << " heap allocations), " << std::setw(6) << total / FRAMES << " ms per update, "
+				<< std::setw(6) << resumes / total / 1000.0 << "M resumes/s ("
+				<< std::setw(5) << total * 1e6 / std::max(resumes, 1LL) << " ns each), "
+				<< ScriptFramePool::heapAllocations() - heap << " heap allocations in the updates\n";
+			scheduler.clear();
+		}
+	}
+}
@@ -0,0 +1,630 @@
+#include <cg_sdf_shapes.hpp>
+#include <cg_shader.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace cgicmc {
+
+	// one quad per shape, sized to the bounds of the shape and rotated
+	static const char *sdfVertexShaderSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 aCorner;\n"     // quad corner in [-1, 1]
+		"layout (location = 1) in vec4 aCenterSize;\n" // center.xy, size.xy
+		"layout (location = 2) in vec4 aShape;\n"      // rotation, type, param, param2
+		"layout (location = 3) in vec4 aColor;\n"
+		"layout (location = 4) in uint aId;\n"        // shape index (picking)
+
+		CAMERA_BLOCK_GLSL
+
+		"out vec2 localPos;\n"
+		"flat out vec3 shapeParams;\n"
+		"flat out vec2 shapeSize;\n"
+		"flat out vec4 shapeColor;\n"
+		"flat out uint shapeId;\n"
+
+		"void main() {\n"
+		"   int type = int(aShape.y + 0.5);\n"
+		"   vec2 size = aCenterSize.zw;\n"
+
+		"   vec2 extent = vec2(size.x);\n"
+		"   if (type == 1) extent = size;\n"
+		"   if (type == 4) extent = vec2(size.x * length(vec2(1.0, aShape.w)));\n"
+
+		// grow the quad so the smoothed edge is not clipped
+		"   localPos = aCorner * (extent + vec2(2.0 * camera.viewport.z));\n"
+
+		"   float c = cos(aShape.x), s = sin(aShape.x);\n"
+		"   vec2 world = aCenterSize.xy + vec2(c * localPos.x - s * localPos.y, s * localPos.x + c * localPos.y);\n"
+		"   gl_Position = camera.view * vec4(world, 0.0, 1.0);\n"
+
+		"   shapeParams = vec3(type, aShape.z, aShape.w);\n"
+		"   shapeSize = size;\n"
+		"   shapeColor = aColor;\n"
+		"   shapeId = aId;\n"
+		"}\0";
+
+	// distance functions after Inigo Quilez's 2D distance functions, shared
+	// by the color and the picking fragment shaders
+	const char *sdfDistanceShaderSource =
+		"in vec2 localPos;\n"
+		"flat in vec3 shapeParams;\n"
+		"flat in vec2 shapeSize;\n"
+		"flat in vec4 shapeColor;\n"
+		"flat in uint shapeId;\n"
+
+		"const float PI = 3.14159265;\n"
+
+		"float sdRoundedRect(vec2 p, vec2 b, float r) {\n"
+		"   vec2 q = abs(p) - b + r;\n"
+		"   return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;\n"
+		"}\n"
+
+		"float sdPolygon(vec2 p, float r, float n) {\n"
+		"   float an = PI / n;\n"
+		"   vec2 acs = vec2(cos(an), sin(an));\n"
+		"   float bn = mod(atan(p.x, p.y), 2.0 * an) - an;\n"
+		"   p = length(p) * vec2(cos(bn), abs(sin(bn))) - r * acs;\n"
+		"   p.y += clamp(-p.y, 0.0, r * acs.y);\n"
+		"   return length(p) * sign(p.x);\n"
+		"}\n"
+
+		"float sdStar(vec2 p, float r, float n, float m) {\n"
+		"   float an = PI / n;\n"
+		"   float en = PI / m;\n"
+		"   vec2 acs = vec2(cos(an), sin(an));\n"
+		"   vec2 ecs = vec2(cos(en), sin(en));\n"
+		"   float bn = mod(atan(p.x, p.y), 2.0 * an) - an;\n"
+		"   p = length(p) * vec2(cos(bn), abs(sin(bn))) - r * acs;\n"
+		"   p += ecs * clamp(-dot(p, ecs), 0.0, r * acs.y / ecs.y);\n"
+		"   return length(p) * sign(p.x);\n"
+		"}\n"
+
+		"float sdTriangle(vec2 p, vec2 p0, vec2 p1, vec2 p2) {\n"
+		"   vec2 e0 = p1 - p0, e1 = p2 - p1, e2 = p0 - p2;\n"
+		"   vec2 v0 = p - p0, v1 = p - p1, v2 = p - p2;\n"
+		"   vec2 pq0 = v0 - e0 * clamp(dot(v0, e0) / dot(e0, e0), 0.0, 1.0);\n"
+		"   vec2 pq1 = v1 - e1 * clamp(dot(v1, e1) / dot(e1, e1), 0.0, 1.0);\n"
+		"   vec2 pq2 = v2 - e2 * clamp(dot(v2, e2) / dot(e2, e2), 0.0, 1.0);\n"
+		"   float s = sign(e0.x * e2.y - e0.y * e2.x);\n"
+		"   vec2 d = min(min(vec2(dot(pq0, pq0), s * (v0.x * e0.y - v0.y * e0.x)),\n"
+		"                    vec2(dot(pq1, pq1), s * (v1.x * e1.y - v1.y * e1.x))),\n"
+		"                    vec2(dot(pq2, pq2), s * (v2.x * e2.y - v2.y * e2.x)));\n"
+		"   return -sqrt(d.x) * sign(d.y);\n"
+		"}\n"
+
+		// blades are right triangles, repeated around the center
+		"float sdPinwheel(vec2 p, float r, float n, float w) {\n"
+		"   float d = 1e20;\n"
+		"   for (int i = 0; i < int(n); i++) {\n"
+		"       float a = -2.0 * PI * float(i) / n;\n"
+		"       vec2 q = vec2(cos(a) * p.x - sin(a) * p.y, sin(a) * p.x + cos(a) * p.y);\n"
+		"       d = min(d, sdTriangle(q, vec2(0.0), vec2(r, 0.0), vec2(r, w * r)));\n"
+		"   }\n"
+		"   return d;\n"
+		"}\n"
+
+		"float shapeDistance() {\n"
+		"   int type = int(shapeParams.x + 0.5);\n"
+		"   if (type == 0) return length(localPos) - shapeSize.x;\n"
+		"   if (type == 1) return sdRoundedRect(localPos, shapeSize, shapeParams.y);\n"
+		"   if (type == 2) return sdPolygon(localPos, shapeSize.x, shapeParams.y);\n"
+		"   if (type == 3) return sdStar(localPos, shapeSize.x, shapeParams.y, shapeParams.z);\n"
+		"   return sdPinwheel(localPos, shapeSize.x, shapeParams.y, shapeParams.z);\n"
+		"}\n";
+
+	const char *sdfFragmentShaderSource =
+		"out vec4 FragColor;\n"
+
+		"void main() {\n"
+		"   float d = shapeDistance();\n"
+
+		// analytic anti-aliasing: coverage from the distance in pixels
+		"   float coverage = clamp(0.5 - d / max(fwidth(d), 1e-6), 0.0, 1.0);\n"
+		"   if (coverage <= 0.0)\n"
+		"       discard;\n"
+		"   FragColor = vec4(shapeColor.rgb, shapeColor.a * coverage);\n"
+		"}\n\0";
+
+	// writes the picking id of the shape covering the pixel center
+	static const char *sdfIdFragmentShaderSource =
+		"out uint FragId;\n"
+
+		"uniform uint idOffset;\n"
+
+		"void main() {\n"
+		"   if (shapeDistance() > 0.0)\n"
+		"       discard;\n"
+		"   FragId = shapeId + idOffset;\n"
+		"}\n\0";
+
+	// per instance data, as read by the vertex shader
+	struct SdfInstance {
+		float centerSize[4];
+		float shape[4];
+		float color[4];
+		GLuint id;
+	};
+
+	SdfShape SdfShape::circle(glm::vec2 center, float radius, glm::vec4 color) {
+		return SdfShape{ShapeType::Circle, center, glm::vec2(radius, radius), 0.0f, 0.0f, 0.0f, color};
+	}
+
+	SdfShape SdfShape::roundedRect(glm::vec2 center, glm::vec2 halfSize, float cornerRadius, glm::vec4 color) {
+		return SdfShape{ShapeType::RoundedRect, center, halfSize, 0.0f, cornerRadius, 0.0f, color};
+	}
+
+	SdfShape SdfShape::polygon(glm::vec2 center, float radius, int sides, glm::vec4 color) {
+		return SdfShape{ShapeType::Polygon, center, glm::vec2(radius, radius), 0.0f, (float)sides, 0.0f, color};
+	}
+
+	SdfShape SdfShape::star(glm::vec2 center, float radius, int points, float sharpness, glm::vec4 color) {
+		return SdfShape{ShapeType::Star, center, glm::vec2(radius, radius), 0.0f, (float)points, sharpness, color};
+	}
+
+	SdfShape SdfShape::pinwheel(glm::vec2 center, float length, int blades, float width, glm::vec4 color) {
+		return SdfShape{ShapeType::Pinwheel, center, glm::vec2(length, length), 0.0f, (float)blades, width, color};
+	}
+
+	float SdfShape::boundingRadius() const {
+		switch (type) {
+		case ShapeType::RoundedRect: return std::sqrt(size.x * size.x + size.y * size.y);
+		case ShapeType::Pinwheel: return size.x * std::sqrt(1.0f + param2 * param2);
+		default: return size.x;
+		}
+	}
+
+	std::vector<glm::vec2> SdfShape::outline() const {
+		std::vector<glm::vec2> outline;
+		if (type == ShapeType::RoundedRect) {
+			outline.push_back(glm::vec2(-size.x, -size.y));
+			outline.push_back(glm::vec2(size.x, -size.y));
+			outline.push_back(glm::vec2(size.x, size.y));
+			outline.push_back(glm::vec2(-size.x, size.y));
+			return outline;
+		}
+
+		// the corners of the polygons and the tips of the stars are at odd
+		// multiples of PI / n, clockwise from the +y axis (see sdPolygon)
+		int sides = 8;
+		float radius = boundingRadius();
+		if (type == ShapeType::Polygon || type == ShapeType::Star)
+			sides = std::min(std::max((int)param, 3), 8);
+		else if (type == ShapeType::Circle)
+			radius /= std::cos(3.14159265f / sides);
+		for (int i = sides - 1; i >= 0; i--) {
+			float angle = 3.14159265f * (2 * i + 1) / sides;
+			outline.push_back(glm::vec2(radius * std::sin(angle), radius * std::cos(angle)));
+		}
+		return outline;
+	}
+
+	// CPU versions of the distance functions of the fragment shader
+	static const float PI = 3.14159265f;
+
+	static float glslMod(float x, float y) {
+		return x - y * std::floor(x / y);
+	}
+
+	static float sdRoundedRect(glm::vec2 p, glm::vec2 b, float r) {
+		float qx = std::fabs(p.x) - b.x + r, qy = std::fabs(p.y) - b.y + r;
+		float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f);
+		return std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - r;
+	}
+
+	static float sdPolygon(glm::vec2 p, float r, float n) {
+		float an = PI / n;
+		float bn = glslMod(std::atan2(p.x, p.y), 2.0f * an) - an;
+		float length = std::sqrt(p.x * p.x + p.y * p.y);
+		float qx = length * std::cos(bn) - r * std::cos(an);
+		float qy = length * std::fabs(std::sin(bn)) - r * std::sin(an);
+		qy += glm::clamp(-qy, 0.0f, r * std::sin(an));
+		return std::sqrt(qx * qx + qy * qy) * (qx > 0.0f ? 1.0f : qx < 0.0f ? -1.0f : 0.0f);
+	}
+
+	static float sdStar(glm::vec2 p, float r, float n, float m) {
+		float an = PI / n, en = PI / m;
+		float acx = std::cos(an), acy = std::sin(an);
+		float ecx = std::cos(en), ecy = std::sin(en);
+		float bn = glslMod(std::atan2(p.x, p.y), 2.0f * an) - an;
+		float length = std::sqrt(p.x * p.x + p.y * p.y);
+		float qx = length * std::cos(bn) - r * acx;
+		float qy = length * std::fabs(std::sin(bn)) - r * acy;
+		float t = glm::clamp(-(qx * ecx + qy * ecy), 0.0f, r * acy / ecy);
+		qx += ecx * t;
+		qy += ecy * t;
+		return std::sqrt(qx * qx + qy * qy) * (qx > 0.0f ? 1.0f : qx < 0.0f ? -1.0f : 0.0f);
+	}
+
+	// the blades are right triangles: inside when on the inner side of the
+	// three edges, otherwise the distance to the closest edge
+	static float sdTriangle(glm::vec2 p, glm::vec2 p0, glm::vec2 p1, glm::vec2 p2) {
+		glm::vec2 e[3] = { p1 - p0, p2 - p1, p0 - p2 };
+		glm::vec2 v[3] = { p - p0, p - p1, p - p2 };
+		float s = e[0].x * e[2].y - e[0].y * e[2].x > 0.0f ? 1.0f : -1.0f;
+		float distance = 1e20f, side = 1e20f;
+		for (int i = 0; i < 3; i++) {
+			float t = glm::clamp((v[i].x * e[i].x + v[i].y * e[i].y) / (e[i].x * e[i].x + e[i].y * e[i].y), 0.0f, 1.0f);
+			glm::vec2 pq = v[i] - e[i] * t;
+			distance = std::min(distance, pq.x * pq.x + pq.y * pq.y);
+			side = std::min(side, s * (v[i].x * e[i].y - v[i].y * e[i].x));
+		}
+		return side < 0.0f ? std::sqrt(distance) : -std::sqrt(distance);
+	}
+
+	float SdfShape::distance(glm::vec2 point) const {
+		// into the frame of the shape (undo the counter-clockwise rotation)
+		glm::vec2 d = point - center;
+		float c = std::cos(rotation), s = std::sin(rotation);
+		glm::vec2 p(c * d.x + s * d.y, -s * d.x + c * d.y);
+
+		switch (type) {
+		case ShapeType::Circle: return std::sqrt(p.x * p.x + p.y * p.y) - size.x;
+		case ShapeType::RoundedRect: return sdRoundedRect(p, size, param);
+		case ShapeType::Polygon: return sdPolygon(p, size.x, param);
+		case ShapeType::Star: return sdStar(p, size.x, param, param2);
+		case ShapeType::Pinwheel: {
+			float result = 1e20f;
+			for (int i = 0; i < (int)param; i++) {
+				float a = -2.0f * PI * i / param;
+				glm::vec2 q(std::cos(a) * p.x - std::sin(a) * p.y, std::sin(a) * p.x + std::cos(a) * p.y);
+				result = std::min(result, sdTriangle(q, glm::vec2(0.0f), glm::vec2(size.x, 0.0f), glm::vec2(size.x, param2 * size.x)));
+			}
+			return result;
+		}
+		}
+		return 1e20f;
+	}
+
+	SdfRenderer::SdfRenderer() {
+		_dirty = true;
+		_program = 0;
+		_idProgram = 0;
+		_idOffsetLocation = -1;
+		_VAO = 0;
+		_quadVBO = 0;
+		_instanceVBO = 0;
+		_instanceCapacity = 0;
+		_instanceCount = 0;
+		_indexType = SpatialIndexType::Grid;
+		_indexValid = false;
+		_indexedCount = 0;
+		_sortCurve = SpaceFillingCurve::None;
+		_sortInterval = 300;
+		_framesSinceSort = 0;
+		_changesSinceSort = 0;
+		_sortedCount = 0;
+	}
+
+	void SdfRenderer::create() {
+		std::string common = std::string("#version 330 core\n") + sdfDistanceShaderSource;
+		_program = createShaderProgram(sdfVertexShaderSource, (common + sdfFragmentShaderSource).c_str());
+		_idProgram = createShaderProgram(sdfVertexShaderSource, (common + sdfIdFragmentShaderSource).c_str());
+		_idOffsetLocation = glGetUniformLocation(_idProgram, "idOffset");
+		Camera::bindBlock(_program);
+		Camera::bindBlock(_idProgram);
+
+		// the quad is shared by every shape, drawn as a triangle strip
+		float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+		glGenVertexArrays(1, &_VAO);
+		glBindVertexArray(_VAO);
+
+		glGenBuffers(1, &_quadVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+		glEnableVertexAttribArray(0);
+
+		// the instance attributes advance once per shape
+		glGenBuffers(1, &_instanceVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+		for (int i = 0; i < 3; i++) {
+			glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(SdfInstance), (void *)(i * 4 * sizeof(float)));
+			glVertexAttribDivisor(1 + i, 1);
+			glEnableVertexAttribArray(1 + i);
+		}
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(SdfInstance), (void *)(12 * sizeof(float)));
+		glVertexAttribDivisor(4, 1);
+		glEnableVertexAttribArray(4);
+
+		glBindVertexArray(0);
+		_instanceCapacity = 0;
+		_dirty = true;
+	}
+
+	void SdfRenderer::destroy() {
+		if (!_program)
+			return;
+		glDeleteProgram(_program);
+		glDeleteProgram(_idProgram);
+		glDeleteVertexArrays(1, &_VAO);
+		glDeleteBuffers(1, &_quadVBO);
+		glDeleteBuffers(1, &_instanceVBO);
+		_program = 0;
+	}
+
+	void SdfRenderer::clear() {
+		_shapes.clear();
+		_slotOf.clear();
+		_idOf.clear();
+		_dirty = true;
+		_indexValid = false;
+		_sortedCount = 0;
+	}
+
+	int SdfRenderer::add(const SdfShape &shape) {
+		int index = (int)_shapes.size();
+		_shapes.push_back(shape);
+		_slotOf.push_back(index);
+		_idOf.push_back(index);
+		_dirty = true;
+		return index;
+	}
+
+	SdfShape &SdfRenderer::shape(int index) {
+		int slot = _slotOf[index];
+		_dirty = true;
+		_changesSinceSort++;
+		if (_indexValid && slot < _indexedCount && !_changedFlags[slot]) {
+			_changedFlags[slot] = true;
+			_changed.push_back(slot);
+		}
+		return _shapes[slot];
+	}
+
+	AABB SdfRenderer::bounds(int index) const {
+		return slotBounds(_slotOf[index]);
+	}
+
+	AABB SdfRenderer::slotBounds(int slot) const {
+		const SdfShape &s = _shapes[slot];
+		return AABB::around(s.center, s.boundingRadius());
+	}
+
+	void SdfRenderer::sortAlongCurve(SpaceFillingCurve curve) {
+		std::vector<glm::vec2> centers(_shapes.size());
+		for (size_t i = 0; i < _shapes.size(); i++)
+			centers[i] = _shapes[i].center;
+		std::vector<int> order;
+		spatialOrder(centers, curve, order);
+		if (curve == SpaceFillingCurve::None) {
+			// back to the insertion order
+			for (size_t slot = 0; slot < order.size(); slot++)
+				order[slot] = _slotOf[slot];
+		}
+
+		// gather the shapes in curve order and remap the indices
+		std::vector<SdfShape> shapes(_shapes.size());
+		std::vector<int> idOf(_idOf.size());
+		for (size_t slot = 0; slot < order.size(); slot++) {
+			shapes[slot] = _shapes[order[slot]];
+			idOf[slot] = _idOf[order[slot]];
+			_slotOf[idOf[slot]] = (int)slot;
+		}
+		_shapes.swap(shapes);
+		_idOf.swap(idOf);
+
+		// the index refers to slots: rebuild it
+		_indexValid = false;
+		_dirty = true;
+		_framesSinceSort = 0;
+		_changesSinceSort = 0;
+		_sortedCount = (int)_shapes.size();
+	}
+
+	void SdfRenderer::setSpatialSort(SpaceFillingCurve curve, int intervalFrames) {
+		_sortInterval = intervalFrames;
+		if (curve == _sortCurve)
+			return;
+		_sortCurve = curve;
+		// sort on the next draw (or restore the insertion order right away)
+		if (curve == SpaceFillingCurve::None)
+			sortAlongCurve(curve);
+		_sortedCount = 0;
+	}
+
+	void SdfRenderer::setSpatialIndex(SpatialIndexType type) {
+		if (type == _indexType)
+			return;
+		_indexType = type;
+		_indexValid = false;
+		_dirty = true;
+	}
+
+	// bring the index up to date with the shapes
+	void SdfRenderer::updateIndex() {
+		if (_indexType == SpatialIndexType::Linear)
+			return;
+
+		int count = (int)_shapes.size();
+		// the BVH is rebuilt when shapes were added, the grid inserts them
+		bool rebuild = !_indexValid || (_indexType == SpatialIndexType::Bvh && _indexedCount != count);
+		if (rebuild) {
+			std::vector<AABB> shapeBounds(count);
+			AABB world;
+			float radii = 0.0f;
+			for (int i = 0; i < count; i++) {
+				shapeBounds[i] = slotBounds(i);
+				world.expand(shapeBounds[i]);
+				radii += _shapes[i].boundingRadius();
+			}
+
+			if (_indexType == SpatialIndexType::Grid) {
+				// about two shapes per cell, cells no smaller than a shape
+				float cellSize = count > 0 ? std::sqrt(2.0f * world.area() / count) : 1.0f;
+				cellSize = std::max(cellSize, count > 0 ? 2.0f * radii / count : 1.0f);
+				_grid.reset(count > 0 ? world : AABB(glm::vec2(-1.0f), glm::vec2(1.0f)), cellSize);
+				for (int i = 0; i < count; i++)
+					_grid.insert(i, shapeBounds[i]);
+			} else {
+				_bvh.build(shapeBounds);
+			}
+			_changed.clear();
+			_changedFlags.assign(count, false);
+			_indexedCount = count;
+			_indexValid = true;
+			return;
+		}
+
+		for (size_t i = 0; i < _changed.size(); i++) {
+			int slot = _changed[i];
+			if (_indexType == SpatialIndexType::Grid)
+				_grid.move(slot, slotBounds(slot));
+			else
+				_bvh.update(slot, slotBounds(slot));
+			_changedFlags[slot] = false;
+		}
+		_changed.clear();
+
+		for (int i = _indexedCount; i < count; i++)
+			_grid.insert(i, slotBounds(i));
+		_changedFlags.resize(count, false);
+		_indexedCount = count;
+	}
+
+	// slots of the shapes in a region, in storage (drawing) order
+	void SdfRenderer::querySlots(const AABB &region, std::vector<int> &result) {
+		updateIndex();
+		size_t first = result.size();
+		if (_indexType == SpatialIndexType::Grid) {
+			_grid.query(region, result);
+		} else if (_indexType == SpatialIndexType::Bvh) {
+			_bvh.query(region, result);
+		} else {
+			for (int i = 0; i < (int)_shapes.size(); i++)
+				if (slotBounds(i).intersects(region))
+					result.push_back(i);
+		}
+		// keep the drawing order, so overlapping shapes do not flicker
+		std::sort(result.begin() + first, result.end());
+	}
+
+	void SdfRenderer::queryPointSlots(glm::vec2 point, std::vector<int> &result) {
+		updateIndex();
+		size_t first = result.size();
+		if (_indexType == SpatialIndexType::Grid) {
+			_grid.queryPoint(point, result);
+		} else if (_indexType == SpatialIndexType::Bvh) {
+			_bvh.queryPoint(point, result);
+		} else {
+			for (int i = 0; i < (int)_shapes.size(); i++)
+				if (slotBounds(i).contains(point))
+					result.push_back(i);
+		}
+		std::sort(result.begin() + first, result.end());
+	}
+
+	void SdfRenderer::query(const AABB &region, std::vector<int> &result) {
+		size_t first = result.size();
+		querySlots(region, result);
+		for (size_t i = first; i < result.size(); i++)
+			result[i] = _idOf[result[i]];
+	}
+
+	void SdfRenderer::queryPoint(glm::vec2 point, std::vector<int> &result) {
+		size_t first = result.size();
+		queryPointSlots(point, result);
+		for (size_t i = first; i < result.size(); i++)
+			result[i] = _idOf[result[i]];
+	}
+
+	// pack the visible shapes into the instance buffer
+	void SdfRenderer::upload(const AABB &visible, float margin) {
+		_visible.clear();
+		querySlots(AABB(visible.min - glm::vec2(margin), visible.max + glm::vec2(margin)), _visible);
+
+		std::vector<SdfInstance> instances;
+		instances.reserve(_visible.size());
+		for (size_t v = 0; v < _visible.size(); v++) {
+			const SdfShape &s = _shapes[_visible[v]];
+			instances.push_back(SdfInstance());
+			SdfInstance &instance = instances.back();
+			instance.centerSize[0] = s.center.x;
+			instance.centerSize[1] = s.center.y;
+			instance.centerSize[2] = s.size.x;
+			instance.centerSize[3] = s.size.y;
+			instance.shape[0] = s.rotation;
+			instance.shape[1] = (float)s.type;
+			instance.shape[2] = s.param;
+			instance.shape[3] = s.param2;
+			instance.color[0] = s.color.x;
+			instance.color[1] = s.color.y;
+			instance.color[2] = s.color.z;
+			instance.color[3] = s.color.w;
+			instance.id = (GLuint)_idOf[_visible[v]];
+		}
+
+		_instanceCount = instances.size();
+		_culledBounds = visible;
+		_dirty = false;
+		if (instances.empty())
+			return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+		size_t bytes = instances.size() * sizeof(SdfInstance);
+		if (instances.size() > _instanceCapacity) {
+			// grow geometrically so adding shapes does not reallocate every time
+			_instanceCapacity = instances.size() * 2;
+			glBufferData(GL_ARRAY_BUFFER, _instanceCapacity * sizeof(SdfInstance), NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances.data());
+	}
+
+	// sort and cull for the camera, true if some shape is visible
+	bool SdfRenderer::prepare(const Camera &camera) {
+		// keep the storage along the curve as shapes are added and move
+		if (_sortCurve != SpaceFillingCurve::None) {
+			_framesSinceSort++;
+			bool added = _sortedCount != (int)_shapes.size();
+			bool moved = _changesSinceSort > 0 && _framesSinceSort >= _sortInterval;
+			if (added || moved)
+				sortAlongCurve(_sortCurve);
+		}
+
+		AABB visible = camera.visibleBounds();
+		if (_dirty || visible.min != _culledBounds.min || visible.max != _culledBounds.max) {
+			// the quads are grown by two pixels for the smoothed edges
+			upload(visible, 2.0f * camera.pixelSize());
+		}
+		return _instanceCount > 0;
+	}
+
+	void SdfRenderer::draw(const Camera &camera) {
+		if (!prepare(camera))
+			return;
+
+		glUseProgram(_program);
+		camera.bind();
+
+		// coverage is written to alpha
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		glBindVertexArray(_VAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)_instanceCount);
+
+		if (!blend)
+			glDisable(GL_BLEND);
+	}
+
+	void SdfRenderer::drawIds(const Camera &camera, GLuint idOffset) {
+		if (!prepare(camera))
+			return;
+
+		glUseProgram(_idProgram);
+		camera.bind();
+		glUniform1ui(_idOffsetLocation, idOffset);
+
+		// the last shape drawn over a pixel wins, like when blending
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glDisable(GL_BLEND);
+
+		glBindVertexArray(_VAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)_instanceCount);
+
+		if (blend)
+			glEnable(GL_BLEND);
+	}
+}
@@ -0,0 +1,82 @@
+#include <cg_shader.hpp>
+#include <iostream>
+
+namespace cgicmc {
+
+	// full screen triangle generated from gl_VertexID (no vertex buffer needed)
+	const char *fullscreenVertexShaderSource =
+		"#version 330 core\n"
+		"out vec2 uv;\n"
+
+		"void main() {\n"
+		"   uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+		"   gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+		"}\0";
+
+	// compile a single shader stage, printing the log on failure
+	static GLuint compileShader(GLenum type, const char *source) {
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			char infoLog[1024];
+			glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+			std::cout << "Failed to compile shader:\n" << infoLog << "\n";
+		}
+		return shader;
+	}
+
+	// link a program, printing the log on failure
+	static void linkProgram(GLuint program) {
+		glLinkProgram(program);
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[1024];
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cout << "Failed to link shader program:\n" << infoLog << "\n";
+		}
+	}
+
+	// program rendering pipeline attaching the given shaders
+	GLuint createShaderProgram(const char *vertexSource, const char *fragmentSource) {
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+		GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+		// create the program using the shaders
+		GLuint shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, vertexShader);
+		glAttachShader(shaderProgram, fragmentShader);
+		linkProgram(shaderProgram);
+
+		// delete the shaders
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		return shaderProgram;
+	}
+
+	GLuint createComputeProgram(const char *computeSource) {
+		GLuint computeShader = compileShader(GL_COMPUTE_SHADER, computeSource);
+		GLuint program = glCreateProgram();
+		glAttachShader(program, computeShader);
+		linkProgram(program);
+		glDeleteShader(computeShader);
+		return program;
+	}
+
+	// the varyings must be declared before linking
+	GLuint createTransformFeedbackProgram(const char *vertexSource, const char *const *varyings, int varyingCount) {
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertexShader);
+		glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+		linkProgram(program);
+		glDeleteShader(vertexShader);
+		return program;
+	}
+}
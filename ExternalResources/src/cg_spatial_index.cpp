@@ -0,0 +1,568 @@
+#include <cg_spatial_index.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+namespace cgicmc {
+
+	// objects per BVH leaf
+	static const int LEAF_SIZE = 4;
+
+	// limit of the grid resolution (cells per side)
+	static const int MAX_CELLS_PER_SIDE = 4096;
+
+	const char *spatialIndexName(SpatialIndexType type) {
+		switch (type) {
+		case SpatialIndexType::Linear: return "linear scan";
+		case SpatialIndexType::Grid: return "loose grid";
+		case SpatialIndexType::Bvh: return "BVH";
+		}
+		return "?";
+	}
+
+	const char *spaceFillingCurveName(SpaceFillingCurve curve) {
+		switch (curve) {
+		case SpaceFillingCurve::None: return "insertion";
+		case SpaceFillingCurve::Morton: return "Morton";
+		case SpaceFillingCurve::Hilbert: return "Hilbert";
+		}
+		return "?";
+	}
+
+	// spread the 16 low bits of v to the even bits
+	static uint32_t spreadBits(uint32_t v) {
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	uint32_t mortonKey(uint32_t x, uint32_t y) {
+		return spreadBits(x) | (spreadBits(y) << 1);
+	}
+
+	// walks the quadrants from the largest, rotating the remaining
+	// coordinates into the orientation of the chosen quadrant
+	uint32_t hilbertKey(uint32_t x, uint32_t y) {
+		const uint32_t n = 1u << 16;
+		uint32_t key = 0;
+		for (uint32_t s = n >> 1; s > 0; s >>= 1) {
+			uint32_t rx = (x & s) ? 1 : 0;
+			uint32_t ry = (y & s) ? 1 : 0;
+			key += s * s * ((3 * rx) ^ ry);
+			if (ry == 0) {
+				if (rx == 1) {
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return key;
+	}
+
+	void spatialOrder(const std::vector<glm::vec2> &points, SpaceFillingCurve curve, std::vector<int> &order) {
+		order.resize(points.size());
+		AABB bounds;
+		for (size_t i = 0; i < points.size(); i++) {
+			bounds.expand(points[i]);
+			order[i] = (int)i;
+		}
+		if (curve == SpaceFillingCurve::None || points.empty())
+			return;
+
+		glm::vec2 size = bounds.size();
+		glm::vec2 scale(size.x > 0.0f ? 65535.0f / size.x : 0.0f, size.y > 0.0f ? 65535.0f / size.y : 0.0f);
+		std::vector<std::pair<uint32_t, int>> keys(points.size());
+		for (size_t i = 0; i < points.size(); i++) {
+			glm::vec2 cell = (points[i] - bounds.min) * scale;
+			uint32_t x = (uint32_t)cell.x, y = (uint32_t)cell.y;
+			keys[i].first = curve == SpaceFillingCurve::Morton ? mortonKey(x, y) : hilbertKey(x, y);
+			keys[i].second = (int)i;
+		}
+		// the index breaks ties, so the order is deterministic
+		std::sort(keys.begin(), keys.end());
+		for (size_t i = 0; i < keys.size(); i++)
+			order[i] = keys[i].second;
+	}
+
+	SpatialGrid::SpatialGrid() {
+		_cellSize = 1.0f;
+		_inverseCellSize = 1.0f;
+		_columns = 0;
+		_rows = 0;
+		_size = 0;
+	}
+
+	void SpatialGrid::reset(const AABB &world, float cellSize) {
+		glm::vec2 size = world.size();
+		float largest = std::max(size.x, size.y);
+		cellSize = std::max(cellSize, largest / MAX_CELLS_PER_SIDE);
+		cellSize = std::max(cellSize, 1e-6f);
+
+		_world = world;
+		_cellSize = cellSize;
+		_inverseCellSize = 1.0f / cellSize;
+		_columns = std::max(1, (int)std::ceil(size.x * _inverseCellSize));
+		_rows = std::max(1, (int)std::ceil(size.y * _inverseCellSize));
+		_cells.assign((size_t)_columns * _rows + 1, std::vector<Entry>());
+		_cellBounds.assign(_cells.size(), AABB());
+		_locations.clear();
+		_size = 0;
+	}
+
+	void SpatialGrid::clear() {
+		for (size_t i = 0; i < _cells.size(); i++) {
+			_cells[i].clear();
+			_cellBounds[i] = AABB();
+		}
+		_locations.clear();
+		_size = 0;
+	}
+
+	int SpatialGrid::cellOf(const AABB &bounds) const {
+		glm::vec2 halfExtent = bounds.size() * 0.5f;
+		if (halfExtent.x > _cellSize || halfExtent.y > _cellSize)
+			return oversizedCell();
+		glm::vec2 center = bounds.center();
+		int x = (int)std::floor((center.x - _world.min.x) * _inverseCellSize);
+		int y = (int)std::floor((center.y - _world.min.y) * _inverseCellSize);
+		x = std::min(std::max(x, 0), _columns - 1);
+		y = std::min(std::max(y, 0), _rows - 1);
+		return y * _columns + x;
+	}
+
+	// cells whose (loose) bounds may intersect the region: the objects in
+	// the cells are no more than a cell from their centers
+	void SpatialGrid::cellRange(const AABB &region, int &x0, int &y0, int &x1, int &y1) const {
+		x0 = (int)std::floor((region.min.x - _cellSize - _world.min.x) * _inverseCellSize);
+		y0 = (int)std::floor((region.min.y - _cellSize - _world.min.y) * _inverseCellSize);
+		x1 = (int)std::floor((region.max.x + _cellSize - _world.min.x) * _inverseCellSize);
+		y1 = (int)std::floor((region.max.y + _cellSize - _world.min.y) * _inverseCellSize);
+		x0 = std::min(std::max(x0, 0), _columns - 1);
+		y0 = std::min(std::max(y0, 0), _rows - 1);
+		x1 = std::min(std::max(x1, 0), _columns - 1);
+		y1 = std::min(std::max(y1, 0), _rows - 1);
+	}
+
+	// a cell holds a couple of objects, so its bounds are cheap to rebuild
+	void SpatialGrid::refreshCell(int cell) {
+		if (cell == oversizedCell())
+			return; // always checked, whatever its bounds
+		AABB bounds;
+		const std::vector<Entry> &entries = _cells[cell];
+		for (size_t i = 0; i < entries.size(); i++)
+			bounds.expand(entries[i].bounds);
+		_cellBounds[cell] = bounds;
+	}
+
+	void SpatialGrid::insert(int id, const AABB &bounds) {
+		if (_cells.empty())
+			reset(bounds, std::max(bounds.size().x, bounds.size().y));
+		if (id >= (int)_locations.size())
+			_locations.resize(id + 1, Location{-1, -1});
+		if (_locations[id].cell >= 0) {
+			move(id, bounds);
+			return;
+		}
+
+		int cell = cellOf(bounds);
+		_locations[id].cell = cell;
+		_locations[id].slot = (int)_cells[cell].size();
+		_cells[cell].push_back(Entry{bounds, id});
+		_cellBounds[cell].expand(bounds);
+		_size++;
+	}
+
+	void SpatialGrid::move(int id, const AABB &bounds) {
+		Location &location = _locations[id];
+		int cell = cellOf(bounds);
+		if (cell == location.cell) {
+			// still in the same cell: only the stored bounds change
+			_cells[cell][location.slot].bounds = bounds;
+			refreshCell(cell);
+			return;
+		}
+		remove(id);
+		insert(id, bounds);
+	}
+
+	void SpatialGrid::remove(int id) {
+		Location &location = _locations[id];
+		int index = location.cell;
+		std::vector<Entry> &cell = _cells[index];
+
+		// fill the hole with the last entry of the cell
+		cell[location.slot] = cell.back();
+		_locations[cell[location.slot].id].slot = location.slot;
+		cell.pop_back();
+		refreshCell(index);
+
+		location.cell = -1;
+		location.slot = -1;
+		_size--;
+	}
+
+	bool SpatialGrid::contains(int id) const {
+		return id >= 0 && id < (int)_locations.size() && _locations[id].cell >= 0;
+	}
+
+	void SpatialGrid::query(const AABB &region, std::vector<int> &result) const {
+		if (_size == 0)
+			return;
+		int x0, y0, x1, y1;
+		cellRange(region, x0, y0, x1, y1);
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				int index = y * _columns + x;
+				if (!_cellBounds[index].intersects(region))
+					continue;
+				const std::vector<Entry> &cell = _cells[index];
+				for (size_t i = 0; i < cell.size(); i++)
+					if (cell[i].bounds.intersects(region))
+						result.push_back(cell[i].id);
+			}
+		}
+
+		const std::vector<Entry> &oversized = _cells[oversizedCell()];
+		for (size_t i = 0; i < oversized.size(); i++)
+			if (oversized[i].bounds.intersects(region))
+				result.push_back(oversized[i].id);
+	}
+
+	void SpatialGrid::queryPoint(glm::vec2 point, std::vector<int> &result) const {
+		if (_size == 0)
+			return;
+		int x0, y0, x1, y1;
+		cellRange(AABB(point, point), x0, y0, x1, y1);
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				int index = y * _columns + x;
+				if (!_cellBounds[index].contains(point))
+					continue;
+				const std::vector<Entry> &cell = _cells[index];
+				for (size_t i = 0; i < cell.size(); i++)
+					if (cell[i].bounds.contains(point))
+						result.push_back(cell[i].id);
+			}
+		}
+
+		const std::vector<Entry> &oversized = _cells[oversizedCell()];
+		for (size_t i = 0; i < oversized.size(); i++)
+			if (oversized[i].bounds.contains(point))
+				result.push_back(oversized[i].id);
+	}
+
+	Bvh::Bvh() {
+		_needsRefit = false;
+	}
+
+	void Bvh::build(const std::vector<AABB> &bounds) {
+		_bounds = bounds;
+		_nodes.clear();
+		_indices.resize(bounds.size());
+		if (bounds.empty())
+			return;
+
+		std::vector<glm::vec2> centers(bounds.size());
+		for (size_t i = 0; i < bounds.size(); i++) {
+			_indices[i] = (int)i;
+			centers[i] = bounds[i].center();
+		}
+
+		// a binary tree with n / LEAF_SIZE leaves has less than twice as many nodes
+		_nodes.reserve(2 * (bounds.size() / LEAF_SIZE + 1));
+		_nodes.push_back(Node());
+		split(0, 0, (int)bounds.size(), centers);
+		_needsRefit = false;
+	}
+
+	void Bvh::split(int node, int begin, int end, std::vector<glm::vec2> &centers) {
+		AABB bounds, centerBounds;
+		for (int i = begin; i < end; i++) {
+			bounds.expand(_bounds[_indices[i]]);
+			centerBounds.expand(centers[_indices[i]]);
+		}
+		_nodes[node].bounds = bounds;
+
+		if (end - begin <= LEAF_SIZE) {
+			_nodes[node].first = begin;
+			_nodes[node].count = end - begin;
+			return;
+		}
+
+		// median split along the longest axis of the centers
+		glm::vec2 extent = centerBounds.size();
+		int axis = extent.x >= extent.y ? 0 : 1;
+		int middle = (begin + end) / 2;
+		std::nth_element(_indices.begin() + begin, _indices.begin() + middle, _indices.begin() + end,
+			[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+		int left = (int)_nodes.size();
+		_nodes[node].first = left;
+		_nodes[node].count = 0;
+		_nodes.push_back(Node());
+		_nodes.push_back(Node());
+		split(left, begin, middle, centers);
+		split(left + 1, middle, end, centers);
+	}
+
+	void Bvh::clear() {
+		_nodes.clear();
+		_indices.clear();
+		_bounds.clear();
+		_needsRefit = false;
+	}
+
+	void Bvh::update(int id, const AABB &bounds) {
+		_bounds[id] = bounds;
+		_needsRefit = true;
+	}
+
+	void Bvh::refit() {
+		// children always come after their parent
+		for (int i = (int)_nodes.size() - 1; i >= 0; i--) {
+			Node &node = _nodes[i];
+			AABB bounds;
+			if (node.count > 0) {
+				for (int j = node.first; j < node.first + node.count; j++)
+					bounds.expand(_bounds[_indices[j]]);
+			} else {
+				bounds = _nodes[node.first].bounds;
+				bounds.expand(_nodes[node.first + 1].bounds);
+			}
+			node.bounds = bounds;
+		}
+		_needsRefit = false;
+	}
+
+	void Bvh::query(const AABB &region, std::vector<int> &result) {
+		if (_nodes.empty())
+			return;
+		if (_needsRefit)
+			refit();
+
+		_stack.clear();
+		_stack.push_back(0);
+		while (!_stack.empty()) {
+			const Node &node = _nodes[_stack.back()];
+			_stack.pop_back();
+			if (!node.bounds.intersects(region))
+				continue;
+			if (node.count > 0) {
+				for (int j = node.first; j < node.first + node.count; j++)
+					if (_bounds[_indices[j]].intersects(region))
+						result.push_back(_indices[j]);
+			} else {
+				_stack.push_back(node.first + 1);
+				_stack.push_back(node.first);
+			}
+		}
+	}
+
+	void Bvh::queryPoint(glm::vec2 point, std::vector<int> &result) {
+		query(AABB(point, point), result);
+	}
+
+	// milliseconds elapsed since start
+	static double elapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void benchmarkSpatialIndex(std::ostream &out, int objectCount) {
+		// about one object per square unit, sizes varying tenfold
+		float extent = 0.5f * std::sqrt((float)objectCount);
+		std::mt19937 random(2019);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.05f, 0.5f);
+		std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+
+		std::vector<AABB> bounds(objectCount);
+		for (int i = 0; i < objectCount; i++)
+			bounds[i] = AABB::around(glm::vec2(position(random), position(random)), size(random));
+
+		// a tenth of the objects move a little every frame
+		int moving = objectCount / 10;
+		std::vector<AABB> moved(moving);
+		for (int i = 0; i < moving; i++) {
+			glm::vec2 delta(step(random), step(random));
+			moved[i] = AABB(bounds[i].min + delta, bounds[i].max + delta);
+		}
+
+		// view sized regions and points
+		const int REGION_QUERIES = 1000, POINT_QUERIES = 100000;
+		std::vector<AABB> regions(REGION_QUERIES);
+		for (int i = 0; i < REGION_QUERIES; i++)
+			regions[i] = AABB::around(glm::vec2(position(random), position(random)), 10.0f);
+		std::vector<glm::vec2> points(POINT_QUERIES);
+		for (int i = 0; i < POINT_QUERIES; i++)
+			points[i] = glm::vec2(position(random), position(random));
+
+		AABB world;
+		for (int i = 0; i < objectCount; i++)
+			world.expand(bounds[i]);
+
+		out << "Spatial index benchmark: " << objectCount << " objects, "
+			<< moving << " moved, " << REGION_QUERIES << " region and "
+			<< POINT_QUERIES << " point queries\n";
+		out << std::fixed << std::setprecision(2);
+
+		std::vector<int> result;
+		for (int type = 0; type < 3; type++) {
+			SpatialIndexType indexType = (SpatialIndexType)type;
+			SpatialGrid grid;
+			Bvh bvh;
+			size_t found = 0;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (indexType == SpatialIndexType::Grid) {
+				grid.reset(world, 2.0f);
+				for (int i = 0; i < objectCount; i++)
+					grid.insert(i, bounds[i]);
+			} else if (indexType == SpatialIndexType::Bvh) {
+				bvh.build(bounds);
+			}
+			double buildMs = elapsedMilliseconds(start);
+
+			start = std::chrono::steady_clock::now();
+			if (indexType == SpatialIndexType::Grid) {
+				for (int i = 0; i < moving; i++)
+					grid.move(i, moved[i]);
+			} else if (indexType == SpatialIndexType::Bvh) {
+				for (int i = 0; i < moving; i++)
+					bvh.update(i, moved[i]);
+				bvh.refit();
+			}
+			double updateMs = elapsedMilliseconds(start);
+
+			// the linear scan is too slow for every query: it runs a sample
+			int regionQueries = indexType == SpatialIndexType::Linear ? REGION_QUERIES / 100 : REGION_QUERIES;
+			int pointQueries = indexType == SpatialIndexType::Linear ? POINT_QUERIES / 10000 : POINT_QUERIES;
+
+			start = std::chrono::steady_clock::now();
+			for (int q = 0; q < regionQueries; q++) {
+				result.clear();
+				if (indexType == SpatialIndexType::Grid)
+					grid.query(regions[q], result);
+				else if (indexType == SpatialIndexType::Bvh)
+					bvh.query(regions[q], result);
+				else
+					for (int i = 0; i < objectCount; i++)
+						if ((i < moving ? moved[i] : bounds[i]).intersects(regions[q]))
+							result.push_back(i);
+				found += result.size();
+			}
+			double regionMs = elapsedMilliseconds(start);
+
+			start = std::chrono::steady_clock::now();
+			for (int q = 0; q < pointQueries; q++) {
+				result.clear();
+				if (indexType == SpatialIndexType::Grid)
+					grid.queryPoint(points[q], result);
+				else if (indexType == SpatialIndexType::Bvh)
+					bvh.queryPoint(points[q], result);
+				else
+					for (int i = 0; i < objectCount; i++)
+						if ((i < moving ? moved[i] : bounds[i]).contains(points[q]))
+							result.push_back(i);
+			}
+			double pointMs = elapsedMilliseconds(start);
+
+			out << "  " << std::setw(11) << spatialIndexName(indexType)
+				<< ": build " << std::setw(8) << buildMs << " ms"
+				<< " | update " << std::setw(7) << updateMs << " ms"
+				<< " | region " << std::setw(10) << regionQueries / (regionMs * 0.001) << " queries/s ("
+				<< found / regionQueries << " hits)"
+				<< " | point " << std::setw(11) << pointQueries / (pointMs * 0.001) << " queries/s\n";
+		}
+	}
+
+	void benchmarkSpatialOrder(std::ostream &out, int objectCount) {
+		float extent = 0.5f * std::sqrt((float)objectCount);
+		std::mt19937 random(2019);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.05f, 0.5f);
+
+		// object records as large as the packed instances (48 bytes)
+		struct Object {
+			AABB bounds;
+			float shape[4];
+			float color[4];
+		};
+		std::vector<Object> insertionOrder(objectCount);
+		for (int i = 0; i < objectCount; i++) {
+			insertionOrder[i].bounds = AABB::around(glm::vec2(position(random), position(random)), size(random));
+			for (int j = 0; j < 4; j++) {
+				insertionOrder[i].shape[j] = (float)j;
+				insertionOrder[i].color[j] = 1.0f;
+			}
+		}
+
+		const int VIEWS = 1000;
+		std::vector<AABB> views(VIEWS);
+		for (int i = 0; i < VIEWS; i++)
+			views[i] = AABB::around(glm::vec2(position(random), position(random)), 20.0f);
+
+		out << "Spatial order benchmark: " << objectCount << " objects, " << VIEWS
+			<< " views culled with the loose grid and packed\n";
+		out << std::fixed << std::setprecision(2);
+
+		std::vector<int> visible;
+		std::vector<Object> packed;
+		for (int c = 0; c < 3; c++) {
+			SpaceFillingCurve curve = (SpaceFillingCurve)c;
+
+			// store the objects along the curve
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<glm::vec2> centers(objectCount);
+			for (int i = 0; i < objectCount; i++)
+				centers[i] = insertionOrder[i].bounds.center();
+			std::vector<int> order;
+			spatialOrder(centers, curve, order);
+			std::vector<Object> objects(objectCount);
+			for (int i = 0; i < objectCount; i++)
+				objects[i] = insertionOrder[order[i]];
+			double sortMs = elapsedMilliseconds(start);
+
+			AABB world;
+			for (int i = 0; i < objectCount; i++)
+				world.expand(objects[i].bounds);
+			SpatialGrid grid;
+			grid.reset(world, 2.0f);
+			for (int i = 0; i < objectCount; i++)
+				grid.insert(i, objects[i].bounds);
+
+			// culling as the renderer does it: query, restore the storage
+			// order, gather the visible records
+			start = std::chrono::steady_clock::now();
+			size_t total = 0;
+			for (int v = 0; v < VIEWS; v++) {
+				visible.clear();
+				grid.query(views[v], visible);
+				std::sort(visible.begin(), visible.end());
+				packed.resize(visible.size());
+				for (size_t i = 0; i < visible.size(); i++)
+					packed[i] = objects[visible[i]];
+				total += packed.size();
+			}
+			double cullMs = elapsedMilliseconds(start);
+
+			// locality of the packed instances: average storage distance
+			// between consecutive visible objects of the last view
+			double gap = 0.0;
+			for (size_t i = 1; i < visible.size(); i++)
+				gap += visible[i] - visible[i - 1];
+			gap /= visible.size() > 1 ? visible.size() - 1 : 1;
+
+			out << "  " << std::setw(9) << spaceFillingCurveName(curve)
+				<< ": sort " << std::setw(7) << sortMs << " ms"
+				<< " | cull+pack " << std::setw(9) << VIEWS / (cullMs * 0.001) << " views/s ("
+				<< total / VIEWS << " objects)"
+				<< " | mean storage gap " << std::setw(9) << gap << " records\n";
+		}
+	}
+}
@@ -0,0 +1,149 @@
+#include <cg_structured_affine.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+namespace cgicmc {
+
+	// the primitives as the window used to build them: full mat4s
+	static glm::mat4 glmTranslation(float x, float y) {
+		glm::mat4 m(1.0f);
+		m[3][0] = x;
+		m[3][1] = y;
+		return m;
+	}
+
+	static glm::mat4 glmRotation(float cos, float sin) {
+		glm::mat4 m(1.0f);
+		m[0][0] = cos;
+		m[0][1] = sin;
+		m[1][0] = -sin;
+		m[1][1] = cos;
+		return m;
+	}
+
+	static glm::mat4 glmScaling(float x, float y) {
+		glm::mat4 m(1.0f);
+		m[0][0] = x;
+		m[1][1] = y;
+		return m;
+	}
+
+	// the parameters of one transform; the sines and cosines are computed
+	// beforehand, only the composition is timed
+	struct ChainInput {
+		float x, y, cos, sin, scale, pivotX, pivotY;
+	};
+
+	void benchmarkStructuredAffine(std::ostream &out, int count) {
+		const int REPEATS = 20, CHAINS = 4;
+		std::mt19937 random(2046);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<ChainInput> inputs(count);
+		for (ChainInput &input : inputs) {
+			float angle = unit(random) * 6.2831853f;
+			input = { unit(random) - 0.5f, unit(random) - 0.5f, std::cos(angle), std::sin(angle), 0.5f + unit(random),
+				unit(random) - 0.5f, unit(random) - 0.5f };
+		}
+
+		out << "Structured affine benchmark: " << count << " transforms, " << REPEATS << " passes\n";
+		out << std::fixed << std::setprecision(2);
+
+		const char *names[CHAINS] = { "rotate, translate", "scale, rotate, translate", "rotate about pivot, translate",
+			"parent * child (R T each)" };
+		std::vector<glm::mat4> glmResults(count);
+		std::vector<Affine2D> genericResults(count), structuredResults(count);
+
+		for (int chainIndex = 0; chainIndex < CHAINS; chainIndex++) {
+			// time one way of composing the chain, writing every result
+			auto time = [&](auto &&compose) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (int repeat = 0; repeat < REPEATS; repeat++)
+					for (int i = 0; i < count; i++)
+						compose(i);
+				return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / REPEATS / count;
+			};
+
+			double glmNanoseconds = time([&](int i) {
+				const ChainInput &in = inputs[i];
+				const ChainInput &next = inputs[(i + 1) % count];
+				switch (chainIndex) {
+				case 0:
+					glmResults[i] = glmTranslation(in.x, in.y) * glmRotation(in.cos, in.sin);
+					break;
+				case 1:
+					glmResults[i] = glmTranslation(in.x, in.y) * glmRotation(in.cos, in.sin) * glmScaling(in.scale, in.scale);
+					break;
+				case 2:
+					glmResults[i] = glmTranslation(in.x, in.y) * glmTranslation(in.pivotX, in.pivotY) * glmRotation(in.cos, in.sin)
+						* glmTranslation(-in.pivotX, -in.pivotY);
+					break;
+				default:
+					glmResults[i] = glmTranslation(in.x, in.y) * glmRotation(in.cos, in.sin) * glmTranslation(next.x, next.y)
+						* glmRotation(next.cos, next.sin);
+				}
+			});
+
+			double genericNanoseconds = time([&](int i) {
+				const ChainInput &in = inputs[i];
+				const ChainInput &next = inputs[(i + 1) % count];
+				switch (chainIndex) {
+				case 0:
+					genericResults[i] = Affine2D::translation(in.x, in.y) * Affine2D::rotation(in.cos, in.sin);
+					break;
+				case 1:
+					genericResults[i] = Affine2D::translation(in.x, in.y) * Affine2D::rotation(in.cos, in.sin)
+						* Affine2D::scaling(in.scale, in.scale);
+					break;
+				case 2:
+					genericResults[i] = Affine2D::translation(in.x, in.y) * Affine2D::rotation(in.cos, in.sin).about(in.pivotX, in.pivotY);
+					break;
+				default:
+					genericResults[i] = Affine2D::translation(in.x, in.y) * Affine2D::rotation(in.cos, in.sin)
+						* Affine2D::translation(next.x, next.y) * Affine2D::rotation(next.cos, next.sin);
+				}
+			});
+
+			double structuredNanoseconds = time([&](int i) {
+				const ChainInput &in = inputs[i];
+				const ChainInput &next = inputs[(i + 1) % count];
+				switch (chainIndex) {
+				case 0:
+					structuredResults[i] = chain(structuredRotation(in.cos, in.sin), structuredTranslation(in.x, in.y)).toAffine();
+					break;
+				case 1:
+					structuredResults[i] = chain(structuredScaling(in.scale, in.scale), structuredRotation(in.cos, in.sin),
+						structuredTranslation(in.x, in.y)).toAffine();
+					break;
+				case 2:
+					structuredResults[i] = chain(structuredTranslation(-in.pivotX, -in.pivotY), structuredRotation(in.cos, in.sin),
+						structuredTranslation(in.pivotX, in.pivotY), structuredTranslation(in.x, in.y)).toAffine();
+					break;
+				default:
+					structuredResults[i] = (structuredTranslation(in.x, in.y) * structuredRotation(in.cos, in.sin)
+						* structuredTranslation(next.x, next.y) * structuredRotation(next.cos, next.sin)).toAffine();
+				}
+			});
+
+			float difference = 0.0f;
+			for (int i = 0; i < count; i++) {
+				const Affine2D &g = genericResults[i], &s = structuredResults[i];
+				const glm::mat4 &m = glmResults[i];
+				float values[6] = { s.a, s.b, s.c, s.d, s.tx, s.ty };
+				float generic[6] = { g.a, g.b, g.c, g.d, g.tx, g.ty };
+				float expected[6] = { m[0][0], m[0][1], m[1][0], m[1][1], m[3][0], m[3][1] };
+				for (int k = 0; k < 6; k++)
+					difference = std::max(difference, std::max(std::fabs(values[k] - expected[k]), std::fabs(generic[k] - expected[k])));
+			}
+
+			out << "  " << std::setw(30) << std::left << names[chainIndex] << std::right
+				<< ": glm mat4 " << std::setw(6) << glmNanoseconds << " ns, Affine2D " << std::setw(6) << genericNanoseconds
+				<< " ns, structured " << std::setw(6) << structuredNanoseconds << " ns"
+				<< " | largest difference: " << std::scientific << std::setprecision(1) << difference
+				<< std::fixed << std::setprecision(2) << "\n";
+		}
+	}
+}
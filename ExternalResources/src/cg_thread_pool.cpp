@@ -0,0 +1,99 @@
+#include <cg_thread_pool.hpp>
+
+namespace cgicmc {
+
+	ThreadPool::ThreadPool(int threadCount) {
+		_function = NULL;
+		_count = 0;
+		_generation = 0;
+		_running = 0;
+		_quit = false;
+		start(threadCount);
+	}
+
+	ThreadPool::~ThreadPool() {
+		stop();
+	}
+
+	void ThreadPool::setThreadCount(int threadCount) {
+		stop();
+		start(threadCount);
+	}
+
+	void ThreadPool::start(int threadCount) {
+		if (threadCount <= 0)
+			threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount <= 0)
+			threadCount = 1;
+
+		_quit = false;
+		for (int i = 1; i < threadCount; i++)
+			_workers.push_back(std::thread(&ThreadPool::work, this, i, _generation));
+	}
+
+	void ThreadPool::stop() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_wake.notify_all();
+		for (size_t i = 0; i < _workers.size(); i++)
+			_workers[i].join();
+		_workers.clear();
+	}
+
+	int ThreadPool::chunkBegin(int count, int chunkCount, int chunk) {
+		return (int)((long long)count * chunk / chunkCount);
+	}
+
+	// worker loop: wait for a new loop, run its chunk, report
+	void ThreadPool::work(int chunk, unsigned generation) {
+		for (;;) {
+			const RangeFunction *function;
+			int count;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [&] { return _quit || _generation != generation; });
+				if (_quit)
+					return;
+				generation = _generation;
+				function = _function;
+				count = _count;
+			}
+
+			int chunks = threadCount();
+			(*function)(chunkBegin(count, chunks, chunk), chunkBegin(count, chunks, chunk + 1), chunk);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_running--;
+			}
+			_finished.notify_one();
+		}
+	}
+
+	void ThreadPool::parallelFor(int count, const RangeFunction &function) {
+		int chunks = threadCount();
+		if (chunks == 1 || count < chunks) {
+			// not worth waking the workers, but keep the chunk layout
+			for (int chunk = 0; chunk < chunks; chunk++)
+				function(chunkBegin(count, chunks, chunk), chunkBegin(count, chunks, chunk + 1), chunk);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_function = &function;
+			_count = count;
+			_running = chunks - 1;
+			_generation++;
+		}
+		_wake.notify_all();
+
+		// the calling thread takes the first chunk
+		function(0, chunkBegin(count, chunks, 1), 0);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_finished.wait(lock, [&] { return _running == 0; });
+	}
+}
@@ -0,0 +1,119 @@
+#include <cg_transform.hpp>
+#include <algorithm>
+
+namespace cgicmc {
+
+	// the identity of an empty chain
+	static const Affine2D IDENTITY;
+
+	TransformPipeline::TransformPipeline() {
+		_firstChanged = 0;
+		_products = 0;
+	}
+
+	Affine2D TransformPipeline::stepMatrix(const Step &step) {
+		Affine2D matrix;
+		switch (step.type) {
+		case TransformStep::Translate:
+			return Affine2D::translation(step.value.x, step.value.y);
+		case TransformStep::Rotate:
+			matrix = Affine2D::rotation(step.angle);
+			break;
+		case TransformStep::Scale:
+			matrix = Affine2D::scaling(step.value.x, step.value.y);
+			break;
+		case TransformStep::Shear:
+			matrix = Affine2D::shearing(step.value.x, step.value.y);
+			break;
+		case TransformStep::Reflect:
+			// a null direction leaves the points where they are
+			if (step.value.x == 0.0f && step.value.y == 0.0f)
+				return Affine2D();
+			matrix = Affine2D::reflection(step.value.x, step.value.y);
+			break;
+		}
+		return matrix.about(step.pivot.x, step.pivot.y);
+	}
+
+	int TransformPipeline::add(TransformStep type, glm::vec2 value, float angle, glm::vec2 pivot) {
+		Step step;
+		step.type = type;
+		step.value = value;
+		step.angle = angle;
+		step.pivot = pivot;
+		step.matrix = stepMatrix(step);
+		_steps.push_back(step);
+		_folded.push_back(Affine2D());
+		changed((int)_steps.size() - 1);
+		return (int)_steps.size() - 1;
+	}
+
+	int TransformPipeline::translate(glm::vec2 offset) {
+		return add(TransformStep::Translate, offset, 0.0f, glm::vec2(0.0f));
+	}
+
+	int TransformPipeline::rotate(float angle, glm::vec2 pivot) {
+		return add(TransformStep::Rotate, glm::vec2(0.0f), angle, pivot);
+	}
+
+	int TransformPipeline::scale(glm::vec2 factors, glm::vec2 pivot) {
+		return add(TransformStep::Scale, factors, 0.0f, pivot);
+	}
+
+	int TransformPipeline::shear(glm::vec2 factors, glm::vec2 pivot) {
+		return add(TransformStep::Shear, factors, 0.0f, pivot);
+	}
+
+	int TransformPipeline::reflect(glm::vec2 direction, glm::vec2 pivot) {
+		return add(TransformStep::Reflect, direction, 0.0f, pivot);
+	}
+
+	void TransformPipeline::changed(int step) {
+		_firstChanged = std::min(_firstChanged, step);
+	}
+
+	void TransformPipeline::setVector(int step, glm::vec2 value) {
+		Step &s = _steps[step];
+		if (s.value.x == value.x && s.value.y == value.y)
+			return;
+		s.value = value;
+		s.matrix = stepMatrix(s);
+		changed(step);
+	}
+
+	void TransformPipeline::setAngle(int step, float angle) {
+		Step &s = _steps[step];
+		if (s.angle == angle)
+			return;
+		s.angle = angle;
+		s.matrix = stepMatrix(s);
+		changed(step);
+	}
+
+	void TransformPipeline::setPivot(int step, glm::vec2 pivot) {
+		Step &s = _steps[step];
+		if (s.pivot.x == pivot.x && s.pivot.y == pivot.y)
+			return;
+		s.pivot = pivot;
+		s.matrix = stepMatrix(s);
+		changed(step);
+	}
+
+	void TransformPipeline::clear() {
+		_steps.clear();
+		_folded.clear();
+		_firstChanged = 0;
+	}
+
+	const Affine2D &TransformPipeline::affine() {
+		int n = (int)_steps.size();
+		if (n == 0)
+			return IDENTITY;
+		for (int i = _firstChanged; i < n; i++) {
+			_folded[i] = i == 0 ? _steps[0].matrix : _steps[i].matrix * _folded[i - 1];
+			_products += i > 0;
+		}
+		_firstChanged = n;
+		return _folded[n - 1];
+	}
+}
@@ -0,0 +1,282 @@
+#include <cg_trig.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CG_TRIG_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CG_TRIG_SSE 1
+#endif
+
+namespace cgicmc {
+
+	// pi/2 in three parts: the first two have few enough bits for q times
+	// them to be exact while |q| < 2^13
+	static const float TWO_OVER_PI = 0.636619772f;
+	static const float PIO2_1 = 1.5703125f;
+	static const float PIO2_2 = 4.837512969970703125e-4f;
+	static const float PIO2_3 = 7.54978995489188216e-8f;
+
+	// minimax polynomials on [-pi/4, pi/4]:
+	//   sin r = r + r^3 (S1 + S2 r^2 + S3 r^4)
+	//   cos r = 1 - r^2 / 2 + r^4 (C1 + C2 r^2 + C3 r^4)
+	static const float S1 = -1.6666654611e-1f, S2 = 8.3321608736e-3f, S3 = -1.9515295891e-4f;
+	static const float C1 = 4.166664568298827e-2f, C2 = -1.388731625493765e-3f, C3 = 2.443315711809948e-5f;
+
+	void sinCos(float angle, float &sine, float &cosine) {
+		// adding and subtracting 1.5 2^23 rounds to nearest even, as the SIMD
+		// conversion does (for |q| < 2^22)
+		float qf = (angle * TWO_OVER_PI + 12582912.0f) - 12582912.0f;
+		int q = (int)qf;
+		float r = angle - qf * PIO2_1;
+		r = r - qf * PIO2_2;
+		r = r - qf * PIO2_3;
+		float z = r * r;
+		float s = r + (r * z) * (S1 + z * (S2 + z * S3));
+		float c = (1.0f - 0.5f * z) + (z * z) * (C1 + z * (C2 + z * C3));
+		// quadrant q mod 4: (s, c), (c, -s), (-s, -c), (-c, s)
+		if (q & 1)
+			std::swap(s, c);
+		sine = q & 2 ? -s : s;
+		cosine = (q + 1) & 2 ? -c : c;
+	}
+
+	void sinCos(const float *angles, float *sines, float *cosines, int count, bool vectorized) {
+		int i = 0;
+		if (vectorized) {
+#ifdef CG_TRIG_AVX2
+			{
+				__m256 twoOverPi = _mm256_set1_ps(TWO_OVER_PI), one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+				__m256i oneBit = _mm256_set1_epi32(1), twoBit = _mm256_set1_epi32(2);
+				for (; i + 8 <= count; i += 8) {
+					__m256 x = _mm256_loadu_ps(angles + i);
+					__m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, twoOverPi));
+					__m256 qf = _mm256_cvtepi32_ps(q);
+					__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_1)));
+					r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_2)));
+					r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_3)));
+					__m256 z = _mm256_mul_ps(r, r);
+					__m256 sinPoly = _mm256_add_ps(_mm256_set1_ps(S2), _mm256_mul_ps(z, _mm256_set1_ps(S3)));
+					sinPoly = _mm256_add_ps(_mm256_set1_ps(S1), _mm256_mul_ps(z, sinPoly));
+					__m256 s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, z), sinPoly));
+					__m256 cosPoly = _mm256_add_ps(_mm256_set1_ps(C2), _mm256_mul_ps(z, _mm256_set1_ps(C3)));
+					cosPoly = _mm256_add_ps(_mm256_set1_ps(C1), _mm256_mul_ps(z, cosPoly));
+					__m256 c = _mm256_add_ps(_mm256_sub_ps(one, _mm256_mul_ps(half, z)), _mm256_mul_ps(_mm256_mul_ps(z, z), cosPoly));
+					__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, oneBit), oneBit));
+					__m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, twoBit), 30));
+					__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, oneBit), twoBit), 30));
+					_mm256_storeu_ps(sines + i, _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign));
+					_mm256_storeu_ps(cosines + i, _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign));
+				}
+			}
+#endif
+#ifdef CG_TRIG_SSE
+			__m128 twoOverPi = _mm_set1_ps(TWO_OVER_PI), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+			__m128i oneBit = _mm_set1_epi32(1), twoBit = _mm_set1_epi32(2);
+			for (; i + 4 <= count; i += 4) {
+				__m128 x = _mm_loadu_ps(angles + i);
+				__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, twoOverPi));
+				__m128 qf = _mm_cvtepi32_ps(q);
+				__m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(PIO2_1)));
+				r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PIO2_2)));
+				r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PIO2_3)));
+				__m128 z = _mm_mul_ps(r, r);
+				__m128 sinPoly = _mm_add_ps(_mm_set1_ps(S2), _mm_mul_ps(z, _mm_set1_ps(S3)));
+				sinPoly = _mm_add_ps(_mm_set1_ps(S1), _mm_mul_ps(z, sinPoly));
+				__m128 s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), sinPoly));
+				__m128 cosPoly = _mm_add_ps(_mm_set1_ps(C2), _mm_mul_ps(z, _mm_set1_ps(C3)));
+				cosPoly = _mm_add_ps(_mm_set1_ps(C1), _mm_mul_ps(z, cosPoly));
+				__m128 c = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(half, z)), _mm_mul_ps(_mm_mul_ps(z, z), cosPoly));
+				__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, oneBit), oneBit));
+				__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, twoBit), 30));
+				__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, oneBit), twoBit), 30));
+				_mm_storeu_ps(sines + i, _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sinSign));
+				_mm_storeu_ps(cosines + i, _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosSign));
+			}
+#endif
+		}
+		for (; i < count; i++)
+			sinCos(angles[i], sines[i], cosines[i]);
+	}
+
+	const char *sinCosInstructionSet() {
+#if defined(CG_TRIG_AVX2)
+		return "AVX2";
+#elif defined(CG_TRIG_SSE)
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+
+	RotationRecurrence::RotationRecurrence() {
+		_steps = 0;
+		_vectorized = true;
+		_updateMilliseconds = 0.0;
+	}
+
+	// the step pairs are rounded from double precision: their error is
+	// repeated at every step
+	int RotationRecurrence::add(float angle, float step) {
+		float s, c;
+		sinCos(angle, s, c);
+		_start.push_back(angle - _steps * (double)step);
+		_step.push_back(step);
+		_stepCos.push_back((float)std::cos((double)step));
+		_stepSin.push_back((float)std::sin((double)step));
+		_cos.push_back(c);
+		_sin.push_back(s);
+		return (int)_cos.size() - 1;
+	}
+
+	void RotationRecurrence::setStep(int rotation, float step) {
+		_start[rotation] = _start[rotation] + _steps * ((double)_step[rotation] - step);
+		_step[rotation] = step;
+		_stepCos[rotation] = (float)std::cos((double)step);
+		_stepSin[rotation] = (float)std::sin((double)step);
+	}
+
+	void RotationRecurrence::clear() {
+		_start.clear();
+		_step.clear();
+		_stepCos.clear();
+		_stepSin.clear();
+		_cos.clear();
+		_sin.clear();
+		_steps = 0;
+	}
+
+	float RotationRecurrence::angle(int rotation) const {
+		return (float)std::remainder(_start[rotation] + _steps * (double)_step[rotation], 6.283185307179586);
+	}
+
+	// the pairs from the exact angles (in [-pi, pi], where the reduction is
+	// the most accurate)
+	void RotationRecurrence::resync() {
+		_angles.resize(_start.size());
+		for (int i = 0; i < count(); i++)
+			_angles[i] = angle(i);
+		sinCos(_angles.data(), _sin.data(), _cos.data(), count(), _vectorized);
+	}
+
+	// (cos, sin) times (stepCos, stepSin) as complex numbers, then one
+	// Newton step towards unit length: k = (3 - |p|^2) / 2
+	void RotationRecurrence::advance() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int n = count(), i = 0;
+		float *c = _cos.data(), *s = _sin.data();
+		const float *sc = _stepCos.data(), *ss = _stepSin.data();
+#ifdef CG_TRIG_SSE
+		if (_vectorized) {
+			__m128 threeHalves = _mm_set1_ps(1.5f), half = _mm_set1_ps(0.5f);
+			for (; i + 4 <= n; i += 4) {
+				__m128 c0 = _mm_loadu_ps(c + i), s0 = _mm_loadu_ps(s + i);
+				__m128 stepC = _mm_loadu_ps(sc + i), stepS = _mm_loadu_ps(ss + i);
+				__m128 c1 = _mm_sub_ps(_mm_mul_ps(c0, stepC), _mm_mul_ps(s0, stepS));
+				__m128 s1 = _mm_add_ps(_mm_mul_ps(s0, stepC), _mm_mul_ps(c0, stepS));
+				__m128 k = _mm_sub_ps(threeHalves, _mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(c1, c1), _mm_mul_ps(s1, s1))));
+				_mm_storeu_ps(c + i, _mm_mul_ps(c1, k));
+				_mm_storeu_ps(s + i, _mm_mul_ps(s1, k));
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			float c1 = c[i] * sc[i] - s[i] * ss[i];
+			float s1 = s[i] * sc[i] + c[i] * ss[i];
+			float k = 1.5f - 0.5f * (c1 * c1 + s1 * s1);
+			c[i] = c1 * k;
+			s[i] = s1 * k;
+		}
+		if (++_steps % RESYNC_STEPS == 0)
+			resync();
+		_updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// largest error of sines and cosines against double precision
+	static double trigError(const std::vector<float> &angles, const std::vector<float> &sines, const std::vector<float> &cosines) {
+		double error = 0.0;
+		for (size_t i = 0; i < angles.size(); i++) {
+			error = std::max(error, std::fabs(sines[i] - std::sin((double)angles[i])));
+			error = std::max(error, std::fabs(cosines[i] - std::cos((double)angles[i])));
+		}
+		return error;
+	}
+
+	void benchmarkTrig(std::ostream &out, int count) {
+		const int REPEATS = 20, STEPS = 3000;
+		std::mt19937 random(2047);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<float> angles(count), sines(count), cosines(count);
+		for (float &angle : angles)
+			angle = (2.0f * unit(random) - 1.0f) * 8192.0f;
+
+		out << "Trigonometry benchmark: " << count << " angles in [-8192, 8192], " << REPEATS << " passes\n";
+		out << std::fixed << std::setprecision(2);
+
+		auto time = [&](auto &&compute) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int repeat = 0; repeat < REPEATS; repeat++)
+				compute();
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+		};
+
+		double libmMilliseconds = time([&] {
+			for (int i = 0; i < count; i++) {
+				sines[i] = std::sin(angles[i]);
+				cosines[i] = std::cos(angles[i]);
+			}
+		});
+		double libmError = trigError(angles, sines, cosines);
+		double scalarMilliseconds = time([&] { sinCos(angles.data(), sines.data(), cosines.data(), count, false); });
+		double scalarError = trigError(angles, sines, cosines);
+		std::vector<float> scalarSines = sines;
+		double simdMilliseconds = time([&] { sinCos(angles.data(), sines.data(), cosines.data(), count, true); });
+		double simdError = trigError(angles, sines, cosines);
+		float difference = 0.0f;
+		for (int i = 0; i < count; i++)
+			difference = std::max(difference, std::fabs(sines[i] - scalarSines[i]));
+
+		out << "  libm sin and cos   : " << std::setw(7) << libmMilliseconds << " ms | largest error " << std::scientific
+			<< std::setprecision(1) << libmError << std::fixed << std::setprecision(2) << "\n";
+		out << "  sinCos scalar      : " << std::setw(7) << scalarMilliseconds << " ms | largest error " << std::scientific
+			<< std::setprecision(1) << scalarError << std::fixed << std::setprecision(2) << "\n";
+		out << "  sinCos " << std::setw(6) << std::left << sinCosInstructionSet() << std::right << "      : " << std::setw(7)
+			<< simdMilliseconds << " ms | largest error " << std::scientific << std::setprecision(1) << simdError
+			<< ", largest difference with scalar " << difference << std::fixed << std::setprecision(2) << "\n";
+
+		// constant-speed rotations, against their exact angles in double
+		std::vector<double> exactStart(count), exactStep(count);
+		for (int pass = 0; pass < 2; pass++) {
+			RotationRecurrence rotations;
+			rotations.setVectorized(pass == 0);
+			std::mt19937 rotationRandom(2048);
+			for (int i = 0; i < count; i++) {
+				float angle = (2.0f * unit(rotationRandom) - 1.0f) * 3.14159265f;
+				float step = (2.0f * unit(rotationRandom) - 1.0f) * 0.1f;
+				rotations.add(angle, step);
+				exactStart[i] = angle;
+				exactStep[i] = step;
+			}
+			double total = 0.0;
+			for (int step = 0; step < STEPS; step++) {
+				rotations.advance();
+				total += rotations.updateMilliseconds();
+			}
+			double error = 0.0;
+			for (int i = 0; i < count; i++) {
+				double angle = exactStart[i] + STEPS * exactStep[i];
+				error = std::max(error, std::fabs(rotations.sine(i) - std::sin(angle)));
+				error = std::max(error, std::fabs(rotations.cosine(i) - std::cos(angle)));
+			}
+			out << "  recurrence " << (pass == 0 ? "SIMD    " : "scalar  ") << ": " << std::setw(7) << total / STEPS
+				<< " ms per step | largest error after " << STEPS << " steps " << std::scientific << std::setprecision(1)
+				<< error << std::fixed << std::setprecision(2) << "\n";
+		}
+	}
+}
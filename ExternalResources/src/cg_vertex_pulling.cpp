@@ -0,0 +1,356 @@
+#include <cg_vertex_pulling.hpp>
+#include <cg_shader.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string>
+
+namespace cgicmc {
+
+	// words of a run: first vertex, index count, index word, vertex word,
+	// vertex format, instance word, instance layout, unused
+	static const int RUN_WORDS = 8;
+
+	static const char *textureStorageSource =
+		"#version 330 core\n"
+		"uniform usamplerBuffer words;\n"
+		"uint word(int i) { return texelFetch(words, i).r; }\n";
+
+	static const char *bufferStorageSource =
+		"#version 430 core\n"
+		"layout (std430, binding = 0) readonly buffer Words { uint words[]; };\n"
+		"uint word(int i) { return words[i]; }\n";
+
+	// everything comes from the words, there are no vertex attributes
+	static const char *pullingVertexShaderSource =
+		CAMERA_BLOCK_GLSL
+
+		"uniform int runCount;\n"
+		"out vec4 color;\n"
+
+		"float wordFloat(int i) { return uintBitsToFloat(word(i)); }\n"
+		"vec4 unpackColor(uint c) { return vec4(uvec4(c, c >> 8u, c >> 16u, c >> 24u) & 0xFFu) / 255.0; }\n"
+
+		"void main() {\n"
+		// the last run starting at or before this vertex
+		"   int low = 0, high = runCount - 1;\n"
+		"   while (low < high) {\n"
+		"      int middle = (low + high + 1) / 2;\n"
+		"      if (int(word(middle * 8)) <= gl_VertexID) low = middle; else high = middle - 1;\n"
+		"   }\n"
+		"   int run = low * 8;\n"
+		"   int local = gl_VertexID - int(word(run));\n"
+		"   int indexCount = int(word(run + 1));\n"
+		"   int instance = local / indexCount;\n"
+		"   int index = int(word(int(word(run + 2)) + local - instance * indexCount));\n"
+
+		"   bool vertexColor = word(run + 4) != 0u;\n"
+		"   int vertex = int(word(run + 3)) + index * (vertexColor ? 3 : 2);\n"
+		"   vec2 position = vec2(wordFloat(vertex), wordFloat(vertex + 1));\n"
+		"   color = vertexColor ? unpackColor(word(vertex + 2)) : vec4(1.0);\n"
+
+		"   vec2 world;\n"
+		"   if (word(run + 6) == 0u) {\n" // offset and scale
+		"      int data = int(word(run + 5)) + instance * 4;\n"
+		"      world = position * wordFloat(data + 2) + vec2(wordFloat(data), wordFloat(data + 1));\n"
+		"      color *= unpackColor(word(data + 3));\n"
+		"   } else {\n" // a, b, c, d, tx, ty
+		"      int data = int(word(run + 5)) + instance * 7;\n"
+		"      world = vec2(wordFloat(data) * position.x + wordFloat(data + 2) * position.y + wordFloat(data + 4),\n"
+		"         wordFloat(data + 1) * position.x + wordFloat(data + 3) * position.y + wordFloat(data + 5));\n"
+		"      color *= unpackColor(word(data + 6));\n"
+		"   }\n"
+		"   gl_Position = camera.view * vec4(world, 0.0, 1.0);\n"
+		"}\0";
+
+	static const char *pullingFragmentShaderSource =
+		"in vec4 color;\n"
+		"out vec4 FragColor;\n"
+		"void main() {\n"
+		"   FragColor = color;\n"
+		"}\0";
+
+	static GLuint floatBits(float value) {
+		GLuint bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	static GLuint packColor(glm::vec4 color) {
+		GLuint packed = 0;
+		for (int i = 0; i < 4; i++)
+			packed |= (GLuint)(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f) << (8 * i);
+		return packed;
+	}
+
+	static int instanceWords(InstanceLayout layout) {
+		return layout == InstanceLayout::OffsetScale ? 4 : 7;
+	}
+
+	const char *pullingStorageName(PullingStorage storage) {
+		switch (storage) {
+		case PullingStorage::TextureBuffer: return "buffer texture";
+		case PullingStorage::StorageBuffer: return "storage buffer";
+		}
+		return "";
+	}
+
+	VertexPuller::VertexPuller() {
+		_runCount = 0;
+		_instanceWord = 0;
+		_vertexCount = 0;
+		_layoutDirty = true;
+		_instancesDirty = true;
+		_storage = PullingStorage::TextureBuffer;
+		_programs[0] = 0;
+		_programs[1] = 0;
+		_VAO = 0;
+		_buffer = 0;
+		_texture = 0;
+		_capacity = 0;
+		_uploadedBytes = 0;
+		_maxTexels = 0;
+		_runCountLocations[0] = -1;
+		_runCountLocations[1] = -1;
+	}
+
+	void VertexPuller::create() {
+		std::string fragment = std::string("#version 330 core\n") + pullingFragmentShaderSource;
+		_programs[0] = createShaderProgram((std::string(textureStorageSource) + pullingVertexShaderSource).c_str(), fragment.c_str());
+		glUseProgram(_programs[0]);
+		glUniform1i(glGetUniformLocation(_programs[0], "words"), 0);
+		if (GLAD_GL_VERSION_4_3) {
+			_programs[1] = createShaderProgram((std::string(bufferStorageSource) + pullingVertexShaderSource).c_str(), fragment.c_str());
+			_storage = PullingStorage::StorageBuffer;
+		}
+		for (int i = 0; i < 2; i++) {
+			if (!_programs[i])
+				continue;
+			Camera::bindBlock(_programs[i]);
+			_runCountLocations[i] = glGetUniformLocation(_programs[i], "runCount");
+		}
+
+		// a core context draws with a vertex array bound, even an empty one
+		glGenVertexArrays(1, &_VAO);
+		glGenBuffers(1, &_buffer);
+		glGenTextures(1, &_texture);
+		glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, _buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &_maxTexels);
+		_capacity = 0;
+		_layoutDirty = true;
+	}
+
+	void VertexPuller::destroy() {
+		if (!_programs[0])
+			return;
+		for (int i = 0; i < 2; i++)
+			if (_programs[i])
+				glDeleteProgram(_programs[i]);
+		glDeleteVertexArrays(1, &_VAO);
+		glDeleteBuffers(1, &_buffer);
+		glDeleteTextures(1, &_texture);
+		_programs[0] = 0;
+		_programs[1] = 0;
+	}
+
+	int VertexPuller::addMesh(const std::vector<glm::vec2> &positions, const std::vector<GLuint> &indices) {
+		return addMesh(positions, std::vector<glm::vec4>(), indices);
+	}
+
+	int VertexPuller::addMesh(const std::vector<glm::vec2> &positions, const std::vector<glm::vec4> &colors,
+		const std::vector<GLuint> &indices) {
+		Mesh mesh;
+		mesh.format = colors.empty() ? VertexFormat::Position : VertexFormat::PositionColor;
+		mesh.indexCount = (int)indices.size();
+		mesh.indexWord = (int)_meshWords.size();
+		_meshWords.insert(_meshWords.end(), indices.begin(), indices.end());
+		mesh.vertexWord = (int)_meshWords.size();
+		for (size_t i = 0; i < positions.size(); i++) {
+			_meshWords.push_back(floatBits(positions[i].x));
+			_meshWords.push_back(floatBits(positions[i].y));
+			if (!colors.empty())
+				_meshWords.push_back(packColor(colors[i]));
+		}
+		_meshes.push_back(mesh);
+		_layoutDirty = true;
+		return (int)_meshes.size() - 1;
+	}
+
+	int VertexPuller::add(int mesh, glm::vec2 offset, float scale, glm::vec4 color) {
+		_instances.push_back({ mesh, InstanceLayout::OffsetScale, 0 });
+		_transforms.push_back(Affine2D(scale, 0.0f, 0.0f, scale, offset.x, offset.y));
+		_colors.push_back(packColor(color));
+		_layoutDirty = true;
+		return (int)_instances.size() - 1;
+	}
+
+	int VertexPuller::add(int mesh, const Affine2D &transform, glm::vec4 color) {
+		_instances.push_back({ mesh, InstanceLayout::Affine, 0 });
+		_transforms.push_back(transform);
+		_colors.push_back(packColor(color));
+		_layoutDirty = true;
+		return (int)_instances.size() - 1;
+	}
+
+	void VertexPuller::setOffset(int instance, glm::vec2 offset, float scale) {
+		_transforms[instance] = Affine2D(scale, 0.0f, 0.0f, scale, offset.x, offset.y);
+		writeInstance(instance);
+	}
+
+	void VertexPuller::setTransform(int instance, const Affine2D &transform) {
+		_transforms[instance] = transform;
+		writeInstance(instance);
+	}
+
+	void VertexPuller::setTransforms(int first, int count, const Affine2D *transforms) {
+		std::copy(transforms, transforms + count, _transforms.begin() + first);
+		for (int i = first; i < first + count; i++)
+			writeInstance(i);
+	}
+
+	void VertexPuller::setColor(int instance, glm::vec4 color) {
+		_colors[instance] = packColor(color);
+		writeInstance(instance);
+	}
+
+	void VertexPuller::clear() {
+		_instances.clear();
+		_transforms.clear();
+		_colors.clear();
+		_vertexCount = 0;
+		_layoutDirty = true;
+	}
+
+	void VertexPuller::setStorage(PullingStorage storage) {
+		if (storage == _storage || (storage == PullingStorage::StorageBuffer && !_programs[1]))
+			return;
+		_storage = storage;
+		// the upload checks that the words fit in the buffer texture
+		_instancesDirty = true;
+	}
+
+	// the words of an instance, in place (after a rebuild, build() writes
+	// them all)
+	void VertexPuller::writeInstance(int instance) {
+		_instancesDirty = true;
+		if (_layoutDirty)
+			return;
+		const Instance &record = _instances[instance];
+		const Affine2D &t = _transforms[instance];
+		GLuint *data = &_words[record.word];
+		if (record.layout == InstanceLayout::OffsetScale) {
+			data[0] = floatBits(t.tx);
+			data[1] = floatBits(t.ty);
+			data[2] = floatBits(t.a);
+			data[3] = _colors[instance];
+		} else {
+			data[0] = floatBits(t.a);
+			data[1] = floatBits(t.b);
+			data[2] = floatBits(t.c);
+			data[3] = floatBits(t.d);
+			data[4] = floatBits(t.tx);
+			data[5] = floatBits(t.ty);
+			data[6] = _colors[instance];
+		}
+	}
+
+	// the instances grouped by mesh and layout, one run per group
+	void VertexPuller::build() {
+		std::vector<int> order(_instances.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			if (_instances[a].mesh != _instances[b].mesh)
+				return _instances[a].mesh < _instances[b].mesh;
+			return _instances[a].layout < _instances[b].layout;
+		});
+
+		int runs = 0;
+		for (size_t i = 0; i < order.size(); i++)
+			if (i == 0 || _instances[order[i]].mesh != _instances[order[i - 1]].mesh
+				|| _instances[order[i]].layout != _instances[order[i - 1]].layout)
+				runs++;
+
+		int meshWord = runs * RUN_WORDS;
+		_instanceWord = meshWord + (int)_meshWords.size();
+		_words.assign(_instanceWord, 0);
+		std::copy(_meshWords.begin(), _meshWords.end(), _words.begin() + meshWord);
+		_runCount = 0;
+
+		int vertex = 0, word = _instanceWord;
+		for (size_t i = 0; i < order.size(); i++) {
+			Instance &instance = _instances[order[i]];
+			const Mesh &mesh = _meshes[instance.mesh];
+			if (i == 0 || instance.mesh != _instances[order[i - 1]].mesh || instance.layout != _instances[order[i - 1]].layout) {
+				GLuint *run = &_words[(size_t)_runCount * RUN_WORDS];
+				run[0] = (GLuint)vertex;
+				run[1] = (GLuint)mesh.indexCount;
+				run[2] = (GLuint)(meshWord + mesh.indexWord);
+				run[3] = (GLuint)(meshWord + mesh.vertexWord);
+				run[4] = mesh.format == VertexFormat::PositionColor ? 1 : 0;
+				run[5] = (GLuint)word;
+				run[6] = instance.layout == InstanceLayout::Affine ? 1 : 0;
+				_runCount++;
+			}
+			instance.word = word;
+			word += instanceWords(instance.layout);
+			vertex += mesh.indexCount;
+		}
+		_vertexCount = vertex;
+		_words.resize(word);
+		_layoutDirty = false;
+		for (size_t i = 0; i < _instances.size(); i++)
+			writeInstance((int)i);
+	}
+
+	void VertexPuller::draw(const Camera &camera) {
+		if (_instances.empty() || !_programs[0])
+			return;
+
+		bool rebuilt = _layoutDirty;
+		if (_layoutDirty)
+			build();
+		if (_vertexCount == 0)
+			return;
+		if (_instancesDirty) {
+			glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+			if (_words.size() > _capacity) {
+				_capacity = _words.size() * 2;
+				glBufferData(GL_TEXTURE_BUFFER, _capacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+				rebuilt = true;
+			}
+			// the runs and meshes only change with the layout
+			size_t first = rebuilt ? 0 : (size_t)_instanceWord;
+			_uploadedBytes = (_words.size() - first) * sizeof(GLuint);
+			glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(GLuint), _uploadedBytes, &_words[first]);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			_instancesDirty = false;
+
+			if (_storage == PullingStorage::TextureBuffer && _words.size() > (size_t)_maxTexels) {
+				if (_programs[1]) {
+					_storage = PullingStorage::StorageBuffer;
+				} else {
+					std::cout << "Vertex pulling: " << _words.size() << " words, more than the "
+						<< _maxTexels << " texels of a buffer texture\n";
+				}
+			}
+		}
+
+		int program = _storage == PullingStorage::StorageBuffer ? 1 : 0;
+		glUseProgram(_programs[program]);
+		camera.bind();
+		if (program == 1) {
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _buffer);
+		} else {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		}
+		glUniform1i(_runCountLocations[program], _runCount);
+		glBindVertexArray(_VAO);
+		glDrawArrays(GL_TRIANGLES, 0, _vertexCount);
+	}
+}
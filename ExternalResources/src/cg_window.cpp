@@ -1,15 +1,35 @@
 #include <cg_window.hpp>
+#include <cg_shader.hpp>
+#include <cassert>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <cmath>
 
 namespace cgicmc {
 
+	// the pinwheel script: spin one way for 2 s, stop, then the other way
+	static Script spinAndReverse(float *speed) {
+		float turn = 0.05f;
+		for (;;) {
+			co_await tween(*speed, turn, 0.5f);
+			co_await wait(2.0f);
+			co_await tween(*speed, 0.0f, 0.3f, Easing::EaseOut);
+			co_await wait(0.5f);
+			turn = -turn;
+		}
+	}
+
 	// Window constructor
 	Window::Window() {
 		// initialize and configure the glfw
 		glfwInit();
-		glfwWindowHint(GLFW_SAMPLES, 4); // apply 4x antialiasing
+		glfwWindowHint(GLFW_SAMPLES, 0); // antialiasing is done offscreen (see AntiAliasing)
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // select OpenGL version 3.3
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_DEPTH_BITS, 0); // 2D only: no depth or stencil buffer
+		glfwWindowHint(GLFW_STENCIL_BITS, 0);
 
 		// initialize the translation values
 		x = 0;
@@ -20,6 +40,132 @@ namespace cgicmc {
 		spacePressed = false;
 		rotationAngle = 0;
 		rotationSpeed = 0.01f;
+
+		// initialize the window values
+		_window = NULL;
+		_width = 0;
+		_height = 0;
+		pendingWidth = 0;
+		pendingHeight = 0;
+		resizePending = false;
+		resizeEvents = 0;
+		lastFrameTime = 0;
+		frameDelta = 0.0f;
+		physicsAccumulator = 0;
+		renderScale = 1.0f;
+		pendingScroll = 0;
+		lastCameraVersion = 0;
+		sceneLayer = -1;
+		indexKeyPressed = false;
+		sortKeyPressed = false;
+
+		// initialize the picking values
+		pickMode = PickMode::Cpu;
+		mousePressed = false;
+		pickKeyPressed = false;
+		pickRequested = false;
+		selected = GpuPicker::NO_ID;
+		selectedColor = glm::vec4(0.0f);
+		pinwheelModel = glm::mat4(1.0f);
+
+		// initialize the collision values
+		useCollisions = false;
+		collisionKeyPressed = false;
+		freeX = 0;
+		freeY = 0;
+		freeAngle = 0;
+
+		// the pinwheel clips: a smooth figure eight while turning, and a
+		// square path with held steps and color changes
+		AnimationClip eight(4.0f);
+		for (int i = 0; i <= 8; i++) {
+			float t = i * 0.5f, angle = t * 1.5707963f;
+			eight.addPositionKey(t, glm::vec2(0.5f * std::sin(angle), 0.25f * std::sin(2.0f * angle)), Interpolation::Smooth);
+		}
+		eight.addRotationKey(0.0f, 0.0f);
+		eight.addRotationKey(4.0f, 6.2831853f);
+		eight.addColorKey(0.0f, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), Interpolation::Smooth);
+		eight.addColorKey(2.0f, glm::vec4(1.0f, 0.6f, 0.0f, 1.0f), Interpolation::Smooth);
+		eight.addColorKey(4.0f, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), Interpolation::Smooth);
+		AnimationClip square(4.0f);
+		glm::vec2 corners[] = { glm::vec2(-0.4f, -0.4f), glm::vec2(0.4f, -0.4f), glm::vec2(0.4f, 0.4f), glm::vec2(-0.4f, 0.4f) };
+		for (int i = 0; i <= 4; i++) {
+			square.addPositionKey(i * 1.0f, corners[i % 4]);
+			square.addRotationKey(i * 1.0f, i * 1.5707963f, Interpolation::Step);
+			square.addColorKey(i * 1.0f, glm::vec4(0.2f * i, 1.0f - 0.2f * i, 0.5f, 1.0f), Interpolation::Step);
+		}
+		pinwheelAnimator.addClip(eight);
+		pinwheelAnimator.addClip(square);
+		pinwheelAnimator.addObject(0);
+		pinwheelClip = -1;
+		pinwheelClipCount = 2;
+		keyframeKeyPressed = false;
+
+		// the pinwheel path: a centripetal Catmull-Rom loop around the view
+		std::vector<glm::vec2> loop;
+		for (int i = 0; i < 7; i++) {
+			float angle = i * 0.8975979f, radius = i % 2 ? 0.3f : 0.6f;
+			loop.push_back(radius * glm::vec2(std::cos(angle), std::sin(angle)));
+		}
+		pinwheelPath.add(pinwheelPath.addPath(SplinePath::catmullRom(loop, true)), 0.0f, 0.4f);
+		usePath = false;
+		pathKeyPressed = false;
+		pinwheelScript = -1;
+		scriptKeyPressed = false;
+
+		// the moons are added under the pinwheel node when shown
+		pinwheelNode = sceneGraph.add();
+		useMoons = false;
+		moonKeyPressed = false;
+
+		// the pinwheel transform steps, applied in this order
+		scaleStep = pinwheelTransform.scale(glm::vec2(1.0f));
+		shearStep = pinwheelTransform.shear(glm::vec2(0.0f));
+		reflectStep = pinwheelTransform.reflect(glm::vec2(0.0f));
+		rotateStep = pinwheelTransform.rotate(0.0f);
+		translateStep = pinwheelTransform.translate(glm::vec2(0.0f));
+		pinwheelScale = 1.0f;
+		pinwheelShear = 0;
+		shearKeyPressed = false;
+		reflectKeyPressed = false;
+		pinwheelReflected = false;
+
+		// initialize the animation values
+		useAnimation = false;
+		animationKeyPressed = false;
+		animationStart = 0;
+
+		// initialize the tiny mesh values
+		useTinyMeshes = false;
+		pullTinyMeshes = false;
+		tinyMeshKeyPressed = false;
+
+		// initialize the particle values
+		useParticles = false;
+		particlesKeyPressed = false;
+		lastParticleTime = 0;
+		aaKeyPressed = false;
+		lastTitleUpdate = 0;
+
+		// initialize the shape values
+		pinwheelShape = -1;
+		useSdfShapes = false;
+		sdfKeyPressed = false;
+
+		// initialize the layer values
+		useLayers = false;
+		layersKeyPressed = false;
+
+		// initialize the partial redraw values
+		usePartialRedraw = false;
+		partialKeyPressed = false;
+		lastX = 0;
+		lastY = 0;
+		lastAngle = 0;
+
+		// initialize the dynamic resolution values
+		useDynamicResolution = false;
+		dynamicKeyPressed = false;
 	}
 
 	// Window destructor
@@ -30,43 +176,50 @@ namespace cgicmc {
 		"#version 330 core\n"
 		"layout (location = 0) in vec3 aPos;\n"
 
+		CAMERA_BLOCK_GLSL
 		"uniform mat4 transform;\n"
 
+		// barycentric coordinates of the vertex inside its triangle (analytic AA)
+		"out vec3 barycentric;\n"
+
 		"void main() {\n"
-		"   gl_Position = transform * vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+		"   int corner = gl_VertexID % 3;\n"
+		"   barycentric = vec3(corner == 0, corner == 1, corner == 2);\n"
+		"   gl_Position = camera.view * transform * vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
 		"}\0";
 
 	// fragment shader source string
 	const char *fragmentShaderSource = "#version 330 core\n"
-		"out vec3 FragColor;\n"
-		"void main() {\n"
-		"   FragColor = vec3(1.0f, 0.0f, 0.0f);\n"
-		"}\n\0";
+		"in vec3 barycentric;\n"
+		"out vec4 FragColor;\n"
 
-	// program rendering pipeline attaching all shaders
-	GLint createRenderingPipeline() {
+		"uniform bool edgeAA;\n"
 
-		// create the vertex shader using vertexShaderSource
-		GLint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, GL_TRUE, &vertexShaderSource, NULL);
-		glCompileShader(vertexShader);
+		"void main() {\n"
+		"   float coverage = 1.0;\n"
+		// distance to the closest edge in pixels gives the covered fraction
+		"   if (edgeAA) {\n"
+		"       vec3 edge = barycentric / fwidth(barycentric);\n"
+		"       coverage = clamp(min(edge.x, min(edge.y, edge.z)) + 0.5, 0.0, 1.0);\n"
+		"   }\n"
+		"   FragColor = vec4(1.0f, 0.0f, 0.0f, coverage);\n"
+		"}\n\0";
 
-		// create the fragment shader using fragmentShaderSource
-		GLint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, GL_TRUE, &fragmentShaderSource, NULL);
-		glCompileShader(fragmentShader);
+	// picking fragment shader: the id of the pinwheel for every covered pixel
+	const char *idFragmentShaderSource = "#version 330 core\n"
+		"out uint FragId;\n"
 
-		// create the program using the shaders
-		GLint shaderProgram = glCreateProgram();
-		glAttachShader(shaderProgram, vertexShader);
-		glAttachShader(shaderProgram, fragmentShader);
-		glLinkProgram(shaderProgram);
+		"uniform uint pickId;\n"
 
-		// delete the shaders
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+		"void main() {\n"
+		"   FragId = pickId;\n"
+		"}\n\0";
 
-		return shaderProgram;
+	// program rendering pipeline attaching all shaders
+	GLint createRenderingPipeline() {
+		GLuint program = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+		Camera::bindBlock(program);
+		return program;
 	}
 
 	// create a single window with the specified size
@@ -82,7 +235,403 @@ namespace cgicmc {
 			std::cout << "Failed to initialize GLAD\n";
 			exit(-2);
 		}
+
+		// on HiDPI screens the framebuffer has more pixels than the window
+		// has screen coordinates: every target follows the framebuffer
+		glfwGetFramebufferSize(_window, &width, &height);
+		glViewport(0, 0, width, height);
+		_width = width;
+		_height = height;
+		glfwSetWindowUserPointer(_window, this);
+		glfwSetFramebufferSizeCallback(_window, framebufferSizeCallback);
+		glfwSetScrollCallback(_window, scrollCallback);
+
+		// view of the world (the aspect follows the framebuffer)
+		camera.create();
+		camera.setViewport(width, height);
+		layerCamera.create();
+		layerCamera.setViewport(width, height);
+		layerCamera.upload();
+		pickCamera.create();
+		picker.create();
+
+		// offscreen targets for the selected anti-aliasing mode
+		antiAliasing.create(width, height);
+
+		// the pinwheel as a distance field: 4 blades of 0.5 x 0.3
+		sdfShapes.create();
+		moonShapes.create();
+		sceneShapes.create();
+		animatedShapes.create();
+		tinyMeshes.create();
+		tinyMeshPuller.create();
+		pinwheelShape = sdfShapes.add(SdfShape::pinwheel(glm::vec2(0.0f), 0.5f, 4, 0.6f, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)));
+
+		// layer storage (the layers themselves are added by run())
+		layers.create(width, height);
+
+		// damage tracking and presentation of the changed regions
+		damage.resize(width, height);
+		presenter.create(_window);
+
+		// scene target for rendering below the window resolution
+		dynamicResolution.create(width, height);
+	}
+
+	// select the anti-aliasing mode
+	void Window::setAntiAliasing(AAMode mode) {
+		antiAliasing.setMode(mode);
+	}
+
+	// configure the dynamic resolution
+	void Window::setDynamicResolution(bool enabled, double targetMilliseconds, UpscaleFilter filter) {
+		useDynamicResolution = enabled;
+		dynamicResolution.setBudget(targetMilliseconds);
+		dynamicResolution.setFilter(filter);
+	}
+
+	// render below the window resolution
+	void Window::setRenderScale(float scale) {
+		renderScale = glm::clamp(scale, 0.25f, 1.0f);
+		dynamicResolution.setScaleRange(glm::min(0.25f, renderScale), renderScale);
+		dynamicResolution.reset();
+	}
+
+	// random shapes, always the same ones (fixed seed)
+	void Window::addRandomShapes(int count, float extent) {
+		std::mt19937 random(2019);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.02f, 0.1f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (int i = 0; i < count; i++) {
+			glm::vec2 center(position(random), position(random));
+			glm::vec4 color(unit(random), unit(random), unit(random), 1.0f);
+			SdfShape shape;
+			switch (i % 4) {
+			case 0: shape = SdfShape::circle(center, size(random), color); break;
+			case 1: shape = SdfShape::roundedRect(center, glm::vec2(size(random), size(random)), 0.01f, color); break;
+			case 2: shape = SdfShape::polygon(center, size(random), 3 + i % 5, color); break;
+			default: shape = SdfShape::star(center, size(random), 5, 3.0f, color); break;
+			}
+			shape.rotation = unit(random) * 6.2831853f;
+			sceneShapes.add(shape);
+		}
+		if (sceneLayer >= 0)
+			layers.markDirty(sceneLayer);
+		damage.invalidate();
+	}
+
+	// random motions, always the same ones (fixed seed)
+	void Window::addAnimatedShapes(int count, float extent) {
+		std::mt19937 random(2020);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.02f, 0.1f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+		for (int i = 0; i < count; i++) {
+			glm::vec2 center(position(random), position(random));
+			glm::vec4 color(unit(random), unit(random), unit(random), 1.0f);
+			SdfShape shape = i % 2 == 0 ? SdfShape::polygon(center, size(random), 3 + i % 5, color)
+				: SdfShape::star(center, size(random), 5, 3.0f, color);
+			Motion motion;
+			switch (i % 4) {
+			case 0: motion = Motion::spinning(signedUnit(random) * 6.0f); break;
+			case 1: motion = Motion::orbiting(0.2f + unit(random), signedUnit(random) * 2.0f, unit(random) * 6.2831853f); break;
+			case 2: motion = Motion::oscillating(glm::vec2(signedUnit(random), signedUnit(random)) * 0.5f, 0.2f + unit(random), unit(random) * 6.2831853f); break;
+			default: motion = Motion::drifting(glm::vec2(signedUnit(random), signedUnit(random)) * 0.1f); break;
+			}
+			// every shape spins a little as well
+			motion.spin += signedUnit(random);
+			animatedShapes.add(shape, motion);
+		}
+	}
+
+	// random placements and speeds, always the same ones (fixed seed); a
+	// quarter of the instances are discs, too large to pre-transform
+	void Window::addTinyMeshes(int count, float extent) {
+		// indexed meshes; the batcher gets them as triangle lists
+		std::vector<glm::vec2> triangle = { glm::vec2(0.0f, 1.0f), glm::vec2(-0.866f, -0.5f), glm::vec2(0.866f, -0.5f) };
+		std::vector<GLuint> triangleIndices = { 0, 1, 2 };
+		std::vector<glm::vec2> square = { glm::vec2(-0.7f, -0.7f), glm::vec2(0.7f, -0.7f), glm::vec2(0.7f, 0.7f), glm::vec2(-0.7f, 0.7f) };
+		std::vector<GLuint> squareIndices = { 0, 1, 2, 0, 2, 3 };
+		std::vector<glm::vec2> pinwheel, disc = { glm::vec2(0.0f) };
+		std::vector<GLuint> pinwheelIndices, discIndices;
+		for (int blade = 0; blade < 4; blade++) {
+			float angle = blade * 1.5707963f;
+			glm::vec2 along(std::cos(angle), std::sin(angle)), across(-along.y, along.x);
+			pinwheel.push_back(glm::vec2(0.0f));
+			pinwheel.push_back(along);
+			pinwheel.push_back(across * 0.6f);
+		}
+		for (GLuint i = 0; i < 12; i++)
+			pinwheelIndices.push_back(i);
+		const int SEGMENTS = 48;
+		for (int i = 0; i < SEGMENTS; i++) {
+			float angle = i * 6.2831853f / SEGMENTS;
+			disc.push_back(glm::vec2(std::cos(angle), std::sin(angle)));
+			discIndices.push_back(0);
+			discIndices.push_back(1 + i);
+			discIndices.push_back(1 + (i + 1) % SEGMENTS);
+		}
+		// the disc also has colors per vertex, a different vertex format
+		// in the same draw of the puller
+		std::vector<glm::vec4> discColors(disc.size(), glm::vec4(1.0f));
+
+		auto triangles = [](const std::vector<glm::vec2> &vertices, const std::vector<GLuint> &indices) {
+			std::vector<glm::vec2> list;
+			for (GLuint index : indices)
+				list.push_back(vertices[index]);
+			return list;
+		};
+		int meshes[4] = { tinyMeshes.addMesh(triangles(triangle, triangleIndices)), tinyMeshes.addMesh(triangles(square, squareIndices)),
+			tinyMeshes.addMesh(triangles(pinwheel, pinwheelIndices)), tinyMeshes.addMesh(triangles(disc, discIndices)) };
+		int pulledMeshes[4] = { tinyMeshPuller.addMesh(triangle, triangleIndices), tinyMeshPuller.addMesh(square, squareIndices),
+			tinyMeshPuller.addMesh(pinwheel, pinwheelIndices), tinyMeshPuller.addMesh(disc, discColors, discIndices) };
+
+		std::mt19937 random(2021);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.02f, 0.08f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+		for (int i = 0; i < count; i++) {
+			glm::vec3 placement(position(random), position(random), size(random));
+			glm::vec4 color(unit(random), unit(random), unit(random), 1.0f);
+			tinyMeshPlacements.push_back(placement);
+			tinyMeshRotations.add(unit(random) * 6.2831853f, signedUnit(random) * 0.05f);
+			tinyMeshes.add(meshes[i % 4], Affine2D(placement.z, 0.0f, 0.0f, placement.z, placement.x, placement.y), color);
+			tinyMeshPuller.add(pulledMeshes[i % 4], Affine2D(placement.z, 0.0f, 0.0f, placement.z, placement.x, placement.y), color);
+		}
+	}
+
+	// columns of boxes, a little apart, so each column is an island
+	void Window::addPhysicsStacks(int count) {
+		const int HEIGHT = 40;
+		int columns = std::max(count / HEIGHT, 1);
+		float width = columns * 1.5f;
+		SdfShape ground = SdfShape::roundedRect(glm::vec2(0.0f, -0.5f), glm::vec2(0.5f * width + 1.0f, 0.5f), 0.0f,
+			glm::vec4(0.4f, 0.4f, 0.4f, 1.0f));
+		physics.addPolygon(ground.outline(), 0.0f, ground.center, 0.0f);
+		physicsShapes.push_back(sceneShapes.add(ground));
+		for (int column = 0; column < columns; column++) {
+			float boxX = (column + 0.5f) * 1.5f - 0.5f * width;
+			for (int row = 0; row < HEIGHT; row++) {
+				glm::vec4 color(0.5f + 0.5f * (column % 2), 0.3f + 0.7f * row / HEIGHT, 0.2f, 1.0f);
+				SdfShape box = SdfShape::roundedRect(glm::vec2(boxX, row * 1.01f + 0.5f), glm::vec2(0.5f), 0.05f, color);
+				physics.addPolygon(box.outline(), 1.0f, box.center, 0.0f);
+				physicsShapes.push_back(sceneShapes.add(box));
+			}
+		}
+		camera.setPosition(glm::vec2(0.0f, 0.5f * HEIGHT));
+		camera.setZoom(2.0f / (1.5f * HEIGHT));
+		if (sceneLayer >= 0)
+			layers.markDirty(sceneLayer);
+		damage.invalidate();
+	}
+
+	void Window::stepPhysics() {
+		// a fixed step keeps the solver stable; a slow frame takes a few steps
+		// and a stall drops the time it could not catch up with
+		const float STEP = 1.0f / 60.0f;
+		const int MAX_STEPS = 4;
+		physicsAccumulator += frameDelta;
+		int steps = 0;
+		while (physicsAccumulator >= STEP && steps < MAX_STEPS) {
+			physics.step(STEP);
+			physicsAccumulator -= STEP;
+			steps++;
+		}
+		if (steps == MAX_STEPS)
+			physicsAccumulator = 0.0;
+		if (steps == 0)
+			return;
+		for (int i = 0; i < physics.bodyCount(); i++) {
+			const RigidBody &body = physics.body(i);
+			if (!body.dynamic())
+				continue;
+			SdfShape &shape = sceneShapes.shape(physicsShapes[i]);
+			shape.center = body.position;
+			shape.rotation = body.angle;
+		}
+		if (sceneLayer >= 0)
+			layers.markDirty(sceneLayer);
+		damage.invalidate();
+	}
+
+	glm::vec2 Window::cursorClipPosition() {
+		double cursorX, cursorY;
+		int windowWidth, windowHeight;
+		glfwGetCursorPos(_window, &cursorX, &cursorY);
+		glfwGetWindowSize(_window, &windowWidth, &windowHeight);
+		return glm::vec2(2.0 * cursorX / windowWidth - 1.0, 1.0 - 2.0 * cursorY / windowHeight);
+	}
+
+	GLuint Window::pickCpu(glm::vec2 point) {
+		// the pinwheel is drawn last, so it is on top
+		if (useSdfShapes) {
+			// where the pinwheel is drawn this frame (see run())
+			SdfShape pinwheel = static_cast<const SdfRenderer &>(sdfShapes).shape(pinwheelShape);
+			pinwheel.center = glm::vec2(x, y);
+			pinwheel.rotation = -rotationAngle;
+			if (pinwheel.distance(point) <= 0.0f)
+				return PINWHEEL_ID;
+		} else {
+			for (size_t i = 0; i + 2 < pinwheelTriangles.size(); i += 3) {
+				glm::vec2 corners[3];
+				for (int j = 0; j < 3; j++) {
+					glm::vec4 world = pinwheelModel * glm::vec4(pinwheelTriangles[i + j].x, pinwheelTriangles[i + j].y, 0.0f, 1.0f);
+					corners[j] = glm::vec2(world.x, world.y);
+				}
+				if (pointInTriangle(point, corners[0], corners[1], corners[2]))
+					return PINWHEEL_ID;
+			}
+		}
+
+		// candidates from the index, in drawing order: the last one is on top
+		// (read through a const reference: the other shape() marks the shape
+		// changed, which would re-upload and re-index it)
+		const SdfRenderer &scene = sceneShapes;
+		std::vector<int> candidates;
+		sceneShapes.queryPoint(point, candidates);
+		for (int i = (int)candidates.size() - 1; i >= 0; i--)
+			if (scene.shape(candidates[i]).distance(point) <= 0.0f)
+				return SCENE_ID_BASE + candidates[i];
+		return GpuPicker::NO_ID;
+	}
+
+	void Window::select(GLuint id) {
+		if (id == selected)
+			return;
+		// give the previous selection its color back
+		if (selected >= SCENE_ID_BASE && (int)(selected - SCENE_ID_BASE) < sceneShapes.count())
+			sceneShapes.shape(selected - SCENE_ID_BASE).color = selectedColor;
+		selected = id;
+		if (selected >= SCENE_ID_BASE && (int)(selected - SCENE_ID_BASE) < sceneShapes.count()) {
+			SdfShape &shape = sceneShapes.shape(selected - SCENE_ID_BASE);
+			selectedColor = shape.color;
+			shape.color = glm::vec4(1.0f - shape.color.x, 1.0f - shape.color.y, 1.0f - shape.color.z, 1.0f);
+		}
+		layers.markDirty(sceneLayer);
+		damage.invalidate();
+		updateTitle();
+	}
+
+	void Window::buildCollisionWorld() {
+		collisions.clear();
+		collisions.addMesh(pinwheelTriangles);
+		for (int i = 0; i < sceneShapes.count(); i++) {
+			const SdfShape &shape = static_cast<const SdfRenderer &>(sceneShapes).shape(i);
+			int body = collisions.addPolygon(shape.outline(), false);
+			collisions.setTransform(body, shape.center, shape.rotation);
+		}
+		freeX = x;
+		freeY = y;
+		freeAngle = rotationAngle;
+	}
+
+	void Window::resolveCollisions() {
+		// the pinwheel rotates clockwise, the bodies counter-clockwise
+		collisions.setTransform(0, glm::vec2(x, y), -rotationAngle);
+		collisions.update();
+		if (collisions.touching(0)) {
+			x = freeX;
+			y = freeY;
+			rotationAngle = freeAngle;
+		} else {
+			freeX = x;
+			freeY = y;
+			freeAngle = rotationAngle;
+		}
+	}
+
+	// only remember the latest size, the next frame applies it
+	void Window::framebufferSizeCallback(GLFWwindow *window, int width, int height) {
+		Window *self = static_cast<Window *>(glfwGetWindowUserPointer(window));
+		self->pendingWidth = width;
+		self->pendingHeight = height;
+		self->resizePending = true;
+		self->resizeEvents++;
+	}
+
+	void Window::scrollCallback(GLFWwindow *window, double, double yOffset) {
+		Window *self = static_cast<Window *>(glfwGetWindowUserPointer(window));
+		self->pendingScroll += yOffset;
+	}
+
+	// the targets only grow geometrically (see Framebuffer::reserve), so
+	// most resizes just change the part of them that is rendered
+	void Window::applyResize(int width, int height) {
+		_width = width;
+		_height = height;
 		glViewport(0, 0, width, height);
+		layerCamera.setViewport(width, height);
+		layerCamera.upload();
+		damage.resize(width, height);
+		layers.resize(width, height);
+		dynamicResolution.resize(width, height);
+	}
+
+	// show the anti-aliasing mode and its GPU cost in the window title
+	void Window::updateTitle() {
+		std::ostringstream title;
+		title << "CG 2019 | AA: " << aaModeName(antiAliasing.mode())
+			<< " | GPU " << std::fixed << std::setprecision(2)
+			<< antiAliasing.frameMilliseconds(antiAliasing.mode()) << " ms";
+		title << " | zoom: " << std::setprecision(2) << camera.zoom();
+		if (sceneShapes.count() > 0)
+			title << " | shapes drawn: " << sceneShapes.drawnLastFrame() << "/" << sceneShapes.count()
+				<< " (" << spatialIndexName(sceneShapes.spatialIndex()) << ", "
+				<< spaceFillingCurveName(sceneShapes.spatialSort()) << " order)";
+		if (useCollisions)
+			title << " | collisions: " << collisions.pairs().size() << " pairs, "
+				<< collisions.contacts().size() << " contacts ("
+				<< collisions.pairMilliseconds() + collisions.contactMilliseconds() << " ms)";
+		if (physics.bodyCount() > 0)
+			title << " | physics: " << physics.islandCount() << " islands, "
+				<< physics.contactCount() << " contacts ("
+				<< physics.collideMilliseconds() + physics.solveMilliseconds() << " ms, "
+				<< physics.threadCount() << " threads)";
+		if (pinwheelClip >= 0)
+			title << " | clip " << pinwheelClip << " (" << std::setprecision(3)
+				<< pinwheelAnimator.updateMilliseconds() << " ms)" << std::setprecision(2);
+		if (scripts.count() > 0)
+			title << " | scripts: " << scripts.count();
+		if (useMoons)
+			title << " | scene graph: " << sceneGraph.count() << " nodes, " << sceneGraph.updatedLastFrame() << " updated";
+		if (usePath)
+			title << " | path (" << std::setprecision(1) << pinwheelPath.updateMicroseconds() << " us)" << std::setprecision(2);
+		if (useAnimation)
+			title << " | animated shapes: " << animatedShapes.count();
+		if (useTinyMeshes && pullTinyMeshes)
+			title << " | tiny meshes: " << tinyMeshPuller.count() << " (pulled from a "
+				<< pullingStorageName(tinyMeshPuller.storage()) << ", 1 draw, " << tinyMeshPuller.runCount() << " runs, "
+				<< tinyMeshPuller.uploadedBytes() / 1024 << " KB uploaded)";
+		else if (useTinyMeshes) {
+			title << " | tiny meshes: " << tinyMeshes.count() << " (" << meshDrawPathName(tinyMeshes.path());
+			if (tinyMeshes.path() != MeshDrawPath::PreTransform)
+				title << ", instances from " << instanceStorageName(tinyMeshes.instanceStorage());
+			title << ", " << tinyMeshes.drawCallsLastFrame() << " draws, " << tinyMeshes.streamedVerticesLastFrame()
+				<< " vertices streamed, CPU " << tinyMeshes.prepareMilliseconds() << " ms)";
+		}
+		if (useParticles)
+			title << " | particles: " << particles.recentCount() << " ("
+				<< particleBackendName(particles.backend()) << ", "
+				<< particles.updateMilliseconds() << " ms)";
+		title << " | pick: " << pickModeName(pickMode);
+		if (pickMode == PickMode::Gpu)
+			title << " (" << picker.lastLatency() << " frames late)";
+		if (selected == PINWHEEL_ID)
+			title << ", pinwheel";
+		else if (selected != GpuPicker::NO_ID)
+			title << ", shape " << selected - SCENE_ID_BASE;
+		if (useLayers)
+			title << " | layers redrawn: " << layers.redrawnLastFrame();
+		if (usePartialRedraw)
+			title << " | pixels touched: " << std::setprecision(1)
+				<< damage.averageTouchedFraction() * 100.0 << "%"
+				<< (presenter.partialPresent() ? " (partial present)" : "");
+		else if (useDynamicResolution)
+			title << " | scale: " << std::setprecision(0) << dynamicResolution.scale() * 100.0f << "%";
+		glfwSetWindowTitle(_window, title.str().c_str());
 	}
 
 	// process the useful inputs
@@ -102,6 +651,43 @@ namespace cgicmc {
 		if (glfwGetKey(_window, GLFW_KEY_D) == GLFW_PRESS)
 			x += DIST_VAR; // D: move right
 
+		// camera keys: pan by a fraction of the view, whatever the zoom
+		float pan = PAN_VAR * 2.0f / camera.zoom();
+		if (glfwGetKey(_window, GLFW_KEY_UP) == GLFW_PRESS)
+			camera.pan(glm::vec2(0.0f, pan));
+		if (glfwGetKey(_window, GLFW_KEY_DOWN) == GLFW_PRESS)
+			camera.pan(glm::vec2(0.0f, -pan));
+		if (glfwGetKey(_window, GLFW_KEY_LEFT) == GLFW_PRESS)
+			camera.pan(glm::vec2(-pan, 0.0f));
+		if (glfwGetKey(_window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+			camera.pan(glm::vec2(pan, 0.0f));
+
+		// mouse wheel: zoom keeping the point under the cursor in place
+		if (pendingScroll != 0) {
+			camera.zoomAt(cursorClipPosition(), (float)std::pow(1.1, pendingScroll));
+			pendingScroll = 0;
+		}
+
+		// left click: pick the shape under the cursor
+		if (glfwGetMouseButton(_window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+			if (!mousePressed) {
+				mousePressed = true;
+				pickRequested = true;
+			}
+		} else {
+			mousePressed = false;
+		}
+
+		// G key: switch between CPU and GPU picking
+		if (glfwGetKey(_window, GLFW_KEY_G) == GLFW_PRESS) {
+			if (!pickKeyPressed) {
+				pickKeyPressed = true;
+				pickMode = pickMode == PickMode::Cpu ? PickMode::Gpu : PickMode::Cpu;
+			}
+		} else {
+			pickKeyPressed = false;
+		}
+
 		// rotation keys
 		// condition to avoid speed changing when rotation is halted
 		if (!stopRotation) {
@@ -113,6 +699,38 @@ namespace cgicmc {
 				rotationSpeed -= SPEED_VAR;
 		}
 
+		// Z and X keys: shrink or grow the pinwheel
+		if (glfwGetKey(_window, GLFW_KEY_Z) == GLFW_PRESS) {
+			pinwheelScale = std::max(0.25f, pinwheelScale * 0.98f);
+			damage.invalidate();
+		}
+		if (glfwGetKey(_window, GLFW_KEY_X) == GLFW_PRESS) {
+			pinwheelScale = std::min(3.0f, pinwheelScale * 1.02f);
+			damage.invalidate();
+		}
+
+		// J key: cycle the shear (none, along x, along y)
+		if (glfwGetKey(_window, GLFW_KEY_J) == GLFW_PRESS) {
+			if (!shearKeyPressed) {
+				shearKeyPressed = true;
+				pinwheelShear = (pinwheelShear + 1) % 3;
+				damage.invalidate();
+			}
+		} else {
+			shearKeyPressed = false;
+		}
+
+		// B key: mirror the pinwheel across its vertical axis, or not
+		if (glfwGetKey(_window, GLFW_KEY_B) == GLFW_PRESS) {
+			if (!reflectKeyPressed) {
+				reflectKeyPressed = true;
+				pinwheelReflected = !pinwheelReflected;
+				damage.invalidate();
+			}
+		} else {
+			reflectKeyPressed = false;
+		}
+
 		// stop rotation when space key is pressed
 		if (glfwGetKey(_window, GLFW_KEY_SPACE) == GLFW_PRESS) {
 			// to avoid repeated changes with a single key press
@@ -123,6 +741,234 @@ namespace cgicmc {
 		} else {
 			spacePressed = false;
 		}
+
+		// M key: cycle the anti-aliasing modes
+		if (glfwGetKey(_window, GLFW_KEY_M) == GLFW_PRESS) {
+			if (!aaKeyPressed) {
+				aaKeyPressed = true;
+				antiAliasing.cycleMode();
+				layers.markAllDirty();
+				damage.invalidate();
+			}
+		} else {
+			aaKeyPressed = false;
+		}
+
+		// P key: switch between triangles and distance field shapes
+		if (glfwGetKey(_window, GLFW_KEY_P) == GLFW_PRESS) {
+			if (!sdfKeyPressed) {
+				sdfKeyPressed = true;
+				useSdfShapes = !useSdfShapes;
+				layers.markAllDirty();
+				damage.invalidate();
+			}
+		} else {
+			sdfKeyPressed = false;
+		}
+
+		// L key: switch between immediate drawing and retained layers
+		if (glfwGetKey(_window, GLFW_KEY_L) == GLFW_PRESS) {
+			if (!layersKeyPressed) {
+				layersKeyPressed = true;
+				useLayers = !useLayers;
+				damage.invalidate();
+			}
+		} else {
+			layersKeyPressed = false;
+		}
+
+		// R key: switch between full and partial redraw
+		if (glfwGetKey(_window, GLFW_KEY_R) == GLFW_PRESS) {
+			if (!partialKeyPressed) {
+				partialKeyPressed = true;
+				usePartialRedraw = !usePartialRedraw;
+				damage.invalidate();
+			}
+		} else {
+			partialKeyPressed = false;
+		}
+
+		// I key: cycle the spatial index used to cull the scene
+		if (glfwGetKey(_window, GLFW_KEY_I) == GLFW_PRESS) {
+			if (!indexKeyPressed) {
+				indexKeyPressed = true;
+				int next = ((int)sceneShapes.spatialIndex() + 1) % 3;
+				sceneShapes.setSpatialIndex((SpatialIndexType)next);
+			}
+		} else {
+			indexKeyPressed = false;
+		}
+
+		// H key: store the scene in Hilbert order or in insertion order
+		if (glfwGetKey(_window, GLFW_KEY_H) == GLFW_PRESS) {
+			if (!sortKeyPressed) {
+				sortKeyPressed = true;
+				bool sorted = sceneShapes.spatialSort() != SpaceFillingCurve::None;
+				sceneShapes.setSpatialSort(sorted ? SpaceFillingCurve::None : SpaceFillingCurve::Hilbert);
+				layers.markDirty(sceneLayer);
+				damage.invalidate();
+			}
+		} else {
+			sortKeyPressed = false;
+		}
+
+		// C key: toggle the collisions between the pinwheel and the scene
+		if (glfwGetKey(_window, GLFW_KEY_C) == GLFW_PRESS) {
+			if (!collisionKeyPressed) {
+				collisionKeyPressed = true;
+				useCollisions = !useCollisions;
+				if (useCollisions)
+					buildCollisionWorld();
+			}
+		} else {
+			collisionKeyPressed = false;
+		}
+
+		// K key: play the next pinwheel clip (the first one starts at once,
+		// the others fade in), or stop after the last one
+		if (glfwGetKey(_window, GLFW_KEY_K) == GLFW_PRESS) {
+			if (!keyframeKeyPressed) {
+				keyframeKeyPressed = true;
+				pinwheelClip = pinwheelClip + 1 < pinwheelClipCount ? pinwheelClip + 1 : -1;
+				if (pinwheelClip >= 0)
+					pinwheelAnimator.play(0, pinwheelClip, pinwheelClip == 0 ? 0.0f : 0.5f);
+				updateTitle();
+			}
+		} else {
+			keyframeKeyPressed = false;
+		}
+
+		// T key: move the pinwheel along its path, or give it back to the
+		// keyboard where it is
+		if (glfwGetKey(_window, GLFW_KEY_T) == GLFW_PRESS) {
+			if (!pathKeyPressed) {
+				pathKeyPressed = true;
+				usePath = !usePath;
+				updateTitle();
+			}
+		} else {
+			pathKeyPressed = false;
+		}
+
+		// Y key: start the pinwheel script, or stop it where it is
+		if (glfwGetKey(_window, GLFW_KEY_Y) == GLFW_PRESS) {
+			if (!scriptKeyPressed) {
+				scriptKeyPressed = true;
+				if (scripts.running(pinwheelScript)) {
+					scripts.stop(pinwheelScript);
+					pinwheelScript = -1;
+				} else {
+					pinwheelScript = scripts.start(spinAndReverse(&rotationSpeed));
+				}
+				updateTitle();
+			}
+		} else {
+			scriptKeyPressed = false;
+		}
+
+		// O key: show the moons around the pinwheel, or remove them
+		if (glfwGetKey(_window, GLFW_KEY_O) == GLFW_PRESS) {
+			if (!moonKeyPressed) {
+				moonKeyPressed = true;
+				useMoons = !useMoons;
+				if (useMoons) {
+					for (int i = 0; i < 4; i++) {
+						int moon = sceneGraph.add(pinwheelNode);
+						moonNodes.push_back(moon);
+						moonShapeIds.push_back(moonShapes.add(SdfShape::circle(glm::vec2(0.0f), 0.06f, glm::vec4(0.8f, 0.8f, 0.9f, 1.0f))));
+						moonRotations.add(i * 1.5707963f, 0.02f);
+						moonNodes.push_back(sceneGraph.add(moon));
+						moonShapeIds.push_back(moonShapes.add(SdfShape::circle(glm::vec2(0.0f), 0.03f, glm::vec4(0.5f, 0.6f, 1.0f, 1.0f))));
+						moonRotations.add(i * 4.7123890f, 0.06f);
+					}
+				} else {
+					for (size_t i = 0; i < moonNodes.size(); i += 2)
+						sceneGraph.remove(moonNodes[i]);
+					moonNodes.clear();
+					moonShapeIds.clear();
+					moonShapes.clear();
+					moonRotations.clear();
+				}
+				damage.invalidate();
+			}
+		} else {
+			moonKeyPressed = false;
+		}
+
+		// N key: show or hide the animated shapes (restarting their motion)
+		if (glfwGetKey(_window, GLFW_KEY_N) == GLFW_PRESS) {
+			if (!animationKeyPressed) {
+				animationKeyPressed = true;
+				useAnimation = !useAnimation;
+				animationStart = glfwGetTime();
+				damage.invalidate();
+			}
+		} else {
+			animationKeyPressed = false;
+		}
+
+		// U key: cycle the tiny meshes hidden, drawn by the automatic
+		// choice, all pre-transformed, all instanced (from attributes, then
+		// from a buffer texture) and pulled by the vertex shader
+		if (glfwGetKey(_window, GLFW_KEY_U) == GLFW_PRESS) {
+			if (!tinyMeshKeyPressed) {
+				tinyMeshKeyPressed = true;
+				if (!useTinyMeshes) {
+					useTinyMeshes = true;
+					tinyMeshes.setPath(MeshDrawPath::Auto);
+					tinyMeshes.setInstanceStorage(InstanceStorage::Attributes);
+				} else if (tinyMeshes.path() == MeshDrawPath::Auto) {
+					tinyMeshes.setPath(MeshDrawPath::PreTransform);
+				} else if (tinyMeshes.path() == MeshDrawPath::PreTransform) {
+					tinyMeshes.setPath(MeshDrawPath::Instanced);
+				} else if (tinyMeshes.instanceStorage() == InstanceStorage::Attributes) {
+					tinyMeshes.setInstanceStorage(InstanceStorage::TextureBuffer);
+				} else if (!pullTinyMeshes) {
+					pullTinyMeshes = true;
+				} else {
+					useTinyMeshes = false;
+					pullTinyMeshes = false;
+				}
+				damage.invalidate();
+				updateTitle();
+			}
+		} else {
+			tinyMeshKeyPressed = false;
+		}
+
+		// F key: cycle the particles off, on the compute shader and on
+		// transform feedback (the buffers are allocated the first time)
+		if (glfwGetKey(_window, GLFW_KEY_F) == GLFW_PRESS) {
+			if (!particlesKeyPressed) {
+				particlesKeyPressed = true;
+				if (!particles.created()) {
+					particles.create(1 << 20);
+					particles.emitter().rate = 200000.0f;
+				}
+				if (!useParticles) {
+					useParticles = true;
+					particles.setBackend(ParticleBackend::Compute);
+				} else if (particles.backend() == ParticleBackend::Compute) {
+					particles.setBackend(ParticleBackend::TransformFeedback);
+				} else {
+					useParticles = false;
+				}
+				lastParticleTime = glfwGetTime();
+				damage.invalidate();
+			}
+		} else {
+			particlesKeyPressed = false;
+		}
+
+		// V key: toggle the dynamic resolution
+		if (glfwGetKey(_window, GLFW_KEY_V) == GLFW_PRESS) {
+			if (!dynamicKeyPressed) {
+				dynamicKeyPressed = true;
+				useDynamicResolution = !useDynamicResolution;
+			}
+		} else {
+			dynamicKeyPressed = false;
+		}
 	}
 
 	void Window::run() {
@@ -130,6 +976,7 @@ namespace cgicmc {
 		// build and compile our shader program
 		GLint shaderProgram = createRenderingPipeline();
 		glUseProgram(shaderProgram);
+		GLint shaderEdgeAA = glGetUniformLocation(shaderProgram, "edgeAA");
 
 		// set up the vertices points
 		float vertices[] = {
@@ -170,49 +1017,390 @@ namespace cgicmc {
 		// enable attribute index 0 as being used
 		glEnableVertexAttribArray(0);
 
+		// the triangles again, for the exact picking tests on the CPU
+		pinwheelTriangles.clear();
+		for (size_t i = 0; i + 2 < sizeof(vertices) / sizeof(float); i += 3)
+			pinwheelTriangles.push_back(glm::vec2(vertices[i], vertices[i + 1]));
+
+		// the same triangles writing their pick id
+		GLuint pickProgram = createShaderProgram(vertexShaderSource, idFragmentShaderSource);
+		Camera::bindBlock(pickProgram);
+		GLint pickTransform = glGetUniformLocation(pickProgram, "transform");
+		GLint pickIdLocation = glGetUniformLocation(pickProgram, "pickId");
+
 		// get the "transform" variable location (to apply transformations later)
 		GLuint shaderTransform = glGetUniformLocation(shaderProgram, "transform");
 
+		// static background: only the clear color, drawn once
+		layers.addLayer(NULL, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f));
+
+		// the scene is drawn through the camera, so it is redrawn when the
+		// camera moves
+		sceneLayer = layers.addLayer([&](int, int) {
+			sceneShapes.draw(camera);
+		});
+
+		// the pinwheel is drawn untransformed once; moving and rotating it
+		// only changes the layer transform
+		int pinwheelLayer = layers.addLayer([&](int, int) {
+			if (useSdfShapes) {
+				SdfShape &pinwheel = sdfShapes.shape(pinwheelShape);
+				pinwheel.center = glm::vec2(0.0f);
+				pinwheel.rotation = 0.0f;
+				sdfShapes.draw(layerCamera);
+			} else {
+				glUseProgram(shaderProgram);
+				glBindVertexArray(VAO);
+				layerCamera.bind();
+				glUniform1i(shaderEdgeAA, antiAliasing.analyticEdges());
+				glUniformMatrix4fv(shaderTransform, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+				glDrawArrays(GL_TRIANGLES, 0, 12);
+			}
+		});
+
+		// bring the camera block up to date (once per frame) for a render
+		// size; a new view invalidates what was drawn through the camera
+		auto updateCamera = [&](int width, int height) {
+			camera.setViewport(width, height);
+			camera.upload();
+			if (camera.version() != lastCameraVersion) {
+				lastCameraVersion = camera.version();
+				layers.markDirty(sceneLayer);
+				damage.invalidate();
+			}
+		};
+
+		// the scene pass clears the color to the background and keeps it for
+		// presentation; depth and stencil are never used
+		RenderPass scenePass;
+		scenePass.color(LoadAction::Clear, StoreAction::Store, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f));
+
 		// window main loop
+		lastFrameTime = glfwGetTime();
 		while (!glfwWindowShouldClose(_window)) {
 			
 			// process the input commands
 			processInput(_window);
 
+			// apply the last size reported since the previous frame
+			if (resizePending) {
+				resizePending = false;
+				applyResize(pendingWidth, pendingHeight);
+			}
+
+			// minimized: nothing to render until the window comes back
+			if (_width == 0 || _height == 0) {
+				glfwWaitEvents();
+				continue;
+			}
+
 			// DEBUG: print values
 			//std::cout<<"X: "<<x<<"  Y: "<<y<<"  angle: "<<rotationAngle<<"  speed: "<<rotationSpeed<<' '<<stopRotation<<std::endl;
 
+			// the real time this frame advances everything by
+			double frameTime = glfwGetTime();
+			frameDelta = (float)glm::min(frameTime - lastFrameTime, 0.1);
+			lastFrameTime = frameTime;
+
+			// the scripts run before the frame uses what they change
+			scripts.update(frameDelta);
+
 			// apply the rotation (if not stopped)
 			if (!stopRotation) {
 				rotationAngle += rotationSpeed;
 			}
 
-			// calculate the translation matrix
-			glm::mat4 translationMatrix = glm::mat4(1.0f);
-			translationMatrix[0][3] = x;
-			translationMatrix[1][3] = y;
+			// a keyframed clip overrides the keyboard (its angles are
+			// counter-clockwise, the pinwheel turns clockwise)
+			if (pinwheelClip >= 0) {
+				pinwheelAnimator.update(frameDelta);
+				x = pinwheelAnimator.position(0).x;
+				y = pinwheelAnimator.position(0).y;
+				rotationAngle = -pinwheelAnimator.rotation(0);
+				sdfShapes.shape(pinwheelShape).color = pinwheelAnimator.color(0);
+			}
+
+			// the path moves the pinwheel at constant speed, whatever the
+			// spacing of its points
+			if (usePath) {
+				pinwheelPath.update(frameDelta);
+				x = pinwheelPath.position(0).x;
+				y = pinwheelPath.position(0).y;
+			}
+
+			// the pinwheel stops where it would enter a scene shape
+			if (useCollisions)
+				resolveCollisions();
 
-			// calculate the rotation matrix
-			glm::mat4 rotationMatrix = glm::mat4(1.0f);
-			float sin = glm::sin(rotationAngle);
-			float cos = glm::cos(rotationAngle);
-			rotationMatrix[0][0] = cos;
-			rotationMatrix[0][1] = sin;
-			rotationMatrix[1][0] = -sin;
-			rotationMatrix[1][1] = cos;
+			// fixed physics steps, driven by the real time
+			if (physics.bodyCount() > 0)
+				stepPhysics();
 
-			// apply the transformations
-			glUniformMatrix4fv(shaderTransform, 1, GL_TRUE, glm::value_ptr(rotationMatrix * translationMatrix));
+			// the pinwheel transform is folded again only if a step changed
+			// (the pinwheel turns counter-clockwise there)
+			pinwheelTransform.setVector(scaleStep, glm::vec2(pinwheelScale));
+			pinwheelTransform.setVector(shearStep, glm::vec2(pinwheelShear == 1 ? 0.4f : 0.0f, pinwheelShear == 2 ? 0.4f : 0.0f));
+			pinwheelTransform.setVector(reflectStep, pinwheelReflected ? glm::vec2(0.0f, 1.0f) : glm::vec2(0.0f));
+			pinwheelTransform.setAngle(rotateStep, -rotationAngle);
+			pinwheelTransform.setVector(translateStep, glm::vec2(x, y));
+			const Affine2D &pinwheelLocal = pinwheelTransform.affine();
+			pinwheelModel = pinwheelLocal.toMat4();
+			// uploaded transposed (see glUniformMatrix4fv)
+			glm::mat4 transform = glm::transpose(pinwheelModel);
 
-			// paint the background
-			glClearColor(0.0f, 0.0f, 0.5f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// the hierarchy only recomputes the nodes that moved and their
+			// descendants (the pinwheel turns counter-clockwise there)
+			if (sceneGraph.local(pinwheelNode) != pinwheelLocal)
+				sceneGraph.setLocal(pinwheelNode, pinwheelLocal);
+			if (useMoons) {
+				// constant speeds: the rotations advance without trigonometry
+				moonRotations.advance();
+				for (int i = 0; i < (int)moonNodes.size(); i++) {
+					float distance = i % 2 ? 0.15f : 0.7f;
+					sceneGraph.setLocal(moonNodes[i], (structuredRotation(moonRotations.cosine(i), moonRotations.sine(i))
+						* structuredTranslation(distance, 0.0f)).toAffine());
+				}
+			}
+			sceneGraph.update();
+			if (useMoons) {
+				for (size_t i = 0; i < moonNodes.size(); i++)
+					moonShapes.shape(moonShapeIds[i]).center = sceneGraph.world(moonNodes[i]).origin();
+				damage.invalidate();
+			}
 
-			// draw the triangles
-			glDrawArrays(GL_TRIANGLES, 0, 12);
 
-			// swap the buffers to make any changes visible
-			glfwSwapBuffers(_window);
+			// picking: the CPU answers right away, the GPU one or two frames
+			// later (the result is polled below, never waited for)
+			if (pickRequested) {
+				pickRequested = false;
+				glm::vec2 point = camera.toWorld(cursorClipPosition());
+				if (pickMode == PickMode::Cpu) {
+					select(pickCpu(point));
+				} else {
+					// a camera covering only the pixel under the cursor, so the
+					// culling leaves just the shapes that may cover it
+					pickCamera.setViewport(1, 1);
+					pickCamera.setPosition(point);
+					pickCamera.setZoom(2.0f / camera.pixelSize());
+					pickCamera.upload();
+
+					picker.begin();
+					sceneShapes.drawIds(pickCamera, SCENE_ID_BASE);
+					if (useSdfShapes) {
+						SdfShape &pinwheel = sdfShapes.shape(pinwheelShape);
+						pinwheel.center = glm::vec2(x, y);
+						pinwheel.rotation = -rotationAngle;
+						// the ids of the renderer are its indices plus the offset,
+						// so its first shape (the pinwheel) gets PINWHEEL_ID and
+						// none of its shapes may reach the ids of the scene
+						const int FIRST_SHAPE = 0;
+						assert(pinwheelShape == FIRST_SHAPE);
+						assert(PINWHEEL_ID + (GLuint)(sdfShapes.count() - FIRST_SHAPE) <= SCENE_ID_BASE);
+						sdfShapes.drawIds(pickCamera, PINWHEEL_ID - FIRST_SHAPE);
+					} else {
+						glUseProgram(pickProgram);
+						glBindVertexArray(VAO);
+						pickCamera.bind();
+						glUniformMatrix4fv(pickTransform, 1, GL_TRUE, glm::value_ptr(transform));
+						glUniform1ui(pickIdLocation, PINWHEEL_ID);
+						GLboolean blend = glIsEnabled(GL_BLEND);
+						glDisable(GL_BLEND);
+						glDrawArrays(GL_TRIANGLES, 0, 12);
+						if (blend)
+							glEnable(GL_BLEND);
+					}
+					picker.end();
+				}
+			}
+			GLuint picked;
+			if (picker.poll(picked))
+				select(picked);
+
+			// the animated shapes only need the time of the frame
+			double animationTime = glfwGetTime() - animationStart;
+			if (useAnimation && animatedShapes.count() > 0)
+				damage.invalidate();
+
+			// the tiny meshes spin at constant speeds, each around its center
+			if (useTinyMeshes && tinyMeshes.count() > 0) {
+				tinyMeshRotations.advance();
+				int count = tinyMeshes.count();
+				const float *cosines = tinyMeshRotations.cosines(), *sines = tinyMeshRotations.sines();
+				tinyMeshTransforms.resize(count);
+				for (int i = 0; i < count; i++) {
+					const glm::vec3 &placement = tinyMeshPlacements[i];
+					float c = cosines[i] * placement.z, s = sines[i] * placement.z;
+					tinyMeshTransforms[i] = Affine2D(c, s, -s, c, placement.x, placement.y);
+				}
+				if (pullTinyMeshes)
+					tinyMeshPuller.setTransforms(0, count, tinyMeshTransforms.data());
+				else
+					tinyMeshes.setTransforms(0, count, tinyMeshTransforms.data());
+				damage.invalidate();
+			}
+
+			// the particles move every frame, whatever else changed; they
+			// are updated once, however many times the scene is drawn
+			if (useParticles) {
+				double now = glfwGetTime();
+				ParticleEmitter &emitter = particles.emitter();
+				emitter.position = glm::vec2(x, y);
+				emitter.direction = -rotationAngle;
+				particles.update((float)glm::min(now - lastParticleTime, 0.1));
+				lastParticleTime = now;
+				damage.invalidate();
+			}
+
+			// draw the whole scene into the target of the anti-aliasing mode
+			int renderWidth = _width, renderHeight = _height;
+			auto drawScene = [&](const RenderPass &pass) {
+				// paint the background
+				pass.begin(antiAliasing.sceneFramebuffer(), renderWidth, renderHeight);
+
+				if (useLayers) {
+					// the layer holds the pinwheel as seen by the layer camera
+					layers.setTransform(pinwheelLayer, camera.view() * glm::transpose(transform) * glm::inverse(layerCamera.view()));
+					layers.render(antiAliasing.sceneFramebuffer(), renderWidth, renderHeight);
+					if (useMoons)
+						moonShapes.draw(camera);
+					if (useAnimation)
+						animatedShapes.draw(camera, animationTime);
+					if (useTinyMeshes && pullTinyMeshes)
+						tinyMeshPuller.draw(camera);
+					else if (useTinyMeshes)
+						tinyMeshes.draw(camera);
+					if (useParticles)
+						particles.draw(camera);
+					pass.end();
+					return;
+				}
+
+				// shapes outside the view are culled before any upload
+				sceneShapes.draw(camera);
+
+				// one uniform moves every animated shape
+				if (useAnimation)
+					animatedShapes.draw(camera, animationTime);
+
+				// the small meshes in one draw, the others instanced (or all
+				// of them in one draw, pulled by the vertex shader)
+				if (useTinyMeshes && pullTinyMeshes)
+					tinyMeshPuller.draw(camera);
+				else if (useTinyMeshes)
+					tinyMeshes.draw(camera);
+
+				// post-processing passes may have changed the program and VAO
+				glUseProgram(shaderProgram);
+				glBindVertexArray(VAO);
+				camera.bind();
+				glUniform1i(shaderEdgeAA, antiAliasing.analyticEdges());
+
+				// apply the transformations
+				glUniformMatrix4fv(shaderTransform, 1, GL_TRUE, glm::value_ptr(transform));
+
+				if (useSdfShapes) {
+					// same motion as the triangles (their rotation is clockwise)
+					SdfShape &pinwheel = sdfShapes.shape(pinwheelShape);
+					pinwheel.center = glm::vec2(x, y);
+					pinwheel.rotation = -rotationAngle;
+					sdfShapes.draw(camera);
+				} else {
+					// draw the triangles
+					glDrawArrays(GL_TRIANGLES, 0, 12);
+				}
+
+				// the moons follow the pinwheel through the scene graph
+				if (useMoons)
+					moonShapes.draw(camera);
+
+				// the particles glow over everything
+				if (useParticles)
+					particles.draw(camera);
+
+				pass.end();
+			};
+
+			// refresh the statistics twice a second
+			if (glfwGetTime() - lastTitleUpdate > 0.5) {
+				lastTitleUpdate = glfwGetTime();
+				updateTitle();
+			}
+
+			if (usePartialRedraw) {
+				updateCamera(_width, _height);
+
+				// the pinwheel damages its bounds before and after it changed
+				// (FXAA also filters the pixels next to the changed ones); its
+				// scale and its shear (at most 0.4) stretch them
+				if (x != lastX || y != lastY || rotationAngle != lastAngle) {
+					float radius = sdfShapes.shape(pinwheelShape).boundingRadius() * pinwheelScale * (pinwheelShear != 0 ? 1.4f : 1.0f);
+					int margin = antiAliasing.mode() == AAMode::FXAA ? 10 : 2;
+					damage.addClipBounds(camera.toClip(AABB::around(glm::vec2(lastX, lastY), radius)), margin);
+					damage.addClipBounds(camera.toClip(AABB::around(glm::vec2(x, y), radius)), margin);
+				}
+				lastX = x;
+				lastY = y;
+				lastAngle = rotationAngle;
+
+				// nothing changed: wait for input instead of redrawing
+				const std::vector<PixelRect> &rects = damage.resolve();
+				if (rects.empty()) {
+					glfwWaitEventsTimeout(1.0 / 60.0);
+					continue;
+				}
+
+				// redraw the damaged rectangles into the retained target
+				retained.reserve(_width, _height, 0);
+				antiAliasing.resize(_width, _height);
+				antiAliasing.beginFrame(retained.id());
+				for (size_t i = 0; i < rects.size(); i++) {
+					RenderPass rectPass = scenePass;
+					drawScene(rectPass.renderArea(rects[i]));
+				}
+				antiAliasing.endFrame(retained.id(), _width, _height, rects.data(), (int)rects.size());
+				PixelRect changed = damage.bounds();
+
+				// bring the back buffer up to date: it misses the damage of
+				// every frame since it was last presented
+				PixelRect present = damage.presentRegion(presenter.bufferAge());
+				presenter.setDamageRegion(present);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, retained.id());
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				glBlitFramebuffer(present.x, present.y, present.x + present.width, present.y + present.height,
+					present.x, present.y, present.x + present.width, present.y + present.height,
+					GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+				// swap, telling the compositor what changed since the last frame
+				presenter.swap(changed);
+			} else {
+				// hold the frame time budget by adapting the render resolution
+				if (useDynamicResolution)
+					dynamicResolution.update(antiAliasing.lastFrameMilliseconds());
+				else
+					dynamicResolution.reset();
+				bool scaled = dynamicResolution.scale() < 1.0f;
+				GLuint output = 0;
+				if (scaled) {
+					output = dynamicResolution.framebuffer();
+					renderWidth = dynamicResolution.renderWidth();
+					renderHeight = dynamicResolution.renderHeight();
+				}
+
+				// bind the target of the anti-aliasing mode
+				updateCamera(renderWidth, renderHeight);
+				antiAliasing.resize(renderWidth, renderHeight);
+				antiAliasing.beginFrame(output);
+				drawScene(scenePass);
+
+				// resolve/filter the scene into the window (or the scaled target)
+				antiAliasing.endFrame(output, renderWidth, renderHeight);
+				if (scaled)
+					dynamicResolution.upscale(0);
+
+				// swap the buffers to make any changes visible
+				glfwSwapBuffers(_window);
+			}
 
 			// process remaining events
 			glfwPollEvents();
@@ -221,5 +1409,26 @@ namespace cgicmc {
 		// de-allocate all resources once they've outlived their purpose:
 		glDeleteVertexArrays(GL_TRUE, &VAO);
 		glDeleteBuffers(GL_TRUE, &VBO);
+		glDeleteProgram(shaderProgram);
+		glDeleteProgram(pickProgram);
+
+		antiAliasing.report(std::cout);
+		std::cout << "Resize events: " << resizeEvents << ", target allocations: "
+			<< Framebuffer::allocationCount() << "\n";
+		antiAliasing.destroy();
+		sdfShapes.destroy();
+		moonShapes.destroy();
+		sceneShapes.destroy();
+		particles.destroy();
+		animatedShapes.destroy();
+		tinyMeshes.destroy();
+		tinyMeshPuller.destroy();
+		camera.destroy();
+		layerCamera.destroy();
+		pickCamera.destroy();
+		picker.destroy();
+		layers.destroy();
+		retained.destroy();
+		dynamicResolution.destroy();
 	}
 }
\ No newline at end of file
@@ -1,7 +1,41 @@
 #include <cg_window.hpp>
+#include <cstring>
 
 int main(int argc, char const *argv[]) {
+  // --benchmark: time the spatial indices and storage orders over a
+  // million objects, the collision detection over 100k bodies, the rigid
+  // body physics over 20k stacked boxes, the keyframe animation of 100k
+  // objects, 10k spline path followers, 50k coroutine scripts, a scene
+  // graph of a million nodes, transform chains composed a million times,
+  // a million sines and cosines, a million tiny meshes pre-transformed,
+  // a million instances drawn from attributes and from a buffer texture
+  // (in a hidden window), and exit
+  if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0) {
+    cgicmc::benchmarkSpatialIndex(std::cout, 1000000);
+    cgicmc::benchmarkSpatialOrder(std::cout, 1000000);
+    cgicmc::benchmarkCollision(std::cout, 100000);
+    cgicmc::benchmarkPhysics(std::cout, 20000);
+    cgicmc::benchmarkAnimation(std::cout, 100000);
+    cgicmc::benchmarkPaths(std::cout, 10000);
+    cgicmc::benchmarkScripts(std::cout, 50000);
+    cgicmc::benchmarkSceneGraph(std::cout, 1000000);
+    cgicmc::benchmarkStructuredAffine(std::cout, 1000000);
+    cgicmc::benchmarkTrig(std::cout, 1000000);
+    cgicmc::benchmarkMeshBatch(std::cout, 1000000);
+    cgicmc::benchmarkInstanceStorage(std::cout, 1000000);
+    return 0;
+  }
+
   cgicmc::Window window;
   window.createWindow(500, 500);
+  // --physics: 20k stacked boxes instead of the random shapes
+  if (argc > 1 && std::strcmp(argv[1], "--physics") == 0)
+    window.addPhysicsStacks(20000);
+  else
+    window.addRandomShapes(100000, 50.0f);
+  // moved by the GPU alone, shown with the N key
+  window.addAnimatedShapes(100000, 50.0f);
+  // pre-transformed or instanced, shown with the U key
+  window.addTinyMeshes(100000, 50.0f);
   window.run();
 }